@@ -95,10 +95,10 @@ bool DistantChatService::handleOutgoingItem(RsChatItem *item)
     DISTANT_CHAT_DEBUG() << "p3ChatService::handleOutgoingItem(): sending to " << item->PeerId() << ": interpreted as a distant chat virtual peer id." << std::endl;
 #endif
     
-    uint32_t size = RsChatSerialiser().size(item) ;
-    RsTemporaryMemory mem(size) ;
+    uint32_t size = 0 ;
+    const uint8_t *mem = RsChatSerialiser().serialiseScratch(item,size) ;
     
-    if(!RsChatSerialiser().serialise(item,mem,&size))
+    if(!mem)
     {
         std::cerr << "(EE) serialisation error. Something's really wrong!" << std::endl;
         return false;
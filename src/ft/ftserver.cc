@@ -1384,15 +1384,12 @@ static const uint8_t  ENCRYPTED_FT_FORMAT_AEAD_CHACHA20_SHA256   = 0x02 ;
 bool ftServer::encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHash& hash,RsTurtleGenericDataItem *& encrypted_item)
 {
 #ifndef USE_NEW_METHOD
-    uint32_t item_serialized_size = size(clear_item) ;
-
-	RsTemporaryMemory data(item_serialized_size) ;
+	uint32_t item_serialized_size = 0 ;
+	const uint8_t *data = serialiseScratch(clear_item, item_serialized_size) ;
 
 	if(data == NULL)
 		return false ;
 
-    serialise(clear_item, data, &item_serialized_size);
-
 	uint8_t encryption_key[32] ;
 	deriveEncryptionKey(hash,encryption_key) ;
 
@@ -45,10 +45,13 @@
 #define GRP_LAST_POST_UPDATE_TRIGGER std::string("LAST_POST_UPDATE")
 
 #define MSG_INDEX_GRPID std::string("INDEX_MESSAGES_GRPID")
+#define MSG_INDEX_META std::string("INDEX_MESSAGES_META")
+#define MSG_INDEX_TS std::string("INDEX_MESSAGES_TS")
 
 // generic
 #define KEY_NXS_DATA        std::string("nxsData")
 #define KEY_NXS_DATA_LEN    std::string("nxsDataLen")
+#define KEY_NXS_BLOB        std::string("nxsBlob")
 #define KEY_NXS_IDENTITY    std::string("identity")
 #define KEY_GRP_ID          std::string("grpId")
 #define KEY_ORIG_GRP_ID     std::string("origGrpId")
@@ -111,6 +114,9 @@ const std::string RsGeneralDataService::MSG_META_STATUS = KEY_MSG_STATUS;
 
 const uint32_t RsGeneralDataService::GXS_MAX_ITEM_SIZE = 1572864; // 1.5 Mbytes
 
+// data dropped from the blob file before looking for what can be reclaimed
+static const uint32_t BLOB_COMPACT_THRESHOLD = 1024;
+
 static int addColumn(std::list<std::string> &list, const std::string &attribute)
 {
     list.push_back(attribute);
@@ -119,15 +125,36 @@ static int addColumn(std::list<std::string> &list, const std::string &attribute)
 
 RsDataService::RsDataService(const std::string &serviceDir, const std::string &dbName, uint16_t serviceType,
                              RsGxsSearchModule * /* mod */, const std::string& key)
-    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL)
+    : RsGeneralDataService(), mDbMutex("RsDataService"), mBatchMutex("RsDataService batch"), mBatchThread(), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL),
+      mBlobStore(NULL), mWriteBlobs(false), mBlobGarbage(0)
 {
     bool isNewDatabase = !RsDirUtil::fileExists(mDbPath);
 
     mDb = new RetroDb(mDbPath, RetroDb::OPEN_READWRITE_CREATE, key);
     mUseCache = true;
 
+    // Commits only append to the log and are not synced one by one, so
+    // storing what peers send is not bounded by the disk flushes
+    mDb->setWalMode();
+    mDb->setSynchronous(RetroDb::SYNCHRONOUS_NORMAL);
+
     initialise(isNewDatabase);
 
+    // The data of messages and groups goes to a file of its own, so the rows
+    // only hold meta data. A blob file written by another build is still read.
+#ifdef RS_GXS_BLOB_STORE
+    mWriteBlobs = true;
+#endif
+    const std::string blobPath = mDbPath + "_blobs";
+    if (mWriteBlobs || RsDirUtil::fileExists(blobPath)) {
+        mBlobStore = new RsGxsBlobStore(blobPath, key);
+        if (!mBlobStore->open()) {
+            RsErr() << "Cannot open blob file of database " << mDbName << ", data is stored in the rows" << std::endl;
+            delete mBlobStore;
+            mBlobStore = NULL;
+        }
+    }
+
     // for retrieving msg meta
     mColMsgMeta_GrpId         = addColumn(mMsgMetaColumns, KEY_GRP_ID);
     mColMsgMeta_TimeStamp     = addColumn(mMsgMetaColumns, KEY_TIME_STAMP);
@@ -151,6 +178,7 @@ RsDataService::RsDataService(const std::string &serviceDir, const std::string &d
     mColMsg_NxsData = addColumn(mMsgColumns, KEY_NXS_DATA);
     mColMsg_MetaData = addColumn(mMsgColumns, KEY_NXS_META);
     mColMsg_MsgId = addColumn(mMsgColumns, KEY_MSG_ID);
+    mColMsg_NxsBlob = addColumn(mMsgColumns, KEY_NXS_BLOB);
 
     // for retrieving msg data with meta
     mMsgColumnsWithMeta = mMsgColumns;
@@ -188,6 +216,7 @@ RsDataService::RsDataService(const std::string &serviceDir, const std::string &d
     mColGrp_GrpId = addColumn(mGrpColumns, KEY_GRP_ID);
     mColGrp_NxsData = addColumn(mGrpColumns, KEY_NXS_DATA);
     mColGrp_MetaData = addColumn(mGrpColumns, KEY_NXS_META);
+    mColGrp_NxsBlob = addColumn(mGrpColumns, KEY_NXS_BLOB);
 
     // for retrieving grp data with meta
     mGrpColumnsWithMeta = mGrpColumns;
@@ -210,6 +239,12 @@ RsDataService::~RsDataService(){
 
     mDb->closeDb();
     delete mDb;
+
+    // the compaction thread uses the blob file
+    if(mBlobCompaction.valid())
+        mBlobCompaction.wait();
+
+    delete mBlobStore;
 }
 
 static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir, const std::string &tableName, const std::string &keyId, std::list<std::string> &files)
@@ -289,13 +324,42 @@ static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir
     return ok;
 }
 
+/*!
+ * Index of the messages by group and message id. Listing the message ids of a
+ * group, and the parents, threads and ages related messages and clean up passes
+ * look for, only read it. The other meta data columns, signatures and names
+ * among them, stay in the table rows, so the index is not a second copy of them
+ * to update on every insert.
+ */
+static bool createMsgMetaIndex(RetroDb *db)
+{
+    return db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_META + " ON " + MSG_TABLE_NAME + "(" +
+                       KEY_GRP_ID + "," +
+                       KEY_MSG_ID + "," +
+                       KEY_MSG_PARENT_ID + "," +
+                       KEY_MSG_THREAD_ID + "," +
+                       KEY_TIME_STAMP + ");");
+}
+
+/*
+ * Pages of a group by publish time read their rows in index order, and stop
+ * at the page size.
+ */
+static bool createMsgTsIndex(RetroDb *db)
+{
+    return db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_TS + " ON " + MSG_TABLE_NAME + "(" +
+                       KEY_GRP_ID + "," +
+                       KEY_TIME_STAMP + "," +
+                       KEY_MSG_ID + ");");
+}
+
 void RsDataService::initialise(bool isNewDatabase)
 {
-    const int databaseRelease = 1;
+    const int databaseRelease = 5;
     int currentDatabaseRelease = 0;
     bool ok = true;
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     // initialise database
 
@@ -318,6 +382,7 @@ void RsDataService::initialise(bool isNewDatabase)
                      KEY_SIGN_SET + " BLOB," +
                      KEY_NXS_DATA + " BLOB,"+
                      KEY_NXS_DATA_LEN + " INT," +
+                     KEY_NXS_BLOB + " BLOB," +
                      KEY_MSG_STATUS + " INT," +
                      KEY_CHILD_TS + " INT," +
                      KEY_NXS_META + " BLOB," +
@@ -334,6 +399,7 @@ void RsDataService::initialise(bool isNewDatabase)
                      KEY_TIME_STAMP + " INT," +
                      KEY_NXS_DATA + " BLOB," +
                      KEY_NXS_DATA_LEN + " INT," +
+                     KEY_NXS_BLOB + " BLOB," +
                      KEY_KEY_SET + " BLOB," +
                      KEY_NXS_META + " BLOB," +
                      KEY_GRP_NAME + " TEXT," +
@@ -365,7 +431,8 @@ void RsDataService::initialise(bool isNewDatabase)
                 + KEY_RECV_TS + " WHERE " + KEY_GRP_ID + "=new." + KEY_GRP_ID + ";"
                 + std::string("END;"));
 
-        mDb->execSQL("CREATE INDEX " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
+        createMsgMetaIndex(mDb);
+        createMsgTsIndex(mDb);
 
         // Insert release, no need to upgrade
         ContentValue cv;
@@ -441,6 +508,64 @@ void RsDataService::initialise(bool isNewDatabase)
                 currentDatabaseRelease = newRelease;
             }
         }
+
+        // Release 2
+        newRelease = 2;
+        if (ok && currentDatabaseRelease < newRelease) {
+            ok = startReleaseUpdate(newRelease);
+
+            // Replace the group id index, which is a prefix of the new one
+            ok = ok && createMsgMetaIndex(mDb);
+            ok = ok && mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID + ";");
+
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
+
+        // Release 3
+        newRelease = 3;
+        if (ok && currentDatabaseRelease < newRelease) {
+            ok = startReleaseUpdate(newRelease);
+
+            // Address of the data in the blob file, the data already stored stays in the rows
+            ok = ok && mDb->execSQL("ALTER TABLE " + GRP_TABLE_NAME + " ADD COLUMN " + KEY_NXS_BLOB + " BLOB;");
+            ok = ok && mDb->execSQL("ALTER TABLE " + MSG_TABLE_NAME + " ADD COLUMN " + KEY_NXS_BLOB + " BLOB;");
+
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
+
+        // Release 4
+        newRelease = 4;
+        if (ok && currentDatabaseRelease < newRelease) {
+            ok = startReleaseUpdate(newRelease);
+
+            ok = ok && createMsgTsIndex(mDb);
+
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
+
+        // Release 5
+        newRelease = 5;
+        if (ok && currentDatabaseRelease < newRelease) {
+            ok = startReleaseUpdate(newRelease);
+
+            // The meta index of release 2 held every meta data column
+            ok = ok && mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_META + ";");
+            ok = ok && createMsgMetaIndex(mDb);
+
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
     }
 
     if (ok) {
@@ -629,9 +754,10 @@ RsNxsGrp* RsDataService::locked_getGroup(RetroCursor &c)
 
     /* now retrieve grp data */
     offset = 0; data_len = 0;
+    std::vector<uint8_t> blob;
     if(ok){
-        data = (char*)c.getData(mColGrp_NxsData, data_len);
-        if(data)
+        ok &= locked_getNxsData(c, mColGrp_NxsData, mColGrp_NxsBlob, data, data_len, blob);
+        if(ok && data)
             ok &= grp->grp.GetTlv(data, data_len, &offset);
     }
 
@@ -741,9 +867,10 @@ RsNxsMsg* RsDataService::locked_getMessage(RetroCursor &c)
 
     /* now retrieve msg data */
     offset = 0; data_len = 0;
+    std::vector<uint8_t> blob;
     if(ok){
-        data = (char*)c.getData(mColMsg_NxsData, data_len);
-        if(data)
+        ok &= locked_getNxsData(c, mColMsg_NxsData, mColMsg_NxsBlob, data, data_len, blob);
+        if(ok && data)
             ok &= msg->msg.GetTlv(data, data_len, &offset);
     }
 
@@ -757,7 +884,7 @@ RsNxsMsg* RsDataService::locked_getMessage(RetroCursor &c)
 int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
 {
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     // start a transaction
     mDb->beginTransaction();
@@ -790,7 +917,7 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         char msgData[dataLen];
         uint32_t offset = 0;
         msgPtr->msg.SetTlv(msgData, dataLen, &offset);
-        cv.put(KEY_NXS_DATA, dataLen, msgData);
+        locked_putNxsData(cv, msgData, dataLen);
 
         cv.put(KEY_NXS_DATA_LEN, (int32_t)dataLen);
         cv.put(KEY_MSG_ID, msgMetaPtr->mMsgId.toStdString());
@@ -842,6 +969,10 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         delete *mit;
     }
 
+    // the rows must not reach the disk before their data
+    if(mBlobStore)
+        mBlobStore->sync();
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
@@ -859,7 +990,7 @@ bool RsDataService::validSize(RsNxsMsg* msg) const
 int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 {
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     // begin transaction
     mDb->beginTransaction();
@@ -893,7 +1024,7 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 		char grpData[dataLen];
 		uint32_t offset = 0;
 		grpPtr->grp.SetTlv(grpData, dataLen, &offset);
-		cv.put(KEY_NXS_DATA, dataLen, grpData);
+		locked_putNxsData(cv, grpData, dataLen);
 
 		cv.put(KEY_NXS_DATA_LEN, (int32_t) dataLen);
 		cv.put(KEY_GRP_ID, grpPtr->grpId.toStdString());
@@ -943,6 +1074,10 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 
         delete *sit;
 	}
+
+    if(mBlobStore)
+        mBlobStore->sync();
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
@@ -952,7 +1087,7 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 int RsDataService::updateGroup(const std::list<RsNxsGrp *> &grp)
 {
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     // begin transaction
     mDb->beginTransaction();
@@ -979,7 +1114,7 @@ int RsDataService::updateGroup(const std::list<RsNxsGrp *> &grp)
         char grpData[dataLen];
         uint32_t offset = 0;
         grpPtr->grp.SetTlv(grpData, dataLen, &offset);
-        cv.put(KEY_NXS_DATA, dataLen, grpData);
+        locked_putNxsData(cv, grpData, dataLen);
 
         cv.put(KEY_NXS_DATA_LEN, (int32_t) dataLen);
         cv.put(KEY_GRP_ID, grpPtr->grpId.toStdString());
@@ -1019,17 +1154,27 @@ int RsDataService::updateGroup(const std::list<RsNxsGrp *> &grp)
 
         mGrpMetaDataCache.updateMeta(grpMetaPtr->mGroupId,*grpMetaPtr);
 
+        // the previous data of the group
+        if(mBlobStore)
+            ++mBlobGarbage;
+
         delete *sit;
     }
+
+    if(mBlobStore)
+        mBlobStore->sync();
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
+    locked_compactBlobs(false);
+
     return ret;
 }
 
 int RsDataService::updateGroupKeys(const RsGxsGroupId& grpId,const RsTlvSecurityKeySet& keys,uint32_t subscribe_flags)
 {
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     // begin transaction
     mDb->beginTransaction();
@@ -1074,7 +1219,7 @@ int RsDataService::retrieveNxsGrps(std::map<RsGxsGroupId, RsNxsGrp *> &grp, bool
 
     if(grp.empty())
     {
-        RsStackMutex stack(mDbMutex);
+        DbStackMutex stack(*this);
         RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, withMeta ? mGrpColumnsWithMeta : mGrpColumns, "", "");
 
         if(c)
@@ -1099,7 +1244,7 @@ int RsDataService::retrieveNxsGrps(std::map<RsGxsGroupId, RsNxsGrp *> &grp, bool
     }
     else
     {
-        RsStackMutex stack(mDbMutex);
+        DbStackMutex stack(*this);
         std::map<RsGxsGroupId, RsNxsGrp *>::iterator mit = grp.begin();
 
         std::list<RsGxsGroupId> toRemove;
@@ -1107,7 +1252,9 @@ int RsDataService::retrieveNxsGrps(std::map<RsGxsGroupId, RsNxsGrp *> &grp, bool
         for(; mit != grp.end(); ++mit)
         {
             const RsGxsGroupId& grpId = mit->first;
-            RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, withMeta ? mGrpColumnsWithMeta : mGrpColumns, "grpId='" + grpId.toStdString() + "'", "");
+            std::list<RetroBind*> binds;
+            binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+            RetroCursor* c = mDb->sqlQuery_bind(GRP_TABLE_NAME, withMeta ? mGrpColumnsWithMeta : mGrpColumns, KEY_GRP_ID + "=?", binds, "");
 
             if(c)
             {
@@ -1185,9 +1332,11 @@ int RsDataService::retrieveNxsMsgs(const GxsMsgReq &reqIds, GxsMsgResult &msg,
 
 		if(msgIdV.empty())
 		{
-			RS_STACK_MUTEX(mDbMutex);
+			DbStackMutex stack(*this);
 
-            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+            std::list<RetroBind*> binds;
+            binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+            RetroCursor* c = mDb->sqlQuery_bind(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID + "=?", binds, "");
 
             if(c)
                 locked_retrieveMessages(c, msgSet, withMeta ? mColMsg_WithMetaOffset : 0);
@@ -1196,7 +1345,7 @@ int RsDataService::retrieveNxsMsgs(const GxsMsgReq &reqIds, GxsMsgResult &msg,
 		}
 		else
 		{
-			RS_STACK_MUTEX(mDbMutex);
+			DbStackMutex stack(*this);
 
             // request each grp
 			for( std::set<RsGxsMessageId>::const_iterator sit = msgIdV.begin();
@@ -1204,8 +1353,10 @@ int RsDataService::retrieveNxsMsgs(const GxsMsgReq &reqIds, GxsMsgResult &msg,
 			{
                 const RsGxsMessageId& msgId = *sit;
 
-                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
-                                               + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
+                std::list<RetroBind*> binds;
+                binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+                binds.push_back(new RsStringBind(msgId.toStdString(), 2));
+                RetroCursor* c = mDb->sqlQuery_bind(MSG_TABLE_NAME, withMeta ? mMsgColumnsWithMeta : mMsgColumns, KEY_GRP_ID + "=? AND " + KEY_MSG_ID + "=?", binds, "");
 
                 if(c)
                 {
@@ -1254,7 +1405,7 @@ void RsDataService::locked_retrieveMessages(RetroCursor *c, std::vector<RsNxsMsg
 
 int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta)
 {
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     rstime::RsScopeTimer timer("");
@@ -1278,7 +1429,9 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
                 cache->getFullMetaList(msgMeta[grpId]);
             else
 			{
-				RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+				std::list<RetroBind*> binds;
+				binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+				RetroCursor* c = mDb->sqlQuery_bind(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID + "=?", binds, "");
 
 				if (c)
 				{
@@ -1308,7 +1461,13 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
                     metaSet.push_back(meta);
                 else
 				{
-					RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
+					std::list<RetroBind*> binds;
+					binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+					binds.push_back(new RsStringBind(msgId.toStdString(), 2));
+					RetroCursor* c = mDb->sqlQuery_bind(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID + "=? AND " + KEY_MSG_ID + "=?", binds, "");
+
+                    if(!c)
+                        continue;
 
                     c->moveToFirst();
                     auto meta = locked_getMsgMeta(*c, 0);
@@ -1379,6 +1538,62 @@ void RsDataService::locked_retrieveMsgMetaList(RetroCursor *c, std::vector<std::
 	}
 }
 
+int RsDataService::retrieveGxsMsgMetaPage( const RsGxsGroupId& grpId, uint32_t pageSize,
+                                           RsGxsMsgPageOrder order, const RsGxsMsgPageCursor& after,
+                                           std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMeta )
+{
+    DbStackMutex stack(*this);
+
+    std::list<RetroBind*> binds;
+    binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+
+    std::string selection = KEY_GRP_ID + "=?";
+    std::string orderBy;
+
+    // the row values follow the indexes, so the page starts with a seek
+    if (order == RsGxsMsgPageOrder::PUBLISH_TS || order == RsGxsMsgPageOrder::PUBLISH_TS_DESC)
+    {
+        const bool desc = (order == RsGxsMsgPageOrder::PUBLISH_TS_DESC);
+
+        if (!after.isNull())
+        {
+            selection += " AND (" + KEY_TIME_STAMP + "," + KEY_MSG_ID + ")" + (desc ? "<" : ">") + "(?,?)";
+            binds.push_back(new RsInt32Bind((int32_t)after.mPublishTs, 2));
+            binds.push_back(new RsStringBind(after.mMsgId.toStdString(), 3));
+        }
+
+        orderBy = KEY_TIME_STAMP + (desc ? " DESC," : ",") + KEY_MSG_ID + (desc ? " DESC" : "");
+    }
+    else
+    {
+        if (!after.isNull())
+        {
+            selection += " AND " + KEY_MSG_ID + ">?";
+            binds.push_back(new RsStringBind(after.mMsgId.toStdString(), 2));
+        }
+
+        orderBy = KEY_MSG_ID;
+    }
+
+    orderBy += " LIMIT ?";
+    binds.push_back(new RsInt32Bind((int32_t)std::min<uint32_t>(pageSize, INT32_MAX), binds.size() + 1));
+
+    RetroCursor* c = mDb->sqlQuery_bind(MSG_TABLE_NAME, mMsgMetaColumns, selection, binds, orderBy);
+
+    if (!c)
+        return 0;
+
+    // A page is a small part of the group, it doesn't make the cache of the
+    // group up to date and would only grow it
+    const bool useCache = mUseCache;
+    mUseCache = false;
+    locked_retrieveMsgMetaList(c, msgMeta);
+    mUseCache = useCache;
+
+    delete c;
+    return 1;
+}
+
 int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<RsGxsGrpMetaData> >& grp)
 {
 #ifdef RS_DATA_SERVICE_DEBUG
@@ -1386,7 +1601,7 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
     std::cerr << std::endl;
 #endif
 
-	RS_STACK_MUTEX(mDbMutex);
+	DbStackMutex stack(*this);
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     rstime::RsScopeTimer timer("");
@@ -1442,7 +1657,12 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
 #endif
 
 				const RsGxsGroupId& grpId = mit->first;
-				RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "grpId='" + grpId.toStdString() + "'", "");
+				std::list<RetroBind*> binds;
+				binds.push_back(new RsStringBind(grpId.toStdString(), 1));
+				RetroCursor* c = mDb->sqlQuery_bind(GRP_TABLE_NAME, mGrpMetaColumns, KEY_GRP_ID + "=?", binds, "");
+
+				if(!c)
+					continue;
 
 				c->moveToFirst();
 
@@ -1483,6 +1703,80 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
     return 1;
 }
 
+bool RsDataService::setSynchronous(int level)
+{
+    DbStackMutex stack(*this);
+    return mDb->setSynchronous(level);
+}
+
+RsDataService::DbStackMutex::DbStackMutex(RsDataService& ds) :
+    mDs(ds), mBatchLocked(ds.mBatchThread != std::this_thread::get_id())
+{
+    // the changes of a batch are not committed yet, other threads must not
+    // write in between nor commit them
+    if(mBatchLocked) mDs.mBatchMutex.lock();
+    mDs.mDbMutex.lock();
+}
+
+RsDataService::DbStackMutex::~DbStackMutex()
+{
+    mDs.mDbMutex.unlock();
+    if(mBatchLocked) mDs.mBatchMutex.unlock();
+}
+
+bool RsDataService::runInBatch(const std::function<bool()>& changes)
+{
+    const bool outermost = mBatchThread != std::this_thread::get_id();
+    if(outermost)
+    {
+        mBatchMutex.lock();
+        mBatchThread = std::this_thread::get_id();
+    }
+
+    bool ok;
+    {
+        RS_STACK_MUTEX(mDbMutex);
+        ok = mDb->beginTransaction();
+    }
+
+    if(ok)
+    {
+        ok = changes();
+
+        RS_STACK_MUTEX(mDbMutex);
+        if(!ok)
+            mDb->rollbackTransaction();
+        else if(!mDb->commitTransaction())
+        {
+            // a failed commit of the outermost batch may leave it open
+            if(outermost && mDb->inTransaction())
+                mDb->rollbackTransaction();
+            ok = false;
+        }
+
+        if(!ok)
+        {
+            std::cerr << "RsDataService::runInBatch(): batch of " << mDbName
+                      << " rolled back" << std::endl;
+
+            // the caches may hold changes which have been rolled back
+            mGrpMetaDataCache = t_MetaDataCache<RsGxsGroupId,RsGxsGrpMetaData>();
+            mMsgMetaDataCache.clear();
+        }
+
+        if(outermost)
+            locked_compactBlobs(false);
+    }
+
+    if(outermost)
+    {
+        mBatchThread = std::thread::id();
+        mBatchMutex.unlock();
+    }
+
+    return ok;
+}
+
 int RsDataService::resetDataStore()
 {
 
@@ -1491,13 +1785,17 @@ int RsDataService::resetDataStore()
 #endif
 
     {
-        RsStackMutex stack(mDbMutex);
+        DbStackMutex stack(*this);
 
-        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_META);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_TS);
         mDb->execSQL("DROP TABLE " + DATABASE_RELEASE_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + MSG_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + GRP_TABLE_NAME);
         mDb->execSQL("DROP TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER);
+
+        locked_compactBlobs(true);
     }
 
     // recreate database
@@ -1512,7 +1810,7 @@ int RsDataService::updateGroupMetaData(const GrpLocMetaData& meta)
     std::cerr << (void*)this << ": Updating Grp Meta data: grpId = " << meta.grpId << std::endl;
 #endif
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
     const RsGxsGroupId& grpId = meta.grpId;
 
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
@@ -1551,7 +1849,7 @@ int RsDataService::updateMessageMetaData(const MsgLocMetaData& metaData)
     std::cerr << (void*)this << ": Updating Msg Meta data: grpId = " << metaData.msgId.first << " msgId = " << metaData.msgId.second << std::endl;
 #endif
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
     const RsGxsGroupId& grpId = metaData.msgId.first;
     const RsGxsMessageId& msgId = metaData.msgId.second;
 
@@ -1583,7 +1881,7 @@ int RsDataService::updateMessageMetaData(const MsgLocMetaData& metaData)
 
 int RsDataService::removeMsgs(const GxsMsgReq& msgIds)
 {
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     GxsMsgReq::const_iterator mit = msgIds.begin();
 
@@ -1604,7 +1902,7 @@ int RsDataService::removeMsgs(const GxsMsgReq& msgIds)
 int RsDataService::removeGroups(const std::vector<RsGxsGroupId> &grpIds)
 {
 
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
     locked_removeGroupEntries(grpIds);
 
@@ -1613,7 +1911,7 @@ int RsDataService::removeGroups(const std::vector<RsGxsGroupId> &grpIds)
 
 int RsDataService::retrieveGroupIds(std::vector<RsGxsGroupId> &grpIds)
 {
-    RsStackMutex stack(mDbMutex);
+    DbStackMutex stack(*this);
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     rstime::RsScopeTimer timer("");
@@ -1711,9 +2009,13 @@ bool RsDataService::locked_removeMessageEntries(const GxsMsgReq& msgIds)
 
             cache.clear(msgId);
         }
+
+        if(mBlobStore)
+            mBlobGarbage += msgsV.size();
     }
 
     ret &= mDb->commitTransaction();
+    locked_compactBlobs(false);
 
     return ret;
 }
@@ -1731,10 +2033,126 @@ bool RsDataService::locked_removeGroupEntries(const std::vector<RsGxsGroupId>& g
 		mGrpMetaDataCache.clear(grpId) ;
     }
 
+    if(mBlobStore)
+        mBlobGarbage += grpIds.size();
+
     ret &= mDb->commitTransaction();
+    locked_compactBlobs(false);
+
     return ret;
 }
 
+void RsDataService::locked_putNxsData(ContentValue& cv, const char* data, uint32_t len)
+{
+    Sha256CheckSum address;
+
+    if(mWriteBlobs && mBlobStore && mBlobStore->put(reinterpret_cast<const uint8_t*>(data), len, address))
+    {
+        cv.put(KEY_NXS_DATA, 0, NULL);
+        cv.put(KEY_NXS_BLOB, Sha256CheckSum::SIZE_IN_BYTES, reinterpret_cast<const char*>(address.toByteArray()));
+    }
+    else
+    {
+        // both are set for updates, a row doesn't hold both
+        cv.put(KEY_NXS_DATA, len, data);
+        cv.put(KEY_NXS_BLOB, 0, NULL);
+    }
+}
+
+bool RsDataService::locked_getNxsData(RetroCursor& c, int dataCol, int blobCol, char*& data, uint32_t& len, std::vector<uint8_t>& buf)
+{
+    uint32_t addressLen = 0;
+    const uint8_t* address = static_cast<const uint8_t*>(c.getData(blobCol, addressLen));
+
+    if(!address || addressLen != Sha256CheckSum::SIZE_IN_BYTES)
+    {
+        data = (char*)c.getData(dataCol, len);
+        return true;
+    }
+
+    const Sha256CheckSum blobAddress = Sha256CheckSum::fromBufferUnsafe(address);
+    if(!mBlobStore || !mBlobStore->get(blobAddress, buf))
+    {
+        RsErr() << __PRETTY_FUNCTION__ << " data " << blobAddress << " missing from the blob file of " << mDbName << std::endl;
+        data = NULL;
+        len = 0;
+        return false;
+    }
+
+    data = reinterpret_cast<char*>(buf.data());
+    len = buf.size();
+    return true;
+}
+
+void RsDataService::locked_compactBlobs(bool force)
+{
+    // rows deleted in a transaction still open could come back
+    if(!mBlobStore || mDb->inTransaction())
+        return;
+
+    if(!force && mBlobGarbage < BLOB_COMPACT_THRESHOLD)
+        return;
+
+    // the next one will drop what this one can't see
+    if( mBlobCompaction.valid() &&
+        mBlobCompaction.wait_for(std::chrono::seconds(0)) != std::future_status::ready )
+    {
+        if(force)
+            mBlobGarbage = BLOB_COMPACT_THRESHOLD;
+        return;
+    }
+
+    mBlobGarbage = 0;
+
+    // The data still referenced. After resetDataStore() there is no table,
+    // and nothing to keep.
+    std::set<Sha256CheckSum> live;
+    std::list<std::string> columns;
+    columns.push_back(KEY_NXS_BLOB);
+
+    const std::string tables[] = { MSG_TABLE_NAME, GRP_TABLE_NAME };
+    for(const std::string& table : tables)
+    {
+        if(!mDb->tableExists(table))
+        {
+            if(force) continue;
+            return;
+        }
+
+        RetroCursor* c = mDb->sqlQuery(table, columns, KEY_NXS_BLOB + " IS NOT NULL", "");
+        if(!c)
+            return;
+
+        for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+        {
+            uint32_t len = 0;
+            const uint8_t* address = static_cast<const uint8_t*>(c->getData(0, len));
+
+            if(address && len == Sha256CheckSum::SIZE_IN_BYTES)
+                live.insert(Sha256CheckSum::fromBufferUnsafe(address));
+        }
+
+        delete c;
+    }
+
+    // not worth rewriting the file for less than a quarter of it
+    const uint64_t fileSize = mBlobStore->fileSize();
+    if(!force && mBlobStore->usedSize(live) * 4 > fileSize * 3)
+        return;
+
+    // The set of data referenced is taken under the database lock, the
+    // records are copied without it, data keeps being put and read meanwhile
+    if(!mBlobStore->beginCompaction(live))
+        return;
+
+    mBlobCompaction = std::async(std::launch::async, [this]()
+    {
+        uint64_t reclaimed = 0;
+        if(mBlobStore->finishCompaction(reclaimed))
+            RsInfo() << "Blob file of database " << mDbName << " compacted, " << reclaimed << " bytes reclaimed" << std::endl;
+    });
+}
+
 uint32_t RsDataService::cacheSize() const {
     return 0;
 }
@@ -1746,7 +2164,7 @@ int RsDataService::setCacheSize(uint32_t /* size */)
 
 void RsDataService::debug_printCacheSize()
 {
-    RS_STACK_MUTEX(mDbMutex);
+    DbStackMutex stack(*this);
 
     uint32_t nb_items;
     uint64_t total_size;
@@ -22,7 +22,12 @@
 #ifndef RSDATASERVICE_H
 #define RSDATASERVICE_H
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 #include "gxs/rsgds.h"
+#include "gxs/rsgxsblobstore.h"
 #include "util/retrodb.h"
 
 class MsgUpdate
@@ -168,6 +173,14 @@ public:
      */
     int retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta) override;
 
+    /*!
+     * Reads the page from the database, leaving the meta data cache alone
+     * @see RsGeneralDataService::retrieveGxsMsgMetaPage
+     */
+    int retrieveGxsMsgMetaPage( const RsGxsGroupId& grpId, uint32_t pageSize,
+                                RsGxsMsgPageOrder order, const RsGxsMsgPageCursor& after,
+                                std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMeta ) override;
+
     /*!
      * remove msgs in data store
      * @param grpId group Id of message to be removed
@@ -256,6 +269,15 @@ public:
      */
     int resetDataStore() override;
 
+    bool runInBatch(const std::function<bool()>& changes) override;
+
+    /*!
+     * Change the durability of the commits, SYNCHRONOUS_NORMAL by default
+     * @param level one of RetroDb::SYNCHRONOUS_*
+     * @return true/false
+     */
+    bool setSynchronous(int level);
+
     bool validSize(RsNxsMsg* msg) const override;
     bool validSize(RsNxsGrp* grp) const override;
 
@@ -338,6 +360,27 @@ private:
     bool locked_removeMessageEntries(const GxsMsgReq& msgIds);
     bool locked_removeGroupEntries(const std::vector<RsGxsGroupId>& grpIds);
 
+    /*!
+     * Puts the nxs data in cv, in the blob file if it is written to, in the
+     * row otherwise
+     */
+    void locked_putNxsData(ContentValue& cv, const char* data, uint32_t len);
+
+    /*!
+     * Nxs data at the current position of c, from the blob file if the row
+     * holds its address
+     * @param buf holds the data read from the blob file
+     * @return false if the data is missing from the blob file
+     */
+    bool locked_getNxsData(RetroCursor& c, int dataCol, int blobCol, char*& data, uint32_t& len, std::vector<uint8_t>& buf);
+
+    /*!
+     * Rewrites the blob file without the data no row references anymore,
+     * once enough has been dropped
+     * @param force whatever has been dropped
+     */
+    void locked_compactBlobs(bool force);
+
 private:
     /*!
      * Start release update
@@ -356,8 +399,27 @@ private:
 
 private:
 
+    /*!
+     * Locks mDbMutex, after waiting for the batch of another thread to end.
+     * Every access to mDb goes through it.
+     */
+    class DbStackMutex
+    {
+    public:
+        explicit DbStackMutex(RsDataService& ds);
+        ~DbStackMutex();
+
+    private:
+        RsDataService& mDs;
+        bool mBatchLocked;
+    };
+
     RsMutex mDbMutex;
 
+    /// held by the thread running a batch, for the whole batch
+    RsMutex mBatchMutex;
+    std::atomic<std::thread::id> mBatchThread;
+
     std::list<std::string> mMsgColumns;
     std::list<std::string> mMsgMetaColumns;
     std::list<std::string> mMsgColumnsWithMeta;
@@ -391,6 +453,7 @@ private:
     int mColMsg_NxsData;
     int mColMsg_MetaData;
     int mColMsg_MsgId;
+    int mColMsg_NxsBlob;
 
     // Message columns with meta
     int mColMsg_WithMetaOffset;
@@ -426,6 +489,7 @@ private:
     int mColGrp_GrpId;
     int mColGrp_NxsData;
     int mColGrp_MetaData;
+    int mColGrp_NxsBlob;
 
     // Group columns with meta
     int mColGrp_WithMetaOffset;
@@ -442,6 +506,12 @@ private:
     uint16_t mServType;
 
     RetroDb* mDb;
+
+    // nxs data kept out of the rows, NULL if there is no blob file
+    RsGxsBlobStore* mBlobStore;
+    bool mWriteBlobs;
+    uint32_t mBlobGarbage;	// data dropped since the last compaction
+    std::future<void> mBlobCompaction;	// records being copied by a thread of their own
     
     // used to store metadata instead of reading it from the database.
     // The boolean variable below is also used to force re-reading when 
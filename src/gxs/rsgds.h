@@ -25,6 +25,7 @@
 #include <set>
 #include <map>
 #include <string>
+#include <functional>
 
 #include "inttypes.h"
 
@@ -175,6 +176,17 @@ public:
      */
     virtual int retrieveGxsMsgMetaData(const GxsMsgReq& msgIds, GxsMsgMetaResult& msgMeta) = 0;
 
+    /*!
+     * Retrieves one page of the meta data of the messages of a group, without
+     * reading the rest of the group
+     * @param after last message of the previous page, null for the first page
+     * @param msgMeta the page, at most pageSize entries in order
+     * @return error code
+     */
+    virtual int retrieveGxsMsgMetaPage( const RsGxsGroupId& grpId, uint32_t pageSize,
+                                        RsGxsMsgPageOrder order, const RsGxsMsgPageCursor& after,
+                                        std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMeta ) = 0;
+
     /*!
      * remove msgs in data store listed in msgIds param
      * @param msgIds ids of messages to be removed
@@ -255,6 +267,15 @@ public:
 
     virtual int updateGroupKeys(const RsGxsGroupId& grpId,const RsTlvSecurityKeySet& keys,uint32_t subscribed_flags) = 0 ;
 
+    /*!
+     * Run changes in a single transaction, so that they reach the disk at
+     * once. Until it returns, calls from other threads wait, while changes
+     * can call this data service (and nest batches).
+     * @param changes returns false to roll the batch back
+     * @return true if the changes have been committed
+     */
+    virtual bool runInBatch(const std::function<bool()>& changes) = 0;
+
     /*!
      * Completely clear out data stored in
      * and returns this to a state
@@ -2061,67 +2061,75 @@ void RsGenExchange::processMsgMetaChanges()
     }
 
     GxsMsgReq msgIds;
+    std::map<uint32_t, bool> applied;
 
-    std::map<uint32_t, MsgLocMetaData>::iterator mit;
-    for (mit = metaMap.begin(); mit != metaMap.end(); ++mit)
+    // one commit for all the changes rather than one per message. Tokens are
+    // only told once the batch is committed
+    bool committed = mDataStore->runInBatch([&]()
     {
-        MsgLocMetaData& m = mit->second;
+        std::map<uint32_t, MsgLocMetaData>::iterator mit;
+        for (mit = metaMap.begin(); mit != metaMap.end(); ++mit)
+        {
+            MsgLocMetaData& m = mit->second;
 
-		int32_t value, mask;
-        bool ok = true;
-        bool changed = false;
+            int32_t value, mask;
+            bool ok = true;
+            bool changed = false;
 
-        // for meta flag changes get flag to apply mask
-        if(m.val.getAsInt32(RsGeneralDataService::MSG_META_STATUS, value))
-        {
-            ok = false;
-            if(m.val.getAsInt32(RsGeneralDataService::MSG_META_STATUS+GXS_MASK, mask))
+            // for meta flag changes get flag to apply mask
+            if(m.val.getAsInt32(RsGeneralDataService::MSG_META_STATUS, value))
             {
-                GxsMsgReq req;
-                std::set<RsGxsMessageId> msgIdV;
-                msgIdV.insert(m.msgId.second);
-                req.insert(std::make_pair(m.msgId.first, msgIdV));
-                GxsMsgMetaResult result;
-                mDataStore->retrieveGxsMsgMetaData(req, result);
-                GxsMsgMetaResult::iterator mit = result.find(m.msgId.first);
-
-                if(mit != result.end())
+                ok = false;
+                if(m.val.getAsInt32(RsGeneralDataService::MSG_META_STATUS+GXS_MASK, mask))
                 {
-                    const auto& msgMetaV = mit->second;
-
-                    if(!msgMetaV.empty())
+                    GxsMsgReq req;
+                    std::set<RsGxsMessageId> msgIdV;
+                    msgIdV.insert(m.msgId.second);
+                    req.insert(std::make_pair(m.msgId.first, msgIdV));
+                    GxsMsgMetaResult result;
+                    mDataStore->retrieveGxsMsgMetaData(req, result);
+                    GxsMsgMetaResult::iterator mit = result.find(m.msgId.first);
+
+                    if(mit != result.end())
                     {
-                        const auto& meta = *(msgMetaV.begin());
-                        value = (meta->mMsgStatus & ~mask) | (mask & value);
-						changed = (static_cast<int64_t>(meta->mMsgStatus) != value);
-                        m.val.put(RsGeneralDataService::MSG_META_STATUS, value);
-                        ok = true;
+                        const auto& msgMetaV = mit->second;
+
+                        if(!msgMetaV.empty())
+                        {
+                            const auto& meta = *(msgMetaV.begin());
+                            value = (meta->mMsgStatus & ~mask) | (mask & value);
+                            changed = (static_cast<int64_t>(meta->mMsgStatus) != value);
+                            m.val.put(RsGeneralDataService::MSG_META_STATUS, value);
+                            ok = true;
+                        }
                     }
+                    m.val.removeKeyValue(RsGeneralDataService::MSG_META_STATUS+GXS_MASK);
                 }
-                m.val.removeKeyValue(RsGeneralDataService::MSG_META_STATUS+GXS_MASK);
             }
-        }
 
-        ok &= mDataStore->updateMessageMetaData(m) == 1;
-        uint32_t token = mit->first;
+            ok &= mDataStore->updateMessageMetaData(m) == 1;
+            applied[mit->first] = ok;
 
-        if(ok)
-        {
-            mDataAccess->updatePublicRequestStatus(token, RsTokenService::COMPLETE);
-            if (changed)
-            {
+            if(ok && changed)
                 msgIds[m.msgId.first].insert(m.msgId.second);
-            }
-        }
-        else
-        {
-            mDataAccess->updatePublicRequestStatus(token, RsTokenService::FAILED);
         }
 
-        {
-            RS_STACK_MUTEX(mGenMtx);
-            mMsgNotify.insert(std::make_pair(token, m.msgId));
-        }
+        return true;
+    });
+
+    if(!committed)
+        msgIds.clear();
+
+    for(auto& it : metaMap)
+    {
+        uint32_t token = it.first;
+
+        mDataAccess->updatePublicRequestStatus( token,
+                    committed && applied[token] ? RsTokenService::COMPLETE
+                                                : RsTokenService::FAILED );
+
+        RS_STACK_MUTEX(mGenMtx);
+        mMsgNotify.insert(std::make_pair(token, it.second.msgId));
     }
 
     if (!msgIds.empty())
@@ -2149,38 +2157,48 @@ void RsGenExchange::processGrpMetaChanges()
     }
 
     std::list<RsGxsGroupId> grpChanged;
+    std::map<uint32_t, bool> applied;
 
-    std::map<uint32_t, GrpLocMetaData>::iterator mit;
-    for (mit = metaMap.begin(); mit != metaMap.end(); ++mit)
+    bool committed = mDataStore->runInBatch([&]()
     {
-        GrpLocMetaData& g = mit->second;
-        uint32_t token = mit->first;
+        std::map<uint32_t, GrpLocMetaData>::iterator mit;
+        for (mit = metaMap.begin(); mit != metaMap.end(); ++mit)
+        {
+            GrpLocMetaData& g = mit->second;
+            uint32_t token = mit->first;
 
 #ifdef GEN_EXCH_DEBUG
-        RsDbg() << " Processing GrpMetaChange for token " << token << std::endl;
+            RsDbg() << " Processing GrpMetaChange for token " << token << std::endl;
 #endif
-        // process mask
-        bool ok = processGrpMask(g.grpId, g.val);
+            // process mask
+            bool ok = processGrpMask(g.grpId, g.val);
 
-        ok = ok && (mDataStore->updateGroupMetaData(g) == 1);
+            ok = ok && (mDataStore->updateGroupMetaData(g) == 1);
+            applied[token] = ok;
 
-        if(ok)
-        {
-            mDataAccess->updatePublicRequestStatus(token, RsTokenService::COMPLETE);
-            grpChanged.push_back(g.grpId);
-        }
-        else
-        {
-            mDataAccess->updatePublicRequestStatus(token, RsTokenService::FAILED);
+            if(ok)
+                grpChanged.push_back(g.grpId);
         }
 
-        {
-            RS_STACK_MUTEX(mGenMtx);
-            mGrpNotify.insert(std::make_pair(token, g.grpId));
+        return true;
+    });
+
+    if(!committed)
+        grpChanged.clear();
+
+    for(auto& it : metaMap)
+    {
+        uint32_t token = it.first;
+
+        mDataAccess->updatePublicRequestStatus( token,
+                    committed && applied[token] ? RsTokenService::COMPLETE
+                                                : RsTokenService::FAILED );
+
+        RS_STACK_MUTEX(mGenMtx);
+        mGrpNotify.insert(std::make_pair(token, it.second.grpId));
 #ifdef GEN_EXCH_DEBUG
-            RsDbg() << " Processing GrpMetaChange Adding token " << token << " to mGrpNotify" << std::endl;
+        RsDbg() << " Processing GrpMetaChange Adding token " << token << " to mGrpNotify" << std::endl;
 #endif
-        }
     }
 
     for(auto& groupId:grpChanged)
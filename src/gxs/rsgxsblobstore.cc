@@ -0,0 +1,920 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: rsgxsblobstore.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+#ifdef WINDOWS_SYS
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "crypto/rscrypto.h"
+#include "gxs/rsgxsblobstore.h"
+#include "util/largefile_retrocompat.hpp"
+#include "util/rsdebug.h"
+#include "util/rsdir.h"
+#include "util/rsrandom.h"
+
+//#define DEBUG_GXS_BLOB_STORE 1
+
+/*
+ * File:   magic "RSGXSBLB" | version u32 | flags u32 | generation u64 | key check u64
+ * Record: address (32 bytes) | payload size u32 | payload
+ * Index:  magic "RSGXSIDX" | generation u64 | covered size u64 | count u64
+ *         then per record, sorted by address: address | payload offset u64 | payload size u32
+ * Integers are little endian. The payload is the data, or its encryption.
+ */
+static const char     BLOB_FILE_MAGIC[8]  = { 'R','S','G','X','S','B','L','B' };
+static const char     BLOB_INDEX_MAGIC[8] = { 'R','S','G','X','S','I','D','X' };
+static const uint32_t BLOB_FILE_VERSION   = 1;
+static const uint32_t BLOB_FLAG_ENCRYPTED = 0x1;
+static const uint32_t BLOB_INDEX_HEADER_SIZE = 32;
+static const uint32_t BLOB_INDEX_ENTRY_SIZE  = Sha256CheckSum::SIZE_IN_BYTES + 8 + 4;
+static const size_t   BLOB_INDEX_MERGE_COUNT = 4096;	// records held in memory before merging them in the index
+static const uint64_t BLOB_REMAP_SIZE = 16 * 1024 * 1024;	// bytes appended, and read from the file, before sync() maps them
+
+const uint32_t RsGxsBlobStore::HEADER_SIZE = 32;
+const uint32_t RsGxsBlobStore::RECORD_HEADER_SIZE = Sha256CheckSum::SIZE_IN_BYTES + 4;
+
+static void putU32(uint8_t* p, uint32_t v)
+{ for(int i = 0; i < 4; ++i) p[i] = (v >> (8*i)) & 0xff; }
+
+static void putU64(uint8_t* p, uint64_t v)
+{ for(int i = 0; i < 8; ++i) p[i] = (v >> (8*i)) & 0xff; }
+
+static uint32_t getU32(const uint8_t* p)
+{
+	uint32_t v = 0;
+	for(int i = 0; i < 4; ++i) v |= uint32_t(p[i]) << (8*i);
+	return v;
+}
+
+static uint64_t getU64(const uint8_t* p)
+{
+	uint64_t v = 0;
+	for(int i = 0; i < 8; ++i) v |= uint64_t(p[i]) << (8*i);
+	return v;
+}
+
+static void deriveKey(const std::string& key, const char* label, uint8_t out[32])
+{
+	unsigned int len = 32;
+	HMAC( EVP_sha256(), key.data(), static_cast<int>(key.size()),
+	      reinterpret_cast<const unsigned char*>(label), strlen(label), out, &len );
+}
+
+static bool syncFile(FILE* f)
+{
+	if(fflush(f) != 0) return false;
+#ifdef WINDOWS_SYS
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+static bool truncateFile(FILE* f, uint64_t size)
+{
+	if(fflush(f) != 0) return false;
+#ifdef WINDOWS_SYS
+	return _chsize_s(_fileno(f), size) == 0;
+#else
+	return ftruncate(fileno(f), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+/* Writes an index to a temporary file, renamed over path by commit() */
+class BlobIndexWriter
+{
+public:
+	BlobIndexWriter( const std::string& path, uint64_t generation,
+	                 uint64_t covered, uint64_t count ) :
+	    mPath(path), mTmpPath(path + ".tmp"),
+	    mFile(RsDirUtil::rs_fopen(mTmpPath.c_str(), "wb")), mOk(mFile != nullptr)
+	{
+		uint8_t header[BLOB_INDEX_HEADER_SIZE];
+		memcpy(header, BLOB_INDEX_MAGIC, 8);
+		putU64(header + 8, generation);
+		putU64(header + 16, covered);
+		putU64(header + 24, count);
+		write(header, BLOB_INDEX_HEADER_SIZE);
+	}
+
+	~BlobIndexWriter()
+	{
+		if(!mFile) return;
+		fclose(mFile);
+		RsDirUtil::removeFile(mTmpPath);
+	}
+
+	void add(const uint8_t* address, uint64_t offset, uint32_t size)
+	{
+		uint8_t entry[BLOB_INDEX_ENTRY_SIZE];
+		memcpy(entry, address, Sha256CheckSum::SIZE_IN_BYTES);
+		putU64(entry + Sha256CheckSum::SIZE_IN_BYTES, offset);
+		putU32(entry + Sha256CheckSum::SIZE_IN_BYTES + 8, size);
+		write(entry, BLOB_INDEX_ENTRY_SIZE);
+	}
+
+	void addEntry(const uint8_t* entry) { write(entry, BLOB_INDEX_ENTRY_SIZE); }
+
+	bool commit()
+	{
+		bool ok = mOk && fclose(mFile) == 0;
+		mFile = nullptr;
+
+		ok = ok && RsDirUtil::renameFile(mTmpPath, mPath);
+		if(!ok) RsDirUtil::removeFile(mTmpPath);
+		return ok;
+	}
+
+private:
+	void write(const uint8_t* p, size_t len)
+	{ mOk = mOk && fwrite(p, 1, len, mFile) == len; }
+
+	const std::string mPath;
+	const std::string mTmpPath;
+	FILE* mFile;
+	bool mOk;
+};
+
+RsGxsBlobStore::RsGxsBlobStore(const std::string& path, const std::string& key)
+	: mBlobMtx("RsGxsBlobStore"), mPath(path), mEncrypted(!key.empty()),
+	  mFile(nullptr), mGeneration(0), mFileSize(0), mNeedsSync(false),
+	  mMap(nullptr), mMapSize(0), mIndex(nullptr), mIndexCount(0),
+	  mIndexMapSize(0), mCompacting(false), mCompactFrom(0)
+{
+	memset(mCryptKey, 0, sizeof(mCryptKey));
+	memset(mAddressKey, 0, sizeof(mAddressKey));
+
+	if(mEncrypted)
+	{
+		deriveKey(key, "RsGxsBlobStore encryption", mCryptKey);
+		deriveKey(key, "RsGxsBlobStore address", mAddressKey);
+	}
+}
+
+RsGxsBlobStore::~RsGxsBlobStore()
+{
+	close();
+}
+
+bool RsGxsBlobStore::open()
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	if(mFile) return true;
+
+	// tells a wrong key at once rather than on every read
+	uint64_t check = 0;
+	if(mEncrypted)
+	{
+		static const char label[] = "RsGxsBlobStore key check";
+		Sha256CheckSum keyCheck;
+		locked_address(reinterpret_cast<const uint8_t*>(label), sizeof(label) - 1, keyCheck);
+		check = getU64(keyCheck.toByteArray());
+	}
+
+	uint8_t header[HEADER_SIZE];
+	mRecent.clear();
+	locked_unmapIndex();
+	mFile = RsDirUtil::rs_fopen(mPath.c_str(), "r+b");
+
+	if(!mFile)
+	{
+		mFile = RsDirUtil::rs_fopen(mPath.c_str(), "w+b");
+		if(!mFile)
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " cannot create " << mPath << std::endl;
+			return false;
+		}
+
+		mGeneration = RsRandom::random_u64();
+		memcpy(header, BLOB_FILE_MAGIC, 8);
+		putU32(header + 8, BLOB_FILE_VERSION);
+		putU32(header + 12, mEncrypted ? BLOB_FLAG_ENCRYPTED : 0);
+		putU64(header + 16, mGeneration);
+		putU64(header + 24, check);
+
+		if(fwrite(header, 1, HEADER_SIZE, mFile) != HEADER_SIZE || !syncFile(mFile))
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " cannot write " << mPath << std::endl;
+			locked_close();
+			return false;
+		}
+
+		mFileSize = HEADER_SIZE;
+	}
+	else
+	{
+		if( fread(header, 1, HEADER_SIZE, mFile) != HEADER_SIZE ||
+		    memcmp(header, BLOB_FILE_MAGIC, 8) != 0 ||
+		    getU32(header + 8) != BLOB_FILE_VERSION )
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " " << mPath
+			        << " is not a blob file" << std::endl;
+			locked_close();
+			return false;
+		}
+
+		if( ((getU32(header + 12) & BLOB_FLAG_ENCRYPTED) != 0) != mEncrypted ||
+		    getU64(header + 24) != check )
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " " << mPath
+			        << " has been written with another key" << std::endl;
+			locked_close();
+			return false;
+		}
+
+		mGeneration = getU64(header + 16);
+		fseeko64(mFile, 0, SEEK_END);
+		mFileSize = ftello64(mFile);
+
+		uint64_t covered = HEADER_SIZE;
+		if(!locked_loadIndex(true, covered))
+			covered = HEADER_SIZE;
+
+		if(!locked_scan(covered))
+		{
+			locked_close();
+			return false;
+		}
+	}
+
+	locked_map();
+
+#ifdef DEBUG_GXS_BLOB_STORE
+	std::cerr << "RsGxsBlobStore::open() " << mPath << ": " << mIndexCount
+	          << " records indexed, " << mRecent.size() << " scanned, "
+	          << mFileSize << " bytes" << std::endl;
+#endif
+	return true;
+}
+
+void RsGxsBlobStore::close()
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+	locked_close();
+}
+
+void RsGxsBlobStore::locked_close()
+{
+	if(!mFile) return;
+
+	fflush(mFile);
+
+	/* A compaction running copies the records put since it began from
+	 * mRecent, let reopening scan them again instead */
+	if(!mRecent.empty() && !mCompacting) locked_saveIndex();
+
+	locked_unmap();
+	locked_unmapIndex();
+	fclose(mFile);
+	mFile = nullptr;
+	mRecent.clear();
+	mNeedsSync = false;
+}
+
+bool RsGxsBlobStore::isOpen()
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+	return mFile != nullptr;
+}
+
+bool RsGxsBlobStore::put(const uint8_t* data, uint32_t len, Sha256CheckSum& address)
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	if(!mFile || !locked_address(data, len, address)) return false;
+
+	Record existing;
+	if(locked_find(address, existing))
+	{
+		// the compaction running didn't see it live, it must keep it now
+		if(mCompacting) mRevived.insert(address);
+		return true;
+	}
+
+	const unsigned char* payload = data;
+	unsigned char* encrypted = nullptr;
+	uint32_t size = len;
+
+	if(mEncrypted)
+	{
+		if(!librs::crypto::encryptAuthenticateData(data, len, mCryptKey, encrypted, size))
+			return false;
+		payload = encrypted;
+	}
+
+	uint8_t header[RECORD_HEADER_SIZE];
+	memcpy(header, address.toByteArray(), Sha256CheckSum::SIZE_IN_BYTES);
+	putU32(header + Sha256CheckSum::SIZE_IN_BYTES, size);
+
+	bool ok = fseeko64(mFile, mFileSize, SEEK_SET) == 0 &&
+	          fwrite(header, 1, RECORD_HEADER_SIZE, mFile) == RECORD_HEADER_SIZE &&
+	          fwrite(payload, 1, size, mFile) == size &&
+	          fflush(mFile) == 0;
+	free(encrypted);
+
+	if(!ok)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot append to " << mPath << std::endl;
+		truncateFile(mFile, mFileSize);
+		return false;
+	}
+
+	Record& r = mRecent[address];
+	r.mOffset = mFileSize + RECORD_HEADER_SIZE;
+	r.mSize = size;
+
+	mFileSize += RECORD_HEADER_SIZE + size;
+	mNeedsSync = true;
+	return true;
+}
+
+bool RsGxsBlobStore::get(const Sha256CheckSum& address, std::vector<uint8_t>& data)
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	Record r;
+	if(!mFile || !locked_find(address, r)) return false;
+
+	std::vector<uint8_t> payload(r.mSize);
+	if(!locked_readAt(r.mOffset, payload.data(), r.mSize))
+		return false;
+
+	if(mEncrypted)
+	{
+		// decrypts in place, hence the copy out of the map
+		unsigned char* clear = nullptr;
+		uint32_t clearSize = 0;
+
+		if(!librs::crypto::decryptAuthenticateData(payload.data(), payload.size(), mCryptKey, clear, clearSize))
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " cannot decrypt record "
+			        << address << " of " << mPath << std::endl;
+			return false;
+		}
+
+		data.assign(clear, clear + clearSize);
+		free(clear);
+	}
+	else
+		data.swap(payload);
+
+	Sha256CheckSum check;
+	if(!locked_address(data.data(), data.size(), check) || check != address)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " corrupted record " << address
+		        << " in " << mPath << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool RsGxsBlobStore::sync()
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	if(!mFile) return false;
+	if(!mNeedsSync) return true;
+
+	if(!syncFile(mFile))
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot sync " << mPath << std::endl;
+		return false;
+	}
+
+	mNeedsSync = false;
+
+	// the records are on the disk, the index can point to them
+	if(!mCompacting && mRecent.size() >= BLOB_INDEX_MERGE_COUNT)
+		locked_saveIndex();
+
+	if(mFileSize - mMapSize >= BLOB_REMAP_SIZE)
+		locked_map();
+
+	return true;
+}
+
+bool RsGxsBlobStore::compact(const std::set<Sha256CheckSum>& live, uint64_t& reclaimed)
+{
+	reclaimed = 0;
+	return beginCompaction(live) && finishCompaction(reclaimed);
+}
+
+bool RsGxsBlobStore::beginCompaction(const std::set<Sha256CheckSum>& live)
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	if(!mFile || mCompacting) return false;
+
+	mCompactRecords.clear();
+	mCompactRecords.reserve(live.size());
+	for(const Sha256CheckSum& address : live)
+	{
+		CompactRecord r;
+		if(!locked_find(address, r)) continue;
+
+		r.mAddress = address;
+		mCompactRecords.push_back(r);
+	}
+
+	// keep the order of the file
+	std::sort( mCompactRecords.begin(), mCompactRecords.end(),
+	           [](const CompactRecord& a, const CompactRecord& b)
+	{ return a.mOffset < b.mOffset; } );
+
+	mCompactFrom = mFileSize;
+	mRevived.clear();
+	mCompacting = true;
+	return true;
+}
+
+bool RsGxsBlobStore::finishCompaction(uint64_t& reclaimed)
+{
+	reclaimed = 0;
+
+	std::vector<CompactRecord> records;
+	uint8_t header[HEADER_SIZE];
+	uint64_t from, oldGeneration;
+	{
+		RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+		if(!mCompacting) return false;
+
+		records.swap(mCompactRecords);
+		from = mCompactFrom;
+		oldGeneration = mGeneration;
+
+		if(!mFile || !locked_readAt(0, header, HEADER_SIZE))
+		{
+			mCompacting = false;
+			mRevived.clear();
+			return false;
+		}
+	}
+
+	/* What is before from is never modified, the file is only appended to,
+	 * so the records kept are copied through a handle of our own without
+	 * locking. Same header, new generation so that the old index doesn't
+	 * apply. */
+	const std::string tmpPath = mPath + ".tmp";
+	const uint64_t generation = RsRandom::random_u64();
+	putU64(header + 16, generation);
+
+	FILE* in = RsDirUtil::rs_fopen(mPath.c_str(), "rb");
+	FILE* out = RsDirUtil::rs_fopen(tmpPath.c_str(), "wb");
+	bool ok = in && out && fwrite(header, 1, HEADER_SIZE, out) == HEADER_SIZE;
+
+	std::vector<uint8_t> buf;
+	uint64_t size = HEADER_SIZE;
+
+	for(size_t i = 0; ok && i < records.size(); ++i)
+	{
+		CompactRecord& r = records[i];
+		buf.resize(RECORD_HEADER_SIZE + r.mSize);
+
+		ok = fseeko64(in, r.mOffset - RECORD_HEADER_SIZE, SEEK_SET) == 0 &&
+		     fread(buf.data(), 1, buf.size(), in) == buf.size() &&
+		     fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+
+		r.mOffset = size + RECORD_HEADER_SIZE;
+		size += buf.size();
+	}
+
+	if(in) fclose(in);
+
+	/* The index of the new file covers the records copied so far, the ones
+	 * copied below under lock are held in memory */
+	std::sort( records.begin(), records.end(),
+	           [](const CompactRecord& a, const CompactRecord& b)
+	{ return a.mAddress < b.mAddress; } );
+
+	bool indexWritten = false;
+	if(ok)
+	{
+		BlobIndexWriter index(mPath + ".idx", generation, size, records.size());
+		for(const CompactRecord& r : records)
+			index.add(r.mAddress.toByteArray(), r.mOffset, r.mSize);
+		ok = indexWritten = index.commit();
+	}
+
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	mCompacting = false;
+	ok = ok && mFile && mGeneration == oldGeneration;
+
+	/* The records put since beginCompaction(), all held in memory as the
+	 * index isn't merged while compacting, and the data put again which
+	 * wasn't live then */
+	std::vector<CompactRecord> tail;
+	for(auto& it : mRecent)
+		if(ok && it.second.mOffset >= from)
+		{
+			CompactRecord r;
+			r.mOffset = it.second.mOffset;
+			r.mSize = it.second.mSize;
+			r.mAddress = it.first;
+			tail.push_back(r);
+		}
+
+	for(const Sha256CheckSum& address : mRevived)
+	{
+		CompactRecord r;
+		if(!ok || !locked_find(address, r) || r.mOffset >= from) continue;
+
+		std::vector<CompactRecord>::const_iterator kept = std::lower_bound(
+		            records.begin(), records.end(), address,
+		            [](const CompactRecord& a, const Sha256CheckSum& b)
+		{ return a.mAddress < b; } );
+		if(kept != records.end() && kept->mAddress == address) continue;
+
+		r.mAddress = address;
+		tail.push_back(r);
+	}
+	mRevived.clear();
+
+	std::sort( tail.begin(), tail.end(),
+	           [](const CompactRecord& a, const CompactRecord& b)
+	{ return a.mOffset < b.mOffset; } );
+
+	std::map<Sha256CheckSum, Record> recent;
+	for(size_t i = 0; ok && i < tail.size(); ++i)
+	{
+		buf.resize(RECORD_HEADER_SIZE + tail[i].mSize);
+
+		ok = locked_readAt(tail[i].mOffset - RECORD_HEADER_SIZE, buf.data(), buf.size()) &&
+		     fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+
+		Record& nr = recent[tail[i].mAddress];
+		nr.mOffset = size + RECORD_HEADER_SIZE;
+		nr.mSize = tail[i].mSize;
+		size += buf.size();
+	}
+
+	ok = ok && syncFile(out);
+	if(out) fclose(out);
+
+	if(!ok)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot write " << tmpPath << std::endl;
+		RsDirUtil::removeFile(tmpPath);
+
+		// the index has been written for the new file
+		if(indexWritten && mFile) locked_saveIndex();
+		return false;
+	}
+
+	locked_unmap();
+	locked_unmapIndex();
+	fclose(mFile);
+
+	ok = RsDirUtil::renameFile(tmpPath, mPath);
+	if(!ok)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot replace " << mPath << std::endl;
+		RsDirUtil::removeFile(tmpPath);
+	}
+
+	mFile = RsDirUtil::rs_fopen(mPath.c_str(), "r+b");
+	if(!mFile)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot reopen " << mPath << std::endl;
+		mRecent.clear();
+		return false;
+	}
+
+	if(ok)
+	{
+		reclaimed = mFileSize - size;
+		mRecent.swap(recent);
+		mGeneration = generation;
+		mFileSize = size;
+		mNeedsSync = false;
+	}
+
+	uint64_t covered;
+	if(!locked_loadIndex(!ok, covered))
+	{
+		// back to the old file, whose index has been replaced
+		mRecent.clear();
+		if(locked_scan(HEADER_SIZE)) locked_saveIndex();
+	}
+
+	locked_map();
+
+#ifdef DEBUG_GXS_BLOB_STORE
+	std::cerr << "RsGxsBlobStore::finishCompaction() " << mPath << ": "
+	          << mIndexCount + mRecent.size() << " records kept, " << reclaimed
+	          << " bytes reclaimed" << std::endl;
+#endif
+	return ok;
+}
+
+uint64_t RsGxsBlobStore::fileSize()
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+	return mFileSize;
+}
+
+uint64_t RsGxsBlobStore::usedSize(const std::set<Sha256CheckSum>& live)
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+
+	uint64_t size = HEADER_SIZE;
+	for(const Sha256CheckSum& address : live)
+	{
+		Record r;
+		if(locked_find(address, r)) size += RECORD_HEADER_SIZE + r.mSize;
+	}
+
+	return size;
+}
+
+size_t RsGxsBlobStore::count()
+{
+	RS_STACK_MUTEX(mBlobMtx); /********** LOCKED MUTEX **********/
+	return mIndexCount + mRecent.size();
+}
+
+bool RsGxsBlobStore::locked_find(const Sha256CheckSum& address, Record& r)
+{
+	std::map<Sha256CheckSum, Record>::const_iterator it = mRecent.find(address);
+	if(it != mRecent.end())
+	{
+		r = it->second;
+		return true;
+	}
+
+	// the index is sorted by address
+	uint64_t low = 0, high = mIndexCount;
+	while(low < high)
+	{
+		const uint64_t mid = low + (high - low) / 2;
+		const uint8_t* entry = mIndex + mid * BLOB_INDEX_ENTRY_SIZE;
+		const int cmp = memcmp(entry, address.toByteArray(), Sha256CheckSum::SIZE_IN_BYTES);
+
+		if(cmp == 0)
+		{
+			r.mOffset = getU64(entry + Sha256CheckSum::SIZE_IN_BYTES);
+			r.mSize = getU32(entry + Sha256CheckSum::SIZE_IN_BYTES + 8);
+			return true;
+		}
+
+		if(cmp < 0) low = mid + 1;
+		else high = mid;
+	}
+
+	return false;
+}
+
+bool RsGxsBlobStore::locked_address(const uint8_t* data, uint32_t len, Sha256CheckSum& address)
+{
+	uint8_t md[EVP_MAX_MD_SIZE];
+	unsigned int mdLen = Sha256CheckSum::SIZE_IN_BYTES;
+
+	if(mEncrypted)
+	{
+		if(!HMAC(EVP_sha256(), mAddressKey, sizeof(mAddressKey), data, len, md, &mdLen))
+			return false;
+	}
+	else
+		SHA256(data, len, md);
+
+	address = Sha256CheckSum::fromBufferUnsafe(md);
+	return true;
+}
+
+bool RsGxsBlobStore::locked_readAt(uint64_t offset, uint8_t* buf, uint32_t len)
+{
+	if(offset + len > mFileSize) return false;
+
+#ifndef WINDOWS_SYS
+	// what was appended since the file was mapped is read, sync() maps it
+	if(mMap && offset + len <= mMapSize)
+	{
+		memcpy(buf, mMap + offset, len);
+		return true;
+	}
+#endif
+
+	return fseeko64(mFile, offset, SEEK_SET) == 0 &&
+	       fread(buf, 1, len, mFile) == len;
+}
+
+bool RsGxsBlobStore::locked_scan(uint64_t from)
+{
+	uint8_t header[RECORD_HEADER_SIZE];
+	uint64_t offset = from;
+
+	while(offset + RECORD_HEADER_SIZE <= mFileSize)
+	{
+		if(!locked_readAt(offset, header, RECORD_HEADER_SIZE)) break;
+
+		uint32_t size = getU32(header + Sha256CheckSum::SIZE_IN_BYTES);
+		if(offset + RECORD_HEADER_SIZE + size > mFileSize) break;
+
+		const Sha256CheckSum address = Sha256CheckSum::fromBufferUnsafe(header);
+		Record r;
+		if(!locked_find(address, r))
+		{
+			r.mOffset = offset + RECORD_HEADER_SIZE;
+			r.mSize = size;
+			mRecent[address] = r;
+		}
+
+		offset += RECORD_HEADER_SIZE + size;
+	}
+
+	if(offset < mFileSize)
+	{
+		RsWarn() << __PRETTY_FUNCTION__ << " dropping " << mFileSize - offset
+		         << " bytes of incomplete record at the end of " << mPath
+		         << std::endl;
+
+		if(!truncateFile(mFile, offset))
+		{
+			RsErr() << __PRETTY_FUNCTION__ << " cannot truncate " << mPath << std::endl;
+			return false;
+		}
+
+		mFileSize = offset;
+	}
+
+	return true;
+}
+
+bool RsGxsBlobStore::locked_loadIndex(bool check, uint64_t& covered)
+{
+	locked_unmapIndex();
+
+	FILE* f = RsDirUtil::rs_fopen((mPath + ".idx").c_str(), "rb");
+	if(!f) return false;
+
+	fseeko64(f, 0, SEEK_END);
+	const uint64_t indexSize = ftello64(f);
+	fseeko64(f, 0, SEEK_SET);
+
+	uint8_t header[BLOB_INDEX_HEADER_SIZE];
+	bool ok = fread(header, 1, BLOB_INDEX_HEADER_SIZE, f) == BLOB_INDEX_HEADER_SIZE &&
+	          memcmp(header, BLOB_INDEX_MAGIC, 8) == 0 &&
+	          getU64(header + 8) == mGeneration;
+
+	const uint64_t indexCovered = ok ? getU64(header + 16) : 0;
+	const uint64_t count = ok ? getU64(header + 24) : 0;
+	ok = ok && indexCovered >= HEADER_SIZE && indexCovered <= mFileSize &&
+	     indexSize == BLOB_INDEX_HEADER_SIZE + count * BLOB_INDEX_ENTRY_SIZE;
+
+	if(ok && count)
+	{
+#ifndef WINDOWS_SYS
+		void* p = mmap(nullptr, indexSize, PROT_READ, MAP_SHARED, fileno(f), 0);
+		if(p != MAP_FAILED)
+		{
+			mIndex = static_cast<const uint8_t*>(p) + BLOB_INDEX_HEADER_SIZE;
+			mIndexMapSize = indexSize;
+		}
+		else
+#endif
+		{
+			mIndexBuf.resize(count * BLOB_INDEX_ENTRY_SIZE);
+			ok = fread(mIndexBuf.data(), 1, mIndexBuf.size(), f) == mIndexBuf.size();
+			mIndex = mIndexBuf.data();
+		}
+
+		mIndexCount = count;
+	}
+
+	fclose(f);
+
+	// sorted, and within the part of the file it covers
+	for(uint64_t i = 0; ok && check && i < mIndexCount; ++i)
+	{
+		const uint8_t* entry = mIndex + i * BLOB_INDEX_ENTRY_SIZE;
+		const uint64_t offset = getU64(entry + Sha256CheckSum::SIZE_IN_BYTES);
+		const uint32_t size = getU32(entry + Sha256CheckSum::SIZE_IN_BYTES + 8);
+
+		ok = offset >= HEADER_SIZE + RECORD_HEADER_SIZE &&
+		     offset + size <= indexCovered &&
+		     (i == 0 || memcmp(entry - BLOB_INDEX_ENTRY_SIZE, entry, Sha256CheckSum::SIZE_IN_BYTES) < 0);
+	}
+
+	if(!ok)
+	{
+		RsWarn() << __PRETTY_FUNCTION__ << " index of " << mPath
+		         << " is outdated, scanning the whole file" << std::endl;
+		locked_unmapIndex();
+		return false;
+	}
+
+	covered = indexCovered;
+	return true;
+}
+
+bool RsGxsBlobStore::locked_saveIndex()
+{
+	// both sorted by address
+	BlobIndexWriter index( mPath + ".idx", mGeneration, mFileSize,
+	                       mIndexCount + mRecent.size() );
+
+	uint64_t i = 0;
+	std::map<Sha256CheckSum, Record>::const_iterator it = mRecent.begin();
+	while(i < mIndexCount || it != mRecent.end())
+	{
+		const uint8_t* entry = mIndex + i * BLOB_INDEX_ENTRY_SIZE;
+		if( i < mIndexCount && ( it == mRecent.end() ||
+		    memcmp(entry, it->first.toByteArray(), Sha256CheckSum::SIZE_IN_BYTES) < 0 ) )
+		{
+			index.addEntry(entry);
+			++i;
+		}
+		else
+		{
+			index.add(it->first.toByteArray(), it->second.mOffset, it->second.mSize);
+			++it;
+		}
+	}
+
+	if(!index.commit())
+	{
+		RsWarn() << __PRETTY_FUNCTION__ << " cannot save index of " << mPath << std::endl;
+		return false;
+	}
+
+	mRecent.clear();
+	uint64_t covered;
+	if(locked_loadIndex(false, covered)) return true;
+
+	// records are looked up in the file again
+	locked_scan(HEADER_SIZE);
+	return false;
+}
+
+void RsGxsBlobStore::locked_map()
+{
+#ifndef WINDOWS_SYS
+	locked_unmap();
+	if(!mFile || mFileSize == 0) return;
+
+	void* p = mmap(nullptr, mFileSize, PROT_READ, MAP_SHARED, fileno(mFile), 0);
+	if(p == MAP_FAILED)
+	{
+		RsWarn() << __PRETTY_FUNCTION__ << " cannot map " << mPath
+		         << ", reading it instead" << std::endl;
+		return;
+	}
+
+	mMap = static_cast<const uint8_t*>(p);
+	mMapSize = mFileSize;
+#endif
+}
+
+void RsGxsBlobStore::locked_unmap()
+{
+#ifndef WINDOWS_SYS
+	if(mMap) munmap(const_cast<uint8_t*>(mMap), mMapSize);
+#endif
+	mMap = nullptr;
+	mMapSize = 0;
+}
+
+void RsGxsBlobStore::locked_unmapIndex()
+{
+#ifndef WINDOWS_SYS
+	if(mIndexMapSize)
+		munmap(const_cast<uint8_t*>(mIndex - BLOB_INDEX_HEADER_SIZE), mIndexMapSize);
+#endif
+	mIndex = nullptr;
+	mIndexCount = 0;
+	mIndexMapSize = 0;
+	std::vector<uint8_t>().swap(mIndexBuf);
+}
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: rsgxsblobstore.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "retroshare/rsids.h"
+#include "util/rsthreads.h"      // for RsMutex
+
+/**
+ * @brief Append-only file holding the data of GXS messages and groups, out of
+ * the rows of their database.
+ * Data is addressed by content: the address is the HMAC-SHA256 of the data
+ * keyed from the database key, or its SHA-256 without key, so data stored
+ * twice is written once. With a key the data is encrypted and authenticated
+ * with librs::crypto, and the address is checked again on read.
+ * Records are never modified: compaction rewrites the file with the records
+ * still referenced. Reads go through a memory map of the file, except on
+ * Windows where they seek.
+ * Where records are is kept in an index next to the file, sorted by address
+ * and looked up in place through a memory map (read in memory on Windows).
+ * Only the records appended since the index was written are held in memory,
+ * they are merged into it on close, compaction, and sync() once they are
+ * BLOB_INDEX_MERGE_COUNT. Opening only scans those.
+ * Every method locks.
+ */
+class RsGxsBlobStore
+{
+public:
+	/// @param key database key, empty for a plain file
+	RsGxsBlobStore(const std::string& path, const std::string& key);
+	~RsGxsBlobStore();
+
+	/**
+	 * Open the file, creating it if needed. A record left incomplete by a
+	 * crash is dropped.
+	 * @return false if the file can't be used, or has been written with
+	 *   another key
+	 */
+	bool open();
+	void close();
+	bool isOpen();
+
+	/// Store data if it is not there already
+	bool put(const uint8_t* data, uint32_t len, Sha256CheckSum& address);
+
+	/// @return false if there is no valid record at address
+	bool get(const Sha256CheckSum& address, std::vector<uint8_t>& data);
+
+	/**
+	 * Flush the records appended so far to the disk, to be called before
+	 * committing the rows which reference them.
+	 */
+	bool sync();
+
+	/**
+	 * Rewrite the file with the records of live only, see beginCompaction()
+	 * @param[out] reclaimed bytes freed
+	 */
+	bool compact(const std::set<Sha256CheckSum>& live, uint64_t& reclaimed);
+
+	/**
+	 * Start compacting the file to the records of live, and of the data put
+	 * from now on. To be called while the set of data referenced can't change,
+	 * finishCompaction() can then run without it, while data is put and got.
+	 * @return false if a compaction is running already
+	 */
+	bool beginCompaction(const std::set<Sha256CheckSum>& live);
+
+	/**
+	 * Copy the records kept to a new file and replace the old one with it.
+	 * Locks only to copy the records put since beginCompaction() and swap
+	 * the files.
+	 * @param[out] reclaimed bytes freed
+	 */
+	bool finishCompaction(uint64_t& reclaimed);
+
+	/// Size of the file, records of dropped data included
+	uint64_t fileSize();
+
+	/// Size the records of live take in the file
+	uint64_t usedSize(const std::set<Sha256CheckSum>& live);
+
+	size_t count();
+
+	static const uint32_t HEADER_SIZE;
+	static const uint32_t RECORD_HEADER_SIZE;
+
+private:
+	class Record
+	{
+	public:
+		uint64_t mOffset;  /// of the payload
+		uint32_t mSize;    /// of the payload
+	};
+
+	class CompactRecord: public Record
+	{
+	public:
+		Sha256CheckSum mAddress;
+	};
+
+	bool locked_find(const Sha256CheckSum& address, Record& r);
+	bool locked_address(const uint8_t* data, uint32_t len, Sha256CheckSum& address);
+	bool locked_readAt(uint64_t offset, uint8_t* buf, uint32_t len);
+	bool locked_scan(uint64_t from);
+	bool locked_loadIndex(bool check, uint64_t& covered);
+	bool locked_saveIndex();
+	void locked_map();
+	void locked_unmap();
+	void locked_unmapIndex();
+	void locked_close();
+
+	RsMutex mBlobMtx; /* MUTEX */
+
+	const std::string mPath;
+	const bool mEncrypted;
+	uint8_t mCryptKey[32];
+	uint8_t mAddressKey[32];
+
+	FILE* mFile;
+	uint64_t mGeneration;  /// changes on compaction, ties the index to the file
+	uint64_t mFileSize;
+	bool mNeedsSync;
+
+	const uint8_t* mMap;
+	uint64_t mMapSize;
+
+	const uint8_t* mIndex;          /// entries of the index file
+	uint64_t mIndexCount;
+	uint64_t mIndexMapSize;         /// 0 if read in mIndexBuf
+	std::vector<uint8_t> mIndexBuf;
+	std::map<Sha256CheckSum, Record> mRecent;  /// records not in the index
+
+	bool mCompacting;
+	uint64_t mCompactFrom;          /// file size at beginCompaction()
+	std::vector<CompactRecord> mCompactRecords;
+	std::set<Sha256CheckSum> mRevived;  /// put while compacting
+};
@@ -997,6 +997,39 @@ bool RsGxsDataAccess::getMsgData(MsgDataReq* req)
 
 	const RsTokReqOptions& opts(req->Options);
 
+	if(opts.mPageSize)
+	{
+		GxsMsgMetaResult pages;
+		if(!getMsgMetaDataPages(req->mMsgIds, opts, pages))
+			return false;
+
+		// an empty id set would ask for the whole group
+		for(auto& it : pages)
+			for(auto& meta : it.second)
+				msgIdOut[it.first].insert(meta->mMsgId);
+
+		if(msgIdOut.empty())
+			return true;
+
+		mDataStore->retrieveNxsMsgs(msgIdOut, req->mMsgData, true);
+
+		// back in the order of the pages
+		for(auto& it : req->mMsgData)
+		{
+			const auto& page = pages[it.first];
+			std::map<RsGxsMessageId, uint32_t> position;
+
+			for(uint32_t i = 0; i < page.size(); ++i)
+				position[page[i]->mMsgId] = i;
+
+			std::sort( it.second.begin(), it.second.end(),
+			           [&position](RsNxsMsg* a, RsNxsMsg* b)
+			           { return position[a->msgId] < position[b->msgId]; } );
+		}
+
+		return true;
+	}
+
 	// filter based on options
 	getMsgIdList(req->mMsgIds, opts, msgIdOut);
 
@@ -1016,7 +1049,8 @@ bool RsGxsDataAccess::getMsgSummary(MsgMetaReq* req)
 	const RsTokReqOptions& opts(req->Options);
 
 	// filter based on options
-	getMsgMetaDataList(req->mMsgIds, opts, req->mMsgMetaData);
+	if(!getMsgMetaDataList(req->mMsgIds, opts, req->mMsgMetaData))
+		return false;
 
 //	// If the list is empty because of filtering do not retrieve from DB
 //	if((opts.mMsgFlagMask || opts.mStatusMask) && msgIdOut.empty())
@@ -1029,6 +1063,10 @@ bool RsGxsDataAccess::getMsgSummary(MsgMetaReq* req)
 
 bool RsGxsDataAccess::getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result )
 {
+    // Pages come as they are, the filters below need the whole group
+    if(opts.mPageSize)
+        return getMsgMetaDataPages(msgIds, opts, result);
+
     // First get all message metas, then filter out the ones we want to keep.
     result.clear();
     mDataStore->retrieveGxsMsgMetaData(msgIds, result);
@@ -1217,11 +1255,52 @@ bool RsGxsDataAccess::getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokRe
     return true;
 }
 
+bool RsGxsDataAccess::getMsgMetaDataPages( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result )
+{
+    result.clear();
+    GxsMsgReq byId;
+
+    uint32_t wholeGroups = 0;
+    for(auto& it : msgIds)
+        if(it.second.empty())
+            ++wholeGroups;
+
+    // the cursor is a position in one group, it would skip messages of others
+    if(wholeGroups > 1 && !opts.mPageAfter.isNull())
+    {
+        RsErr() << __PRETTY_FUNCTION__ << " a page cursor can't be used for "
+                << wholeGroups << " groups" << std::endl;
+        return false;
+    }
+
+    for(auto& it : msgIds)
+        if(!it.second.empty())
+            byId.insert(it);
+        else if(!mDataStore->retrieveGxsMsgMetaPage( it.first, opts.mPageSize, opts.mPageOrder,
+                                                     opts.mPageAfter, result[it.first] ))
+        {
+            RsErr() << __PRETTY_FUNCTION__ << " cannot read a page of group "
+                    << it.first << std::endl;
+            result.clear();
+            return false;
+        }
+
+    if(!byId.empty())
+    {
+        GxsMsgMetaResult byIdResult;
+        mDataStore->retrieveGxsMsgMetaData(byId, byIdResult);
+        result.insert(byIdResult.begin(), byIdResult.end());
+    }
+
+    return true;
+}
+
 bool RsGxsDataAccess::getMsgIdList( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgReq& msgIdsOut )
 {
     GxsMsgMetaResult result;
 
-	getMsgMetaDataList( msgIds, opts, result );
+	if(!getMsgMetaDataList( msgIds, opts, result ))
+		return false;
 
     // extract MessageIds
 
@@ -1601,6 +1680,9 @@ bool RsGxsDataAccess::getServiceStatistic(ServiceStatisticRequest *req)
 
 bool RsGxsDataAccess::getMsgIdList(MsgIdReq* req)
 {
+    // the ids of whole groups would be asked by id, and not paged
+    if(req->Options.mPageSize)
+        return getMsgIdList(req->mMsgIds, req->Options, req->mMsgIdResult);
 
     GxsMsgMetaResult result;
     mDataStore->retrieveGxsMsgMetaData(req->mMsgIds, result);
@@ -396,6 +396,13 @@ private:
      */
 	bool getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result );
 
+    /*!
+     * Retrieves the page of opts of each whole group of msgIds, and the
+     * messages asked by id for the others
+     * @see RsTokReqOptions::mPageSize
+     */
+	bool getMsgMetaDataPages( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result );
+
     /*!
      * Attempts to retrieve group meta data from data store
      * @param req
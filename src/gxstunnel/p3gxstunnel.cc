@@ -1267,10 +1267,10 @@ bool p3GxsTunnelService::locked_sendEncryptedTunnelData(RsGxsTunnelItem *item)
 {
     RsGxsTunnelSerialiser ser;
 
-    uint32_t rssize = ser.size(item);
-    RsTemporaryMemory buff(rssize) ;
+    uint32_t rssize = 0;
+    const uint8_t *buff = ser.serialiseScratch(item,rssize) ;
 
-    if(!ser.serialise(item,buff,&rssize))
+    if(!buff)
     {
 	    std::cerr << "(EE) GxsTunnelService::sendEncryptedTunnelData(): Could not serialise item!" << std::endl;
 	    return false;
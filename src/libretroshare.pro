@@ -86,7 +86,9 @@ SOURCES +=	dht/p3bitdht.cc  \
 
 HEADERS +=	tcponudp/udppeer.h \
 		tcponudp/bio_tou.h \
+		tcponudp/tcpcongestion.h \
 		tcponudp/tcppacket.h \
+		tcponudp/tcpqueue.h \
 		tcponudp/tcpstream.h \
 		tcponudp/tou.h \
 		tcponudp/udprelay.h \
@@ -94,6 +96,7 @@ HEADERS +=	tcponudp/udppeer.h \
 		pqi/pqissludp.h \
 
 SOURCES +=	tcponudp/udppeer.cc \
+		tcponudp/tcpcongestion.cc \
 		tcponudp/tcppacket.cc \
 		tcponudp/tcpstream.cc \
 		tcponudp/tou.cc \
@@ -374,7 +377,10 @@ HEADERS +=	pqi/authssl.h \
 			pqi/p3netmgr.h \
 			pqi/p3notify.h \
 			pqi/p3upnpmgr.h \
+			pqi/pqibwalloc.h \
+			pqi/pqicompression.h \
 			pqi/pqiqos.h \
+			pqi/pqioutslice.h \
 			pqi/pqi.h \
 			pqi/pqi_base.h \
 			pqi/pqiassist.h \
@@ -402,6 +408,8 @@ HEADERS +=	pqi/authssl.h \
 			pqi/pqithreadstreamer.h \
 			pqi/pqiqosstreamer.h \
 			pqi/sslfns.h \
+			pqi/sslcertcache.h \
+			pqi/sslsessioncache.h \
 			pqi/pqinetstatebox.h \
                         pqi/p3servicecontrol.h
 
@@ -491,6 +499,8 @@ HEADERS +=	util/folderiterator.h \
 			util/argstream.h \
 			util/rsdiscspace.h \
 			util/rsnet.h \
+			util/rsiptrie.h \
+			util/rsrcu.h \
 			util/extaddrfinder.h \
 			util/dnsresolver.h \
                         util/radix32.h \
@@ -554,6 +564,8 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/rstcpsocket.cc \
 			pqi/p3netmgr.cc \
 			pqi/p3notify.cc \
+			pqi/pqibwalloc.cc \
+			pqi/pqicompression.cc \
 			pqi/pqiqos.cc \
 			pqi/pqibin.cc \
 			pqi/pqihandler.cc \
@@ -575,6 +587,8 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/pqithreadstreamer.cc \
 			pqi/pqiqosstreamer.cc \
 			pqi/sslfns.cc \
+			pqi/sslcertcache.cc \
+			pqi/sslsessioncache.cc \
 			pqi/pqinetstatebox.cc \
                         pqi/p3servicecontrol.cc
 
@@ -649,6 +663,8 @@ SOURCES +=	util/folderiterator.cc \
 			util/rsdiscspace.cc \
 			util/rsnet.cc \
 			util/rsnet_ss.cc \
+			util/rsiptrie.cc \
+			util/rsrcu.cc \
 			util/rsdnsutils.cc \
 			util/extaddrfinder.cc \
 			util/dnsresolver.cc \
@@ -697,6 +713,7 @@ HEADERS += rsitems/rsnxsitems.h \
 	gxs/rsgds.h \
 	gxs/rsgxs.h \
 	gxs/rsdataservice.h \
+	gxs/rsgxsblobstore.h \
 	gxs/rsgxsnetservice.h \
 	gxs/rsgxsnettunnel.h \
 	gxs/rsgenexchange.h \
@@ -717,6 +734,7 @@ SOURCES += rsitems/rsnxsitems.cc \
 	gxs/gxssecurity.cc \
 	gxs/rsgxsdataaccess.cc \
 	gxs/rsdataservice.cc \
+	gxs/rsgxsblobstore.cc \
 	gxs/rsgenexchange.cc \
 	gxs/rsgxsnetservice.cc \
 	gxs/rsgxsnettunnel.cc \
@@ -1040,6 +1058,20 @@ rs_deep_files_index_taglib {
     HEADERS += deep_search/filestaglibindexer.hpp
 }
 
+rs_pqi_reactor {
+    DEFINES *= RS_PQI_REACTOR
+    HEADERS += pqi/pqireactor.h
+    SOURCES += pqi/pqireactor.cc
+}
+
+rs_ktls {
+    DEFINES *= RS_KTLS
+}
+
+rs_gxs_blob_store {
+    DEFINES *= RS_GXS_BLOB_STORE
+}
+
 rs_broadcast_discovery {
     HEADERS += retroshare/rsbroadcastdiscovery.h \
         services/broadcastdiscoveryservice.h
@@ -40,6 +40,7 @@
 #include "util/rsdebug.h"
 #include "util/rsdir.h"
 #include "util/rsstring.h"
+#include "util/rsbase64.h"
 #include "pgp/pgpkeyutil.h"
 
 #include "retroshare/rspeers.h" // for RsPeerDetails structure 
@@ -218,6 +219,29 @@ void tls_cleanup()
 
 AuthSSL* AuthSSL::getAuthSSL() { return &instance(); }
 
+// See InitAuth() for the choice of ciphers
+static const char* const sslCipherList = "kEDH+HIGH:!DSS:!aNULL:!3DES:!EXP";
+
+/*static*/ void AuthSSL::setupContextOptions(SSL_CTX* ctx)
+{
+	SSL_CTX_set_options(ctx,SSL_OP_NO_SSLv3) ;
+
+	//SSL_OP_SINGLE_DH_USE 	CVE-2016-0701
+	//https://www.openssl.org/docs/manmaster/ssl/SSL_CTX_set_options.html
+	//If "strong" primes were used, it is not strictly necessary to generate a new DH key during each handshake but it is also recommended. SSL_OP_SINGLE_DH_USE should therefore be enabled whenever temporary/ephemeral DH parameters are used.
+	//SSL_CTX_set_options() adds the options set via bitmask in options to ctx. Options already set before are not cleared!
+        SSL_CTX_set_options(ctx,SSL_OP_SINGLE_DH_USE) ;
+
+#ifdef RS_KTLS
+	// Let OpenSSL hand record encryption over to the kernel once the handshake is done. This only
+	// happens on plain sockets (not TOU) and if the kernel supports the negotiated cipher, otherwise
+	// records keep being processed in user space, so there is nothing to fall back to explicitly.
+	SSL_CTX_set_options(ctx,SSL_OP_ENABLE_KTLS) ;
+#endif
+
+	SSL_CTX_set_cipher_list(ctx, sslCipherList);
+}
+
 AuthSSL::~AuthSSL() = default;
 
 
@@ -228,6 +252,18 @@ AuthSSL::~AuthSSL() = default;
 /********************************************************************************/
 
 static int verify_x509_callback(int preverify_ok, X509_STORE_CTX *ctx);
+static int new_session_callback(SSL* ssl, SSL_SESSION* session);
+
+// Same for all our listeners, sessions are bound to the peer anyway.
+static const unsigned char RS_SSL_SESSION_ID_CONTEXT[] = "RetroShare";
+
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
+// name, HMAC and AES keys of the session tickets
+static const size_t RS_SSL_TICKET_KEYS_SIZE = 80;
+#endif
+
+static const std::string RS_SSL_SESSIONS_KEY = "TLS_SESSIONS";
+static const std::string RS_SSL_TICKET_KEYS_KEY = "TICKET_KEYS";
 
 std::string RsX509Cert::getCertName(const X509& x509)
 {
@@ -371,13 +407,7 @@ bool AuthSSLimpl::InitAuth(
 
 	// setup connection method
 	sslctx = SSL_CTX_new(SSLv23_method());
-	SSL_CTX_set_options(sslctx,SSL_OP_NO_SSLv3) ;
-
-	//SSL_OP_SINGLE_DH_USE 	CVE-2016-0701
-	//https://www.openssl.org/docs/manmaster/ssl/SSL_CTX_set_options.html
-	//If "strong" primes were used, it is not strictly necessary to generate a new DH key during each handshake but it is also recommended. SSL_OP_SINGLE_DH_USE should therefore be enabled whenever temporary/ephemeral DH parameters are used.
-	//SSL_CTX_set_options() adds the options set via bitmask in options to ctx. Options already set before are not cleared!
-        SSL_CTX_set_options(sslctx,SSL_OP_SINGLE_DH_USE) ;
+	setupContextOptions(sslctx);
 
 
 	// Setup cipher lists:
@@ -401,10 +431,6 @@ bool AuthSSLimpl::InitAuth(
 
 	std::string dh_prime_4096_hex = "A6F5777292D9E6BB95559C9124B9119E6771F11F2048C8FE74F4E8140494520972A087EF1D60B73894F1C5D509DD15D96CF379E9DDD46CE51B748085BACB440D915565782C73AF3A9580CE788441D1DA4D114E3D302CAB45A061ABCFC1F7E9200AE019CB923B77E096FA9377454A16FFE91D86535FF23E075B3E714F785CD7606E9CBD9D06F01CAFA2271883D649F13ABE170D714F6B6EC064C5BF35C4F4BDA5EF5ED5E70D5DC78F1AC1CDC04EEDAE8ADD65C4A9E27368E0B2C8595DD7626D763BFFB15364B3CCA9FCE814B9226B35FE652F4B041F0FF6694D6A482B0EF48CA41163D083AD2DE7B7A068BB05C0453E9D008551C7F67993A3EF2C4874F0244F78C4E0997BD31AB3BD88446916B499B2513DD5BA002063BD38D2CE55D29D071399D5CEE99458AF6FDC104A61CA3FACDAC803CBDE62B4C0EAC946D0E12F05CE9E94497110D64E611D957423B8AA412D84EC83E6E70E0977A31D6EE056D0527D4667D7242A77C9B679D191562E4026DA9C35FF85666296D872ED548E0FFE1A677FCC373C1F490CAB4F53DFD8735C0F1DF02FEAD824A217FDF4E3404D38A5BBC719C6622630FCD34F6F1968AF1B66A4AB1A9FCF653DA96EB3A42AF6FCFEA0547B8F314A527C519949007D7FA1726FF3D33EC46393B0207AA029E5EA574BDAC94D78894B22A2E3303E65A3F820DF57DB44951DE4E973C016C57F7A242D0BC53BC563AF" ;
 
-	std::string cipherString = "kEDH+HIGH:!DSS:!aNULL:!3DES:!EXP";
-
-	SSL_CTX_set_cipher_list(sslctx, cipherString.c_str());
-
 	DH* dh = DH_new();
 	int codes = 0;
 	bool pfs_enabled = true ;
@@ -591,13 +617,33 @@ bool AuthSSLimpl::InitAuth(
 			SSL_VERIFY_FAIL_IF_NO_PEER_CERT, 
 				verify_x509_callback);
 
+	/* Let friends resume their TLS sessions on reconnection, which skips the
+	 * certificate checks. Resumed connections are authenticated again in
+	 * VerifyResumedSession(). We keep the sessions of the connections we
+	 * initiate, and issue stateless tickets for the ones we accept. */
+	SSL_CTX_set_session_id_context(
+	            sslctx, RS_SSL_SESSION_ID_CONTEXT,
+	            sizeof(RS_SSL_SESSION_ID_CONTEXT) - 1 );
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
+	SSL_CTX_set_timeout(sslctx, RS_SSL_SESSION_LIFETIME);
+	SSL_CTX_set_session_cache_mode(
+	            sslctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+	SSL_CTX_sess_set_new_cb(sslctx, new_session_callback);
+
+	// replaced by the saved ones in loadList() if they are still valid
+	mTicketKeys.resize(RS_SSL_TICKET_KEYS_SIZE);
+	if(SSL_CTX_get_tlsext_ticket_keys(
+	            sslctx, mTicketKeys.data(), mTicketKeys.size() ) != 1)
+		mTicketKeys.clear();
+#endif
+
 	mOwnCert = x509;
 
 	RsInfo mInfo;
 	mInfo << __PRETTY_FUNCTION__ << " SSL verification setup complete"
 	      << std::endl <<
 	         "\t Certificate id: " << mOwnId << std::endl <<
-	         "\t cipher list: " << cipherString << std::endl <<
+	         "\t cipher list: " << sslCipherList << std::endl <<
 	         "\t PFS enabled: " << (pfs_enabled ? "yes" : "no");
 	if(codes > 0)
 	{
@@ -1090,6 +1136,17 @@ bool AuthSSLimpl::AuthX509WithGPG(X509 *x509,bool verbose, uint32_t& diagnostic)
 		Dbg3() << __PRETTY_FUNCTION__ << " issuer: " << issuer << " found"
 		       << std::endl;
 
+	/* Same certificate checked with the same key before, the result can't be
+	 * different. This skips the PGP signature check on reconnections. */
+	if(mVerifiedCerts.get(x509, pd.fpr, diagnostic, time(nullptr)))
+	{
+		Dbg3() << __PRETTY_FUNCTION__ << " cached diagnostic: " << diagnostic
+		       << " for certificate of sslId: "
+		       << RsX509Cert::getCertSslId(*x509) << std::endl;
+
+		return diagnostic == RS_SSL_HANDSHAKE_DIAGNOSTIC_OK;
+	}
+
 	/* verify GPG signature */
 	/*** NOW The Manual signing bit (HACKED FROM asn1/a_sign.c) ***/
 
@@ -1244,6 +1301,7 @@ bool AuthSSLimpl::AuthX509WithGPG(X509 *x509,bool verbose, uint32_t& diagnostic)
 	OPENSSL_free(buf_in);
 
 	diagnostic = RS_SSL_HANDSHAKE_DIAGNOSTIC_OK;
+	mVerifiedCerts.store(x509, issuer, pd.fpr, diagnostic, time(nullptr));
 
 	return true;
 
@@ -1251,11 +1309,20 @@ err: // TODO: this label is very short and might collide every easly
 	RsInfo() << __PRETTY_FUNCTION__ << " X509 PGP authentication failed with "
 	         << "diagnostic: " << diagnostic << std::endl;
 
+	// the signature itself is wrong, not worth checking it again
+	if(diagnostic != RS_SSL_HANDSHAKE_DIAGNOSTIC_MALLOC_ERROR)
+		mVerifiedCerts.store(x509, issuer, pd.fpr, diagnostic, time(nullptr));
+
 	if(buf_in) OPENSSL_free(buf_in);
 
 	return false;
 }
 
+void AuthSSLimpl::forgetVerifiedCerts(const RsPgpId& issuer)
+{
+	mVerifiedCerts.forgetIssuer(issuer);
+}
+
 /********************************************************************************/
 /********************************************************************************/
 /****************************  encrypt / decrypt fns ****************************/
@@ -1278,9 +1345,6 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 	constexpr int verificationFailed = 0;
 	constexpr int verificationSuccess = 1;
 
-	using Evt_t = RsAuthSslConnectionAutenticationEvent;
-	std::unique_ptr<Evt_t> ev = std::unique_ptr<Evt_t>(new Evt_t);
-
 	X509* x509Cert = X509_STORE_CTX_get_current_cert(ctx);
 	if(!x509Cert)
 	{
@@ -1293,6 +1357,15 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 		return verificationFailed;
 	}
 
+	return authenticatePeerCert(x509Cert) ? verificationSuccess
+	                                      : verificationFailed;
+}
+
+bool AuthSSLimpl::authenticatePeerCert(X509* x509Cert)
+{
+	using Evt_t = RsAuthSslConnectionAutenticationEvent;
+	std::unique_ptr<Evt_t> ev = std::unique_ptr<Evt_t>(new Evt_t);
+
 	RsPeerId sslId = RsX509Cert::getCertSslId(*x509Cert);
 	std::string sslCn = RsX509Cert::getCertIssuerString(*x509Cert);
 
@@ -1323,7 +1396,7 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 			rsEvents->postEvent(std::move(ev));
 		}
 
-		return verificationFailed;
+		return false;
 	}
 
 	if(pgpId.isNull())
@@ -1343,7 +1416,7 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 			rsEvents->postEvent(std::move(ev));
 		}
 
-		return verificationFailed;
+		return false;
 	}
 
 	bool isSslOnlyFriend = false;
@@ -1373,7 +1446,7 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 				rsEvents->postEvent(std::move(ev));
 			}
 
-			return verificationFailed;
+			return false;
 		}
 	}
 
@@ -1415,7 +1488,7 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 		if (auth_diagnostic == RS_SSL_HANDSHAKE_DIAGNOSTIC_ISSUER_UNKNOWN)
 			RsServer::notify()->AddPopupMessage(RS_POPUP_CONNECT_ATTEMPT, pgpId.toStdString(), sslCn, sslId.toStdString()); /* notify Connect Attempt */
 
-		return verificationFailed;
+		return false;
 	}
 #ifdef AUTHSSL_DEBUG
     std::cerr << "******* VerifyX509Callback cert: " << std::hex << ctx->cert <<std::dec << std::endl;
@@ -1441,7 +1514,7 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 
 		RsServer::notify()->AddPopupMessage(RS_POPUP_CONNECT_ATTEMPT, pgpId.toStdString(), sslCn, sslId.toStdString()); /* notify Connect Attempt */
 
-		return verificationFailed;
+		return false;
 	}
 
     LocalStoreCert(x509Cert);
@@ -1450,7 +1523,104 @@ int AuthSSLimpl::VerifyX509Callback(int /*preverify_ok*/, X509_STORE_CTX* ctx)
 	         << "sslId: " << sslId << " isSslOnlyFriend: " << isSslOnlyFriend
 	         << std::endl;
 
-	return verificationSuccess;
+	return true;
+}
+
+static int new_session_callback(SSL* ssl, SSL_SESSION* session)
+{ return AuthSSL::instance().NewSessionCallback(ssl, session); }
+
+int AuthSSLimpl::NewSessionCallback(SSL* ssl, SSL_SESSION* session)
+{
+	/* We only resume connections we initiate. The session was established
+	 * with an authenticated peer, either by VerifyX509Callback or by
+	 * VerifyResumedSession before the new ticket could be read. */
+	if(SSL_is_server(ssl))
+		return 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
+	X509* x509 = SSL_SESSION_get0_peer(session);
+	if(!x509)
+		return 0;
+
+	RsPeerId sslId = RsX509Cert::getCertSslId(*x509);
+	if(sslId.isNull())
+		return 0;
+
+	mSessions.store(sslId, session);
+	IndicateConfigChanged();
+#else
+	(void) session;
+#endif
+
+	return 0;
+}
+
+bool AuthSSLimpl::setResumableSession(SSL* ssl, const RsPeerId& peerId)
+{
+	SSL_SESSION* session = mSessions.get(peerId, time(nullptr));
+	if(!session)
+		return false;
+
+	bool offered = (SSL_set_session(ssl, session) == 1);
+	SSL_SESSION_free(session);
+
+	Dbg3() << __PRETTY_FUNCTION__ << " offering session to peer: " << peerId
+	       << " " << offered << std::endl;
+
+	return offered;
+}
+
+bool AuthSSLimpl::VerifyResumedSession(SSL* ssl, const RsPeerId& peerId)
+{
+	if(!SSL_session_reused(ssl))
+		return true;
+
+	X509* x509 = SSL_get_peer_certificate(ssl);
+	if(!x509)
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " resumed session without peer "
+		        << "certificate!" << std::endl;
+		mSessions.remove(peerId);
+		return false;
+	}
+
+	RsPeerId sslId = RsX509Cert::getCertSslId(*x509);
+	bool accepted = !sslId.isNull() && (peerId.isNull() || sslId == peerId);
+
+	if(accepted)
+	{
+		bool known;
+		{
+			RS_STACK_MUTEX(sslMtx);
+			auto it = mCerts.find(sslId);
+			known = it != mCerts.end() && X509_cmp(it->second, x509) == 0;
+		}
+
+		if(known)
+		{
+			/* The certificate was fully authenticated when the session was
+			 * established, what may have changed since is the friendship. */
+			RsPgpId pgpId = RsX509Cert::getCertIssuer(*x509);
+
+			accepted = rsPeers->isSslOnlyFriend(sslId)
+			        || pgpId == AuthPGP::getPgpOwnId()
+			        || AuthPGP::isPGPAccepted(pgpId);
+		}
+		else
+			accepted = authenticatePeerCert(x509);
+	}
+
+	if(!accepted)
+	{
+		RsInfo() << __PRETTY_FUNCTION__ << " refusing resumed session of peer: "
+		         << sslId << " expected: " << peerId << std::endl;
+
+		mSessions.remove(sslId);
+		if(!peerId.isNull()) mSessions.remove(peerId);
+	}
+
+	X509_free(x509);
+	return accepted;
 }
 
 bool AuthSSLimpl::parseX509DetailsFromFile( const std::string& certFilePath, RsPeerId& certId, RsPgpId& issuer, std::string& location )
@@ -1814,6 +1984,9 @@ bool AuthSSLimpl::saveList(bool& cleanup, std::list<RsItem*>& lst)
         std::cerr << "AuthSSLimpl::saveList() called" << std::endl ;
         #endif
 
+        // encrypting takes the lock
+        RsConfigKeyValueSet *sessions = saveSessions();
+
         RsStackMutex stack(sslMtx); /******* LOCKED ******/
 
         cleanup = true ;
@@ -1835,6 +2008,9 @@ bool AuthSSLimpl::saveList(bool& cleanup, std::list<RsItem*>& lst)
         }
         lst.push_back(vitem);
 
+        if(sessions)
+                lst.push_back(sessions);
+
         return true ;
 }
 
@@ -1860,6 +2036,10 @@ bool AuthSSLimpl::loadList(std::list<RsItem*>& load)
                         std::list<RsTlvKeyValue>::iterator kit;
                         for(kit = vitem->tlvkvs.pairs.begin(); kit != vitem->tlvkvs.pairs.end(); ++kit)
                         {
+                                if (kit->key == RS_SSL_SESSIONS_KEY) {
+                                        loadSessions(kit->value);
+                                        continue;
+                                }
                                 if (RsPeerId(kit->key) == mOwnId) {
                                         continue;
                                 }
@@ -1879,6 +2059,121 @@ bool AuthSSLimpl::loadList(std::list<RsItem*>& load)
         return true;
 }
 
+RsConfigKeyValueSet* AuthSSLimpl::saveSessions()
+{
+	/* Session master secrets and ticket keys are as sensitive as our private
+	 * key, so they are saved encrypted to ourselves, all in one go. Values
+	 * are base64 encoded, as TLV strings are filtered. */
+	RsTlvKeyValueSet plain;
+	RsTlvKeyValue kv;
+
+	std::map<RsPeerId, std::vector<uint8_t> > sessions;
+	mSessions.exportSessions(sessions, time(nullptr));
+
+	for(auto& it : sessions)
+	{
+		kv.key = it.first.toStdString();
+		RsBase64::encode(it.second.data(), it.second.size(), kv.value);
+		plain.pairs.push_back(kv);
+	}
+
+	{
+		RS_STACK_MUTEX(sslMtx);
+
+		/* Saved with the time they were last in use, which bounds the validity
+		 * of the tickets we issued with them. */
+		if(!mTicketKeys.empty())
+		{
+			kv.key = RS_SSL_TICKET_KEYS_KEY + ":" + std::to_string(time(nullptr));
+			RsBase64::encode(mTicketKeys.data(), mTicketKeys.size(), kv.value);
+			plain.pairs.push_back(kv);
+		}
+	}
+
+	if(plain.pairs.empty())
+		return nullptr;
+
+	uint32_t size = plain.TlvSize();
+	std::vector<uint8_t> buf(size);
+	uint32_t offset = 0;
+	if(!plain.SetTlv(buf.data(), size, &offset))
+		return nullptr;
+
+	void* encrypted = nullptr;
+	int encryptedLen = 0;
+	if(!encrypt(encrypted, encryptedLen, buf.data(), size, mOwnId))
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot encrypt TLS sessions"
+		        << std::endl;
+		return nullptr;
+	}
+
+	RsConfigKeyValueSet* vitem = new RsConfigKeyValueSet;
+	kv.key = RS_SSL_SESSIONS_KEY;
+	RsBase64::encode(
+	            static_cast<const uint8_t*>(encrypted), encryptedLen, kv.value );
+	vitem->tlvkvs.pairs.push_back(kv);
+	free(encrypted);
+
+	return vitem;
+}
+
+void AuthSSLimpl::loadSessions(const std::string& encoded)
+{
+	std::vector<uint8_t> encrypted;
+	if(RsBase64::decode(encoded, encrypted) || encrypted.empty())
+		return;
+
+	void* decrypted = nullptr;
+	int decryptedLen = 0;
+	if(!decrypt(decrypted, decryptedLen, encrypted.data(), encrypted.size()))
+	{
+		RsErr() << __PRETTY_FUNCTION__ << " cannot decrypt saved TLS sessions"
+		        << std::endl;
+		return;
+	}
+
+	RsTlvKeyValueSet plain;
+	uint32_t offset = 0;
+	bool ok = plain.GetTlv(decrypted, decryptedLen, &offset);
+	free(decrypted);
+	if(!ok)
+		return;
+
+	rstime_t now = time(nullptr);
+	std::map<RsPeerId, std::vector<uint8_t> > sessions;
+
+	for(const RsTlvKeyValue& kv : plain.pairs)
+	{
+		std::vector<uint8_t> value;
+		if(RsBase64::decode(kv.value, value))
+			continue;
+
+		if(kv.key.compare(0, RS_SSL_TICKET_KEYS_KEY.size(), RS_SSL_TICKET_KEYS_KEY))
+		{
+			sessions[RsPeerId(kv.key)] = value;
+			continue;
+		}
+
+		rstime_t lastUsed = atoll(kv.key.c_str() + RS_SSL_TICKET_KEYS_KEY.size() + 1);
+		if(now < lastUsed || now - lastUsed >= RS_SSL_SESSION_LIFETIME)
+			continue;
+
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
+		RS_STACK_MUTEX(sslMtx);
+		if( sslctx && value.size() == RS_SSL_TICKET_KEYS_SIZE &&
+		    SSL_CTX_set_tlsext_ticket_keys(sslctx, value.data(), value.size()) == 1 )
+			mTicketKeys = value;
+#endif
+	}
+
+	sessions.erase(RsPeerId());
+	mSessions.importSessions(sessions, now);
+
+	Dbg2() << __PRETTY_FUNCTION__ << " loaded " << mSessions.size()
+	       << " TLS sessions" << std::endl;
+}
+
 const EVP_PKEY*RsX509Cert::getPubKey(const X509& x509)
 {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
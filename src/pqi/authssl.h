@@ -33,10 +33,14 @@
 #include "pqi/pqi_base.h"
 #include "pqi/pqinetwork.h"
 #include "pqi/p3cfgmgr.h"
+#include "pqi/sslcertcache.h"
+#include "pqi/sslsessioncache.h"
 #include "util/rsmemory.h"
 #include "retroshare/rsevents.h"
 #include "retroshare/rsinit.h"
 
+class RsConfigKeyValueSet;
+
 /**
  * Functions to interact elegantly with X509 certificates, using this functions
  * you can avoid annoying #ifdef *SSL_VERSION_NUMBER all around the code.
@@ -65,6 +69,13 @@ public:
 	RS_DEPRECATED_FOR(AuthSSL::instance())
 	static AuthSSL* getAuthSSL();
 
+	/**
+	 * Set the protocol options (kernel TLS included when built with RS_KTLS)
+	 * and the cipher list every peer connection context uses. Certificates
+	 * and Diffie-Hellman parameters are left to the caller.
+	 */
+	static void setupContextOptions(SSL_CTX* ctx);
+
 	/* Initialisation Functions (Unique) */
 	virtual bool validateOwnCertificate(X509 *x509, EVP_PKEY *pkey) = 0;
 
@@ -128,6 +139,12 @@ public:
 	        uint32_t& diagnostic = RS_DEFAULT_STORAGE_PARAM(uint32_t)
 	        ) = 0;
 
+	/**
+	 * @brief Forget the signature checks of the certificates issued by a PGP
+	 * key, to be called when the key is removed from the keyring
+	 */
+	virtual void forgetVerifiedCerts(const RsPgpId& issuer) = 0;
+
 	/**
 	 * @brief Callback provided to OpenSSL to authenticate connections
 	 * This is the ultimate place where connection attempts get accepted
@@ -141,6 +158,34 @@ public:
 	 */
 	virtual int VerifyX509Callback(int preverify_ok, X509_STORE_CTX* ctx) = 0;
 
+	/**
+	 * @brief Offer the last TLS session of the peer for resumption
+	 * To be called on connections we initiate, before the handshake. If the
+	 * peer doesn't accept the session OpenSSL falls back to a full handshake.
+	 * @return true if a session was offered
+	 */
+	virtual bool setResumableSession(SSL* ssl, const RsPeerId& peerId) = 0;
+
+	/**
+	 * @brief Authenticate the peer of a resumed TLS session
+	 * OpenSSL doesn't call VerifyX509Callback when a session is resumed: the
+	 * session carries the certificate authenticated when it was established.
+	 * This checks that it is the expected peer, that its certificate is the
+	 * one we authenticated, and that the peer is still a friend.
+	 * To be called once the handshake is complete.
+	 * @param[in] peerId expected peer, null to accept any friend
+	 * @return true if the session was not resumed or the peer is still
+	 *	accepted, false if the connection must be dropped
+	 */
+	virtual bool VerifyResumedSession(SSL* ssl, const RsPeerId& peerId) = 0;
+
+	/**
+	 * @brief Callback provided to OpenSSL to keep the sessions of the
+	 * connections we initiate, @see SslSessionCache
+	 * @return 0, the session reference is left to OpenSSL
+	 */
+	virtual int NewSessionCallback(SSL* ssl, SSL_SESSION* session) = 0;
+
 	/// SSL specific functions used in pqissl/pqissllistener
 	virtual SSL_CTX* getCTX() = 0;
 
@@ -211,9 +256,21 @@ public:
 	/// @see AuthSSL
 	bool AuthX509WithGPG(X509 *x509, bool verbose, uint32_t& auth_diagnostic) override;
 
+	/// @see AuthSSL
+	void forgetVerifiedCerts(const RsPgpId& issuer) override;
+
 	/// @see AuthSSL
 	int VerifyX509Callback(int preverify_ok, X509_STORE_CTX *ctx) override;
 
+	/// @see AuthSSL
+	bool setResumableSession(SSL* ssl, const RsPeerId& peerId) override;
+
+	/// @see AuthSSL
+	bool VerifyResumedSession(SSL* ssl, const RsPeerId& peerId) override;
+
+	/// @see AuthSSL
+	int NewSessionCallback(SSL* ssl, SSL_SESSION* session) override;
+
 	/// @see AuthSSL
 	bool parseX509DetailsFromFile(
 	        const std::string& certFilePath, RsPeerId& certId,
@@ -237,6 +294,13 @@ private:
 	bool LocalStoreCert(X509* x509);
 	bool RemoveX509(const RsPeerId id);
 
+	/// Full authentication of a peer certificate, see VerifyX509Callback
+	bool authenticatePeerCert(X509* x509Cert);
+
+	/// Sessions and ticket keys, encrypted to ourselves, to survive restarts
+	RsConfigKeyValueSet* saveSessions();
+	void loadSessions(const std::string& encrypted);
+
 	/*********** LOCKED Functions ******/
 	bool locked_FindCert(const RsPeerId& id, X509** cert);
 
@@ -265,4 +329,10 @@ private:
 	RsPgpId _last_gpgid_to_connect;
 	std::string _last_sslcn_to_connect;
 	RsPeerId _last_sslid_to_connect;
+
+	/* keys protecting the session tickets we issue */
+	std::vector<uint8_t> mTicketKeys;
+
+	SslSessionCache mSessions; /* has its own mutex */
+	SslVerifiedCertCache mVerifiedCerts; /* has its own mutex */
 };
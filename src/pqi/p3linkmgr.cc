@@ -85,6 +85,13 @@ const uint32_t P3CONNMGR_UDP_DEFAULT_PERIOD = 30;  // this represents how long i
 
 void  printConnectState(std::ostream &out, peerConnectState &peer);
 
+/* direct TCP addresses can be tried together, proxies and UDP can't */
+static bool isRaceableAddress(const peerConnectAddress &pca)
+{
+	return (pca.type & RS_NET_CONN_TCP_ALL) &&
+	       !(pca.type & (RS_NET_CONN_TCP_HIDDEN_TOR | RS_NET_CONN_TCP_HIDDEN_I2P));
+}
+
 peerConnectAddress::peerConnectAddress()
 	:delay(0), period(0), type(0), flags(0), ts(0), bandwidth(0), domain_port(0)
 {
@@ -644,11 +651,30 @@ bool p3LinkMgrIMPL::connectAttempt(const RsPeerId &id, struct sockaddr_storage &
 	rslog(RSL_WARNING, p3connectzone, "p3LinkMgrIMPL::connectAttempt() called id: " + id.toStdString());
 #endif
 
-        it->second.lastattempt = time(NULL); 
+	rstime_t now = time(NULL);
+	if (!it->second.inConnAttempt)
+		it->second.raceConnAddrs.clear();
+
+        it->second.lastattempt = now;
         it->second.inConnAttempt = true;
         it->second.currentConnAddrAttempt = it->second.connAddrs.front();
 	it->second.connAddrs.pop_front();
 
+	/* TCP attempts started together are staggered, so the first address
+	 * keeps a head start and the others only compete if it is slow.
+	 */
+	if (isRaceableAddress(it->second.currentConnAddrAttempt))
+	{
+		std::list<peerConnectAddress>::iterator rit;
+		for(rit = it->second.raceConnAddrs.begin(); rit != it->second.raceConnAddrs.end(); ++rit)
+		{
+			if (rit->ts == now)
+				it->second.currentConnAddrAttempt.delay += RS_TCP_RACE_STAGGER;
+		}
+	}
+	it->second.currentConnAddrAttempt.ts = now;
+	it->second.raceConnAddrs.push_back(it->second.currentConnAddrAttempt);
+
 	raddr = it->second.currentConnAddrAttempt.addr;
 	delay = it->second.currentConnAddrAttempt.delay;
 	period = it->second.currentConnAddrAttempt.period;
@@ -894,17 +920,26 @@ bool p3LinkMgrIMPL::connectResult(const RsPeerId &id, bool success, bool isIncom
 			// THIS TEST IS A Bit BAD XXX, we should update their address anyway...
 			// This means we only update connections that we've made.. so maybe not too bad?
 			
-			if ((it->second.inConnAttempt) &&
-					(sockaddr_storage_same(it->second.currentConnAddrAttempt.addr, remote_peer_address)))
-			{				
-				updatePeerAddr = true;
+			if (it->second.inConnAttempt)
+			{
+				std::list<peerConnectAddress>::iterator rit;
+				for(rit = it->second.raceConnAddrs.begin(); rit != it->second.raceConnAddrs.end(); ++rit)
+				{
+					if (sockaddr_storage_same(rit->addr, remote_peer_address))
+					{
+						updatePeerAddr = true;
+						it->second.currentConnAddrAttempt = *rit;
 #ifdef LINKMGR_DEBUG
-				std::cerr << "p3LinkMgrIMPL::connectResult() adding current peer address in list." << std::endl;
+						std::cerr << "p3LinkMgrIMPL::connectResult() adding current peer address in list." << std::endl;
 #endif
+						break;
+					}
+				}
 			}
 
-			/* remove other attempts */
+			/* remove other attempts, pqiperson has cancelled them */
 			it->second.inConnAttempt = false;
+			it->second.raceConnAddrs.clear();
 			it->second.connAddrs.clear();
 			mStatusChanged = true;
 		}
@@ -926,7 +961,23 @@ bool p3LinkMgrIMPL::connectResult(const RsPeerId &id, bool success, bool isIncom
 			}
 #endif
 
-			it->second.inConnAttempt = false;
+			/* the attempt in progress to the failed address is over, a
+			 * failure of something else (a dropped connection, an incoming
+			 * one) leaves the others running.
+			 */
+			if (it->second.inConnAttempt)
+			{
+				std::list<peerConnectAddress>::iterator rit;
+				for(rit = it->second.raceConnAddrs.begin(); rit != it->second.raceConnAddrs.end(); ++rit)
+				{
+					if (sockaddr_storage_same(rit->addr, remote_peer_address))
+					{
+						it->second.raceConnAddrs.erase(rit);
+						break;
+					}
+				}
+			}
+			it->second.inConnAttempt = !it->second.raceConnAddrs.empty();
 
 #ifdef LINKMGR_DEBUG
 			std::cerr << "p3LinkMgrIMPL::connectResult() Disconnect/Fail: id: " << id << std::endl;
@@ -943,13 +994,15 @@ bool p3LinkMgrIMPL::connectResult(const RsPeerId &id, bool success, bool isIncom
 				updateLastContact = true; /* time of disconnect */
 			}
 
-			if (it->second.connAddrs.size() >= 1)
+			/* next address, unless it has to wait for the race to end */
+			if ((it->second.connAddrs.size() >= 1) &&
+			    (!it->second.inConnAttempt || locked_CanRaceConnectAttempt(&(it->second))))
 			{
 				it->second.actions |= RS_PEER_CONNECT_REQ;
 				mStatusChanged = true;
 			}
 
-			if (it->second.dhtVisible)
+			if (it->second.dhtVisible && !it->second.inConnAttempt)
 			{
 				doDhtAssist = true;
 			}
@@ -1442,6 +1495,38 @@ void p3LinkMgrIMPL::peerConnectRequest(
 /*******************************************************************/
 /*******************************************************************/
        /*************** External Control ****************/
+bool   p3LinkMgrIMPL::canRaceConnectAttempt(const RsPeerId &id)
+{
+	RS_STACK_MUTEX(mLinkMtx); /****** STACK LOCK MUTEX *******/
+
+	std::map<RsPeerId, peerConnectState>::iterator it = mFriendList.find(id);
+	if (it == mFriendList.end())
+		return false;
+
+	return locked_CanRaceConnectAttempt(&(it->second));
+}
+
+bool   p3LinkMgrIMPL::locked_CanRaceConnectAttempt(peerConnectState *peer)
+{
+	if (!peer->inConnAttempt || peer->connAddrs.empty())
+		return false;
+
+	if (peer->raceConnAddrs.size() >= RS_TCP_RACE_WIDTH)
+		return false;
+
+	if (!isRaceableAddress(peer->connAddrs.front()))
+		return false;
+
+	std::list<peerConnectAddress>::const_iterator it;
+	for(it = peer->raceConnAddrs.begin(); it != peer->raceConnAddrs.end(); ++it)
+	{
+		if (!isRaceableAddress(*it))
+			return false;
+	}
+
+	return true;
+}
+
 bool   p3LinkMgrIMPL::retryConnect(const RsPeerId &id)
 {
 	/* push all available addresses onto the connect addr stack */
@@ -1985,6 +2070,12 @@ bool  p3LinkMgrIMPL::locked_ConnectAttempt_Complete(peerConnectState *peer)
 	if (peer->inConnAttempt) 
 	{
                 /*  -> it'll automatically use the addresses we added */
+		/*  -> or right now if there is room in the race */
+		if (locked_CanRaceConnectAttempt(peer))
+		{
+			peer->actions |= RS_PEER_CONNECT_REQ;
+			mStatusChanged = true;
+		}
 #ifdef LINKMGR_DEBUG
 		std::cerr << "p3LinkMgrIMPL::locked_ConnectAttempt_Complete() Already in CONNECT ATTEMPT";
 		std::cerr << std::endl;
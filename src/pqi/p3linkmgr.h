@@ -53,6 +53,10 @@ const uint32_t RS_TCP_STD_TIMEOUT_PERIOD	= 5; /* 5 seconds! */
 const uint32_t RS_TCP_HIDDEN_TIMEOUT_PERIOD	= 30; /* 30 seconds! */
 const uint32_t RS_UDP_STD_TIMEOUT_PERIOD	= 80; /* 80 secs, allows UDP TTL to get to 40! - Plenty of time (30+80) = 110 secs */
 
+// TCP addresses of a peer tried at once, each one a bit later than the previous.
+const uint32_t RS_TCP_RACE_WIDTH		= 3;
+const uint32_t RS_TCP_RACE_STAGGER		= 1; /* 1 second between two starts */
+
 class peerAddrInfo
 {
 	public:
@@ -118,6 +122,7 @@ class peerConnectState
 	/* a list of connect attempts to make (in order) */
 	bool inConnAttempt;
 	peerConnectAddress currentConnAddrAttempt;
+	std::list<peerConnectAddress> raceConnAddrs; /* attempts in progress, ts is their start */
 	std::list<peerConnectAddress> connAddrs;
 
 	/* information about denial */
@@ -171,6 +176,9 @@ virtual bool	connectAttempt(const RsPeerId &id, struct sockaddr_storage &raddr,
 virtual bool 	connectResult(const RsPeerId &id, bool success, bool isIncomingConnection, uint32_t flags, const struct sockaddr_storage &remote_peer_address) = 0;
 virtual bool	retryConnect(const RsPeerId &id) = 0;
 
+	/* true if the next address can be tried alongside the ones in progress */
+virtual bool	canRaceConnectAttempt(const RsPeerId &id) = 0;
+
 	/* Network Addresses */
 virtual bool 	setLocalAddress(const struct sockaddr_storage &addr) = 0;
 virtual bool 	getLocalAddress(struct sockaddr_storage &addr) = 0;
@@ -227,6 +235,7 @@ virtual bool	connectAttempt(const RsPeerId &id, struct sockaddr_storage &raddr,
 	
 virtual bool 	connectResult(const RsPeerId &id, bool success, bool isIncomingConnection, uint32_t flags, const struct sockaddr_storage &remote_peer_address);
 virtual bool	retryConnect(const RsPeerId &id);
+virtual bool	canRaceConnectAttempt(const RsPeerId &id);
 
 	/* Network Addresses */
 virtual bool 	setLocalAddress(const struct sockaddr_storage &addr);
@@ -298,6 +307,7 @@ void 	locked_ConnectAttempt_AddTunnel(peerConnectState *peer);
 void  	locked_ConnectAttempt_ProxyAddress(peerConnectState *peer, const uint32_t type, const struct sockaddr_storage &proxy_addr, const std::string &domain_addr, uint16_t domain_port);
 
 bool  	locked_ConnectAttempt_Complete(peerConnectState *peer);
+bool  	locked_CanRaceConnectAttempt(peerConnectState *peer);
 
     bool locked_CheckPotentialAddr(const sockaddr_storage& addr);
 
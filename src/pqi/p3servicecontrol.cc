@@ -86,10 +86,11 @@ RsServiceControl *rsServiceControl = NULL;
 p3ServiceControl::p3ServiceControl(p3LinkMgr *linkMgr)
   : RsServiceControl(), p3Config(),
     mLinkMgr(linkMgr), mOwnPeerId(linkMgr->getOwnId()),
-    mCtrlMtx("p3ServiceControl"), mMonitorMtx("P3ServiceControl::Monitor"),
-    mServiceServer(NULL)
+    mCtrlMtx("p3ServiceControl"), mDeferFilterPublish(false),
+    mMonitorMtx("P3ServiceControl::Monitor"), mServiceServer(NULL)
 {
     mSerialiser = new ServiceControlSerialiser ;
+    mFilterSnapshot.publish(std::make_shared<ServiceFilterSnapshot>());
 }
 
 RsSerialiser *p3ServiceControl::setupSerialiser()
@@ -424,38 +425,13 @@ bool p3ServiceControl::updateServicePermissions(uint32_t serviceId, const RsServ
 /****************************************************************************/
 /****************************************************************************/
 
-// This is the basic system...
-// which will be a little slow (2x maps).
-//
-// Potential improvement is to push the RsPeerFilter
-// to the pqiStreamer, (when items have been sorted by peers already!).
-// but we will do this later.
+// Called for every item going in or out, so it must not take mCtrlMtx.
 
 bool	p3ServiceControl::checkFilter(uint32_t serviceId, const RsPeerId &peerId)
 {
-	RsStackMutex stack(mCtrlMtx); /***** LOCK STACK MUTEX ****/
-
 #ifdef SERVICECONTROL_DEBUG
 	std::cerr << "p3ServiceControl::checkFilter() ";
 	std::cerr << " ServiceId: " << serviceId;
-#endif
-
-	std::map<uint32_t, RsServiceInfo>::iterator it;
-	it = mOwnServices.find(serviceId);
-	if (it != mOwnServices.end())
-	{
-#ifdef SERVICECONTROL_DEBUG
-		std::cerr << " ServiceName: " << it->second.mServiceName;
-#endif
-	}
-	else
-	{
-#ifdef SERVICECONTROL_DEBUG
-		std::cerr << " ServiceName: Unknown! ";
-#endif
-	}
-
-#ifdef SERVICECONTROL_DEBUG
 	std::cerr << " PeerId: " << peerId.toStdString();
 	std::cerr << std::endl;
 #endif
@@ -470,51 +446,65 @@ bool	p3ServiceControl::checkFilter(uint32_t serviceId, const RsPeerId &peerId)
 		return true;
 	}
 
+	bool allowed = false;
 
-	std::map<RsPeerId, ServicePeerFilter>::const_iterator pit;
-	pit = mPeerFilterMap.find(peerId);
-	if (pit == mPeerFilterMap.end())
 	{
-#ifdef SERVICECONTROL_DEBUG
-		std::cerr << "p3ServiceControl::checkFilter() Denied No PeerId";
-		std::cerr << std::endl;
-#endif
-		return false;
+		RsRcuReadLock rcu;
+		const ServiceFilterSnapshot *snapshot = mFilterSnapshot.get();
+
+		ServiceFilterSnapshot::const_iterator pit = snapshot->find(peerId);
+		if (pit != snapshot->end())
+			allowed = pit->second->isAllowed(serviceId);
 	}
 
-	if (pit->second.mDenyAll)
-	{
 #ifdef SERVICECONTROL_DEBUG
-		std::cerr << "p3ServiceControl::checkFilter() Denied Peer.DenyAll";
-		std::cerr << std::endl;
+	std::cerr << "p3ServiceControl::checkFilter() ";
+	std::cerr << (allowed ? "Allowed" : "Denied");
+	std::cerr << std::endl;
 #endif
-		return false;
-	}
+	return allowed;
+}
 
-	if (pit->second.mAllowAll)
+ServicePermissionBitmap::ServicePermissionBitmap(const ServicePeerFilter &filter)
+  : mAllowAll(!filter.mDenyAll && filter.mAllowAll)
+{
+	if (filter.mDenyAll)
+		return;
+
+	for(uint32_t serviceId : filter.mAllowedServices)
+		if (isServiceId(serviceId))
+			mAllowed.set((serviceId >> 8) & 0xffff);
+}
+
+void	p3ServiceControl::publishFilters_locked(const RsPeerId &peerId)
+{
+	if (mDeferFilterPublish)
+		return;
+
+	std::shared_ptr<ServiceFilterSnapshot> snapshot;
+
+	if (peerId.isNull())
 	{
-#ifdef SERVICECONTROL_DEBUG
-		std::cerr << "p3ServiceControl::checkFilter() Allowed Peer.AllowAll";
-		std::cerr << std::endl;
-#endif
-		return true;
+		snapshot = std::make_shared<ServiceFilterSnapshot>();
+		for(const auto &it : mPeerFilterMap)
+			(*snapshot)[it.first] =
+			        std::make_shared<ServicePermissionBitmap>(it.second);
 	}
-
-	std::set<uint32_t>::const_iterator sit;
-	sit = pit->second.mAllowedServices.find(serviceId);
-	if (sit == pit->second.mAllowedServices.end())
+	else
 	{
-#ifdef SERVICECONTROL_DEBUG
-		std::cerr << "p3ServiceControl::checkFilter() Denied !Peer.find(serviceId)";
-		std::cerr << std::endl;
-#endif
-		return false;
+		// Copy the current one, only the bitmap of peerId is rebuilt.
+		snapshot = std::make_shared<ServiceFilterSnapshot>(*mFilterSnapshot.published());
+
+		std::map<RsPeerId, ServicePeerFilter>::const_iterator fit;
+		fit = mPeerFilterMap.find(peerId);
+		if (fit == mPeerFilterMap.end())
+			snapshot->erase(peerId);
+		else
+			(*snapshot)[peerId] =
+			        std::make_shared<ServicePermissionBitmap>(fit->second);
 	}
-#ifdef SERVICECONTROL_DEBUG
-	std::cerr << "p3ServiceControl::checkFilter() Allowed Peer.find(serviceId)";
-	std::cerr << std::endl;
-#endif
-	return true;
+
+	mFilterSnapshot.publish(snapshot);
 }
 
 bool versionOkay(uint16_t version_major, uint16_t version_minor,
@@ -617,10 +607,15 @@ bool	p3ServiceControl::updateAllFilters_locked()
 		peerSet.insert(fit->first);
 	}
 
+	// Publish a single snapshot once all the filters are updated.
+	mDeferFilterPublish = true;
 	for(pit = peerSet.begin(); pit != peerSet.end(); ++pit)
 	{
 		updateFilterByPeer_locked(*pit);
 	}
+	mDeferFilterPublish = false;
+
+	publishFilters_locked(RsPeerId());
 	return true;
 }
 
@@ -658,6 +653,7 @@ bool	p3ServiceControl::updateFilterByPeer_locked(const RsPeerId &peerId)
 		{
 			std::cerr << std::endl;
 			mPeerFilterMap.erase(fit);
+			publishFilters_locked(peerId);
 		}
 		return true;
 	}
@@ -757,6 +753,7 @@ bool	p3ServiceControl::updateFilterByPeer_locked(const RsPeerId &peerId)
 #endif
 		mPeerFilterMap[peerId] = peerFilter;
 	}
+	publishFilters_locked(peerId);
 	recordFilterChanges_locked(peerId, originalFilter, peerFilter);
 
 	using Evt_t = RsPeerStateChangedEvent;
@@ -888,6 +885,7 @@ void	p3ServiceControl::removePeer(const RsPeerId &peerId)
 			hadFilter = true;
 			originalFilter = fit->second;
 			mPeerFilterMap.erase(fit);
+			publishFilters_locked(peerId);
 		}
 		else
 		{
@@ -1033,6 +1031,11 @@ void	p3ServiceControl::tick()
 	notifyAboutFriends();
 	notifyServices();
 
+	{
+		RsStackMutex stack(mCtrlMtx); /***** LOCK STACK MUTEX ****/
+		mFilterSnapshot.reclaim();
+	}
+
 #ifdef SERVICECONTROL_DEBUG
 	std::cerr << "p3ServiceControl::tick()";
 	std::cerr << std::endl;
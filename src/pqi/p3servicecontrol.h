@@ -24,12 +24,18 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
+#include <bitset>
+#include <memory>
 
 #include "retroshare/rsservicecontrol.h"
+#include "serialiser/rsserial.h"
 #include "pqi/p3cfgmgr.h"
 #include "pqi/pqimonitor.h"
 #include "pqi/pqiservicemonitor.h"
 #include "pqi/p3linkmgr.h"
+#include "util/rsrcu.h"
 
 class p3ServiceServer ;
 
@@ -53,6 +59,38 @@ class ServicePeerFilter
 
 std::ostream &operator<<(std::ostream &out, const ServicePeerFilter &filter);
 
+/**
+ * Flat copy of a ServicePeerFilter, one bit per 16 bits service type, so
+ * checking if an item may go through costs a single bit test.
+ */
+class ServicePermissionBitmap
+{
+public:
+	explicit ServicePermissionBitmap(const ServicePeerFilter &filter);
+
+	bool isAllowed(uint32_t serviceId) const
+	{
+		if(mAllowAll) return true;
+		if(!isServiceId(serviceId)) return false;
+		return mAllowed.test((serviceId >> 8) & 0xffff);
+	}
+
+private:
+	/// Only full service ids (version in top byte, empty low byte) are indexed
+	static bool isServiceId(uint32_t serviceId)
+	{ return (serviceId & 0xff0000ff) == (((uint32_t) RS_PKT_VERSION_SERVICE) << 24); }
+
+	bool mAllowAll;
+	std::bitset<65536> mAllowed;
+};
+
+/**
+ * Immutable snapshot of all the peer filters. Bitmaps of peers whose filter
+ * didn't change are shared between successive snapshots.
+ */
+typedef std::map<RsPeerId, std::shared_ptr<const ServicePermissionBitmap> >
+        ServiceFilterSnapshot;
+
 class ServiceControlSerialiser ;
 
 class p3ServiceControl: public RsServiceControl, public pqiMonitor, public p3Config
@@ -162,6 +200,12 @@ bool 	updateFilterByPeer_locked(const RsPeerId &peerId);
 	void    recordFilterChanges_locked(const RsPeerId &peerId,
         	ServicePeerFilter &originalFilter, ServicePeerFilter &updatedFilter);
 
+	/**
+	 * Publish a new filter snapshot reflecting mPeerFilterMap entry of
+	 * given peer, or of all peers if peerId is null.
+	 */
+	void publishFilters_locked(const RsPeerId &peerId);
+
 	// Called from recordFilterChanges.
 	void filterChangeAdded_locked(const RsPeerId &peerId, uint32_t serviceId);
 	void filterChangeRemoved_locked(const RsPeerId &peerId, uint32_t serviceId);
@@ -183,6 +227,11 @@ bool peerHasPermissionForService_locked(const RsPeerId &peerId, uint32_t service
 	// derived from all the others.
         std::map<RsPeerId, ServicePeerFilter> mPeerFilterMap;
 
+	/* mPeerFilterMap is mirrored in an immutable snapshot which is swapped
+	 * each time it changes, so checkFilter() doesn't need mCtrlMtx. */
+	RsRcuPtr<ServiceFilterSnapshot> mFilterSnapshot;
+	bool mDeferFilterPublish;
+
         std::map<uint32_t, ServiceNotifications> mNotifications;
         std::list<pqiServicePeer> mFriendNotifications;
 
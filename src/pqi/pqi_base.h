@@ -23,6 +23,7 @@
 #define PQI_BASE_ITEM_HEADER
 
 #include <list>
+#include <vector>
 #include <string>
 #include <iostream>
 #include <functional>
@@ -30,8 +31,10 @@
 #include <inttypes.h>
 
 #include "pqi/pqinetwork.h"
+#include "pqi/pqioutslice.h"
 
 struct RSTrafficClue;
+struct RsQoSClassStats;
 
 /*** Base DataTypes: ****/
 #include "serialiser/rsserial.h"
@@ -84,6 +87,12 @@ public:
 
 	virtual int gatherStatistics(std::list<RSTrafficClue>& /* outqueue_lst */,std::list<RSTrafficClue>& /* inqueue_lst */) { return 0;}
 
+	/// Same as above, also gathering per priority class outgoing queue statistics, left untouched if the interface has no priority classes
+	virtual int gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,std::list<RSTrafficClue>& inqueue_lst,std::vector<RsQoSClassStats>& /* qos_stats */)
+	{
+		return gatherStatistics(outqueue_lst,inqueue_lst);
+	}
+
 	virtual int     getQueueSize(bool /* in */) { return 0;}
 	virtual float	getRate(bool in)
 	{
@@ -284,6 +293,30 @@ public:
      */
 	virtual int senddata(void *data, int len) = 0;
 
+	/**
+	 * Sends the concatenation of a batch of buffers, skipping the first
+	 * offset bytes, which have already been sent. Implementations may pack
+	 * the segments in fewer and larger writes. The default implementation
+	 * concatenates the remaining data and hands it to senddata().
+	 * If not everything could be sent, the caller must hand over again the
+	 * same batch with offset advanced by the number of bytes sent.
+	 *@param segments buffers to be sent, in order
+	 *@param offset number of bytes of the batch already sent
+	 *@returns number of bytes actually sent, or -1 if nothing was sent
+	 */
+	virtual int senddatav(const std::vector<pqiOutSlice>& segments, uint32_t offset)
+	{
+		std::vector<uint8_t> buf;
+		for(const pqiOutSlice& seg : segments)
+		{
+			if(offset >= seg.size()) { offset -= seg.size(); continue; }
+			buf.insert(buf.end(), seg.data() + offset, seg.data() + seg.size());
+			offset = 0;
+		}
+		if(buf.empty()) return 0;
+		return senddata(buf.data(), buf.size());
+	}
+
 	/**
 	 * reads data from a prescribed location (implementation dependent)
      * -- WARNING -- if used to feed a pqistreamer, the streamer will assume one of the two situations:
@@ -325,6 +358,14 @@ public:
 	 *  used by pqistreamer to limit transfers
 	 **/
 	virtual bool bandwidthLimited() { return true; }
+
+	/**
+	 * Kernel file descriptor which can be watched for readiness (epoll/poll)
+	 * to know when moretoread()/cansend() may become true.
+	 * @return the descriptor, or -1 if the interface has none, like TOU
+	 *	sockets, in that case the interface must be polled
+	 **/
+	virtual int getPollFd() { return -1; }
 };
 
 
@@ -0,0 +1,261 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqibwalloc.cc                                        *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "pqi/pqibwalloc.h"
+#include "rsitems/itempriorities.h"
+
+//#define DEBUG_BWALLOC 1
+
+static const double PQI_BW_BURST_DURATION = 0.1;     // buckets hold 100ms of traffic...
+static const double PQI_BW_MIN_BURST      = 16384;   // ... but at least one full TLS record.
+static const double PQI_BW_MAX_ALLOWED    = 100000000; // same bound as the streamer unlimited case.
+
+// Fraction of the peer rate each class is assured of. All of them may borrow up to the peer ceiling.
+static const double PQI_BW_CLASS_WEIGHTS[PQI_BW_NB_CLASSES] = { 0.15, 0.60, 0.25 };
+
+static const int PQI_BW_DATA_MIN_PRIORITY        = 5; // file and turtle data
+static const int PQI_BW_INTERACTIVE_MIN_PRIORITY = 7; // chat, tunnel management
+
+pqiBandwidthAllocator::Bucket::Bucket()
+	: mRate(0), mCeil(0), mTokens(0), mCTokens(0),
+	  mBurst(PQI_BW_MIN_BURST), mCBurst(PQI_BW_MIN_BURST), mLastTS(0)
+{
+}
+
+void pqiBandwidthAllocator::Bucket::setRates(double rate, double ceil, double now)
+{
+	bool fresh = (mLastTS == 0);
+
+	refill(now);
+
+	mRate = rate;
+	mCeil = std::max(rate, ceil);
+	mBurst = std::max(mRate * PQI_BW_BURST_DURATION, PQI_BW_MIN_BURST);
+	mCBurst = std::max(mCeil * PQI_BW_BURST_DURATION, PQI_BW_MIN_BURST);
+
+	if(fresh)
+	{
+		mTokens = mBurst;
+		mCTokens = mCBurst;
+	}
+	else
+	{
+		mTokens = std::min(mTokens, mBurst);
+		mCTokens = std::min(mCTokens, mCBurst);
+	}
+}
+
+void pqiBandwidthAllocator::Bucket::refill(double now)
+{
+	// nothing to add on first call, or if the clock went back
+	if(mLastTS > 0 && now > mLastTS)
+	{
+		double dt = now - mLastTS;
+		mTokens = std::min(mBurst, mTokens + mRate * dt);
+		mCTokens = std::min(mCBurst, mCTokens + mCeil * dt);
+	}
+	mLastTS = now;
+}
+
+void pqiBandwidthAllocator::Bucket::charge(double bytes)
+{
+	// an overshoot is paid back later, but never more than one burst, so
+	// that a big batch doesn't stall the node for long.
+	mTokens = std::max(-mBurst, mTokens - bytes);
+	mCTokens = std::max(-mCBurst, mCTokens - bytes);
+}
+
+pqiBandwidthAllocator::pqiBandwidthAllocator()
+	: mAllocMtx("pqiBandwidthAllocator")
+{
+}
+
+void pqiBandwidthAllocator::setRates( double total,
+                                      const std::map<RsPeerId, double>& ceils,
+                                      double now )
+{
+	RS_STACK_MUTEX(mAllocMtx); /********** LOCKED MUTEX **********/
+
+	mRoot.setRates(total, total, now);
+
+	for(std::map<RsPeerId, PeerBuckets>::iterator it = mPeers.begin(); it != mPeers.end(); )
+		if(ceils.find(it->first) == ceils.end())
+			it = mPeers.erase(it);
+		else
+			++it;
+
+	// Max-min fair share: peers limited below an equal share get their ceiling,
+	// what they leave is split equally between the others.
+
+	std::vector<std::pair<double, RsPeerId> > sorted;
+	sorted.reserve(ceils.size());
+
+	for(std::map<RsPeerId, double>::const_iterator it = ceils.begin(); it != ceils.end(); ++it)
+	{
+		double ceil = it->second;
+		if(ceil <= 0 || ceil > total)
+			ceil = total;
+		sorted.push_back(std::make_pair(ceil, it->first));
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	double remaining = total;
+
+	for(size_t i = 0; i < sorted.size(); ++i)
+	{
+		double ceil = sorted[i].first;
+		double rate = std::min(ceil, remaining / (sorted.size() - i));
+		remaining -= rate;
+
+		PeerBuckets& buckets = mPeers[sorted[i].second];
+		buckets.mPeer.setRates(rate, ceil, now);
+
+		for(uint32_t c = 0; c < PQI_BW_NB_CLASSES; ++c)
+			buckets.mClasses[c].setRates(rate * PQI_BW_CLASS_WEIGHTS[c], ceil, now);
+
+#ifdef DEBUG_BWALLOC
+		std::cerr << "pqiBandwidthAllocator::setRates() peer " << sorted[i].second;
+		std::cerr << " rate " << rate << " ceil " << ceil << std::endl;
+#endif
+	}
+}
+
+double pqiBandwidthAllocator::locked_sendable(const Bucket& cls, const Bucket& peer) const
+{
+	// A class sends its own tokens, or borrows those of the first ancestor
+	// having some, within all ceilings up to that ancestor.
+
+	const Bucket *path[3] = { &cls, &peer, &mRoot };
+	double room = PQI_BW_MAX_ALLOWED;
+	double sendable = 0;
+
+	for(int i = 0; i < 3; ++i)
+	{
+		room = std::min(room, path[i]->mCTokens);
+		if(room <= 0)
+			break;
+
+		if(path[i]->mTokens > 0)
+			sendable = std::max(sendable, std::min(room, path[i]->mTokens));
+	}
+	return sendable;
+}
+
+bool pqiBandwidthAllocator::outAllowedBytes( const RsPeerId& id, double now,
+                                             int& allowed,
+                                             uint32_t& blocked_classes )
+{
+	RS_STACK_MUTEX(mAllocMtx); /********** LOCKED MUTEX **********/
+
+	std::map<RsPeerId, PeerBuckets>::iterator it = mPeers.find(id);
+	if(it == mPeers.end())
+		return false;
+
+	PeerBuckets& buckets = it->second;
+	mRoot.refill(now);
+	buckets.mPeer.refill(now);
+
+	double best = 0;
+	blocked_classes = 0;
+
+	for(uint32_t c = 0; c < PQI_BW_NB_CLASSES; ++c)
+	{
+		buckets.mClasses[c].refill(now);
+
+		double sendable = locked_sendable(buckets.mClasses[c], buckets.mPeer);
+		if(sendable <= 0)
+			blocked_classes |= (1u << c);
+
+		best = std::max(best, sendable);
+	}
+
+	allowed = int(best);
+	return true;
+}
+
+void pqiBandwidthAllocator::outSentBytes( const RsPeerId& id, double now,
+                                          const uint32_t bytes[PQI_BW_NB_CLASSES] )
+{
+	RS_STACK_MUTEX(mAllocMtx); /********** LOCKED MUTEX **********/
+
+	std::map<RsPeerId, PeerBuckets>::iterator it = mPeers.find(id);
+	if(it == mPeers.end())
+		return;
+
+	PeerBuckets& buckets = it->second;
+	uint32_t total = 0;
+
+	for(uint32_t c = 0; c < PQI_BW_NB_CLASSES; ++c)
+	{
+		if(!bytes[c])
+			continue;
+
+		buckets.mClasses[c].refill(now);
+		buckets.mClasses[c].charge(bytes[c]);
+		total += bytes[c];
+	}
+
+	buckets.mPeer.refill(now);
+	buckets.mPeer.charge(total);
+	mRoot.refill(now);
+	mRoot.charge(total);
+}
+
+bool pqiBandwidthAllocator::getPeerRates(const RsPeerId& id, double& rate, double& ceil)
+{
+	RS_STACK_MUTEX(mAllocMtx); /********** LOCKED MUTEX **********/
+
+	std::map<RsPeerId, PeerBuckets>::const_iterator it = mPeers.find(id);
+	if(it == mPeers.end())
+		return false;
+
+	rate = it->second.mPeer.mRate;
+	ceil = it->second.mPeer.mCeil;
+	return true;
+}
+
+uint32_t pqiBandwidthAllocator::classOf(int priority)
+{
+	if(priority >= PQI_BW_INTERACTIVE_MIN_PRIORITY)
+		return PQI_BW_CLASS_INTERACTIVE;
+
+	if(priority >= PQI_BW_DATA_MIN_PRIORITY)
+		return PQI_BW_CLASS_DATA;
+
+	return PQI_BW_CLASS_BULK;
+}
+
+uint32_t pqiBandwidthAllocator::priorityMask(uint32_t classes)
+{
+	uint32_t mask = 0;
+
+	for(int p = 0; p <= QOS_PRIORITY_TOP; ++p)
+		if(classes & (1u << classOf(p)))
+			mask |= (1u << p);
+
+	return mask;
+}
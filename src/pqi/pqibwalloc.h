@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqibwalloc.h                                         *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include "retroshare/rstypes.h"  // for RsPeerId
+#include "util/rsthreads.h"      // for RsMutex
+
+/* Service classes the traffic of a peer is split into, from QoS priorities */
+static const uint32_t PQI_BW_CLASS_BULK        = 0; // discovery, mail, status...
+static const uint32_t PQI_BW_CLASS_DATA        = 1; // file and turtle data, GXS sync
+static const uint32_t PQI_BW_CLASS_INTERACTIVE = 2; // chat, heartbeats, tunnel setup...
+static const uint32_t PQI_BW_NB_CLASSES        = 3;
+
+/**
+ * @brief Hierarchical token bucket sharing the upload budget between peers.
+ * The budget is split into three levels: the global rate, then each connected
+ * peer, then the service classes of each peer. Every node has an assured rate
+ * and a ceiling:
+ *  - peers are assured a max-min fair share of the global rate, given their
+ *    ceiling (user set cap, rate the peer allowed us through BwCtrl...)
+ *  - classes are assured a fixed fraction of their peer rate, and may use up
+ *    to the peer ceiling.
+ * A node having tokens left sends on its own. Otherwise it borrows from the
+ * first ancestor having tokens, within its own ceiling and the ceilings on
+ * the way. Every byte sent is charged to the node and all its ancestors, so
+ * what a peer or class doesn't use is borrowed by the others while the total
+ * never goes above the global rate by more than one burst.
+ * Buckets are refilled from the time elapsed at each call, so the allowance
+ * follows the streamers tick rate rather than a fixed time slice.
+ * Used by all the streamer threads, every method locks.
+ */
+class pqiBandwidthAllocator
+{
+public:
+	pqiBandwidthAllocator();
+
+	/**
+	 * Set the global rate and the peers sharing it. Peers not in the list are
+	 * forgotten, their streamers then fall back to their own max rate.
+	 * @param total global rate, in B/s
+	 * @param ceils peers and their ceiling in B/s, 0 meaning the global rate
+	 * @param now current time, in seconds
+	 */
+	void setRates( double total, const std::map<RsPeerId, double>& ceils,
+	               double now );
+
+	/**
+	 * @param[out] allowed bytes the peer may send now, in the classes not
+	 *	blocked
+	 * @param[out] blocked_classes bit mask of the classes which can't send
+	 * @return false if the peer is not handled by the allocator
+	 */
+	bool outAllowedBytes( const RsPeerId& id, double now, int& allowed,
+	                      uint32_t& blocked_classes );
+
+	/// Charge bytes sent by the peer, per class, to the buckets
+	void outSentBytes( const RsPeerId& id, double now,
+	                   const uint32_t bytes[PQI_BW_NB_CLASSES] );
+
+	/// Assured rate and ceiling of a peer, in B/s, false if unknown
+	bool getPeerRates(const RsPeerId& id, double& rate, double& ceil);
+
+	/// Service class of items of the given QoS priority
+	static uint32_t classOf(int priority);
+
+	/// Bit mask of the QoS priorities of the given service classes
+	static uint32_t priorityMask(uint32_t classes);
+
+private:
+	class Bucket
+	{
+	public:
+		Bucket();
+
+		void setRates(double rate, double ceil, double now);
+		void refill(double now);
+		void charge(double bytes);
+
+		double mRate;     // assured rate, B/s
+		double mCeil;     // max rate when borrowing, B/s
+		double mTokens;   // bytes left at assured rate, negative when borrowing
+		double mCTokens;  // bytes left below the ceiling
+		double mBurst;
+		double mCBurst;
+		double mLastTS;
+	};
+
+	class PeerBuckets
+	{
+	public:
+		Bucket mPeer;
+		Bucket mClasses[PQI_BW_NB_CLASSES];
+	};
+
+	double locked_sendable(const Bucket& cls, const Bucket& peer) const;
+
+	RsMutex mAllocMtx; /* MUTEX */
+
+	Bucket mRoot;
+	std::map<RsPeerId, PeerBuckets> mPeers;
+};
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqicompression.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "pqi/pqicompression.h"
+#include "serialiser/rsbaseserial.h"
+#include "serialiser/rsserial.h"
+#include "util/rsmemory.h"
+
+//#define DEBUG_PQI_COMPRESSION 1
+
+static const uint8_t  PQI_COMPRESSION_SUBTYPE       = 0xce;
+static const uint32_t PQI_COMPRESSION_HEADER_SIZE   = 12;   // RS header + original size
+static const uint32_t PQI_COMPRESSION_MIN_SIZE      = 256;  // smaller packets don't compress enough
+static const uint32_t PQI_COMPRESSION_MAX_PENALTY   = 64;   // max packets sent as is after a failure
+static const int      PQI_COMPRESSION_LEVEL         = Z_BEST_SPEED;
+
+const uint8_t pqiPacketCompressor::PROBE_BYTES[8] =
+{ RS_PKT_VERSION_SERVICE, 0xaa, 0xbb, 0xcd, 0x00, 0x00, 0x00, 0x08 };
+
+pqiPacketCompressor::pqiPacketCompressor() {}
+
+bool pqiPacketCompressor::isCompressed(const void* pkt, uint32_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(pkt);
+	return size > PQI_COMPRESSION_HEADER_SIZE && p[0] == RS_PKT_VERSION_SERVICE
+	        && p[1] == 0xaa && p[2] == 0xbb && p[3] == PQI_COMPRESSION_SUBTYPE;
+}
+
+bool pqiPacketCompressor::compress( const void* pkt, uint32_t size,
+                                    uint16_t service, void*& out,
+                                    uint32_t& outSize )
+{
+	out = nullptr;
+	outSize = 0;
+
+	if(size < PQI_COMPRESSION_MIN_SIZE) return false;
+
+	Backoff& backoff = mBackoff[service];
+	if(backoff.mSkip > 0)
+	{
+		--backoff.mSkip;
+		return false;
+	}
+
+	/* Only keep the result if it saves at least 1/8th, not to make the peer
+	 * spend time uncompressing for nothing */
+	uLongf maxOut = size - size/8;
+	uint8_t* buf = static_cast<uint8_t*>(
+	            rs_malloc(PQI_COMPRESSION_HEADER_SIZE + compressBound(size)) );
+	if(!buf) return false;
+
+	uLongf clen = compressBound(size);
+	int ret = compress2( buf + PQI_COMPRESSION_HEADER_SIZE, &clen,
+	                     static_cast<const Bytef*>(pkt), size,
+	                     PQI_COMPRESSION_LEVEL );
+
+	if(ret != Z_OK || clen > maxOut)
+	{
+		backoff.mPenalty = std::min( 2*backoff.mPenalty + 1,
+		                             PQI_COMPRESSION_MAX_PENALTY );
+		backoff.mSkip = backoff.mPenalty;
+		free(buf);
+
+#ifdef DEBUG_PQI_COMPRESSION
+		std::cerr << "pqiPacketCompressor: service " << std::hex << service
+		          << std::dec << " incompressible, skipping next "
+		          << backoff.mSkip << " packets" << std::endl;
+#endif
+		return false;
+	}
+
+	backoff.mPenalty = 0;
+
+	outSize = PQI_COMPRESSION_HEADER_SIZE + clen;
+	buf[0] = RS_PKT_VERSION_SERVICE;
+	buf[1] = 0xaa;
+	buf[2] = 0xbb;
+	buf[3] = PQI_COMPRESSION_SUBTYPE;
+
+	uint32_t offset = 4;
+	setRawUInt32(buf, outSize, &offset, outSize);
+	setRawUInt32(buf, outSize, &offset, size);
+
+	out = buf;
+
+#ifdef DEBUG_PQI_COMPRESSION
+	std::cerr << "pqiPacketCompressor: compressed " << size << " -> "
+	          << outSize << std::endl;
+#endif
+	return true;
+}
+
+void* pqiPacketCompressor::uncompress( const void* pkt, uint32_t size,
+                                       uint32_t& outSize )
+{
+	outSize = 0;
+	if(!isCompressed(pkt, size)) return nullptr;
+
+	const uint8_t* p = static_cast<const uint8_t*>(pkt);
+	uint32_t offset = 8;
+	uint32_t origSize = 0;
+	getRawUInt32(p, size, &offset, &origSize);
+
+	// never allocate more than a legit packet may need
+	if(origSize < 8 || origSize > RsSerialiser::MAX_SERIAL_SIZE) return nullptr;
+
+	void* buf = rs_malloc(origSize);
+	if(!buf) return nullptr;
+
+	uLongf len = origSize;
+	if( ::uncompress( static_cast<Bytef*>(buf), &len,
+	                  p + PQI_COMPRESSION_HEADER_SIZE,
+	                  size - PQI_COMPRESSION_HEADER_SIZE ) != Z_OK
+	        || len != origSize )
+	{
+		free(buf);
+		return nullptr;
+	}
+
+	outSize = origSize;
+	return buf;
+}
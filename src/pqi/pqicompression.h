@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqicompression.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+/**
+ * @brief Per connection compression of serialised packets for pqistreamer.
+ * A compressed packet travels wrapped in a packet of its own, so slicing, QoS
+ * and packing don't need to know about compression:
+ *	[version 1B] [0xaa 0xbb] [0xce] [wrapper size 4B] [packet size 4B] [deflate]
+ * Peers advertise that they understand the wrapper by sending a probe packet,
+ * the same way packet slicing is negotiated, and packets are compressed only
+ * toward peers which sent it.
+ * Payloads which don't compress (encrypted tunnel data, media files...) are
+ * detected per service: after a failed attempt the next packets of the same
+ * service are sent as is, for an exponentially growing number of packets, so
+ * little CPU is wasted on them.
+ */
+class pqiPacketCompressor
+{
+public:
+	pqiPacketCompressor();
+
+	/// Probe advertising support of compressed packets, to be sent as is
+	static const uint8_t PROBE_BYTES[8];
+
+	/**
+	 * Compress a serialised packet if worth it.
+	 * @param[in] service service of the packet, for incompressible payloads
+	 *	detection
+	 * @param[out] out rs_malloc()ed wrapper packet, to be freed by caller
+	 * @return false if the packet must be sent as is
+	 */
+	bool compress( const void* pkt, uint32_t size, uint16_t service,
+	               void*& out, uint32_t& outSize );
+
+	/// @return true if the packet is a compressed packet wrapper
+	static bool isCompressed(const void* pkt, uint32_t size);
+
+	/**
+	 * @return rs_malloc()ed original packet extracted from the wrapper, or
+	 *	nullptr if the wrapper is invalid
+	 */
+	static void* uncompress(const void* pkt, uint32_t size, uint32_t& outSize);
+
+	/// Forget what has been learnt about the services, ex: at disconnection
+	void reset() { mBackoff.clear(); }
+
+private:
+	struct Backoff
+	{
+		Backoff() : mSkip(0), mPenalty(0) {}
+		uint32_t mSkip;     /// packets left to send uncompressed
+		uint32_t mPenalty;  /// packets to skip after next failure
+	};
+
+	std::map<uint16_t, Backoff> mBackoff;
+};
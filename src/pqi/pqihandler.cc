@@ -133,7 +133,8 @@ int	pqihandler::tick()
 
 bool pqihandler::queueOutRsItem(RsItem *item)
 {
-	RS_STACK_MUTEX(coreMtx); /**************** LOCKED MUTEX ****************/
+	ModuleShard& shard = shardOf(item->PeerId());
+	RsStackMutex stack(shard.mShardMtx); /********** LOCKED MUTEX **********/
 
 	uint32_t size ;
     locked_HandleRsItem(item, size);
@@ -202,6 +203,10 @@ bool	pqihandler::AddSearchModule(SearchModule *mod)
 
 	// store.
 	mods[mod->peerid] = mod;
+
+	ModuleShard& shard = shardOf(mod->peerid);
+	RsStackMutex stack(shard.mShardMtx); /********** LOCKED MUTEX **********/
+	shard.mMods[mod->peerid] = mod;
 	return true;
 }
 
@@ -213,6 +218,7 @@ bool	pqihandler::RemoveSearchModule(SearchModule *mod)
 	{
 		if (mod == it -> second)
 		{
+			locked_RemoveFromShards(it->first);
 			mods.erase(it);
 			return true;
 		}
@@ -220,6 +226,13 @@ bool	pqihandler::RemoveSearchModule(SearchModule *mod)
 	return false;
 }
 
+void	pqihandler::locked_RemoveFromShards(const RsPeerId& id)
+{
+	ModuleShard& shard = shardOf(id);
+	RsStackMutex stack(shard.mShardMtx); /********** LOCKED MUTEX **********/
+	shard.mMods.erase(id);
+}
+
 // generalised output
 int	pqihandler::locked_HandleRsItem(RsItem *item, uint32_t& computed_size)
 {
@@ -236,7 +249,8 @@ int	pqihandler::locked_HandleRsItem(RsItem *item, uint32_t& computed_size)
 
 
 	// find module.
-	if ((it = mods.find(item->PeerId())) == mods.end())
+	ModuleShard& shard = shardOf(item->PeerId());
+	if ((it = shard.mMods.find(item->PeerId())) == shard.mMods.end())
 	{
 		std::string out = "pqihandler::HandleRsItem() Invalid chan!";
 		pqioutput(PQL_DEBUG_BASIC, pqihandlerzone, out);
@@ -286,6 +300,21 @@ int     pqihandler::ExtractTrafficInfo(std::list<RSTrafficClue>& out_lst,std::li
     return 1 ;
 }
 
+int     pqihandler::ExtractQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats)
+{
+    qos_stats.clear() ;
+
+    RS_STACK_MUTEX(coreMtx); /**************** LOCKED MUTEX ****************/
+
+    for( std::map<RsPeerId, SearchModule *>::iterator it = mods.begin(); it != mods.end(); ++it)
+    {
+        std::list<RSTrafficClue> ilst,olst ;
+        (it -> second)->pqi->gatherStatistics(olst,ilst,qos_stats[it->first]) ;
+    }
+
+    return 1 ;
+}
+
 // NEW extern fn to extract rates.
 int     pqihandler::ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRates &total)
 {
@@ -337,7 +366,6 @@ int     pqihandler::UpdateRates()
 
 	int num_sm = mods.size();
 	float used_bw_in_table[num_sm];         /* table of in bandwidth currently used by each module */
-	float used_bw_out_table[num_sm];        /* table of out bandwidth currently used by each module */
 
 	// loop through modules to get the used bandwidth
 #ifdef UPDATE_RATES_DEBUG
@@ -361,60 +389,27 @@ int     pqihandler::UpdateRates()
 
 		/* fill the table of used bandwidths */
 		used_bw_in_table[index] = crate_in;
-		used_bw_out_table[index] = crate_out;
 
 		++index;
 	}
 
 #ifdef UPDATE_RATES_DEBUG
-	RsDbg() << "UPDATE_RATES pqihandler::UpdateRates Sorting used_bw_out_table: " << num_sm << " entries" << std::endl;
+	RsDbg() << "UPDATE_RATES pqihandler::UpdateRates Sorting used_bw_in_table: " << num_sm << " entries" << std::endl;
 #endif
 
-	/* Sort the used bw in/out table in ascending order */
+	/* Sort the used bw in table in ascending order */
 	std::sort(used_bw_in_table, used_bw_in_table + num_sm);
-	std::sort(used_bw_out_table, used_bw_out_table + num_sm);
-
-#ifdef UPDATE_RATES_DEBUG
-	RsDbg() << "UPDATE_RATES pqihandler::UpdateRates used_bw_out " << used_bw_out << std::endl;
-#endif
-
-	/* Calculate the optimal out_max value, taking into account avail_out and the out bw requested by modules */
-
-	float out_remaining_bw = avail_out;
-	float out_max_bw = 0;
-	bool keep_going = true;
-	int mod_index = 0;
 
-	while (keep_going && (mod_index < num_sm)) {
-		float result = (num_sm - mod_index) * (used_bw_out_table[mod_index] - out_max_bw);
-		if (result > out_remaining_bw) {
-			/* There is not enough remaining out bw to satisfy all modules,
-			   distribute the remaining out bw among modules, then exit */
-			out_max_bw += out_remaining_bw / (num_sm - mod_index);
-			out_remaining_bw = 0;
-			keep_going = false;
-		} else {
-			/* Grant the requested out bandwidth to all modules,
-			   then recalculate the remaining out bandwidth */
-			out_remaining_bw -= result;
-			out_max_bw = used_bw_out_table[mod_index];
-			++mod_index;
-		}
-	}
-
-#ifdef UPDATE_RATES_DEBUG
-	RsDbg() << "UPDATE_RATES pqihandler::UpdateRates mod_index " << mod_index << " out_max_bw " << out_max_bw << " remaining out bw " << out_remaining_bw << std::endl;
-#endif
-
-	/* Allocate only 50 pct the remaining out bw, if any, to make the transition more smooth */
-	out_max_bw = out_max_bw + 0.5 * out_remaining_bw;
+	/* The out bandwidth is shared by mOutAllocator, which lends what a peer
+	   doesn't use to the others as it goes, so only the in bandwidth is
+	   estimated here from the rates of the last period. */
 
 	/* Calculate the optimal in_max value, taking into account avail_in and the in bw requested by modules */
 
 	float in_remaining_bw = avail_in;
 	float in_max_bw = 0;
-	keep_going = true;
-	mod_index = 0;
+	bool keep_going = true;
+	int mod_index = 0;
 
 	while (keep_going && mod_index < num_sm) {
 		float result = (num_sm - mod_index) * (used_bw_in_table[mod_index] - in_max_bw);
@@ -444,7 +439,7 @@ int     pqihandler::UpdateRates()
 	locked_StoreCurrentRates(used_bw_in, used_bw_out);
 
 #ifdef UPDATE_RATES_DEBUG
-	RsDbg() << "UPDATE_RATES pqihandler::UpdateRates setting new out_max " << out_max_bw << " in_max " << in_max_bw << std::endl;
+	RsDbg() << "UPDATE_RATES pqihandler::UpdateRates used_bw_out " << used_bw_out << " avail_out " << avail_out << " setting new in_max " << in_max_bw << std::endl;
 #endif
 
 	// retrieve the bandwidth limits provided by peers via BwCtrl
@@ -460,6 +455,8 @@ int     pqihandler::UpdateRates()
 #endif
 
         // update max rates
+	std::map<RsPeerId, double> out_ceils;
+
 	for(it = mods.begin(); it != mods.end(); ++it)
 	{
 		SearchModule *mod = (it -> second);
@@ -470,13 +467,21 @@ int     pqihandler::UpdateRates()
 
 		// for our up bandwidth we take into account the max down provided by peers via BwCtrl
 		// because we don't want to clog our outqueues, the TCP buffers, and the peers inbound queues
-		mod -> pqi -> setMaxRate(false, out_max_bw);
+		float out_ceil = avail_out;
 		if ((rateMap_it = rateMap.find(mod->pqi->PeerId())) != rateMap.end())
 			if (rateMap_it->second.mAllowedOut > 0)
-				if (out_max_bw > rateMap_it->second.mAllowedOut)
-        	                        mod -> pqi -> setMaxRate(false, rateMap_it->second.mAllowedOut);
+				if (out_ceil > rateMap_it->second.mAllowedOut)
+					out_ceil = rateMap_it->second.mAllowedOut;
+
+		// setMaxRate() also applies the cap set by the user for this peer.
+		// This is the most the peer can get, borrowing from the others.
+		mod -> pqi -> setMaxRate(false, out_ceil);
+		out_ceils[it->first] = 1024.0 * mod -> pqi -> getMaxRate(false);
 	}
 
+	// same clock as the streamers, for the bandwidth allocator buckets
+	mOutAllocator.setRates(1024.0 * avail_out, out_ceils, rstime::getCurrentTS());
+
 #ifdef UPDATE_RATES_DEBUG
 	// dump maxRates
 	for(it = mods.begin(); it != mods.end(); ++it)
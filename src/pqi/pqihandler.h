@@ -26,9 +26,12 @@
 #include "util/rstime.h"                // for rstime_t, NULL
 #include <list>                  // for list
 #include <map>                   // for map
+#include <vector>                // for vector
 
 #include "pqi/pqi.h"             // for P3Interface, pqiPublisher
+#include "pqi/pqibwalloc.h"      // for pqiBandwidthAllocator
 #include "retroshare/rstypes.h"  // for RsPeerId
+#include "retroshare/rsconfig.h" // for RSTrafficClue, RsQoSClassStats
 #include "util/rsthreads.h"      // for RsStackMutex, RsMutex
 
 class PQInterface;
@@ -83,9 +86,13 @@ class pqihandler: public P3Interface, public pqiPublisher
 
 		void	getCurrentRates(float &in, float &out);
 
+		/// Upload budget shared by the streamers of all peers
+		pqiBandwidthAllocator *outBandwidthAllocator() { return &mOutAllocator; }
+
 		// TESTING INTERFACE.
 		int     ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRates &totals);
 		int 	ExtractTrafficInfo(std::list<RSTrafficClue> &out_lst, std::list<RSTrafficClue> &in_lst);
+		int 	ExtractQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats);
 
 		uint64_t traffInSum;
 		uint64_t traffOutSum;
@@ -96,9 +103,15 @@ protected:
 		 * generates warnings otherwise
 		 */
 
+		// shard of the destination peer must be locked.
         int	locked_HandleRsItem(RsItem *ns, uint32_t& size);
 		bool  queueOutRsItem(RsItem *) ;
 
+		/* Remove peer from the send shards, waiting for items being handed
+		 * to its module. To be called before deleting the module pqi.
+		 * (coreMtx locked) */
+		void	locked_RemoveFromShards(const RsPeerId& id);
+
 #ifdef TO_BE_REMOVED
 		int		locked_GetItems();
 		void	locked_SortnStoreItem(RsItem *item);
@@ -108,10 +121,30 @@ protected:
 
 		std::map<RsPeerId, SearchModule *> mods;
 
-		std::list<RsItem *> in_service;
-
 	private:
 
+		/* Outgoing items are dispatched using a copy of mods split by peer
+		 * id, so service threads sending to different peers only contend on
+		 * the shard mutex instead of coreMtx, which stays held by tick()
+		 * while ticking all the modules. */
+		static const uint32_t PQI_HANDLER_NB_SHARDS = 16;
+
+		class ModuleShard
+		{
+			public:
+			ModuleShard() : mShardMtx("pqihandler::ModuleShard") {}
+
+			RsMutex mShardMtx; /* MUTEX */
+			std::map<RsPeerId, SearchModule *> mMods;
+		};
+
+		ModuleShard& shardOf(const RsPeerId& id)
+		{
+			return mShards[id.toByteArray()[0] % PQI_HANDLER_NB_SHARDS];
+		}
+
+		ModuleShard mShards[PQI_HANDLER_NB_SHARDS];
+
 		// rate control.
 		int	UpdateRates();
 		void	locked_StoreCurrentRates(float in, float out);
@@ -124,6 +157,8 @@ protected:
 		float rateTotal_in;
 		float rateTotal_out;
 
+		pqiBandwidthAllocator mOutAllocator;
+
 		uint32_t nb_ticks ;
 		rstime_t last_m ;
         	rstime_t mLastRateCapUpdate ;
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqioutslice.h                                        *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+/**
+ * @brief Read only view on (part of) a serialized item waiting to be sent.
+ * Whole items are handed over as is, the view owns the buffer and frees it on
+ * destruction. When a large item is sliced, all its slices reference the same
+ * buffer through a shared pointer, so slicing doesn't copy the item data and
+ * the buffer is freed once the last slice has been consumed.
+ * Views are move only, to avoid accidental double free of owned buffers.
+ */
+class pqiOutSlice
+{
+public:
+	pqiOutSlice() : mOwned(nullptr), mData(nullptr), mSize(0) {}
+
+	/// Take ownership of a whole item allocated with malloc()/rs_malloc()
+	pqiOutSlice(void* item, uint32_t size) :
+	    mOwned(item), mData(static_cast<const uint8_t*>(item)), mSize(size) {}
+
+	/// Reference size bytes at offset of an item shared with other slices
+	pqiOutSlice( const std::shared_ptr<void>& item, uint32_t offset,
+	             uint32_t size ) :
+	    mOwned(nullptr), mShared(item),
+	    mData(static_cast<const uint8_t*>(item.get()) + offset), mSize(size) {}
+
+	pqiOutSlice(pqiOutSlice&& o) :
+	    mOwned(o.mOwned), mShared(std::move(o.mShared)), mData(o.mData),
+	    mSize(o.mSize)
+	{ o.mOwned = nullptr; o.mData = nullptr; o.mSize = 0; }
+
+	pqiOutSlice& operator=(pqiOutSlice&& o)
+	{
+		if(this != &o)
+		{
+			reset();
+			mOwned = o.mOwned; o.mOwned = nullptr;
+			mShared = std::move(o.mShared);
+			mData = o.mData; o.mData = nullptr;
+			mSize = o.mSize; o.mSize = 0;
+		}
+		return *this;
+	}
+
+	pqiOutSlice(const pqiOutSlice&) = delete;
+	pqiOutSlice& operator=(const pqiOutSlice&) = delete;
+
+	~pqiOutSlice() { free(mOwned); }
+
+	const uint8_t* data() const { return mData; }
+	uint32_t size() const { return mSize; }
+	bool isNull() const { return mData == nullptr; }
+
+	/// Release the referenced data, freeing it if this was the last reference
+	void reset()
+	{
+		free(mOwned);
+		mOwned = nullptr;
+		mShared.reset();
+		mData = nullptr;
+		mSize = 0;
+	}
+
+private:
+	void* mOwned;
+	std::shared_ptr<void> mShared;
+	const uint8_t* mData;
+	uint32_t mSize;
+};
@@ -44,7 +44,7 @@ pqiperson::~pqiperson()
 	RS_STACK_MUTEX(mPersonMtx);
 
 	// clean up the childrens
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
 	{
 		pqiconnect *pc = (it->second);
@@ -186,7 +186,7 @@ int	pqiperson::tick()
 #endif
 	
 			// tick the children.
-			std::map<uint32_t, pqiconnect *>::iterator it;
+			std::multimap<uint32_t, pqiconnect *>::iterator it;
 			for(it = kids.begin(); it != kids.end(); ++it)
 			{
 				if (0 < (it->second)->tick())
@@ -270,7 +270,7 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 	/* find the pqi, */
 	pqiconnect *pqi = NULL;
 	uint32_t    type = 0;
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 		
 	/* start again */
 	for(it = kids.begin(); it != kids.end(); ++it)
@@ -302,6 +302,27 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 	case CONNECT_RECEIVED:
 	case CONNECT_SUCCESS:
 	{
+		/* two racing attempts can succeed in the same tick: the first one
+		 * won, drop the late one. */
+		if (active && (activepqi != pqi))
+		{
+			bool raceLoser = false;
+			for(it = kids.lower_bound(type); it != kids.upper_bound(type); ++it)
+				if (it->second == activepqi)
+					raceLoser = true;
+
+			if (raceLoser)
+			{
+#ifdef PERSON_DEBUG
+				std::cerr << "pqiperson::handleNotifyEvent_locked Id: "
+						  << PeerId().toStdString() << " CONNECT_SUCCESS-> "
+						  << "from a race loser, resetting it" << std::endl;
+#endif
+				connectingpqi.erase(pqi);
+				pqi->reset();
+				return 1;
+			}
+		}
 
 		/* notify */
 		if (pqipg)
@@ -344,12 +365,14 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 			inConnectAttempt = false;
 
 			// STARTUP THREAD
-			activepqi->start("pqi " + PeerId().toStdString().substr(0, 11));
+			activepqi->startStreaming("pqi " + PeerId().toStdString().substr(0, 11));
 
-			// reset all other children (clear up long UDP attempt)
+			// reset all other children (clear up long UDP attempt, and the
+			// losers of a race)
 			for(it = kids.begin(); it != kids.end(); ++it)
 				if (!(it->second)->thisNetInterface(ni))
 					it->second->reset();
+			connectingpqi.clear();
 			return 1;
         }
 		break;
@@ -358,6 +381,29 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 	case CONNECT_FIREWALLED:
 	case CONNECT_FAILED:
 	{
+		/* pqissl reports its failures without the address, the link
+		 * manager needs it to tell which of the attempts in progress is over */
+		sockaddr_storage failed_address = remote_peer_address;
+		std::map<pqiconnect *, sockaddr_storage>::iterator cit = connectingpqi.find(pqi);
+		if (cit != connectingpqi.end())
+		{
+			if (sockaddr_storage_isnull(failed_address))
+				failed_address = cit->second;
+			connectingpqi.erase(cit);
+		}
+
+		if (active && (activepqi != pqi))
+		{
+			// an attempt cancelled because another one won, the peer is
+			// connected: nothing to report.
+#ifdef PERSON_DEBUG
+			std::cerr << "pqiperson::handleNotifyEvent_locked Id: "
+					  << PeerId().toStdString() << " CONNECT_FAILED-> from "
+					  << "a cancelled attempt, ignoring" << std::endl;
+#endif
+			return 1;
+		}
+
 		if (active && (activepqi == pqi))
 		{
 #ifdef PERSON_DEBUG
@@ -366,7 +412,7 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 					  << " CONNECT_FAILED->marking so!" << std::endl;
 #endif
 
-			activepqi->askForStop(); // STOP THREAD.
+			activepqi->stopStreaming(false); // STOP THREAD.
 			active = false;
 			activepqi = nullptr;
 		}
@@ -379,7 +425,7 @@ int pqiperson::handleNotifyEvent_locked(NetInterface *ni, int newState,
 #endif
 		/* notify up */
 		if (pqipg)
-			pqipg->notifyConnect(PeerId(), type, false, false, remote_peer_address);
+			pqipg->notifyConnect(PeerId(), type, false, false, failed_address);
 
 		return 1;
 	}
@@ -403,16 +449,17 @@ int pqiperson::reset_locked()
 			  << PeerId().toStdString() << std::endl;
 #endif
 
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
 	{
-		it->second->askForStop(); // STOP THREAD.
+		it->second->stopStreaming(false); // STOP THREAD.
 		(it->second) -> reset();
 	}
 
 	activepqi = NULL;
 	active = false;
 	lastHeartbeatReceived = 0;
+	connectingpqi.clear();
 
 	return 1;
 }
@@ -426,9 +473,9 @@ int pqiperson::fullstopthreads()
 
 	RS_STACK_MUTEX(mPersonMtx);
 
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
-		(it->second)->fullstop(); // WAIT FOR THREAD TO STOP.
+		(it->second)->stopStreaming(true); // WAIT FOR THREAD TO STOP.
 
 	activepqi = NULL;
 	active = false;
@@ -446,10 +493,26 @@ int	pqiperson::addChildInterface(uint32_t type, pqiconnect *pqi)
 
 	RS_STACK_MUTEX(mPersonMtx);
 
-	kids[type] = pqi;
+	// the connection shares the upload budget with the other peers
+	if(pqipg)
+		pqi->setBandwidthAllocator(pqipg->outBandwidthAllocator());
+
+	kids.insert(std::make_pair(type, pqi));
 	return 1;
 }
 
+bool pqiperson::canConnect(uint32_t type)
+{
+	RS_STACK_MUTEX(mPersonMtx);
+
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
+	for(it = kids.lower_bound(type); it != kids.upper_bound(type); ++it)
+		if ((it->second != activepqi) && !connectingpqi.count(it->second))
+			return true;
+
+	return false;
+}
+
 /***************** PRIVATE FUNCTIONS ***********************/
 // functions to iterate over the connects and change state.
 
@@ -464,7 +527,7 @@ int pqiperson::listen()
 
 	if (!active)
 	{
-		std::map<uint32_t, pqiconnect *>::iterator it;
+		std::multimap<uint32_t, pqiconnect *>::iterator it;
 		for(it = kids.begin(); it != kids.end(); ++it)
 			(it->second)->listen();
 	}
@@ -481,7 +544,7 @@ int pqiperson::stoplistening()
 
 	RS_STACK_MUTEX(mPersonMtx);
 
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
 		(it->second)->stoplistening();
 
@@ -507,7 +570,7 @@ int	pqiperson::connect(uint32_t type, const sockaddr_storage &raddr,
 
 	RS_STACK_MUTEX(mPersonMtx);
 
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	
 	it = kids.find(type);
 	if (it == kids.end())
@@ -517,7 +580,16 @@ int	pqiperson::connect(uint32_t type, const sockaddr_storage &raddr,
 		return 0;
 	}
 
+	/* take a free one if this attempt races others, or restart the first */
 	pqiconnect *pqi = it->second;
+	for(; it != kids.upper_bound(type); ++it)
+	{
+		if ((it->second != activepqi) && !connectingpqi.count(it->second))
+		{
+			pqi = it->second;
+			break;
+		}
+	}
 
 #ifdef PERSON_DEBUG
 	std::cerr << "pqiperson::connect() resetting for new connection attempt" << std::endl;
@@ -552,6 +624,7 @@ int	pqiperson::connect(uint32_t type, const sockaddr_storage &raddr,
 	pqi->connect_parameter(NET_PARAM_CONNECT_REMOTE_PORT, domain_port);
 
 	pqi->connect(raddr);
+	connectingpqi[pqi] = raddr;
 		
 	// flag if we started a new connectionAttempt.
 	inConnectAttempt = true;
@@ -583,6 +656,21 @@ int pqiperson::gatherStatistics(std::list<RSTrafficClue>& out_lst,
 	return activepqi->gatherStatistics(out_lst, in_lst);
 }
 
+int pqiperson::gatherStatistics(std::list<RSTrafficClue>& out_lst,
+								std::list<RSTrafficClue>& in_lst,
+								std::vector<RsQoSClassStats>& qos_stats)
+{
+	RS_STACK_MUTEX(mPersonMtx);
+
+	qos_stats.clear();
+
+	// Get the stats from the active one.
+	if( (!active) || (activepqi == NULL) )
+		return 0 ;
+
+	return activepqi->gatherStatistics(out_lst, in_lst, qos_stats);
+}
+
 int pqiperson::getQueueSize(bool in)
 {
 	RS_STACK_MUTEX(mPersonMtx);
@@ -604,6 +692,8 @@ bool pqiperson::getCryptoParams(RsPeerCryptoParams & params)
 	{
 		params.connexion_state = 0;
 		params.cipher_name.clear();
+		params.kernel_tls_send = false;
+		params.kernel_tls_recv = false;
 
 		return false ;
 	}
@@ -622,6 +712,8 @@ bool pqiconnect::getCryptoParams(RsPeerCryptoParams & params)
 	{
 		params.connexion_state = 0 ;
 		params.cipher_name.clear() ;
+		params.kernel_tls_send = false ;
+		params.kernel_tls_recv = false ;
 		return false ;
 	}
 }
@@ -651,7 +743,7 @@ void pqiperson::setMaxRate(bool in, float val)
 	// set to all of them. (and us)
 	PQInterface::setMaxRate(in, val);
 	// clean up the children.
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
 		(it->second) -> setMaxRate(in, val);
 }
@@ -691,7 +783,7 @@ void pqiperson::setRateCap_locked(float val_in, float val_out)
 	// set to all of them. (and us)
 	PQInterface::setRateCap(val_in, val_out);
 	// clean up the children.
-	std::map<uint32_t, pqiconnect *>::iterator it;
+	std::multimap<uint32_t, pqiconnect *>::iterator it;
 	for(it = kids.begin(); it != kids.end(); ++it)
 		(it->second)->setRateCap(val_in, val_out);
 }
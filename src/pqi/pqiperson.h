@@ -28,6 +28,7 @@
 #include "util/rsnet.h"
 
 #include <list>
+#include <map>
 
 class pqiperson;
 struct RsPeerCryptoParams;
@@ -114,9 +115,12 @@ public:
 	int fullstopthreads();
 	int receiveHeartbeat();
 
-	// add in connection method.
+	// add in connection method, several of a type race each other.
 	int addChildInterface(uint32_t type, pqiconnect *pqi);
 
+	// true if a connection of this type is free for a new attempt.
+	bool canConnect(uint32_t type);
+
 	virtual bool getCryptoParams(RsPeerCryptoParams&);
 
 	// The PQInterface interface.
@@ -148,6 +152,9 @@ public:
 	virtual void setRateCap(float val_in, float val_out);
 	virtual int gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,
 								 std::list<RSTrafficClue>& inqueue_lst);
+	virtual int gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,
+								 std::list<RSTrafficClue>& inqueue_lst,
+								 std::vector<RsQoSClassStats>& qos_stats);
 
 private:
 	void processNotifyEvents();
@@ -163,10 +170,11 @@ private:
 
 	void setRateCap_locked(float val_in, float val_out);
 
-	std::map<uint32_t, pqiconnect *> kids;
+	std::multimap<uint32_t, pqiconnect *> kids;
 	bool active;
 	pqiconnect *activepqi;
 	bool inConnectAttempt;
+	std::map<pqiconnect *, sockaddr_storage> connectingpqi; // outgoing attempts in progress, and their address
 	//int waittimes;
 	rstime_t lastHeartbeatReceived; // use to track connection failure
 	pqipersongrp *pqipg; /* parent for callback */
@@ -443,6 +443,9 @@ int     pqipersongrp::removePeer(const RsPeerId& id)
 	it = mods.find(id);
 	if (it != mods.end())
 	{
+		// stop routing items to it before it is deleted.
+		locked_RemoveFromShards(id);
+
 		SearchModule *mod = it->second;
 		pqiperson *p = (pqiperson *) mod -> pqi;
 		p -> stoplistening();
@@ -656,6 +659,22 @@ int     pqipersongrp::connectPeer(const RsPeerId& id
 
 	p->connect(ptype, addr, proxyaddr, srcaddr, delay, period, timeout, flags, bandwidth, domain_addr, domain_port);
 
+	/* race the next TCP addresses against this one, the first connection
+	 * to be authenticated wins and pqiperson cancels the others. */
+	while ((ptype == PQI_CONNECT_TCP) && p->canConnect(PQI_CONNECT_TCP) &&
+	       mLinkMgr->canRaceConnectAttempt(id))
+	{
+		if (!mLinkMgr->connectAttempt(id, addr, proxyaddr, srcaddr, delay, period, type, flags, bandwidth, domain_addr, domain_port))
+			break;
+
+#ifdef PGRP_DEBUG
+		std::cerr << " pqipersongrp::connectPeer() racing with addr: " << sockaddr_storage_tostring(addr);
+		std::cerr << " delay: " << delay << std::endl;
+#endif
+
+		p->connect(PQI_CONNECT_TCP, addr, proxyaddr, srcaddr, delay, period, RS_TCP_STD_TIMEOUT_PERIOD, flags, bandwidth, domain_addr, domain_port);
+	}
+
 	return 1;
 }
 
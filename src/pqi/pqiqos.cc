@@ -22,41 +22,62 @@
 #include <iostream>
 #include <list>
 #include <math.h>
+#include <algorithm>
 #include <serialiser/rsserial.h>
 #include <serialiser/rsbaseserial.h>
+#include "util/rstime.h"
 
 #include "pqiqos.h"
 
 const uint32_t pqiQoS::MAX_PACKET_COUNTER_VALUE = (1 << 24) ;
+const uint32_t pqiQoS::DEFAULT_BASE_QUANTUM     = 512 ;
 
-pqiQoS::pqiQoS(uint32_t nb_levels,float alpha)
-	: _item_queues(nb_levels),_alpha(alpha)
+pqiQoS::pqiQoS(uint32_t nb_levels,float alpha,uint32_t base_quantum)
+	: _item_queues(nb_levels),_front_credited(false),_blocked_levels(0),_last_out_level(0),_alpha(alpha)
 {
 #ifdef DEBUG
 	assert(pow(alpha,nb_levels) < 1e+20) ;
 #endif
 
-	float c = 1.0f ;
-	float inc = alpha ;
 	_nb_items = 0 ;
     	_id_counter = 0 ;
 
-for(int i=((int)nb_levels)-1;i>=0;--i,c *= alpha)
+	float q = base_quantum ;
+
+	for(uint32_t i=0;i<nb_levels;++i,q *= alpha)
+		_item_queues[i]._quantum = std::max(1u,uint32_t(std::min(q,float(RsSerialiser::MAX_SERIAL_SIZE)))) ;
+}
+
+uint32_t pqiQoS::quantum(uint32_t priority) const
+{
+	if(priority >= _item_queues.size())
+		return 0 ;
+
+	return _item_queues[priority]._quantum ;
+}
+
+void pqiQoS::setQuantum(uint32_t priority,uint32_t bytes)
+{
+	if(priority >= _item_queues.size() || bytes == 0)
 	{
-		_item_queues[i]._threshold = c ;
-		_item_queues[i]._counter = 0 ;
-		_item_queues[i]._inc = inc ;
+		std::cerr << "pqiQoS::setQuantum() ****Warning****: invalid quantum " << bytes << " for priority " << priority << std::endl;
+		return ;
 	}
+	_item_queues[priority]._quantum = bytes ;
 }
 
 void pqiQoS::clear()
 {
-	void *item ;
-
 	for(uint32_t i=0;i<_item_queues.size();++i)
-		while( (item = _item_queues[i].pop()) != NULL)
-			free(item) ;
+	{
+		while(!_item_queues[i]._items.empty())
+			_item_queues[i].clear_front() ;
 
+		_item_queues[i]._deficit = 0 ;
+	}
+
+	_active_levels.clear() ;
+	_front_credited = false ;
 	_nb_items = 0 ;
 }
 
@@ -78,79 +99,121 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 		priority = _item_queues.size()-1 ;
 	}
 
-	_item_queues[priority].push(ptr,size,_id_counter++) ;
+	ItemQueue& queue(_item_queues[priority]) ;
+
+	if(queue._items.empty())
+		_active_levels.push_back(priority) ;	// joins the round, with no credit left from previous turns
+
+	queue.push(ptr,size,_id_counter++,rstime::RsScopeTimer::currentTime()) ;
 	++_nb_items ;
     
     	if(_id_counter >= MAX_PACKET_COUNTER_VALUE)
             _id_counter = 0 ;
 }
 
-// int pqiQoS::gatherStatistics(std::vector<uint32_t>& per_service_count,std::vector<uint32_t>& per_priority_count) const
-// {
-//     assert(per_priority_count.size() == 10) ;
-//     assert(per_service_count.size() == 65536) ;
-//
-//     for(uint32_t i=0;i<_item_queues.size();++i)
-//     {
-//         per_priority_count[i] += _item_queues[i].size() ;
-//
-//         for(std::list<void*>::const_iterator it(_item_queues[i]._items.begin());it!=_item_queues[i]._items.end();++it)
-//         {
-//                         uint32_t type = 0;
-//                         uint32_t offset = 0;
-//                         getRawUInt32((uint8_t*)(*it), 4, &offset, &type);
-//
-//             uint16_t service_id =  (type >> 8) & 0xffff ;
-//
-//             ++per_service_count[service_id] ;
-//         }
-//     }
-//     return 1 ;
-// }
-
-
-void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id) 
+void pqiQoS::updateDelayStats(ItemQueue& queue,double queued_time)
 {
-	// Go through the queues. Increment counters.
+	float delay = std::max(0.0,rstime::RsScopeTimer::currentTime() - queued_time) ;
 
-	if(_nb_items == 0)
-		return NULL ;
+	queue._mean_delay = (queue._sent_items == 0 && queue._mean_delay == 0.0f)? delay : 0.875f*queue._mean_delay + 0.125f*delay ;
+	queue._max_delay = std::max(queue._max_delay,delay) ;
+	++queue._sent_items ;
+}
 
-	float inc = 1.0f ;
-	int i = _item_queues.size()-1 ;
+void pqiQoS::gatherQueueStatistics(std::vector<RsQoSClassStats>& per_priority_stats)
+{
+	per_priority_stats.resize(_item_queues.size()) ;
 
-	while(i > 0 && _item_queues[i]._items.empty())
-		--i, inc = _item_queues[i]._inc ;
+	for(uint32_t i=0;i<_item_queues.size();++i)
+	{
+		ItemQueue& queue(_item_queues[i]) ;
+		RsQoSClassStats& stats(per_priority_stats[i]) ;
+
+		stats.priority     = i ;
+		stats.quantum      = queue._quantum ;
+		stats.backlogItems = queue._items.size() ;
+		stats.backlogBytes = queue._backlog_bytes ;
+		stats.sentItems    = queue._sent_items ;
+		stats.meanDelay    = queue._mean_delay ;
+		stats.maxDelay     = queue._max_delay ;
+
+		queue._sent_items = 0 ;
+		queue._max_delay = 0.0f ;
+	}
+}
 
-	int last = i ;
+bool pqiQoS::out_rsItem(uint32_t max_slice_size, pqiOutSlice& out, bool& starts, bool& ends, uint32_t& packet_id) 
+{
+	// Deficit round robin. The level at the front of the active list gets its quantum when
+	// its turn starts, and is served while its deficit covers the next slice. It then goes
+	// at the back of the list, keeping the unused deficit for its next turn. Every turn adds
+	// a quantum, so this loop ends, and costs O(1) per quantum of data sent.
+	// Blocked levels are passed over without being credited, provided one active level
+	// is not blocked.
+
+	if(_blocked_levels)
+	{
+		bool any_allowed = false ;
+
+		for(std::deque<uint32_t>::const_iterator it(_active_levels.begin());it!=_active_levels.end() && !any_allowed;++it)
+			any_allowed = !(_blocked_levels & (1u << *it)) ;
 
-	for(int j=i;j>=0;--j)
-		if( (!_item_queues[j]._items.empty()) && ((_item_queues[j]._counter += inc) >= _item_queues[j]._threshold ))
+		if(!any_allowed)
+			return false ;
+	}
+
+	while(!_active_levels.empty())
+	{
+		uint32_t level = _active_levels.front() ;
+		ItemQueue& queue(_item_queues[level]) ;
+
+		if(_blocked_levels & (1u << level))
 		{
-			last = j ;
-			_item_queues[j]._counter -= _item_queues[j]._threshold ;
+			_active_levels.pop_front() ;
+			_active_levels.push_back(level) ;
+			_front_credited = false ;
+			continue ;
 		}
 
-	if(last >= 0)
-	{
-#ifdef DEBUG
-		assert(_nb_items > 0) ;
-#endif
-        
-        	// now chop a slice of this item
-        
-        	void *res = _item_queues[last].slice(max_slice_size,size,starts,ends,packet_id) ;
-            
-            	if(ends)
+		if(!_front_credited)
+		{
+			queue._deficit += queue._quantum ;
+			_front_credited = true ;
+		}
+
+		uint32_t next_size = queue.next_slice_size(max_slice_size) ;
+
+		if(next_size > queue._deficit)
+		{
+			_active_levels.pop_front() ;
+			_active_levels.push_back(level) ;
+			_front_credited = false ;
+			continue ;
+		}
+
+		queue._deficit -= next_size ;
+
+		double queued_time = queue._items.front().queued_time ;
+		bool res = queue.slice(max_slice_size,out,starts,ends,packet_id) ;
+		_last_out_level = level ;
+
+		if(res && starts)
+			updateDelayStats(queue,queued_time) ;
+
+		if(!res || ends)
 			--_nb_items ;
-                
-		return res ;
-	}
-	else
-		return NULL ;
-}
 
+		if(queue._items.empty())
+		{
+			// leaving the round: an idle level must not accumulate credit
+
+			queue._deficit = 0 ;
+			_active_levels.pop_front() ;
+			_front_credited = false ;
+		}
 
+		return res ;
+	}
 
-    
-    
+	return false ;
+}
@@ -25,10 +25,17 @@
 //
 // - lower priority items get out with lower rate than high priority items
 // - items of equal priority get out of the queue in the same order than they got in
-// - items of level n+1 are output \alpha times more often than items of level n. 
-//   \alpha is a constant that is not necessarily an integer, but strictly > 1.
 // - the set of possible priority levels is finite, and pre-determined.
 //
+// Queues are served with Deficit Round Robin: each priority level that has data
+// waiting is given, on its turn, a quantum of bytes it is allowed to send. Level
+// n+1 gets \alpha times the quantum of level n. Whatever a level could not use
+// (because its next slice is bigger than what is left) is kept for its next turn,
+// so over time every backlogged level gets a share of the bandwidth proportional
+// to its quantum, and a higher priority item waits at most one quantum of each
+// other backlogged level, whatever the amount of traffic queued at lower
+// priorities.
+//
 #pragma once
 
 #include <stdint.h>
@@ -37,45 +44,66 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <deque>
+#include <memory>
 
 #include <util/rsmemory.h>
+#include "pqi/pqioutslice.h"
+#include "retroshare/rsconfig.h"
 
 class pqiQoS
 {
 public:
-	pqiQoS(uint32_t max_levels,float alpha) ;
+	/**
+	 * @param max_levels number of priority levels
+	 * @param alpha ratio between the quanta of two consecutive levels, > 1
+	 * @param base_quantum bytes level 0 may send on each of its turn
+	 */
+	pqiQoS(uint32_t max_levels,float alpha,uint32_t base_quantum = DEFAULT_BASE_QUANTUM) ;
 
 	struct ItemRecord
 	{
 		void *data ;
+		std::shared_ptr<void> shared ;	// set once the item is being sliced, then owns data
 		uint32_t current_offset ;
 		uint32_t size ;
 		uint32_t id ;
+		double queued_time ;		// used to compute queuing delay stats
 	};
 
 	class ItemQueue 
 	{
 	public:
 		ItemQueue()
-		  : _threshold(0.0)
-		  , _counter(0.0)
-		  , _inc(0.0)
+		  : _quantum(0)
+		  , _deficit(0)
+		  , _backlog_bytes(0)
+		  , _sent_items(0)
+		  , _mean_delay(0.0)
+		  , _max_delay(0.0)
 		{}
-		void *pop() 
+		// size of the slice that slice() would return for the given max_size
+		uint32_t next_slice_size(uint32_t max_size) const
 		{
-			if(_items.empty())
-				return NULL ;
+			const ItemRecord& rec(_items.front()) ;
 
-			void *item = _items.front().data ;
-			_items.pop_front() ;
+			if(rec.current_offset == 0 && rec.size < max_size)
+				return rec.size ;
 
-			return item ;
+			if(rec.size <= rec.current_offset)
+				return 0 ;
+
+			return std::min(max_size, rec.size - rec.current_offset) ;
 		}
 
-		void *slice(uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) 
+		// Returns a view on the next chunk of at most max_size bytes of the front item. Slices
+		// of a large item share the item buffer instead of copying it, the buffer is freed
+		// when the last slice is released.
+
+		bool slice(uint32_t max_size,pqiOutSlice& out,bool& starts,bool& ends,uint32_t& packet_id) 
 		{
 			if(_items.empty())
-				return NULL ;
+				return false ;
 
 			ItemRecord& rec(_items.front()) ;
 			packet_id = rec.id ;
@@ -86,9 +114,11 @@ public:
 			{
 				starts = true ;
 				ends = true ;
-				size = rec.size ;
+				out = pqiOutSlice(rec.data,rec.size) ;
+				_backlog_bytes -= rec.size ;
+				_items.pop_front() ;
 
-				return pop() ;
+				return true ;
 			}
 			starts = (rec.current_offset == 0) ;
 			ends   = (rec.current_offset + max_size >= rec.size) ;
@@ -96,34 +126,26 @@ public:
 			if(rec.size <= rec.current_offset)
 			{
 				std::cerr << "(EE) severe error in slicing in QoS." << std::endl;
-				pop() ;
-				return NULL ;
+				clear_front() ;
+				return false ;
 			}
 
-			size = std::min(max_size, uint32_t((int)rec.size - (int)rec.current_offset)) ;
-			void *mem = rs_malloc(size) ;
-
-			if(!mem)
-			{
-				std::cerr << "(EE) memory allocation error in QoS." << std::endl;
-				pop() ;
-				return NULL ;
-			}
+			if(!rec.shared)
+				rec.shared = std::shared_ptr<void>(rec.data,free) ;
 
-			memcpy(mem,&((unsigned char*)rec.data)[rec.current_offset],size) ;
+			uint32_t size = std::min(max_size, uint32_t((int)rec.size - (int)rec.current_offset)) ;
+			out = pqiOutSlice(rec.shared,rec.current_offset,size) ;
+			_backlog_bytes -= size ;
 
-			if(ends)	// we're taking the whole stuff. So we can delete the entry.
-			{
-				free(rec.data) ;
+			if(ends)	// we're taking the whole stuff. So we can delete the entry, the slice keeps the data alive.
 				_items.pop_front() ;
-			}
 			else
 				rec.current_offset += size ;	// by construction, !ends  implies  rec.current_offset < rec.size
 
-			return mem ;
+			return true ;
 		}
 
-		void push(void *item,uint32_t size,uint32_t id) 
+		void push(void *item,uint32_t size,uint32_t id,double now) 
 		{
 			ItemRecord rec ;
 
@@ -131,49 +153,86 @@ public:
 			rec.current_offset = 0 ;
 			rec.size = size ;
 			rec.id = id ;
+			rec.queued_time = now ;
 
 			_items.push_back(rec) ;
+			_backlog_bytes += size ;
+		}
+
+		// Drops the front item, freeing its data unless it is owned by slices already handed out.
+		void clear_front()
+		{
+			if(!_items.front().shared)
+				free(_items.front().data) ;
+
+			_backlog_bytes -= _items.front().size - _items.front().current_offset ;
+			_items.pop_front() ;
 		}
 
         uint32_t size() const { return _items.size() ; }
 
-		float _threshold ;
-		float _counter ;
-		float _inc ;
+		uint32_t _quantum ;		// bytes added to the deficit on each turn
+		uint32_t _deficit ;		// bytes this level may still send in its current turn
+
+		uint32_t _backlog_bytes ;
+		uint32_t _sent_items ;
+		float _mean_delay ;
+		float _max_delay ;
 
 		std::list<ItemRecord> _items ;
 	};
 
-	// This function pops items from the queue, y order of priority
+	// This function pops items from the queue, y order of priority. The returned slice
+	// references the queued item memory, no copy is made.
 	//
-	void *out_rsItem(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
+	bool out_rsItem(uint32_t max_slice_size,pqiOutSlice& out,bool& starts,bool& ends,uint32_t& packet_id) ;
 
 	// This function is used to queue items.
 	//
 	void in_rsItem(void *item, int size, int priority) ;
 
+	// Levels (bit mask) out_rsItem() must leave aside, ex: because the bandwidth allocator has
+	// no budget left for them. Blocked levels keep their place and deficit in the round.
+	void setBlockedLevels(uint32_t mask) { _blocked_levels = mask ; }
+
+	// Level of the last slice returned by out_rsItem()
+	uint32_t lastOutLevel() const { return _last_out_level ; }
+
 	void print() const ;
 	uint64_t qos_queue_size() const { return _nb_items ; }
 
 	// kills all waiting items.
 	void clear() ;
 
-	// get some stats about what's going on. service_packets will contain the number of
-	// packets per service, and queue_sizes will contain the size of the different priority queues.
+	// Quantum, in bytes, of the given priority level.
+	uint32_t quantum(uint32_t priority) const ;
+	void setQuantum(uint32_t priority,uint32_t bytes) ;
 
-	//int gatherStatistics(std::vector<uint32_t>& per_service_count,std::vector<uint32_t>& per_priority_count) const ;
+	// Gets per priority level backlog and queuing delay. Counters that are relative to the
+	// last gathering (sent items, max delay) are reset.
+	void gatherQueueStatistics(std::vector<RsQoSClassStats>& per_priority_stats) ;
 
 	void computeTotalItemSize() const ;
 	int debug_computeTotalItemSize() const ;
+
+	static const uint32_t DEFAULT_BASE_QUANTUM ;
 private:
+	void updateDelayStats(ItemQueue& queue, double queued_time) ;
+
 	// This vector stores the lists of items with equal priorities.
 	//
 	std::vector<ItemQueue> _item_queues ;
+
+	// Levels that have items waiting, in round robin order. The level at the front is the
+	// one being served, _front_credited tells if it already got its quantum for this turn.
+	std::deque<uint32_t> _active_levels ;
+	bool _front_credited ;
+	uint32_t _blocked_levels ;
+	uint32_t _last_out_level ;
+
 	float _alpha ;
 	uint64_t _nb_items ;
 	uint32_t _id_counter ;
 
 	static const uint32_t MAX_PACKET_COUNTER_VALUE ;
 };
-
-
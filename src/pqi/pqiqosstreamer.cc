@@ -48,6 +48,11 @@ int pqiQoSstreamer::getQueueSize(bool in)
 //    return pqiQoS::gatherStatistics(per_service_count,per_priority_count) ;
 //}
 
+void pqiQoSstreamer::locked_gatherQueueStatistics(std::vector<RsQoSClassStats>& qos_stats)
+{
+	pqiQoS::gatherQueueStatistics(qos_stats) ;
+}
+
 void pqiQoSstreamer::locked_storeInOutputQueue(void *ptr,int size,int priority)
 {
 	_total_item_size += size ;
@@ -68,18 +73,16 @@ void pqiQoSstreamer::locked_clear_out_queue()
 	_total_item_count = 0 ;
 }
 
-void *pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+bool pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, pqiOutSlice& out, bool& starts, bool& ends, uint32_t& packet_id)
 {
-	void *out = pqiQoS::out_rsItem(max_slice_size,size,starts,ends,packet_id) ;
+	if(!pqiQoS::out_rsItem(max_slice_size,out,starts,ends,packet_id))
+		return false ;
 
-	if(out != NULL) 
-	{
-		_total_item_size -= size ;
-        
-        	if(ends)
-			--_total_item_count ;
-	}
+	_total_item_size -= out.size() ;
+
+	if(ends)
+		--_total_item_count ;
 
-	return out ;
+	return true ;
 }
 
@@ -36,12 +36,17 @@ class pqiQoSstreamer: public pqithreadstreamer, public pqiQoS
 		virtual int locked_out_queue_size() const { return _total_item_count ; }
 		virtual void locked_clear_out_queue() ;
 		virtual int locked_compute_out_pkt_size() const { return _total_item_size ; }
-		virtual  void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual  bool locked_pop_out_data(uint32_t max_slice_size,pqiOutSlice& out,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual int  locked_last_out_priority() const { return pqiQoS::lastOutLevel() ; }
+		virtual void locked_block_priorities(uint32_t mask) { pqiQoS::setBlockedLevels(mask) ; }
                 //virtual int  locked_gatherStatistics(std::vector<uint32_t>& per_service_count,std::vector<uint32_t>& per_priority_count) const; // extracting data.
 
 
 		virtual int getQueueSize(bool in) ;
 
+	protected:
+		virtual void locked_gatherQueueStatistics(std::vector<RsQoSClassStats>& qos_stats) ;
+
 	private:
 		uint32_t _total_item_size ;
 		uint32_t _total_item_count ;
@@ -0,0 +1,437 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqireactor.cc                                        *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include "pqi/pqireactor.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+
+#include "pqi/pqithreadstreamer.h"
+#include "util/rsdebug.h"
+#include "util/rstime.h"
+#include "util/stacktrace.h"
+
+//#define DEBUG_PQI_REACTOR 1
+
+static const int    PQI_REACTOR_MAX_EVENTS    = 64;
+static const double PQI_REACTOR_RECV_RETRY    = 0.010; // 10 ms, same as old streamer timeout
+static const double PQI_REACTOR_SEND_RETRY    = 0.030; // 30 ms, same as old streamer sleep
+static const double PQI_REACTOR_DEFER_RETRY   = 0.002; // 2 ms, pqistreamer output coalescing delay
+static const double PQI_REACTOR_IDLE_PERIOD   = 1.0;   // housekeeping (rates update, inactive)
+
+/// Wake up file descriptor is registered with this id, real entries start at 1
+static const uint64_t PQI_REACTOR_WAKE_ID = 0;
+
+RsMutex pqiReactor::sPoolMtx("pqiReactor pool");
+std::vector<pqiReactor*> pqiReactor::sPool;
+
+pqiReactor* pqiReactor::pick()
+{
+	RS_STACK_MUTEX(sPoolMtx);
+
+	if(sPool.empty())
+	{
+		unsigned int n = std::thread::hardware_concurrency();
+		if(!n) n = 1;
+
+		for(unsigned int i = 0; i < n; ++i)
+		{
+			pqiReactor* r = new pqiReactor();
+			r->start("pqi reactor " + std::to_string(i));
+			sPool.push_back(r);
+		}
+
+		RsInfo() << __PRETTY_FUNCTION__ << " started " << n << " reactors";
+	}
+
+	pqiReactor* best = nullptr;
+	uint32_t bestCount = 0;
+	for(pqiReactor* r: sPool)
+	{
+		uint32_t c = r->attachedCount();
+		if(!best || c < bestCount) { best = r; bestCount = c; }
+	}
+
+	return best;
+}
+
+void pqiReactor::stopAll()
+{
+	RS_STACK_MUTEX(sPoolMtx);
+
+	/* Reactors are not deleted as streamers which are not fully stopped at
+	 * shutdown may still hold a pointer to them */
+	for(pqiReactor* r: sPool) r->fullstop();
+}
+
+pqiReactor::pqiReactor() : mReactorMtx("pqiReactor"),
+    mEpollFd(-1), mWakeFd(-1), mLastEntryId(PQI_REACTOR_WAKE_ID)
+{
+	mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if(mEpollFd < 0 || mWakeFd < 0)
+	{
+		RS_ERR("Failure creating epoll/eventfd: ", strerror(errno));
+		print_stacktrace();
+		return;
+	}
+
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = PQI_REACTOR_WAKE_ID;
+	if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev) < 0)
+		RS_ERR("Failure registering wake up fd: ", strerror(errno));
+}
+
+pqiReactor::~pqiReactor()
+{
+	for(auto& it: mEntries) delete it.second;
+	mEntries.clear();
+
+	if(mWakeFd >= 0) close(mWakeFd);
+	if(mEpollFd >= 0) close(mEpollFd);
+}
+
+uint32_t pqiReactor::attachedCount()
+{
+	RS_STACK_MUTEX(mReactorMtx);
+	return static_cast<uint32_t>(mStreamerIds.size());
+}
+
+void pqiReactor::attach(pqithreadstreamer* streamer)
+{
+	int fd = streamer->reactorFd();
+
+	RS_STACK_MUTEX(mReactorMtx);
+
+	Entry* e = nullptr;
+	uint64_t id;
+
+	auto it = mStreamerIds.find(streamer);
+	if(it != mStreamerIds.end())
+	{
+		id = it->second;
+		e = mEntries[id];
+
+		if(e->mFd != fd)
+		{
+			unregisterFd_locked(id, *e);
+			e->mFd = fd;
+		}
+	}
+	else
+	{
+		id = ++mLastEntryId;
+		e = new Entry();
+		e->mStreamer = streamer;
+		e->mFd = fd;
+		mEntries[id] = e;
+		mStreamerIds[streamer] = id;
+	}
+
+	updateInterest_locked(id, *e, EPOLLIN | EPOLLRDHUP);
+
+	// Service it ASAP
+	e->mNextTick = rstime::RsScopeTimer::currentTime();
+	wakeUp();
+
+#ifdef DEBUG_PQI_REACTOR
+	RsDbg() << __PRETTY_FUNCTION__ << " streamer: " << streamer << " fd: "
+	        << e->mFd << " id: " << id;
+#endif
+}
+
+void pqiReactor::detach(pqithreadstreamer* streamer, bool wait)
+{
+	uint64_t id;
+
+	{
+		RS_STACK_MUTEX(mReactorMtx);
+
+		auto it = mStreamerIds.find(streamer);
+		if(it == mStreamerIds.end()) return;
+
+		id = it->second;
+		mStreamerIds.erase(it);
+		mNotified.erase(id);
+
+		Entry* e = mEntries[id];
+		unregisterFd_locked(id, *e);
+
+		if(!e->mBusy)
+		{
+			mEntries.erase(id);
+			delete e;
+			return;
+		}
+
+		// The reactor thread will delete it once done
+		e->mDetached = true;
+	}
+
+	if(!wait) return;
+
+	if(std::this_thread::get_id() == mReactorThreadId)
+	{
+		RS_ERR("Cannot wait for streamer detach from reactor thread");
+		print_stacktrace();
+		return;
+	}
+
+	while(true)
+	{
+		{
+			RS_STACK_MUTEX(mReactorMtx);
+			if(mEntries.find(id) == mEntries.end()) return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void pqiReactor::notifyOutgoing(pqithreadstreamer* streamer)
+{
+	RS_STACK_MUTEX(mReactorMtx);
+
+	auto it = mStreamerIds.find(streamer);
+	if(it == mStreamerIds.end()) return;
+
+	/* The reactor clears mNotified each round, so one wake up is enough no
+	 * matter how many items are queued in the meantime */
+	bool wasEmpty = mNotified.empty();
+	mNotified.insert(it->second);
+	if(wasEmpty) wakeUp();
+}
+
+void pqiReactor::onStopRequested()
+{
+	wakeUp();
+}
+
+void pqiReactor::wakeUp()
+{
+	uint64_t one = 1;
+	if(write(mWakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		RS_WARN("Failure writing wake up fd: ", strerror(errno));
+}
+
+void pqiReactor::updateInterest_locked(uint64_t id, Entry& e, uint32_t events)
+{
+	if(e.mFd < 0 || e.mEvents == events) return;
+
+	if(e.mEvents)
+	{
+		/* The descriptor may have been closed and its number reused by another
+		 * streamer, in that case fall back to timer driven servicing */
+		auto oIt = mFdOwners.find(e.mFd);
+		if(oIt == mFdOwners.end() || oIt->second != id)
+		{
+			e.mFd = -1;
+			e.mEvents = 0;
+			return;
+		}
+	}
+
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.u64 = id;
+
+	int op = e.mEvents ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if(epoll_ctl(mEpollFd, op, e.mFd, &ev) < 0)
+	{
+		RS_WARN( "epoll_ctl failed for fd: ", e.mFd, " ", strerror(errno),
+		         " falling back to timer" );
+		if(e.mEvents) mFdOwners.erase(e.mFd);
+		e.mFd = -1;
+		e.mEvents = 0;
+		return;
+	}
+
+	e.mEvents = events;
+	mFdOwners[e.mFd] = id;
+}
+
+void pqiReactor::unregisterFd_locked(uint64_t id, Entry& e)
+{
+	if(e.mFd < 0 || !e.mEvents) return;
+
+	auto oIt = mFdOwners.find(e.mFd);
+	if(oIt != mFdOwners.end() && oIt->second == id)
+	{
+		// May fail with EBADF if already closed, epoll forgot it already then
+		epoll_ctl(mEpollFd, EPOLL_CTL_DEL, e.mFd, nullptr);
+		mFdOwners.erase(oIt);
+	}
+
+	e.mEvents = 0;
+}
+
+int pqiReactor::nextTimeout_locked(double now)
+{
+	double next = now + PQI_REACTOR_IDLE_PERIOD;
+
+	for(auto& it: mEntries)
+	{
+		const Entry& e = *it.second;
+		if(!e.mDetached && e.mNextTick > 0 && e.mNextTick < next)
+			next = e.mNextTick;
+	}
+
+	if(next <= now) return 0;
+	return static_cast<int>((next - now) * 1000.0) + 1;
+}
+
+void pqiReactor::run()
+{
+	mReactorThreadId = std::this_thread::get_id();
+
+	epoll_event events[PQI_REACTOR_MAX_EVENTS];
+	std::vector<std::pair<uint64_t, Entry*> > ready;
+
+	while(!shouldStop())
+	{
+		int timeout;
+		{
+			RS_STACK_MUTEX(mReactorMtx);
+			timeout = nextTimeout_locked(rstime::RsScopeTimer::currentTime());
+		}
+
+		int n = epoll_wait(mEpollFd, events, PQI_REACTOR_MAX_EVENTS, timeout);
+		if(n < 0)
+		{
+			if(errno == EINTR) continue;
+
+			RS_ERR("epoll_wait failed: ", strerror(errno));
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			continue;
+		}
+
+		ready.clear();
+
+		{
+			RS_STACK_MUTEX(mReactorMtx);
+			double now = rstime::RsScopeTimer::currentTime();
+
+			for(int i = 0; i < n; ++i)
+			{
+				uint64_t id = events[i].data.u64;
+
+				if(id == PQI_REACTOR_WAKE_ID)
+				{
+					uint64_t cnt;
+					while(read(mWakeFd, &cnt, sizeof(cnt)) > 0);
+					continue;
+				}
+
+				auto eIt = mEntries.find(id);
+				if(eIt == mEntries.end()) continue;
+				Entry& e = *eIt->second;
+
+				/* Hang up and errors are always reported by epoll (level
+				 * triggered) so stop watching the descriptor to avoid a busy
+				 * loop, pqissl will notice and reset the connection soon */
+				if(events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+				{
+					unregisterFd_locked(id, e);
+					e.mFd = -1;
+				}
+
+				e.mReadable = true;
+			}
+
+			for(uint64_t id: mNotified)
+			{
+				auto eIt = mEntries.find(id);
+				if(eIt != mEntries.end()) eIt->second->mNotified = true;
+			}
+			mNotified.clear();
+
+			for(auto& it: mEntries)
+			{
+				Entry& e = *it.second;
+				if(e.mDetached || e.mBusy) continue;
+
+				if( e.mReadable || e.mNotified ||
+				        (e.mNextTick > 0 && e.mNextTick <= now) )
+				{
+					e.mBusy = true;
+					e.mReadable = false;
+					e.mNotified = false;
+					ready.push_back(it);
+				}
+			}
+		}
+
+		for(auto& it: ready) service(it.first, *it.second);
+	}
+}
+
+void pqiReactor::service(uint64_t id, Entry& e)
+{
+	// No reactor lock held here, streamer work may take some time
+	uint32_t hints = e.mStreamer->reactorTick();
+
+	RS_STACK_MUTEX(mReactorMtx);
+	e.mBusy = false;
+
+	if(e.mDetached)
+	{
+		mEntries.erase(id);
+		delete &e;
+		return;
+	}
+
+	double now = rstime::RsScopeTimer::currentTime();
+
+	if(hints & TICK_INACTIVE)
+	{
+		e.mNextTick = now + PQI_REACTOR_IDLE_PERIOD;
+		return;
+	}
+
+	/* While there is something left to read (either rate limited or already
+	 * decrypted in SSL buffers) don't watch for readability, as it would
+	 * keep waking us up, retry on timer instead */
+	uint32_t events = EPOLLRDHUP;
+	if(!(hints & TICK_RECV_PENDING)) events |= EPOLLIN;
+	if(hints & TICK_SEND_BLOCKED) events |= EPOLLOUT;
+	updateInterest_locked(id, e, events);
+
+	if(hints & TICK_SEND_DEFERRED)
+		e.mNextTick = now + PQI_REACTOR_DEFER_RETRY;
+	else if(hints & TICK_RECV_PENDING)
+		e.mNextTick = now + PQI_REACTOR_RECV_RETRY;
+	else if((hints & TICK_SEND_PENDING) || e.mFd < 0)
+		e.mNextTick = now + PQI_REACTOR_SEND_RETRY;
+	else
+		e.mNextTick = now + PQI_REACTOR_IDLE_PERIOD;
+
+#ifdef DEBUG_PQI_REACTOR
+	RsDbg() << __PRETTY_FUNCTION__ << " id: " << id << " hints: " << hints
+	        << " events: " << events;
+#endif
+}
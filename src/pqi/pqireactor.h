@@ -0,0 +1,151 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqireactor.h                                         *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include "util/rsthreads.h"
+
+class pqithreadstreamer;
+
+/**
+ * @brief Shared epoll based event loop driving many pqithreadstreamer.
+ * Without a reactor each connected peer owns a thread which polls its
+ * BinInterface and then sleeps, so the number of threads grows with the number
+ * of friends and every packet may wait up to one sleep period.
+ * A reactor instead waits on the sockets of all the streamers attached to it
+ * and services a streamer only when its socket is readable, writable (while
+ * output is pending) or when new outgoing data has been queued.
+ * Streamers whose BinInterface doesn't expose a kernel file descriptor (like
+ * pqissludp on top of TOU) are serviced on a timer with the same period the
+ * per peer thread used.
+ * A fixed pool of reactors (one per core) is shared by all the peers, so the
+ * number of threads doesn't depend on the number of connected friends.
+ * Available only on Linux/Android, enabled by RS_PQI_REACTOR.
+ */
+class pqiReactor: public RsThread
+{
+public:
+	/**
+	 * Get the least loaded reactor of the pool, the pool is created and
+	 * started on first call.
+	 */
+	static pqiReactor* pick();
+
+	/**
+	 * Stop all reactors of the pool, to be called at shutdown once all
+	 * streamers have been detached.
+	 */
+	static void stopAll();
+
+	/**
+	 * Start servicing given streamer. If the streamer is already attached its
+	 * file descriptor is updated.
+	 */
+	void attach(pqithreadstreamer* streamer);
+
+	/**
+	 * Stop servicing given streamer.
+	 * @param[in] wait if true wait until the reactor is not servicing the
+	 *	streamer anymore before returning, so the streamer can be safely
+	 *	deleted. Must not be true when called from the reactor thread.
+	 */
+	void detach(pqithreadstreamer* streamer, bool wait);
+
+	/**
+	 * Wake up the reactor because new outgoing data has been queued for given
+	 * streamer. Cheap, can be called from any thread.
+	 */
+	void notifyOutgoing(pqithreadstreamer* streamer);
+
+	/// @return number of streamers attached to this reactor
+	uint32_t attachedCount();
+
+	/**
+	 * Hints returned by pqithreadstreamer::reactorTick() to tell the reactor
+	 * when the streamer needs to be serviced again.
+	 */
+	enum TickHint : uint32_t
+	{
+		TICK_IDLE         = 0x00, /// Nothing pending, wait for socket/notify
+		TICK_RECV_PENDING = 0x01, /// Data left to read (ex: in SSL buffers)
+		TICK_SEND_PENDING = 0x02, /// Output left but rate limited
+		TICK_SEND_BLOCKED = 0x04, /// Output left and socket buffer full
+		TICK_INACTIVE     = 0x08, /// Connection not active
+		TICK_SEND_DEFERRED= 0x10  /// Output kept to be packed with next items
+	};
+
+protected:
+	void run() override;
+	void onStopRequested() override;
+
+private:
+	pqiReactor();
+	~pqiReactor() override;
+
+	struct Entry
+	{
+		Entry() : mStreamer(nullptr), mFd(-1), mEvents(0), mBusy(false),
+		    mDetached(false), mReadable(false), mNotified(false),
+		    mNextTick(0) {}
+
+		pqithreadstreamer* mStreamer;
+		int mFd;           /// -1 if timer driven
+		uint32_t mEvents;  /// epoll events currently armed
+		bool mBusy;        /// being serviced by the reactor thread
+		bool mDetached;    /// to be deleted as soon as not busy
+		bool mReadable;
+		bool mNotified;
+		double mNextTick;  /// next timer driven service, 0 if none
+	};
+
+	void wakeUp();
+	void service(uint64_t id, Entry& e);
+	void updateInterest_locked(uint64_t id, Entry& e, uint32_t events);
+	void unregisterFd_locked(uint64_t id, Entry& e);
+	int nextTimeout_locked(double now);
+
+	RsMutex mReactorMtx;
+
+	int mEpollFd;
+	int mWakeFd;
+
+	uint64_t mLastEntryId;
+	std::map<uint64_t, Entry*> mEntries;
+	std::map<pqithreadstreamer*, uint64_t> mStreamerIds;
+
+	/** As epoll silently forget closed file descriptors, keep track of which
+	 * entry owns which descriptor to avoid unregistering a reused descriptor
+	 * number now belonging to another streamer */
+	std::map<int, uint64_t> mFdOwners;
+
+	std::set<uint64_t> mNotified;
+
+	std::thread::id mReactorThreadId;
+
+	static RsMutex sPoolMtx;
+	static std::vector<pqiReactor*> sPool;
+};
@@ -29,6 +29,7 @@
 #include "util/rsstring.h"
 
 #include <unistd.h>
+#include <algorithm>
 #include <errno.h>
 #include <openssl/err.h>
 
@@ -67,6 +68,7 @@ const int PQISSL_UDP_FLAG = 0x02;
 
 static const int PQISSL_MAX_READ_ZERO_COUNT = 20;
 static const rstime_t PQISSL_MAX_READ_ZERO_TIME = 15; // 15 seconds of no data => reset. (atm HeartBeat pkt sent 5 secs)
+static const uint32_t PQISSL_MAX_RECORD_SIZE = 16384; // max TLS record payload, see SSL3_RT_MAX_PLAIN_LENGTH
 
 static const int PQISSL_SSL_CONNECT_TIMEOUT = 30;
 
@@ -308,11 +310,18 @@ void pqissl::getCryptoParams(RsPeerCryptoParams& params)
 		char *desc = SSL_CIPHER_description(SSL_get_current_cipher(ssl_connection), NULL, 0);
 		params.cipher_name = std::string(desc);
 		OPENSSL_free(desc);
+
+#ifdef RS_KTLS
+		params.kernel_tls_send = BIO_get_ktls_send(SSL_get_wbio(ssl_connection));
+		params.kernel_tls_recv = BIO_get_ktls_recv(SSL_get_rbio(ssl_connection));
+#endif
 	}
 	else
 	{
 		params.connexion_state = 0 ;
 		params.cipher_name.clear() ;
+		params.kernel_tls_send = false ;
+		params.kernel_tls_recv = false ;
 	}
 }
 
@@ -1043,6 +1052,11 @@ int 	pqissl::Initiate_SSL_Connection()
 		rslog(RSL_ALERT, pqisslzone, out);
 	}
 
+	// resume the last session with that peer if we have one, this saves most
+	// of the handshake work. The peer is authenticated again once connected.
+	if (sslmode == PQISSL_ACTIVE)
+		AuthSSL::instance().setResumableSession(ssl, PeerId());
+
 #ifdef PQISSL_LOG_DEBUG 
   	rslog(RSL_DEBUG_BASIC, pqisslzone, 
 	  "pqissl::Initiate_SSL_Connection() Waiting for SSL Connection");
@@ -1140,6 +1154,17 @@ int pqissl::SSL_Connection_Complete()
 	}
 	// if we get here... success v quickly.
 
+	// VerifyX509Callback was skipped if the session was resumed.
+	if (!AuthSSL::instance().VerifyResumedSession(ssl_connection, PeerId()))
+	{
+		rslog(RSL_WARNING, pqisslzone, "pqissl::SSL_Connection_Complete() resumed session refused for Peer: " + PeerId().toStdString());
+
+		reset_locked();
+		waiting = WAITING_FAIL_INTERFACE;
+
+		return -1;
+	}
+
 	rslog(RSL_WARNING, pqisslzone, "pqissl::SSL_Connection_Complete() Success!: Peer: " + PeerId().toStdString());
 
 	waiting = WAITING_SSL_AUTHORISE;
@@ -1375,6 +1400,12 @@ int pqissl::accept_locked( SSL *ssl, int fd,
 	          << PeerId().toStdString() << " remoteaddr: "
 	          << sockaddr_storage_iptostring(remote_addr) << std::endl;
 
+#ifdef RS_KTLS
+	RsInfo() << __PRETTY_FUNCTION__ << " cipher: " << SSL_get_cipher(ssl)
+	         << " kernel TLS send: " << BIO_get_ktls_send(SSL_get_wbio(ssl))
+	         << " recv: " << BIO_get_ktls_recv(SSL_get_rbio(ssl)) << std::endl;
+#endif
+
 #ifdef PQISSL_DEBUG
 	{
 		int alg;
@@ -1431,9 +1462,56 @@ int pqissl::accept_locked( SSL *ssl, int fd,
  */
 
 int 	pqissl::senddata(void *data, int len)
+{
+	RsStackMutex stack(mSslMtx); /**** LOCKED MUTEX ****/
+	return senddata_locked(data, len);
+}
+
+int pqissl::senddatav(const std::vector<pqiOutSlice>& segments, uint32_t offset)
 {
 	RsStackMutex stack(mSslMtx); /**** LOCKED MUTEX ****/
 
+	/* Pack the segments into records of the maximum TLS record size, so a
+	 * batch of small items costs a single record (MAC, padding) and a single
+	 * write() instead of one per item. The record buffer is reused, and the
+	 * packing only depends on the batch and offset, so a record which
+	 * couldn't be written is rebuilt identical at next call, as OpenSSL
+	 * requires */
+	if(mRecordBuf.empty()) mRecordBuf.resize(PQISSL_MAX_RECORD_SIZE);
+
+	std::vector<pqiOutSlice>::const_iterator it = segments.begin();
+	uint32_t segOffset = offset;
+	int sent = 0;
+
+	for(;;)
+	{
+		uint32_t recordSize = 0;
+
+		for(; it != segments.end() && recordSize < PQISSL_MAX_RECORD_SIZE; ++it)
+		{
+			if(segOffset >= it->size()) { segOffset -= it->size(); continue; }
+
+			uint32_t n = std::min<uint32_t>( it->size() - segOffset,
+			                                 PQISSL_MAX_RECORD_SIZE - recordSize );
+			memcpy(&mRecordBuf[recordSize], it->data() + segOffset, n);
+			recordSize += n;
+			segOffset += n;
+
+			if(segOffset < it->size()) break; // record full, keep segment
+			segOffset = 0;
+		}
+
+		if(!recordSize) return sent;
+
+		int ss = senddata_locked(mRecordBuf.data(), recordSize);
+		if(ss != (int)recordSize) return sent ? sent : ss;
+
+		sent += ss;
+	}
+}
+
+int pqissl::senddata_locked(void *data, int len)
+{
 	int tmppktlen ;
 
 	// safety check.  Apparently this avoids some SIGSEGV.
@@ -1866,6 +1944,13 @@ bool 	pqissl::cansend(uint32_t usec)
 
 RsFileHash pqissl::gethash() { return RsFileHash(); }
 
+int pqissl::getPollFd()
+{
+	/* No mutex here, as for isactive(), this is called also while handling
+	 * our own notifyEvent(NET_CONNECT_SUCCESS) with mSslMtx already locked */
+	return active ? sockfd : -1;
+}
+
 /********** End of Implementation of BinInterface ******************/
 
 
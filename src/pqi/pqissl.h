@@ -165,6 +165,7 @@ virtual int	tick();
 virtual int     status();
 
 virtual int senddata(void*, int);
+virtual int senddatav(const std::vector<pqiOutSlice>& segments, uint32_t offset);
 virtual int readdata(void*, int);
 virtual int netstatus();
 virtual int isactive();
@@ -174,6 +175,7 @@ virtual bool cansend(uint32_t usec);
 virtual int close(); /* BinInterface version of reset() */
 virtual RsFileHash gethash(); /* not used here */
 virtual bool bandwidthLimited() { return true ; }
+virtual int getPollFd();
 
 public:
 
@@ -196,6 +198,12 @@ protected:
 
 virtual int reset_locked();
 
+	/// single SSL_write(), with error handling
+	int senddata_locked(void *data, int len);
+
+	/// reused buffer where senddatav() packs segments into TLS records
+	std::vector<uint8_t> mRecordBuf;
+
 	/// initiate incoming connection.
 	int accept_locked( SSL *ssl, int fd,
 	                   const sockaddr_storage& foreign_addr );
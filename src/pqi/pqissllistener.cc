@@ -515,6 +515,16 @@ int	pqissllistenbase::continueSSL(IncomingSSLInfo& incoming_connexion_info, bool
         std::cerr << "  no info." << std::endl;
 #endif
 
+	// VerifyX509Callback was skipped if the peer resumed a session.
+	if(!AuthSSL::instance().VerifyResumedSession(incoming_connexion_info.ssl, RsPeerId()))
+	{
+		pqioutput(PQL_WARNING, pqissllistenzone,
+		    "pqissllistenbase::continueSSL() resumed session refused!");
+
+		closeConnection(fd, incoming_connexion_info.ssl);
+		return -1;
+	}
+
 	// if it succeeds
 	if (0 < completeConnection(fd, incoming_connexion_info))
 		return 1;
@@ -37,6 +37,7 @@ static struct RsLog::logInfo pqipersongrpzoneInfo = {RsLog::Default, "pqipersong
 
 #include "pqi/pqissl.h"
 #include "pqi/pqissllistener.h"
+#include "pqi/p3linkmgr.h"
 #include "pqi/p3peermgr.h"
 
 //#define PQISSLPERSON_DEBUG
@@ -144,7 +145,8 @@ pqiperson * pqisslpersongrp::locked_createPerson(const RsPeerId& id, pqilistener
 		 * * ServiceGeneric
 		 */
 	
-		ssl_tunnels[id] = pqis ;	// keeps for getting crypt info per peer.
+		ssl_tunnels.erase(id);
+		ssl_tunnels.insert(std::make_pair(id, pqis));	// keeps for getting crypt info per peer.
 	
 		RsSerialiser *rss = new RsSerialiser();
 		rss->addSerialType(new RsRawSerialiser());
@@ -152,6 +154,20 @@ pqiperson * pqisslpersongrp::locked_createPerson(const RsPeerId& id, pqilistener
 		pqiconnect *pqisc = new pqiconnect(pqip, rss, pqis);
 	
 		pqip -> addChildInterface(PQI_CONNECT_TCP, pqisc);
+
+		/* more TCP connections, to try several addresses at once. They only
+		 * connect out: incoming connections are handed to the first one.
+		 */
+		for(uint32_t i = 1; i < RS_TCP_RACE_WIDTH; ++i)
+		{
+			pqissl *racer = new pqissl(NULL, pqip, mLinkMgr);
+			ssl_tunnels.insert(std::make_pair(id, racer));
+
+			RsSerialiser *rssr = new RsSerialiser();
+			rssr->addSerialType(new RsRawSerialiser());
+
+			pqip -> addChildInterface(PQI_CONNECT_TCP, new pqiconnect(pqip, rssr, racer));
+		}
 	
 #ifndef PQI_DISABLE_UDP
 		pqissludp *pqius 	= new pqissludp(pqip, mLinkMgr);
@@ -172,12 +188,13 @@ pqiperson * pqisslpersongrp::locked_createPerson(const RsPeerId& id, pqilistener
 
 void pqisslpersongrp::disconnectPeer(const RsPeerId &peer)
 {
-    std::map<RsPeerId,pqissl*>::iterator it = ssl_tunnels.find(peer) ;
+    std::multimap<RsPeerId,pqissl*>::iterator it = ssl_tunnels.find(peer) ;
 
-    if(it != ssl_tunnels.end())
-        it->second->disconnect() ;
-    else
+    if(it == ssl_tunnels.end())
         std::cerr << "pqisslpersongrp::cannot find peer " << peer << ". cannot disconnect!" << std::endl;
+
+    for(; it != ssl_tunnels.upper_bound(peer); ++it)
+        it->second->disconnect() ;
 }
 
 
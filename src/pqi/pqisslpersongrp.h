@@ -46,7 +46,7 @@ virtual pqiperson   *locked_createPerson(const RsPeerId& id, pqilistener *listen
 	private:
 
 	p3PeerMgr *mPeerMgr;
-	std::map<RsPeerId,pqissl*> ssl_tunnels ;
+	std::multimap<RsPeerId,pqissl*> ssl_tunnels ;
 };
 
 
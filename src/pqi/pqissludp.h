@@ -55,6 +55,8 @@ public:
 	virtual bool cansend(uint32_t usec);
 	/* UDP always through firewalls -> always bandwidth Limited */
 	virtual bool bandwidthLimited() { return true; }
+	/* TOU sockets are not kernel file descriptors, they must be polled */
+	int getPollFd() override { return -1; }
 
 protected:
 
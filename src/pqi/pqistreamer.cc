@@ -31,8 +31,10 @@
 #include <utility>                // for pair
 
 #include "pqi/p3notify.h"         // for p3Notify
+#include "pqi/pqibwalloc.h"       // for pqiBandwidthAllocator
 #include "retroshare/rsids.h"     // for operator<<
 #include "retroshare/rsnotify.h"  // for RS_SYS_WARNING
+#include "rsitems/itempriorities.h" // for QOS_PRIORITY_DEFAULT
 #include "rsserver/p3face.h"      // for RsServer
 #include "serialiser/rsserial.h"  // for RsItem, RsSerialiser, getRsItemSize
 #include "util/rsdebug.h"         // for pqioutput, PQL_ALERT, PQL_DEBUG_ALL
@@ -57,6 +59,8 @@ static const int   PQISTREAM_SLICE_FLAG_ENDS 			= 0x02;		// these flags should b
 static const int   PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01     = 0x10;		// Protocol version ID. Should hold on the 4 lower bits.
 static const int   PQISTREAM_PARTIAL_PACKET_HEADER_SIZE	= 8;   		// Same size than normal header, to make the code simpler.
 static const int   PQISTREAM_PACKET_SLICING_PROBE_DELAY	= 60;  		// send every 60 secs.
+static const uint32_t PQISTREAM_COALESCE_SIZE			= 16384;	// Group slices up to one full TLS record before handing them to the BinInterface.
+static const double PQISTREAM_COALESCE_DELAY			= 0.002;	// Max time less than a record of output is kept queued, waiting for more items to group.
 
 // This is a probe packet, that won't deserialise (it's empty) but will not cause problems to old peers either, since they will ignore
 // it. This packet however will be understood by new peers as a signal to enable packet slicing. This should go when all peers use the
@@ -64,9 +68,10 @@ static const int   PQISTREAM_PACKET_SLICING_PROBE_DELAY	= 60;  		// send every 6
 
 static uint8_t PACKET_SLICING_PROBE_BYTES[8] =  { 0x02, 0xaa, 0xbb, 0xcc, 0x00, 0x00, 0x00,  0x08 } ;
 
-/* Change to true to disable packet slicing and/or packet grouping, if needed */
+/* Change to true to disable packet slicing and/or packet grouping and/or compression, if needed */
 #define DISABLE_PACKET_SLICING  false
 #define DISABLE_PACKET_GROUPING false
+#define DISABLE_PACKET_COMPRESSION false
 
 /* This removes the print statements (which hammer pqidebug) */
 /***
@@ -80,28 +85,15 @@ static uint8_t PACKET_SLICING_PROBE_BYTES[8] =  { 0x02, 0xaa, 0xbb, 0xcc, 0x00,
 	#include "util/rsprint.h"
 #endif
 
-static double getCurrentTS()
-{
-#ifndef WINDOWS_SYS
-        struct timeval cts_tmp;
-        gettimeofday(&cts_tmp, NULL);
-        double cts =  (cts_tmp.tv_sec) + ((double) cts_tmp.tv_usec) / 1000000.0;
-#else
-        struct _timeb timebuf;
-        _ftime( &timebuf);
-        double cts =  (timebuf.time) + ((double) timebuf.millitm) / 1000.0;
-#endif
-        return cts;
-}
-
 pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
 	:PQInterface(id), mStreamerMtx("pqistreamer"),
 	mBio(bio_in), mBio_flags(bio_flags_in), mRsSerialiser(rss), 
-	mPkt_wpending(NULL), mPkt_wpending_size(0),
+	mOutBatchSize(0), mOutBatchSent(0), mOutQueuedSince(0), mOutDeferred(false), mOutCoalescing(false),
 	mTotalRead(0), mTotalSent(0),
 	mCurrRead(0), mCurrSent(0),
 	mAvgReadCount(0), mAvgSentCount(0),
-	mAvgDtOut(0), mAvgDtIn(0)
+	mAvgDtOut(0), mAvgDtIn(0),
+	mBwAllocator(NULL), mOutAllocated(false)
 {
 
 	// 100 B/s (minimal)
@@ -114,8 +106,9 @@ pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bi
 
 	mAcceptsPacketSlicing = false ; // by default. Will be turned into true when everyone's ready.
 	mLastSentPacketSlicingProbe = 0 ;
+	mAcceptsCompression = false ; // until the peer sends the compression probe.
 
-	mAvgLastUpdate = mCurrSentTS = mCurrReadTS = getCurrentTS();
+	mAvgLastUpdate = mCurrSentTS = mCurrReadTS = rstime::getCurrentTS();
 
 	mIncomingSize = 0 ;
 	mIncomingSize_bytes = 0;
@@ -250,12 +243,18 @@ void pqistreamer::setRate(bool b,float f)
     	RateInterface::setRate(b,f) ;
 }
 
+void pqistreamer::setBandwidthAllocator(pqiBandwidthAllocator *allocator)
+{
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+	mBwAllocator = allocator ;
+}
+
 
 void pqistreamer::updateRates()
 {
 	// update actual rates both ways.
 
-	double t = getCurrentTS(); // get current timestamp.
+	double t = rstime::getCurrentTS(); // get current timestamp.
 	double diff = t - mAvgLastUpdate;
 
 	if (diff > PQISTREAM_AVG_PERIOD)
@@ -264,7 +263,7 @@ void pqistreamer::updateRates()
 		float avgSentpSec = PQISTREAM_AVG_FRAC * getRate(false) + (1.0 - PQISTREAM_AVG_FRAC) * mAvgSentCount/(1024.0 * diff);
 
 #ifdef DEBUG_PQISTREAMER
-		uint64_t t_now = 1000 * getCurrentTS();
+		uint64_t t_now = 1000 * rstime::getCurrentTS();
 		std::cerr << std::dec << t_now << " DEBUG_PQISTREAMER pqistreamer::updateRates PeerId " << this->PeerId().toStdString() << " Current speed estimates: down " << std::dec << (int)(1024 * avgReadpSec)  << " B/s / up " << (int)(1024 * avgSentpSec) << " B/s"  << std::endl;
 #endif
 
@@ -337,6 +336,24 @@ int 	pqistreamer::tick_send(uint32_t timeout)
 	return 1;
 }
 
+bool pqistreamer::hasPendingOutput()
+{
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+	return !mOutBatch.empty() || locked_out_queue_size() > 0;
+}
+
+bool pqistreamer::hasDeferredOutput()
+{
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+	return mOutDeferred;
+}
+
+void pqistreamer::setOutputCoalescing(bool enable)
+{
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+	mOutCoalescing = enable;
+}
+
 int	pqistreamer::status()
 {
 	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
@@ -369,18 +386,40 @@ int	pqistreamer::queue_outpqi_locked(RsItem *pqi,uint32_t& pktsize)
 #ifdef DEBUG_PQISTREAMER
         std::cerr << "pqistreamer::queue_outpqi() called." << std::endl;
 #endif
+	if(mOutBatch.empty() && locked_out_queue_size() == 0)
+		mOutQueuedSince = rstime::getCurrentTS();
+
+	/* Items reaching the streamer have usually been serialised by the
+	 * service already, if we own the item take over its buffer instead of
+	 * allocating a new one and copying the data into it */
+	RsRawItem *raw = nullptr;
+	if( !(mBio_flags & BIN_FLAGS_NO_DELETE)
+	        && (raw = dynamic_cast<RsRawItem*>(pqi))
+	        && raw->getRawData() && raw->getRawLength() >= 8
+	        && raw->getRawLength() <= getRsPktMaxSize() )
+	{
+		pktsize = raw->getRawLength();
+		locked_addTrafficClue(pqi,pktsize,mCurrentStatsChunk_Out) ;
 
-	/* decide which type of packet it is */
+		void *data = raw->releaseRawData() ;
+		uint32_t size = pktsize ;
+		locked_compressPacket(data,size,pqi->PacketService()) ;
+		locked_storeInOutputQueue(data,size,pqi->priority_level()) ;
+		delete pqi;
+		return 1;
+	}
 
-	pktsize = mRsSerialiser->size(pqi);
-	void *ptr = rs_malloc(pktsize);
-    
-    	if(ptr == NULL)
-            return 0 ;
+	/* decide which type of packet it is, and serialise it in a single pass */
 
+	const uint8_t *data = mRsSerialiser->serialiseScratch(pqi, pktsize);
+	void *ptr = data ? rs_malloc(pktsize) : NULL;
+
+	if (ptr != NULL)
+	{
 #ifdef DEBUG_PQISTREAMER
-	std::cerr << "pqistreamer::queue_outpqi() serializing packet with packet size : " << pktsize << std::endl;
+		std::cerr << "pqistreamer::queue_outpqi() serialized packet with packet size : " << pktsize << std::endl;
 #endif
+		memcpy(ptr, data, pktsize);
 
         /*******************************************************************************************/
     	// keep info for stats for a while. Only keep the items for the last two seconds. sec n is ongoing and second n-1
@@ -390,9 +429,9 @@ int	pqistreamer::queue_outpqi_locked(RsItem *pqi,uint32_t& pktsize)
 
         /*******************************************************************************************/
 
-	if (mRsSerialiser->serialise(pqi, ptr, &pktsize))
-	{
-		locked_storeInOutputQueue(ptr,pktsize,pqi->priority_level()) ;
+		uint32_t size = pktsize ;
+		locked_compressPacket(ptr,size,pqi->PacketService()) ;
+		locked_storeInOutputQueue(ptr,size,pqi->priority_level()) ;
 
 		if (!(mBio_flags & BIN_FLAGS_NO_DELETE))
 		{
@@ -400,11 +439,6 @@ int	pqistreamer::queue_outpqi_locked(RsItem *pqi,uint32_t& pktsize)
 		}
 		return 1;
 	}
-	else
-	{
-		/* cleanup serialiser */
-		free(ptr);
-	}
 
 	std::string out = "pqistreamer::queue_outpqi() Null Pkt generated!\nCaused By:\n";
 	pqi -> print_string(out);
@@ -472,6 +506,23 @@ void pqistreamer::locked_addTrafficClue(const RsItem *pqi,uint32_t pktsize,std::
     lst.push_back(tc) ;
 }
 
+// Replaces the serialised packet by its compressed version, if the peer understands it and it is worth it.
+void pqistreamer::locked_compressPacket(void *& ptr, uint32_t& size, uint16_t service)
+{
+	if(!mAcceptsCompression)
+		return ;
+
+	void *compressed = NULL ;
+	uint32_t compressed_size = 0 ;
+
+	if(mCompressor.compress(ptr,size,service,compressed,compressed_size))
+	{
+		free(ptr) ;
+		ptr = compressed ;
+		size = compressed_size ;
+	}
+}
+
 rstime_t	pqistreamer::getLastIncomingTS()
 {
 	// This is the only case where another thread (rs main for pqiperson) will access our data
@@ -517,7 +568,7 @@ int	pqistreamer::handleoutgoing_locked()
     
     //	std::cerr << "pqistreamer: maxbytes=" << maxbytes<< std::endl ; 
 
-    std::list<void *>::iterator it;
+    mOutDeferred = false;
 
     // if not connection, or cannot send anything... pause.
     if (!(mBio->isactive()))
@@ -528,14 +579,13 @@ int	pqistreamer::handleoutgoing_locked()
         	std::cerr << "(II) Switching off packet slicing." << std::endl;
 #endif
         	mAcceptsPacketSlicing = false ;
+        	mAcceptsCompression = false ;
+        	mCompressor.reset() ;
 
 	    /* also remove the pending packets */
-	    if (mPkt_wpending)
-	    {
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    	mPkt_wpending_size = 0 ;
-	    }
+	    mOutBatch.clear();
+	    mOutBatchSize = 0 ;
+	    mOutBatchSent = 0 ;
 
 	    return 0;
     }
@@ -558,14 +608,18 @@ int	pqistreamer::handleoutgoing_locked()
 #endif
 		    return 0;
 	    }
-	    // send a out_pkt., else send out_data. unless there is a pending packet. The strategy is to
-            //	- grab as many packets as possible while below the optimal packet size, so as to allow some packing and decrease encryption padding overhead (suposeddly)
-            //	- limit packets size to OPTIMAL_PACKET_SIZE when sending big packets so as to keep as much QoS as possible.
+	    // send a out_pkt., else send out_data. unless there is a pending batch. The strategy is to
+            //	- grab as many slices as possible while below a full TLS record, so that the BinInterface can pack them into
+            //	  a single record and write, which decreases encryption padding/MAC overhead and the number of syscalls.
+            //	- limit slices size to OPTIMAL_PACKET_SIZE when sending big packets so as to keep as much QoS as possible.
+            //	- when the owner retries it shortly (see setOutputCoalescing()), keep less than a record queued for at most
+            //	  PQISTREAM_COALESCE_DELAY, in case more items follow.
         
-	    if (!mPkt_wpending)
+	    if (mOutBatch.empty())
 	{
-		void *dta;
-		mPkt_wpending_size = 0 ;
+		pqiOutSlice dta;
+		mOutBatchSize = 0 ;
+		mOutBatchSent = 0 ;
 		int k=0;
 
         	// Checks for inserting a packet slicing probe. We do that to send the other peer the information that packet slicing can be used.
@@ -578,14 +632,35 @@ int	pqistreamer::handleoutgoing_locked()
                 	std::cerr << "(II) Inserting packet slicing probe in traffic" << std::endl;
 #endif
                     
-                    	mPkt_wpending_size = 8 ;
-                    	mPkt_wpending = rs_malloc(8) ;
-                        memcpy(mPkt_wpending,PACKET_SLICING_PROBE_BYTES,8) ;
+                    	void *probe = rs_malloc(8) ;
+                    	if(probe)
+                    	{
+                        	memcpy(probe,PACKET_SLICING_PROBE_BYTES,8) ;
+                        	mOutBatch.push_back(pqiOutSlice(probe,8)) ;
+                        	mOutBatchSize += 8 ;
+                    	}
+
+                    	// Also tell the peer that we understand compressed packets, same way.
+                    	if(!DISABLE_PACKET_COMPRESSION && (probe = rs_malloc(8)))
+                    	{
+                        	memcpy(probe,pqiPacketCompressor::PROBE_BYTES,8) ;
+                        	mOutBatch.push_back(pqiOutSlice(probe,8)) ;
+                        	mOutBatchSize += 8 ;
+                    	}
                         
                 	mLastSentPacketSlicingProbe = now ;
         	}
+            else if( sentbytes == 0 && mOutCoalescing && !DISABLE_PACKET_GROUPING
+                     && locked_compute_out_pkt_size() < (int)PQISTREAM_COALESCE_SIZE
+                     && rstime::getCurrentTS() < mOutQueuedSince + PQISTREAM_COALESCE_DELAY )
+            {
+                	// Less than a record to send, and it was queued very recently. Wait a bit for more items to pack.
+                	mOutDeferred = true ;
+                	return 0 ;
+            }
             
         	uint32_t slice_size=0;
+		uint32_t class_bytes[PQI_BW_NB_CLASSES] = { 0, 0, 0 } ;	// batch size per service class, for the allocator
 		bool slice_starts=true ;
 		bool slice_ends=true ;
 		uint32_t slice_packet_id=0 ;
@@ -594,20 +669,19 @@ int	pqistreamer::handleoutgoing_locked()
 		{
             		int desired_packet_size = mAcceptsPacketSlicing?PQISTREAM_OPTIMAL_PACKET_SIZE:(getRsPktMaxSize());
                     
-			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id) ;
-
-			if(!dta)
+			if(!locked_pop_out_data(desired_packet_size,dta,slice_starts,slice_ends,slice_packet_id))
 				break ;
 
+			slice_size = dta.size() ;
+
 			if(slice_starts && slice_ends)	// good old method. Send the packet as is, since it's a full packet.
 			{
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending full slice, old style. Size=" << slice_size << std::endl;
 #endif
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
-				free(dta);
-				mPkt_wpending_size += slice_size ;
+				mOutBatch.push_back(std::move(dta)) ;
+				mOutBatchSize += slice_size ;
+				class_bytes[pqiBandwidthAllocator::classOf(locked_last_out_priority())] += slice_size ;
 				++k ;
 			}
 			else	// partial packet. We make a special header for it and insert it in the stream
@@ -615,17 +689,21 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_size > 0xffff || !mAcceptsPacketSlicing)
 				{
 					std::cerr << "(EE) protocol error in pqitreamer: slice size is too large and cannot be encoded." ;
-					free(mPkt_wpending) ;
-					mPkt_wpending_size = 0;
+					mOutBatch.clear() ;
+					mOutBatchSize = 0;
 					return -1 ;
 				}
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending partial slice, packet ID=" << std::hex << slice_packet_id << std::dec << ", size=" << slice_size << std::endl;
 #endif
+				uint8_t *header = (uint8_t*)rs_malloc(PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
 
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],dta,slice_size) ;
-				free(dta);
+				if(!header)
+				{
+					mOutBatch.clear() ;
+					mOutBatchSize = 0;
+					return -1 ;
+				}
 
 				// New2: pp ff xxxxxxxx ssss  [data, sss bytes] => [flags 1B] [protocol version 1B] [2^32 packet count] [2^16 size]
 
@@ -633,68 +711,78 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_starts) partial_flags |= PQISTREAM_SLICE_FLAG_STARTS  ;
 				if(slice_ends  ) partial_flags |= PQISTREAM_SLICE_FLAG_ENDS  ;
 
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x01] = partial_flags ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x06] = uint8_t(slice_size      >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x07] = uint8_t(slice_size      >>  0) & 0xff ;
-
-				mPkt_wpending_size += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE;
+				header[0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
+				header[0x01] = partial_flags ;
+				header[0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
+				header[0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
+				header[0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
+				header[0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
+				header[0x06] = uint8_t(slice_size      >>  8) & 0xff ;
+				header[0x07] = uint8_t(slice_size      >>  0) & 0xff ;
+
+				mOutBatch.push_back(pqiOutSlice(header,PQISTREAM_PARTIAL_PACKET_HEADER_SIZE)) ;
+				mOutBatch.push_back(std::move(dta)) ;
+				mOutBatchSize += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE;
+				class_bytes[pqiBandwidthAllocator::classOf(locked_last_out_priority())] += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE ;
 				++k ;
 			}
 		} 
-                 while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size < PQISTREAM_OPTIMAL_PACKET_SIZE && !DISABLE_PACKET_GROUPING) ;
+                 while(mOutBatchSize < (uint32_t)maxbytes && mOutBatchSize < PQISTREAM_COALESCE_SIZE && !DISABLE_PACKET_GROUPING) ;
+
+		// The batch is kept until written, so it is charged to the buckets right away.
+		if(mOutAllocated && k > 0)
+			mBwAllocator->outSentBytes(PeerId(), rstime::getCurrentTS(), class_bytes) ;
              
 #ifdef DEBUG_PQISTREAMER
 		if(k > 1)
-			std::cerr << "Packed " << k << " packets into " << mPkt_wpending_size << " bytes." << std::endl;
+			std::cerr << "Packed " << k << " packets into " << mOutBatchSize << " bytes." << std::endl;
 #endif
 	}
         
-	    if (mPkt_wpending)
+	    if (!mOutBatch.empty())
 	    {
-		    // write packet.
+		    // write batch.
 #ifdef DEBUG_PQISTREAMER
-		std::cout << "Sending Out Pkt of size " << mPkt_wpending_size << " !" << std::endl;
+		std::cout << "Sending Out batch of size " << mOutBatchSize << " !" << std::endl;
 #endif
-            		int ss=0;
+		    int ss = mBio->senddatav(mOutBatch, mOutBatchSent);
+
+		    if (ss > 0)
+		    {
+			    mOutBatchSent += ss;
+			    sentbytes += ss;
+			    outSentBytes_locked(ss);	// this is the only time where we know exactly what was sent.
+		    }
 
-		    if (mPkt_wpending_size != (uint32_t)(ss = mBio->senddata(mPkt_wpending, mPkt_wpending_size)))
+		    if (mOutBatchSent < mOutBatchSize)
 		    {
 #ifdef DEBUG_PQISTREAMER
 			    std::string out;
-			    rs_sprintf(out, "Problems with Send Data! (only %d bytes sent, total pkt size=%d)", ss, mPkt_wpending_size);
+			    rs_sprintf(out, "Problems with Send Data! (only %d bytes sent, total batch size=%d)", mOutBatchSent, mOutBatchSize);
 			    //				std::cerr << out << std::endl ;
 			    pqioutput(PQL_DEBUG_BASIC, pqistreamerzone, out);
 #endif
-                		std::cerr << PeerId() << ": sending failed. Only " << ss << " bytes sent over " << mPkt_wpending_size << std::endl;
+                		std::cerr << PeerId() << ": sending failed. Only " << mOutBatchSent << " bytes sent over " << mOutBatchSize << std::endl;
 
-			    // pkt_wpending will kept til next time.
-			    // ensuring exactly the same data is written (openSSL requirement).
+			    // the batch is kept til next time, and the remaining part
+			    // handed over again as is (openSSL requirement).
 			    return -1;
 		    }
 #ifdef DEBUG_PQISTREAMER
             else
-                		std::cerr << PeerId() << ": sent " << ss << " bytes " << std::endl;
+                		std::cerr << PeerId() << ": sent " << mOutBatchSize << " bytes " << std::endl;
 #endif
             
 		    ++nsent;
-            
-            outSentBytes_locked(mPkt_wpending_size);	// this is the only time where we know exactly what was sent.
 
 #ifdef DEBUG_TRANSFERS
-            std::cerr << "pqistreamer::handleoutgoing_locked() Sent Packet len: " << mPkt_wpending_size << " @ " << getCurrentTS();
+            std::cerr << "pqistreamer::handleoutgoing_locked() Sent Packet len: " << mOutBatchSize << " @ " << rstime::getCurrentTS();
 		    std::cerr << std::endl;
 #endif
 
-		    sentbytes += mPkt_wpending_size;
-            
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    mPkt_wpending_size = 0 ;
+		    mOutBatch.clear();
+		    mOutBatchSize = 0 ;
+		    mOutBatchSent = 0 ;
 
             sent = true;
 	    }
@@ -813,6 +901,16 @@ start_packet_read:
             mFailed_read_attempts = 0 ;
             return 0;
         }
+
+	    // Check for compression probe: the peer can uncompress the packets we send.
+
+	    if(!memcmp(block,pqiPacketCompressor::PROBE_BYTES,8))
+	    {
+            mAcceptsCompression = !DISABLE_PACKET_COMPRESSION;
+            mReading_state = reading_state_initial ;	// restart at state 1.
+            mFailed_read_attempts = 0 ;
+            return 0;
+        }
     }
 continue_packet:
     {
@@ -992,7 +1090,7 @@ continue_packet:
             		pktlen = packet_length ;
 	    }
 	    else
-		    pkt = mRsSerialiser->deserialise(block, &pktlen);
+		    pkt = deserialiseIncoming(block, pktlen, false);
 
 	    if ((pkt != NULL) && (0  < handleincomingitem(pkt,pktlen)))
 	    {
@@ -1057,18 +1155,28 @@ RsItem *pqistreamer::addPartialPacket(const void *block, uint32_t len, uint32_t
 		    std::cerr << " (EE) non starting packet has no record. Dropping" << std::endl;
 		    return NULL ;
 	    }
+	    // The first slice starts with the item header, which tells the size of the whole packet. Allocate it at
+	    // once so that the following slices are copied in place, instead of reallocating the buffer for each of them.
+
+	    uint32_t capacity = slice_length ;
+
+	    if(slice_length >= 8)
+		    capacity = std::max(slice_length, std::min(getRsItemSize(slice_data), getRsPktMaxSize())) ;
+
 	    PartialPacketRecord& rec = mPartialPackets[slice_packet_id] ;
 
-	    rec.mem = rs_malloc(slice_length) ;
+	    rec.mem = rs_malloc(capacity) ;
 
 	    if(!rec.mem)
 	    {
-		    std::cerr << " (EE) Cannot allocate memory for slice of size " << slice_length << std::endl;
+		    std::cerr << " (EE) Cannot allocate memory for slice of size " << capacity << std::endl;
+		    mPartialPackets.erase(slice_packet_id) ;
 		    return NULL ;
 	    }
 
-	    memcpy(rec.mem, slice_data, slice_length) ; ;
+	    memcpy(rec.mem, slice_data, slice_length) ;
 	    rec.size = slice_length ;
+	    rec.capacity = capacity ;
 
 #ifdef DEBUG_PACKET_SLICING
 	    std::cerr << " => stored in new record (size=" << rec.size << std::endl;
@@ -1086,10 +1194,27 @@ RsItem *pqistreamer::addPartialPacket(const void *block, uint32_t len, uint32_t
 		    free(rec.mem);
             		rec.mem = NULL ;
 		    rec.size = 0 ;
+		    rec.capacity = 0 ;
 	    }
 	    // make sure this is a continuing packet, otherwise this is an error.
 
-	    rec.mem = realloc(rec.mem, rec.size + slice_length) ;
+	    if(rec.size + slice_length > rec.capacity)
+	    {
+		    // Only happens if the header of the first slice lied about the packet size. Grow geometrically anyway.
+
+		    uint32_t capacity = std::max(rec.size + slice_length, 2*rec.capacity) ;
+		    void *mem = realloc(rec.mem, capacity) ;
+
+		    if(!mem)
+		    {
+			    std::cerr << " (EE) Cannot allocate memory for partial packet of size " << capacity << std::endl;
+			    free(rec.mem) ;
+			    mPartialPackets.erase(it) ;
+			    return NULL ;
+		    }
+		    rec.mem = mem ;
+		    rec.capacity = capacity ;
+	    }
 	    memcpy( &((char*)rec.mem)[rec.size],slice_data,slice_length) ;
 	    rec.size += slice_length ;
 
@@ -1102,10 +1227,11 @@ RsItem *pqistreamer::addPartialPacket(const void *block, uint32_t len, uint32_t
 #ifdef DEBUG_PACKET_SLICING
 		    std::cerr << " => deserialising: mem=" << RsUtil::BinToHex((char*)rec.mem,std::min(8u,rec.size)) << std::endl;
 #endif
-		    RsItem *item = mRsSerialiser->deserialise(rec.mem, &rec.size);
+		    // deserialise straight from the reassembly buffer, which is handed over to the item when possible
+
+		    RsItem *item = deserialiseIncoming(rec.mem, rec.size, true);
 
 		    total_len = rec.size ;
-		    free(rec.mem) ;
 		    mPartialPackets.erase(it) ;
 		    return item ;
 	    }
@@ -1119,6 +1245,28 @@ RsItem *pqistreamer::addPartialPacket(const void *block, uint32_t len, uint32_t
     }
 }
 
+// Deserialises a complete incoming packet, uncompressing it first when needed. When owned, data was allocated
+// with malloc() and is handed over.
+RsItem *pqistreamer::deserialiseIncoming(void *data, uint32_t& size, bool owned)
+{
+	if(!pqiPacketCompressor::isCompressed(data,size))
+		return owned ? mRsSerialiser->deserialiseOwned(data, &size) : mRsSerialiser->deserialise(data, &size) ;
+
+	uint32_t pkt_size = 0 ;
+	void *pkt = pqiPacketCompressor::uncompress(data,size,pkt_size) ;
+
+	if(owned)
+		free(data) ;
+
+	if(!pkt)
+	{
+		std::cerr << "(EE) pqistreamer: cannot uncompress packet of size " << size << " from peer " << PeerId() << std::endl;
+		return NULL ;
+	}
+
+	return mRsSerialiser->deserialiseOwned(pkt, &pkt_size) ;
+}
+
 /* BandWidth Management Assistance */
 
 float   pqistreamer::outTimeSlice_locked()
@@ -1133,7 +1281,10 @@ float   pqistreamer::outTimeSlice_locked()
 
 int     pqistreamer::outAllowedBytes_locked()
 {
-	double t = getCurrentTS() ; // in sec, with high accuracy
+	double t = rstime::getCurrentTS() ; // in sec, with high accuracy
+
+	mOutAllocated = false ;
+	locked_block_priorities(0) ;
 
 	// allow a lot if not bandwidthLimited()
 	if (!mBio->bandwidthLimited())
@@ -1143,6 +1294,21 @@ int     pqistreamer::outAllowedBytes_locked()
 		return PQISTREAM_ABS_MAX;
 	}
 
+	// when sharing the upload budget, the allocator tells how much we can send, and
+	// which service classes must wait for their buckets to refill.
+	int allowed = 0 ;
+	uint32_t blocked_classes = 0 ;
+
+	if (mBwAllocator && mBwAllocator->outAllowedBytes(PeerId(), t, allowed, blocked_classes))
+	{
+		mOutAllocated = true ;
+		mCurrSent = 0;
+		mCurrSentTS = t;
+		locked_block_priorities(pqiBandwidthAllocator::priorityMask(blocked_classes)) ;
+
+		return (allowed > 0) ? allowed : -1 ;
+	}
+
 	// dt is the time elapsed since the last round of sending data
 	double dt = t - mCurrSentTS;
 
@@ -1178,7 +1344,7 @@ int     pqistreamer::outAllowedBytes_locked()
 
 int     pqistreamer::inAllowedBytes()
 {
-	double t = getCurrentTS(); // in sec, with high accuracy
+	double t = rstime::getCurrentTS(); // in sec, with high accuracy
 
 	// allow a lot if not bandwidthLimited()
 	if (!mBio->bandwidthLimited())
@@ -1308,15 +1474,15 @@ void pqistreamer::free_pend()
 	}
 	mPkt_rpend_size = 0;
 
-	if (mPkt_wpending)
+	if (!mOutBatch.empty())
 	{
 #ifdef DEBUG_PQISTREAMER
-        		std::cerr << "pqistreamer::free_pend(): pending output packet buffer" << std::endl;
+        		std::cerr << "pqistreamer::free_pend(): pending output batch" << std::endl;
 #endif
-		free(mPkt_wpending);
-		mPkt_wpending = NULL;
+		mOutBatch.clear();
 	}
-	mPkt_wpending_size = 0 ;
+	mOutBatchSize = 0 ;
+	mOutBatchSent = 0 ;
 
 #ifdef DEBUG_PQISTREAMER
     if(!mPartialPackets.empty())
@@ -1339,6 +1505,20 @@ int     pqistreamer::gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,std
     return locked_gatherStatistics(outqueue_lst,inqueue_lst);
 }
 
+int     pqistreamer::gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,std::list<RSTrafficClue>& inqueue_lst,std::vector<RsQoSClassStats>& qos_stats)
+{
+    RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+
+    locked_gatherQueueStatistics(qos_stats);
+    return locked_gatherStatistics(outqueue_lst,inqueue_lst);
+}
+
+// this method is overloaded by pqiqosstreamer
+int     pqistreamer::locked_last_out_priority() const
+{
+	return QOS_PRIORITY_DEFAULT ;	// a single queue, with no priorities
+}
+
 // this method is overloaded by pqiqosstreamer
 int     pqistreamer::getQueueSize(bool in)
 {
@@ -1423,28 +1603,25 @@ int pqistreamer::locked_gatherStatistics(std::list<RSTrafficClue>& out_lst,std::
 }
 
 // this method is overloaded by pqiqosstreamer
-void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id)
+bool pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, pqiOutSlice& out, bool &starts, bool &ends, uint32_t &packet_id)
 {
-    size = 0 ;
     starts = true ;
     ends = true ;
     packet_id = 0 ;
     
-	void *res = NULL ;
+	if (mOutPkts.empty())
+		return false ;
 
-	if (!mOutPkts.empty())
-	{
-		res = *(mOutPkts.begin()); 
-		mOutPkts.pop_front();
+	void *res = *(mOutPkts.begin()); 
+	mOutPkts.pop_front();
 
         // In pqistreamer, we do not split outgoing packets. For now only pqiQoSStreamer supports packet slicing.
-        size = getRsItemSize(res);
+	out = pqiOutSlice(res,getRsItemSize(res)) ;
 
 #ifdef DEBUG_TRANSFERS
         std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt " << std::hex << res << std::dec << " from mOutPkts queue";
 		std::cerr << std::endl;
 #endif
-	}
-	return res ;
+	return true ;
 }
 
@@ -29,17 +29,21 @@
 #include <map>                    // for map
 
 #include "pqi/pqi_base.h"         // for BinInterface (ptr only), PQInterface
+#include "pqi/pqicompression.h"   // for pqiPacketCompressor
+#include "pqi/pqioutslice.h"      // for pqiOutSlice
 #include "retroshare/rsconfig.h"  // for RSTrafficClue
 #include "retroshare/rstypes.h"   // for RsPeerId
 #include "util/rsthreads.h"       // for RsMutex
 
 struct RsItem;
 class RsSerialiser;
+class pqiBandwidthAllocator;
 
 struct PartialPacketRecord
 {
 	void *mem ;
 	uint32_t size ;
+	uint32_t capacity ;	// allocated size of mem, the full packet size announced by the first slice
 };
 
 /**
@@ -70,6 +74,7 @@ class pqistreamer: public PQInterface
 		virtual int     getQueueSize(bool in); // extracting data.
 		virtual int     getQueueSize_bytes(bool in); // size of incoming queue in bytes
 		virtual int     gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
+		virtual int     gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats,std::vector<RsQoSClassStats>& qos_stats);
         
             	// mutex protected versions of RateInterface calls.
             	virtual void setRate(bool b,float f) ;
@@ -80,6 +85,12 @@ class pqistreamer: public PQInterface
 		virtual float getMaxRate(bool b) ;
 		virtual float getMaxRate_locked(bool b);
 
+		/**
+		 * Share the upload budget with the other peers through allocator,
+		 * instead of sending up to our own max rate. NULL to stop.
+		 */
+		void setBandwidthAllocator(pqiBandwidthAllocator *allocator) ;
+
 	protected:
        		virtual int reset() ;
 
@@ -87,6 +98,23 @@ class pqistreamer: public PQInterface
 		int tick_send(uint32_t timeout);
 		int tick_recv(uint32_t timeout);
 
+		/// @return true if some data is still waiting to be sent
+		bool hasPendingOutput();
+
+		/**
+		 * @return true if the last call to handleoutgoing_locked() kept a
+		 *	small amount of output queued to let it be packed with the next
+		 *	items, the output must be retried shortly
+		 */
+		bool hasDeferredOutput();
+
+		/**
+		 * Let handleoutgoing_locked() keep small output queued for the next
+		 * items. Only for owners which retry the output when it is deferred,
+		 * otherwise it waits for the next regular tick.
+		 */
+		void setOutputCoalescing(bool enable);
+
 		/* Implementation */
 
 		// These methods are redefined in pqiQoSstreamer
@@ -95,8 +123,11 @@ class pqistreamer: public PQInterface
 		virtual int locked_out_queue_size() const ;
 		virtual void locked_clear_out_queue() ;
 		virtual int locked_compute_out_pkt_size() const ;
-		virtual void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual bool  locked_pop_out_data(uint32_t max_slice_size,pqiOutSlice& out,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual int   locked_last_out_priority() const ;	// QoS priority of the last popped slice
+		virtual void  locked_block_priorities(uint32_t /* mask */) {}	// no priority classes here, nothing to block
 		virtual int   locked_gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
+		virtual void  locked_gatherQueueStatistics(std::vector<RsQoSClassStats>& qos_stats) { qos_stats.clear(); } // no priority classes here
 
         	void updateRates() ;
             	
@@ -131,8 +162,12 @@ class pqistreamer: public PQInterface
 		// RsSerialiser - determines which packets can be serialised.
 		RsSerialiser *mRsSerialiser;
 
-		void *mPkt_wpending; // storage for pending packet to write.
-        	uint32_t mPkt_wpending_size; // ... and its size.
+		std::vector<pqiOutSlice> mOutBatch; // pending slices (and slice headers) to write, packed by the BinInterface.
+		uint32_t mOutBatchSize; // ... their total size.
+		uint32_t mOutBatchSent; // ... and how much of it has already been written.
+		double mOutQueuedSince; // TS when the output queue last became non empty.
+		bool mOutDeferred; // output was kept queued to be coalesced with next items.
+		bool mOutCoalescing; // ... which is allowed, see setOutputCoalescing().
 
 		void allocate_rpend(); // use these two functions to allocate/free the buffer below
         
@@ -170,6 +205,9 @@ class pqistreamer: public PQInterface
 		double mAvgDtIn;	// average time diff between 2 rounds of receiving data
 
 		rstime_t mLastIncomingTs;
+
+		pqiBandwidthAllocator *mBwAllocator;	// shared upload budget, owned by pqihandler
+		bool mOutAllocated;	// last outAllowedBytes_locked() quota came from mBwAllocator
 	
         	// traffic statistics
 
@@ -181,8 +219,12 @@ class pqistreamer: public PQInterface
 
 		bool mAcceptsPacketSlicing ;
 		rstime_t mLastSentPacketSlicingProbe ;
+		bool mAcceptsCompression ; // peer sent the compression probe, so we can send it compressed packets
+		pqiPacketCompressor mCompressor ;
 		void locked_addTrafficClue(const RsItem *pqi, uint32_t pktsize, std::list<RSTrafficClue> &lst);
+		void locked_compressPacket(void *& ptr, uint32_t& size, uint16_t service);
 		RsItem *addPartialPacket(const void *block, uint32_t len, uint32_t slice_packet_id,bool packet_starting,bool packet_ending,uint32_t& total_len);
+		RsItem *deserialiseIncoming(void *data, uint32_t& size, bool owned);
         
 		std::map<uint32_t,PartialPacketRecord> mPartialPackets ;
 };
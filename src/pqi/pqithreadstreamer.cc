@@ -23,6 +23,10 @@
 #include "pqi/pqithreadstreamer.h"
 #include <unistd.h>
 
+#ifdef RS_PQI_REACTOR
+#	include "pqi/pqireactor.h"
+#endif
+
 #define DEFAULT_STREAMER_TIMEOUT	  10000 // 10 ms
 #define DEFAULT_STREAMER_SLEEP		  30000 // 30 ms
 #define DEFAULT_STREAMER_IDLE_SLEEP	1000000 // 1 sec
@@ -31,6 +35,9 @@
 
 pqithreadstreamer::pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
 :pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mThreadMutex("pqithreadstreamer")
+#ifdef RS_PQI_REACTOR
+, mReactor(nullptr)
+#endif
 {
 	mTimeout = DEFAULT_STREAMER_TIMEOUT;
 	mSleepPeriod = DEFAULT_STREAMER_SLEEP;
@@ -41,6 +48,48 @@ bool pqithreadstreamer::RecvItem(RsItem *item)
 	return mParent->RecvItem(item);
 }
 
+int pqithreadstreamer::SendItem(RsItem *item, uint32_t& serialized_size)
+{
+	int ret = pqistreamer::SendItem(item, serialized_size);
+
+#ifdef RS_PQI_REACTOR
+	// wake up the reactor so the item is sent now, not at next timer
+	if(pqiReactor* reactor = mReactor.load()) reactor->notifyOutgoing(this);
+#endif
+
+	return ret;
+}
+
+void pqithreadstreamer::startStreaming(const std::string& name)
+{
+#ifdef RS_PQI_REACTOR
+	pqiReactor* reactor = mReactor.load();
+	if(!reactor)
+	{
+		reactor = pqiReactor::pick();
+		mReactor.store(reactor);
+	}
+	// the reactor ticks again after PQI_REACTOR_DEFER_RETRY when output is deferred
+	setOutputCoalescing(true);
+	reactor->attach(this);
+	(void) name;
+#else
+	start(name);
+#endif
+}
+
+void pqithreadstreamer::stopStreaming(bool wait)
+{
+#ifdef RS_PQI_REACTOR
+	if(pqiReactor* reactor = mReactor.exchange(nullptr))
+		reactor->detach(this, wait);
+	setOutputCoalescing(false);
+#else
+	if(wait) fullstop();
+	else askForStop();
+#endif
+}
+
 int	pqithreadstreamer::tick()
 {
 	// pqithreadstreamer mutex lock is not needed here
@@ -99,3 +148,58 @@ void	pqithreadstreamer::threadTick()
 	}
 }
 
+#ifdef RS_PQI_REACTOR
+int pqithreadstreamer::reactorFd()
+{
+	// mBio never changes, and streamer mutex may be already locked up the stack
+	return mBio->getPollFd();
+}
+
+uint32_t pqithreadstreamer::reactorTick()
+{
+	bool isactive = false;
+	{
+		RsStackMutex stack(mStreamerMtx);
+		isactive = mBio->isactive();
+	}
+
+	// update the connection rates
+	updateRates() ;
+
+	if (!isactive)
+		return pqiReactor::TICK_INACTIVE;
+
+	uint32_t hints = pqiReactor::TICK_IDLE;
+
+	// fill incoming queue with items from SSL
+	{
+		RsStackMutex stack(mThreadMutex);
+		tick_recv(0);
+
+		// either rate limited or data already decrypted in SSL buffers
+		if(mBio->moretoread(0)) hints |= pqiReactor::TICK_RECV_PENDING;
+	}
+
+	// move items to appropriate service queue or shortcut  to fast service
+	RsItem *incoming = NULL;
+	while((incoming = GetItem()))
+	{
+		RecvItem(incoming);
+	}
+
+	// parse the outgoing queue and send items to SSL
+	{
+		RsStackMutex stack(mThreadMutex);
+		tick_send(0);
+
+		if(hasPendingOutput())
+			hints |= mBio->cansend(0) ?
+			            pqiReactor::TICK_SEND_PENDING :
+			            pqiReactor::TICK_SEND_BLOCKED;
+
+		if(hasDeferredOutput()) hints |= pqiReactor::TICK_SEND_DEFERRED;
+	}
+
+	return hints;
+}
+#endif // def RS_PQI_REACTOR
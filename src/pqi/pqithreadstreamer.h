@@ -22,18 +22,48 @@
 #ifndef MRK_PQI_THREAD_STREAMER_HEADER
 #define MRK_PQI_THREAD_STREAMER_HEADER
 
+#include <atomic>
+
 #include "pqi/pqistreamer.h"
 #include "util/rsthreads.h"
 
+class pqiReactor;
+
 class pqithreadstreamer: public pqistreamer, public RsTickingThread
 {
 public:
     pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& peerid, BinInterface *bio_in, int bio_flagsin);
 
     // from pqistreamer
+    using pqistreamer::SendItem;
+    virtual int  SendItem(RsItem *item, uint32_t& serialized_size) override;
     virtual bool RecvItem(RsItem *item) override;
     virtual int  tick() override;
 
+    /**
+     * Start moving data, either in a dedicated thread or, if RS_PQI_REACTOR
+     * is enabled, attached to a shared pqiReactor.
+     */
+    void startStreaming(const std::string& name);
+
+    /**
+     * Stop moving data.
+     * @param[in] wait if true wait until the streamer is fully stopped.
+     */
+    void stopStreaming(bool wait);
+
+#ifdef RS_PQI_REACTOR
+    /**
+     * Called by pqiReactor when the socket is ready, outgoing data has been
+     * queued or a retry timer expired. Does one round of receive/send.
+     * @return pqiReactor::TickHint flags
+     */
+    uint32_t reactorTick();
+
+    /// @return file descriptor pqiReactor should wait on, -1 if none
+    int reactorFd();
+#endif
+
 protected:
 	void threadTick() override; /// @see RsTickingThread
 
@@ -44,6 +74,10 @@ protected:
 private:
     /* thread variables */
     RsMutex mThreadMutex;
+
+#ifdef RS_PQI_REACTOR
+    std::atomic<pqiReactor*> mReactor;
+#endif
 };
 
 #endif //MRK_PQI_THREAD_STREAMER_HEADER
@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: sslcertcache.cc                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <iostream>
+
+#include <openssl/evp.h>
+
+#include "pqi/sslcertcache.h"
+
+//#define DEBUG_SSL_CERT_CACHE 1
+
+SslVerifiedCertCache::SslVerifiedCertCache(size_t maxCerts)
+	: mCertMtx("SslVerifiedCertCache"), mMaxCerts(maxCerts)
+{
+}
+
+bool SslVerifiedCertCache::certHash(const X509* x509, Sha256CheckSum& hash)
+{
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+
+	if( !x509 || !X509_digest(const_cast<X509*>(x509), EVP_sha256(), md, &len) ||
+	    len != Sha256CheckSum::SIZE_IN_BYTES )
+		return false;
+
+	hash = Sha256CheckSum::fromBufferUnsafe(md);
+	return true;
+}
+
+bool SslVerifiedCertCache::get( const X509* x509, const RsPgpFingerprint& fpr,
+                                uint32_t& diagnostic, rstime_t now )
+{
+	Sha256CheckSum hash;
+	if(!certHash(x509, hash))
+		return false;
+
+	RS_STACK_MUTEX(mCertMtx); /********** LOCKED MUTEX **********/
+
+	std::map<Sha256CheckSum, Entry>::iterator it = mCerts.find(hash);
+	if(it == mCerts.end())
+		return false;
+
+	// the issuer key changed since, the result doesn't apply anymore
+	if(it->second.mFpr != fpr)
+	{
+#ifdef DEBUG_SSL_CERT_CACHE
+		std::cerr << "SslVerifiedCertCache::get() key of " << it->second.mIssuer
+		          << " changed, dropping result" << std::endl;
+#endif
+		mCerts.erase(it);
+		return false;
+	}
+
+	it->second.mLastUsed = now;
+	diagnostic = it->second.mDiagnostic;
+	return true;
+}
+
+void SslVerifiedCertCache::store( const X509* x509, const RsPgpId& issuer,
+                                  const RsPgpFingerprint& fpr,
+                                  uint32_t diagnostic, rstime_t now )
+{
+	Sha256CheckSum hash;
+	if(!certHash(x509, hash))
+		return;
+
+	RS_STACK_MUTEX(mCertMtx); /********** LOCKED MUTEX **********/
+
+	if(mCerts.find(hash) == mCerts.end() && mCerts.size() >= mMaxCerts)
+	{
+		std::map<Sha256CheckSum, Entry>::iterator oldest = mCerts.begin();
+		for(std::map<Sha256CheckSum, Entry>::iterator it = mCerts.begin(); it != mCerts.end(); ++it)
+			if(it->second.mLastUsed < oldest->second.mLastUsed)
+				oldest = it;
+
+		mCerts.erase(oldest);
+	}
+
+	Entry& entry = mCerts[hash];
+	entry.mIssuer = issuer;
+	entry.mFpr = fpr;
+	entry.mDiagnostic = diagnostic;
+	entry.mLastUsed = now;
+}
+
+void SslVerifiedCertCache::forgetIssuer(const RsPgpId& issuer)
+{
+	RS_STACK_MUTEX(mCertMtx); /********** LOCKED MUTEX **********/
+
+	for(std::map<Sha256CheckSum, Entry>::iterator it = mCerts.begin(); it != mCerts.end(); )
+		if(it->second.mIssuer == issuer)
+			it = mCerts.erase(it);
+		else
+			++it;
+}
+
+size_t SslVerifiedCertCache::size()
+{
+	RS_STACK_MUTEX(mCertMtx); /********** LOCKED MUTEX **********/
+	return mCerts.size();
+}
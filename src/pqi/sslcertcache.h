@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: sslcertcache.h                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include <openssl/x509.h>
+
+#include "retroshare/rsids.h"
+#include "util/rsthreads.h"      // for RsMutex
+#include "util/rstime.h"
+
+/**
+ * @brief Results of the PGP signature check of SSL certificates.
+ * Checking the PGP signature of a certificate is the costly part of accepting
+ * a connection, and it gives the same result as long as neither the
+ * certificate nor the PGP key change. Results are keyed by the SHA-256 of
+ * the whole certificate, signature included, and remember the fingerprint of
+ * the key that was used: a result only applies if the issuer still has that
+ * key. Results of a key are dropped when it is removed from the keyring.
+ * Only results that depend on the certificate and the key alone are meant to
+ * be stored, not the ones of a missing issuer.
+ * The least recently used result is dropped when the cache is full.
+ * Used by the connection threads through AuthSSL, every method locks.
+ */
+class SslVerifiedCertCache
+{
+public:
+	explicit SslVerifiedCertCache(size_t maxCerts = 1024);
+
+	/**
+	 * @param[in] fpr fingerprint of the current key of the issuer
+	 * @param[out] diagnostic RS_SSL_HANDSHAKE_DIAGNOSTIC_* of the check
+	 * @return true if the result of the check of x509 with that key is known
+	 */
+	bool get( const X509* x509, const RsPgpFingerprint& fpr,
+	          uint32_t& diagnostic, rstime_t now );
+
+	/// Record the result of the check of x509, issued by issuer with key fpr
+	void store( const X509* x509, const RsPgpId& issuer,
+	            const RsPgpFingerprint& fpr, uint32_t diagnostic,
+	            rstime_t now );
+
+	/// Forget the results of all the certificates issued by issuer
+	void forgetIssuer(const RsPgpId& issuer);
+
+	size_t size();
+
+private:
+	class Entry
+	{
+	public:
+		RsPgpId mIssuer;
+		RsPgpFingerprint mFpr;
+		uint32_t mDiagnostic;
+		rstime_t mLastUsed;
+	};
+
+	static bool certHash(const X509* x509, Sha256CheckSum& hash);
+
+	RsMutex mCertMtx; /* MUTEX */
+
+	size_t mMaxCerts;
+	std::map<Sha256CheckSum, Entry> mCerts;
+};
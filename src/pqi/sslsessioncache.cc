@@ -0,0 +1,196 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: sslsessioncache.cc                                   *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <iostream>
+
+#include "pqi/sslsessioncache.h"
+
+//#define DEBUG_SSL_SESSION_CACHE 1
+
+SslSessionCache::SslSessionCache(size_t maxSessions)
+	: mCacheMtx("SslSessionCache"), mMaxSessions(maxSessions)
+{
+}
+
+SslSessionCache::~SslSessionCache()
+{
+	for(auto& it : mSessions)
+		SSL_SESSION_free(it.second);
+}
+
+bool SslSessionCache::expired(const SSL_SESSION* session, rstime_t now)
+{
+	long start = SSL_SESSION_get_time(session);
+	long timeout = SSL_SESSION_get_timeout(session);
+
+	// sessions from the future are as suspicious as old ones
+	return now < start || now >= start + timeout;
+}
+
+void SslSessionCache::locked_store(const RsPeerId& peer, SSL_SESSION* session)
+{
+	std::map<RsPeerId, SSL_SESSION*>::iterator it = mSessions.find(peer);
+
+	if(it != mSessions.end())
+	{
+		SSL_SESSION_free(it->second);
+		it->second = session;
+		return;
+	}
+
+	if(mSessions.size() >= mMaxSessions)
+	{
+		std::map<RsPeerId, SSL_SESSION*>::iterator oldest = mSessions.begin();
+		for(it = mSessions.begin(); it != mSessions.end(); ++it)
+			if(SSL_SESSION_get_time(it->second) < SSL_SESSION_get_time(oldest->second))
+				oldest = it;
+
+		SSL_SESSION_free(oldest->second);
+		mSessions.erase(oldest);
+	}
+
+	mSessions[peer] = session;
+}
+
+void SslSessionCache::store(const RsPeerId& peer, SSL_SESSION* session)
+{
+	if(peer.isNull() || !session)
+		return;
+
+	/* OpenSSL marks the session of a connection not closed cleanly as not
+	 * resumable, which is how most of them end when the network drops. Keep
+	 * our own copy so the ticket can still be used. */
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	session = SSL_SESSION_dup(session);
+	if(!session)
+		return;
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+	CRYPTO_add(&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#else
+	SSL_SESSION_up_ref(session);
+#endif
+
+#ifdef DEBUG_SSL_SESSION_CACHE
+	std::cerr << "SslSessionCache::store() session for peer " << peer << std::endl;
+#endif
+
+	RS_STACK_MUTEX(mCacheMtx); /********** LOCKED MUTEX **********/
+	locked_store(peer, session);
+}
+
+SSL_SESSION* SslSessionCache::get(const RsPeerId& peer, rstime_t now)
+{
+	RS_STACK_MUTEX(mCacheMtx); /********** LOCKED MUTEX **********/
+
+	std::map<RsPeerId, SSL_SESSION*>::iterator it = mSessions.find(peer);
+	if(it == mSessions.end())
+		return nullptr;
+
+	if(expired(it->second, now))
+	{
+#ifdef DEBUG_SSL_SESSION_CACHE
+		std::cerr << "SslSessionCache::get() session for peer " << peer
+		          << " expired" << std::endl;
+#endif
+		SSL_SESSION_free(it->second);
+		mSessions.erase(it);
+		return nullptr;
+	}
+
+	// a copy again, the connection may spoil the one it is given
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	return SSL_SESSION_dup(it->second);
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
+	CRYPTO_add(&it->second->references, 1, CRYPTO_LOCK_SSL_SESSION);
+	return it->second;
+#else
+	SSL_SESSION_up_ref(it->second);
+	return it->second;
+#endif
+}
+
+void SslSessionCache::remove(const RsPeerId& peer)
+{
+	RS_STACK_MUTEX(mCacheMtx); /********** LOCKED MUTEX **********/
+
+	std::map<RsPeerId, SSL_SESSION*>::iterator it = mSessions.find(peer);
+	if(it == mSessions.end())
+		return;
+
+	SSL_SESSION_free(it->second);
+	mSessions.erase(it);
+}
+
+size_t SslSessionCache::size()
+{
+	RS_STACK_MUTEX(mCacheMtx); /********** LOCKED MUTEX **********/
+	return mSessions.size();
+}
+
+void SslSessionCache::exportSessions(
+        std::map<RsPeerId, std::vector<uint8_t> >& sessions, rstime_t now )
+{
+	RS_STACK_MUTEX(mCacheMtx); /********** LOCKED MUTEX **********/
+
+	for(auto& it : mSessions)
+	{
+		if(expired(it.second, now))
+			continue;
+
+		int len = i2d_SSL_SESSION(it.second, nullptr);
+		if(len <= 0)
+			continue;
+
+		std::vector<uint8_t>& der = sessions[it.first];
+		der.resize(len);
+		unsigned char* p = der.data();
+		i2d_SSL_SESSION(it.second, &p);
+	}
+}
+
+void SslSessionCache::importSessions(
+        const std::map<RsPeerId, std::vector<uint8_t> >& sessions,
+        rstime_t now )
+{
+	RS_STACK_MUTEX(mCacheMtx); /********** LOCKED MUTEX **********/
+
+	for(auto& it : sessions)
+	{
+		const unsigned char* p = it.second.data();
+		SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &p, it.second.size());
+
+		if(!session)
+		{
+			std::cerr << "SslSessionCache::importSessions() cannot decode "
+			          << "session of peer " << it.first << std::endl;
+			continue;
+		}
+
+		if(expired(session, now))
+		{
+			SSL_SESSION_free(session);
+			continue;
+		}
+
+		locked_store(it.first, session);
+	}
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: sslsessioncache.h                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include "retroshare/rstypes.h"  // for RsPeerId
+#include "util/rsthreads.h"      // for RsMutex
+#include "util/rstime.h"
+
+/// Lifetime of the sessions we issue and keep, in seconds
+static const long RS_SSL_SESSION_LIFETIME = 7200;
+
+/**
+ * @brief Client side TLS sessions of our peers, for resumption.
+ * One session is kept per peer, the last one received: a TLS 1.3 ticket or a
+ * TLS 1.2 session. Offering it when connecting again to that peer saves the
+ * certificate exchange and signatures and, more costly, the PGP signature
+ * check of its certificate.
+ * Sessions are only stored after a full handshake or a resumption, both
+ * having authenticated the peer, keyed by the SSL id of the certificate they
+ * carry. The cache doesn't check that itself: AuthSSL does when storing, and
+ * again when a session was resumed. Expired sessions are dropped when looked
+ * up or exported.
+ * Used by the connection threads through AuthSSL, every method locks.
+ */
+class SslSessionCache
+{
+public:
+	explicit SslSessionCache(size_t maxSessions = 1024);
+	~SslSessionCache();
+
+	/**
+	 * Keep a copy of the session, replacing the previous one of the peer.
+	 * The oldest session is dropped when the cache is full.
+	 */
+	void store(const RsPeerId& peer, SSL_SESSION* session);
+
+	/// @return a copy of the valid session of peer to be freed, or nullptr
+	SSL_SESSION* get(const RsPeerId& peer, rstime_t now);
+
+	/// Forget the session of peer, i.e. when resuming it failed
+	void remove(const RsPeerId& peer);
+
+	size_t size();
+
+	/// DER encoding of the valid sessions, to be saved
+	void exportSessions(std::map<RsPeerId, std::vector<uint8_t> >& sessions,
+	                    rstime_t now);
+
+	/// Load sessions saved by exportSessions, skipping expired ones
+	void importSessions(
+	        const std::map<RsPeerId, std::vector<uint8_t> >& sessions,
+	        rstime_t now );
+
+private:
+	static bool expired(const SSL_SESSION* session, rstime_t now);
+	void locked_store(const RsPeerId& peer, SSL_SESSION* session);
+
+	RsMutex mCacheMtx; /* MUTEX */
+
+	size_t mMaxSessions;
+	std::map<RsPeerId, SSL_SESSION*> mSessions;
+};
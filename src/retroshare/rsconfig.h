@@ -212,6 +212,33 @@ struct RSTrafficClue : RsSerializable
 	}
 };
 
+/// Outgoing queue statistics of one QoS priority class of a peer
+struct RsQoSClassStats : RsSerializable
+{
+	uint8_t  priority ;
+	uint32_t quantum ;       /// bytes the class may send per scheduling round
+	uint32_t backlogItems ;  /// items waiting to be sent
+	uint32_t backlogBytes ;  /// bytes waiting to be sent
+	uint32_t sentItems ;     /// items that started to be sent since last gathering
+	float    meanDelay ;     /// moving average of queuing delay, in seconds
+	float    maxDelay ;      /// max queuing delay since last gathering, in seconds
+
+	RsQoSClassStats() :
+	    priority(0), quantum(0), backlogItems(0), backlogBytes(0),
+	    sentItems(0), meanDelay(0), maxDelay(0) {}
+
+	// RsSerializable interface
+	void serial_process(RsGenericSerializer::SerializeJob j, RsGenericSerializer::SerializeContext &ctx) {
+		RS_SERIAL_PROCESS(priority);
+		RS_SERIAL_PROCESS(quantum);
+		RS_SERIAL_PROCESS(backlogItems);
+		RS_SERIAL_PROCESS(backlogBytes);
+		RS_SERIAL_PROCESS(sentItems);
+		RS_SERIAL_PROCESS(meanDelay);
+		RS_SERIAL_PROCESS(maxDelay);
+	}
+};
+
 struct RsConfigNetStatus : RsSerializable
 {
 	RsConfigNetStatus() : netLocalOk(true)
@@ -338,6 +365,15 @@ public:
 	 */
     virtual int getTrafficInfo(std::list<RSTrafficClue>& out_lst,std::list<RSTrafficClue>& in_lst) = 0 ;
 
+	/**
+	 * @brief getQueueStatistics returns the outgoing queue statistics of each
+	 *	QoS priority class, for all peers
+	 * @jsonapi{development}
+	 * @param[out] qos_stats map with peers->per class statistics
+	 * @return returns 1 on succes and 0 otherwise
+	 */
+	virtual int getQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats) = 0 ;
+
     /* From RsInit */
 
     // NOT IMPLEMENTED YET!
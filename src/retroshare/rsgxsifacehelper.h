@@ -261,6 +261,54 @@ public:
 	void setSyncPeriod(const RsGxsGroupId& groupId, uint32_t syncAge)
 	{ mGxs.setSyncPeriod(groupId, syncAge); }
 
+	/*!
+	 * @brief Get the meta data of the messages of a group one page at a time,
+	 * without loading the whole group. Blocking API.
+	 * @jsonapi{development}
+	 * @param[in] groupId Id of the group
+	 * @param[in] pageSize maximum number of messages of the page
+	 * @param[in] order order of the messages
+	 * @param[in] after next returned with the previous page, empty for the
+	 *	first page
+	 * @param[out] msgsMeta meta data of the messages of the page
+	 * @param[out] next to get the next page, empty after the last page
+	 * @return false if something failed, true otherwhise
+	 */
+	bool getMsgMetaPage( const RsGxsGroupId& groupId, uint32_t pageSize,
+	                     RsGxsMsgPageOrder order, const RsGxsMsgPageCursor& after,
+	                     std::vector<RsMsgMetaData>& msgsMeta,
+	                     RsGxsMsgPageCursor& next )
+	{
+		next = RsGxsMsgPageCursor();
+		msgsMeta.clear();
+
+		RsTokReqOptions opts;
+		opts.mReqType = GXS_REQUEST_TYPE_MSG_META;
+		opts.mPageSize = pageSize;
+		opts.mPageOrder = order;
+		opts.mPageAfter = after;
+
+		uint32_t token;
+		GxsMsgMetaMap result;
+
+		if( !pageSize ||
+		    !requestMsgInfo(token, opts, std::list<RsGxsGroupId>({groupId})) ||
+		    waitToken(token) != RsTokenService::COMPLETE ||
+		    !getMsgSummary(token, result) )
+			return false;
+
+		msgsMeta.swap(result[groupId]);
+
+		// a short page is the last one
+		if(msgsMeta.size() == pageSize)
+		{
+			next.mMsgId = msgsMeta.back().mMsgId;
+			next.mPublishTs = msgsMeta.back().mPublishTs;
+		}
+
+		return true;
+	}
+
 	/*!
 	 * This determines the reputation threshold messages need to surpass in order
 	 * for it to be accepted by local user from remote source
@@ -51,6 +51,37 @@ enum class GxsRequestPriority {
     VERY_LOW       =  0x04,
 };
 
+/// Order of the messages of a group read page by page
+enum class RsGxsMsgPageOrder : uint8_t
+{
+	MSG_ID          = 0x00, /// cheapest
+	PUBLISH_TS      = 0x01, /// oldest first
+	PUBLISH_TS_DESC = 0x02  /// newest first
+};
+
+/**
+ * Position in the messages of a group, after the last message of a page.
+ * Pages start after a message rather than at an offset, so messages received
+ * meanwhile don't shift the next pages.
+ */
+struct RsGxsMsgPageCursor : RsSerializable
+{
+	RsGxsMsgPageCursor() : mPublishTs(0) {}
+
+	RsGxsMessageId mMsgId; /// null before the first page and after the last
+	rstime_t mPublishTs;
+
+	bool isNull() const { return mMsgId.isNull(); }
+
+	/// @see RsSerializable
+	virtual void serial_process( RsGenericSerializer::SerializeJob j,
+	                             RsGenericSerializer::SerializeContext& ctx )
+	{
+		RS_SERIAL_PROCESS(mMsgId);
+		RS_SERIAL_PROCESS(mPublishTs);
+	}
+};
+
 class RsGxsGrpMetaData;
 class RsGxsMsgMetaData;
 
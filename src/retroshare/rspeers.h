@@ -473,6 +473,10 @@ struct RsPeerCryptoParams
 {
 	int connexion_state;
 	std::string cipher_name;
+
+	/// Record encryption/decryption done by the kernel (kTLS)
+	bool kernel_tls_send = false;
+	bool kernel_tls_recv = false;
 };
 
 struct RsGroupInfo : RsSerializable
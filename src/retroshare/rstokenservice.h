@@ -80,7 +80,8 @@ struct RsTokReqOptions
 {
 	RsTokReqOptions() : mOptions(0), mStatusFilter(0), mStatusMask(0),
 	    mMsgFlagMask(0), mMsgFlagFilter(0), mReqType(0), mSubscribeFilter(0),
-	    mSubscribeMask(0), mBefore(0), mAfter(0),mPriority(GxsRequestPriority::NORMAL) {}
+	    mSubscribeMask(0), mBefore(0), mAfter(0),mPriority(GxsRequestPriority::NORMAL),
+	    mPageSize(0), mPageOrder(RsGxsMsgPageOrder::MSG_ID) {}
 
 	/**
 	 * Can be one or multiple RS_TOKREQOPT_*
@@ -109,6 +110,17 @@ struct RsTokReqOptions
 	rstime_t   mAfter;
 
     GxsRequestPriority mPriority;
+
+	/* Paging of the messages of whole groups, for MSG_META, MSG_DATA and
+	 * MSG_IDS requests: at most mPageSize messages of each group, in
+	 * mPageOrder, after mPageAfter. The database is read one page at a time
+	 * instead of whole groups. The RS_TOKREQOPT_MSG_* filters, which need the
+	 * whole group, are not applied to pages. 0 for no paging.
+	 * mPageAfter is a position in one group: requests with a cursor must ask
+	 * for a single whole group, or they fail. */
+	uint32_t mPageSize;
+	RsGxsMsgPageOrder mPageOrder;
+	RsGxsMsgPageCursor mPageAfter;
 };
 
 /*!
@@ -120,11 +120,25 @@ class RsRawItem: public RsItem
 public:
 	RsRawItem(uint32_t t, uint32_t size) : RsItem(t), len(size)
 	{ data = rs_malloc(len); }
+
+	/** Take ownership of already serialised data, which must have been
+	 * allocated with malloc and hold at least size bytes */
+	RsRawItem(uint32_t t, uint32_t size, void* serialised) :
+	    RsItem(t), data(serialised), len(size) {}
 	virtual ~RsRawItem() { free(data); }
 
 	uint32_t getRawLength() { return len; }
 	void * getRawData() { return data; }
 
+	/** Give up ownership of the serialised data, leaving the item empty.
+	 * @return data allocated with rs_malloc, to be released with free() */
+	void * releaseRawData()
+	{
+		void* ret = data;
+		data = nullptr; len = 0;
+		return ret;
+	}
+
 //	virtual void clear() override {}
 	virtual std::ostream &print(std::ostream &out, uint16_t indent = 0);
 
@@ -29,6 +29,10 @@
 #include "plugins/pluginmanager.h"
 #include "util/rsdebug.h"
 
+#ifdef RS_PQI_REACTOR
+#	include "pqi/pqireactor.h"
+#endif
+
 #ifdef RS_JSONAPI
 #	include "jsonapi/jsonapi.h"
 #endif // ifdef RS_JSONAPI
@@ -103,6 +107,10 @@ void RsServer::rsGlobalShutDown()
 
 	fullstop();
 
+#ifdef RS_PQI_REACTOR
+	pqiReactor::stopAll();
+#endif
+
 #ifdef RS_JSONAPI
 	rsJsonApi->fullstop();
 #endif
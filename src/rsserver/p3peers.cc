@@ -802,7 +802,13 @@ bool p3Peers::addSslOnlyFriend( const RsPeerId& sslId, const RsPgpId& pgp_id,con
 
 bool 	p3Peers::removeKeysFromPGPKeyring(const std::set<RsPgpId>& pgp_ids,std::string& backup_file,uint32_t& error_code)
 {
-    return AuthPGP::removeKeysFromPGPKeyring(pgp_ids,backup_file,error_code) ;
+    if(!AuthPGP::removeKeysFromPGPKeyring(pgp_ids,backup_file,error_code))
+        return false ;
+
+    for(const RsPgpId& id : pgp_ids)
+        AuthSSL::instance().forgetVerifiedCerts(id) ;
+
+    return true ;
 }
 
 bool 	p3Peers::removeFriendLocation(const RsPeerId &sslId)
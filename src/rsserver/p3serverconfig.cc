@@ -184,6 +184,14 @@ int p3ServerConfig::getTrafficInfo(std::list<RSTrafficClue>& out_lst,std::list<R
         return 0 ;
 }
 
+int p3ServerConfig::getQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats)
+{
+    if (rsBandwidthControl)
+        return rsBandwidthControl->ExtractQueueStatistics(qos_stats);
+    else
+        return 0 ;
+}
+
 int 	p3ServerConfig::getTotalBandwidthRates(RsConfigDataRates &rates)
 {
 	if (rsBandwidthControl)
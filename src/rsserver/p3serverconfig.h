@@ -49,6 +49,7 @@ class p3ServerConfig: public RsServerConfig
 	virtual int getTotalBandwidthRates(RsConfigDataRates &rates) override;
 	virtual int getAllBandwidthRates(std::map<RsPeerId, RsConfigDataRates> &ratemap) override;
 	virtual int getTrafficInfo(std::list<RSTrafficClue>& out_lst, std::list<RSTrafficClue> &in_lst) override;
+	virtual int getQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats) override;
 
 	/* From RsInit */
 
@@ -23,6 +23,8 @@
  *******************************************************************************/
 
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <iostream>
@@ -33,6 +35,7 @@
 #include "util/rsthreads.h"
 #include "util/rsstring.h"
 #include "util/rsprint.h"
+#include "util/rsdebug.h"
 #include "rsitems/rsitem.h"
 #include "rsitems/itempriorities.h"
 
@@ -240,6 +243,66 @@ RsItem *    RsSerialType::deserialise(void */*data*/, uint32_t */*size*/)
 	return NULL;
 }
 
+const uint8_t* RsSerialType::serialiseScratch(RsItem* item, uint32_t& size)
+{
+	size = this->size(item);
+	if(!size) return nullptr;
+
+	uint32_t capacity = 0;
+	uint8_t* data = scratchBuffer(size, capacity);
+	if(!data || !serialise(item, data, &size)) return nullptr;
+
+	return data;
+}
+
+RsItem* RsSerialType::deserialiseOwned(void* data, uint32_t* size)
+{
+	RsItem* item = deserialise(data, size);
+	free(data);
+	return item;
+}
+
+namespace
+{
+/* Memory is obtained with malloc and never initialised, so a thread which
+ * only serialises small items only commits the few pages it actually writes */
+struct RsSerialScratch
+{
+	RsSerialScratch() : mData(nullptr), mCapacity(0) {}
+	~RsSerialScratch() { free(mData); }
+
+	uint8_t* mData;
+	uint32_t mCapacity;
+};
+
+thread_local RsSerialScratch sSerialScratch;
+}
+
+/*static*/ uint8_t* RsSerialType::scratchBuffer(
+        uint32_t minSize, uint32_t& capacity )
+{
+	/* Make room for the biggest packet allowed on the wire at once, so
+	 * serialising outgoing items never needs to grow the buffer */
+	minSize = std::max(minSize, getRsPktMaxSize());
+
+	if(sSerialScratch.mCapacity < minSize)
+	{
+		void* mem = realloc(sSerialScratch.mData, minSize);
+		if(!mem)
+		{
+			RS_ERR("Failure allocating ", minSize, " bytes scratch buffer");
+			capacity = 0;
+			return nullptr;
+		}
+
+		sSerialScratch.mData = static_cast<uint8_t*>(mem);
+		sSerialScratch.mCapacity = minSize;
+	}
+
+	capacity = sSerialScratch.mCapacity;
+	return sSerialScratch.mData;
+}
+
 uint32_t    RsSerialType::PacketId() const
 {
 	return type;
@@ -367,6 +430,55 @@ bool        RsSerialiser::serialise  (RsItem *item, void *data, uint32_t *size)
 
 
 
+RsSerialType* RsSerialiser::serialTypeFor(uint32_t packetId)
+{
+	/* same lookup as size() and serialise(), most specific type first */
+	uint32_t type = (packetId & 0xFFFFFF00);
+	for(uint32_t mask : { 0xFFFFFF00, 0xFFFF0000, 0xFF000000 })
+	{
+		auto it = serialisers.find(type & mask);
+		if(it != serialisers.end()) return it->second;
+	}
+	return nullptr;
+}
+
+const uint8_t* RsSerialiser::serialiseScratch(RsItem* item, uint32_t& size)
+{
+	size = 0;
+
+	RsSerialType* st = serialTypeFor(item->PacketId());
+	if(!st)
+	{
+#ifdef  RSSERIAL_ERROR_DEBUG
+		RS_ERR("serialiser missing for PacketId: ", item->PacketId());
+#endif
+		return nullptr;
+	}
+
+	return st->serialiseScratch(item, size);
+}
+
+RsItem* RsSerialiser::deserialiseOwned(void* data, uint32_t* size)
+{
+	/* same checks as deserialise() */
+	if( *size < 8 || getRsItemSize(data) > *size
+	        || getRsItemSize(data) > getRsPktMaxSize() )
+	{
+		free(data);
+		return nullptr;
+	}
+
+	RsSerialType* st = serialTypeFor(getRsItemId(data));
+	if(!st)
+	{
+		free(data);
+		return nullptr;
+	}
+
+	*size = getRsItemSize(data);
+	return st->deserialiseOwned(data, size);
+}
+
 RsItem *    RsSerialiser::deserialise(void *data, uint32_t *size)
 {
 	/* find the type */
@@ -78,9 +78,16 @@ public:
 	uint32_t    size(RsItem *);
 	bool        serialise  (RsItem *item, void *data, uint32_t *size);
 	RsItem *    deserialise(void *data, uint32_t *size);
-	
+
+	/// @see RsSerialType::serialiseScratch
+	const uint8_t* serialiseScratch(RsItem* item, uint32_t& size);
+
+	/// @see RsSerialType::deserialiseOwned
+	RsItem*     deserialiseOwned(void* data, uint32_t* size);
 	
 private:
+	RsSerialType* serialTypeFor(uint32_t packetId);
+
 	std::map<uint32_t, RsSerialType *> serialisers;
 };
 
@@ -162,6 +162,60 @@ bool RsGenericSerializer::serialise(RsItem* item, void* data, uint32_t* size)
 	return true;
 }
 
+const uint8_t* RsGenericSerializer::serialiseScratch(
+        RsItem* item, uint32_t& size )
+{
+	size = 0;
+
+	const uint32_t headerSize =
+	        !!(mFlags & RsSerializationFlags::SKIP_HEADER) ? 0 : 8;
+
+	uint32_t capacity = 0;
+	uint8_t* data = scratchBuffer(0, capacity);
+	if(!data) return nullptr;
+
+	const auto serialisePass = [&](uint32_t available)
+	{
+		SerializeContext ctx(data, available, mFlags);
+		ctx.mOffset = headerSize;
+		item->serial_process(RsGenericSerializer::SERIALIZE, ctx);
+		return ctx.mOk ? ctx.mOffset : 0;
+	};
+
+	uint32_t tlvsize = serialisePass(capacity);
+
+	if(!tlvsize)
+	{
+		/* Either the item doesn't fit in the scratch buffer or it cannot be
+		 * serialised at all, only the size estimate can tell */
+		uint32_t estimated = this->size(item);
+		if(estimated <= capacity)
+		{
+			RS_ERR("Failure serialising item: ", typeid(*item).name());
+			print_stacktrace();
+			return nullptr;
+		}
+
+		data = scratchBuffer(estimated, capacity);
+		if(!data) return nullptr;
+
+		tlvsize = serialisePass(estimated);
+		if(tlvsize != estimated)
+		{
+			RS_ERR( "Serialised size: ", tlvsize, " doesn't match estimated "
+			        "size: ", estimated, " for item: ", typeid(*item).name() );
+			print_stacktrace();
+			return nullptr;
+		}
+	}
+
+	if(headerSize && !setRsItemHeader(data, tlvsize, item->PacketId(), tlvsize))
+		return nullptr;
+
+	size = tlvsize;
+	return data;
+}
+
 uint32_t RsGenericSerializer::size(RsItem *item)
 {
 	SerializeContext ctx(nullptr, 0, mFlags);
@@ -256,6 +310,23 @@ RsItem *RsRawSerialiser::deserialise(void *data, uint32_t *pktsize)
 	return item;
 }
 
+RsItem *RsRawSerialiser::deserialiseOwned(void *data, uint32_t *pktsize)
+{
+	/* same checks as deserialise() */
+	uint32_t rstype = getRsItemId(data);
+	uint32_t rssize = getRsItemSize(data);
+
+	if ( RS_PKT_VERSION_SERVICE != getRsItemVersion(rstype)
+	     || *pktsize < rssize || rssize > getRsPktMaxSize() )
+	{
+		free(data);
+		return NULL;
+	}
+
+	*pktsize = rssize;
+	return new RsRawItem(rstype, rssize, data);
+}
+
 
 RsGenericSerializer::SerializeContext::SerializeContext(
         uint8_t* data, uint32_t size, RsSerializationFlags flags,
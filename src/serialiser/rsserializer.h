@@ -174,7 +174,42 @@ public:
 	virtual	bool        serialise  (RsItem *item, void *data, uint32_t *size)=0;
 	virtual	RsItem *    deserialise(void *data, uint32_t *size)=0;
 
+	/**
+	 * @brief Serialise item into a per thread scratch buffer.
+	 * The buffer is reused by following calls from the same thread, which
+	 * spares the allocation and release of a buffer for each item on hot
+	 * paths which just copy or encrypt the serialised data right away.
+	 * The default implementation computes the size and then serialises,
+	 * RsGenericSerializer overrides it to serialise in a single pass.
+	 * @param[in] item item to serialise
+	 * @param[out] size serialised size of the item
+	 * @return pointer to the serialised data, nullptr on failure. The memory
+	 *	belongs to the calling thread and is valid only until the next call
+	 *	to serialiseScratch() from the same thread.
+	 */
+	virtual const uint8_t* serialiseScratch(RsItem* item, uint32_t& size);
+
+	/**
+	 * @brief Deserialise data allocated with malloc, taking ownership of it.
+	 * Serialisers whose items can keep the serialised buffer as is take it
+	 * over instead of copying it, the default implementation deserialises
+	 * the usual way and frees the buffer.
+	 * @param[in] data serialised packet, always released by this method
+	 * @param[inout] size size of data, set to the consumed size on return
+	 * @return the deserialised item, nullptr on failure
+	 */
+	virtual RsItem* deserialiseOwned(void* data, uint32_t* size);
+
 	uint32_t    PacketId() const;
+
+protected:
+	/**
+	 * @return per thread scratch buffer of at least minSize bytes, nullptr if
+	 *	it cannot be allocated
+	 * @param[out] capacity actual size of the returned buffer
+	 */
+	static uint8_t* scratchBuffer(uint32_t minSize, uint32_t& capacity);
+
 private:
 	uint32_t type;
 };
@@ -190,6 +225,9 @@ class RsRawSerialiser: public RsSerialType
 		virtual	uint32_t    size(RsItem *);
 		virtual	bool        serialise  (RsItem *item, void *data, uint32_t *size);
 		virtual	RsItem *    deserialise(void *data, uint32_t *size);
+
+		/// Raw items keep the received buffer instead of a copy of it
+		virtual RsItem *    deserialiseOwned(void *data, uint32_t *size) override;
 };
 
 /** These are convenience flags to be used by the items when processing the
@@ -264,6 +302,13 @@ struct RsGenericSerializer : RsSerialType
 	uint32_t size(RsItem *item);
 	void print(RsItem *item);
 
+	/**
+	 * Serialise item walking it only once, the size estimate pass is done
+	 * only if the item doesn't fit into the scratch buffer.
+	 * @see RsSerialType::serialiseScratch
+	 */
+	const uint8_t* serialiseScratch(RsItem* item, uint32_t& size) override;
+
 protected:
 	RsGenericSerializer(
 	        uint8_t serial_class, uint8_t serial_type,
@@ -33,6 +33,8 @@
 #include "rsitems/rsconfigitems.h"
 
 #include <sys/time.h>
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 /****
@@ -86,12 +88,26 @@ RsServiceInfo p3BanList::getServiceInfo()
 
 bool p3BanList::ipFilteringEnabled() { return mIPFilteringEnabled ; }
 void p3BanList::enableIPFiltering(bool b) { mIPFilteringEnabled = b ; }
-void p3BanList::enableIPsFromFriends(bool b) { mIPFriendGatheringEnabled = b; mLastDhtInfoRequest=0;}
-void p3BanList::enableIPsFromDHT(bool b)
+void p3BanList::enableIPsFromFriends(bool b)
 {
-    mIPDHTGatheringEnabled = b;
+    RS_STACK_MUTEX(mBanMtx) ;
+
+    mIPFriendGatheringEnabled = b;
     mLastDhtInfoRequest=0;
 
+    updateFilters_locked();
+}
+void p3BanList::enableIPsFromDHT(bool b)
+{
+    {
+        RS_STACK_MUTEX(mBanMtx) ;
+
+        mIPDHTGatheringEnabled = b;
+        mLastDhtInfoRequest=0;
+
+        updateFilters_locked();
+    }
+
     IndicateConfigChanged();
 }
 void p3BanList::enableAutoRange(bool b)
@@ -214,7 +230,11 @@ void p3BanList::autoFigureOutBanRanges()
 
     IndicateConfigChanged();
 
-	if(!mAutoRangeIps) return;
+	if(!mAutoRangeIps)
+	{
+		updateFilters_locked();
+		return;
+	}
 
 #ifdef DEBUG_BANLIST
     std::cerr << "Automatically figuring out IP ranges from banned IPs." << std::endl;
@@ -318,28 +338,18 @@ bool p3BanList::isAddressAccepted(
 	if(!sockaddr_storage_ipv6_to_ipv4(addr)) return true;
 	if(sockaddr_storage_isLoopbackNet(addr)) return true;
 
-
-	RS_STACK_MUTEX(mBanMtx);
-
 	if(!mIPFilteringEnabled) return true;
 
 #ifdef DEBUG_BANLIST
     std::cerr << "isAddressAccepted(): tested addr=" << sockaddr_storage_iptostring(addr) << ", checking flags=" << checking_flags ;
 #endif
 
-    // we should normally work this including entire ranges of IPs. For now, just check the exact IPs.
-
-    sockaddr_storage addr_32 = makeBitsRange(addr,0) ;	// this is necessay because it cleans the address
-    sockaddr_storage addr_24 = makeBitsRange(addr,1) ;
-    sockaddr_storage addr_16 = makeBitsRange(addr,2) ;
-
-    bool white_list_found = false ;
-
-    white_list_found = white_list_found || (mWhiteListedRanges.find(addr_16) != mWhiteListedRanges.end()) ;
-    white_list_found = white_list_found || (mWhiteListedRanges.find(addr_24) != mWhiteListedRanges.end()) ;
-    white_list_found = white_list_found || (mWhiteListedRanges.find(addr_32) != mWhiteListedRanges.end()) ;
+	/* Whitelist and blacklist are checked against lock free tries, mBanMtx is
+	 * only taken to account the connection attempt of banned addresses. */
+	RsIpPrefix ip;
+	if(!RsIpPrefix::fromSockaddr(addr, 32, ip)) return true;
 
-    if(white_list_found)
+	if(mWhiteListFilter.lookup(ip))
 	{
 		check_result = RSBANLIST_CHECK_RESULT_ACCEPTED;
 #ifdef DEBUG_BANLIST
@@ -366,48 +376,20 @@ bool p3BanList::isAddressAccepted(
         return true;
     }
 
-    std::map<sockaddr_storage,BanListPeer>::iterator it ;
+    // The shortest matching prefix is found first, so wider ranges win as
+    // they did when /16, /24 and /32 were probed in this order.
+    RsIpPrefix matched;
+    uint32_t sources = mBlackListFilter.lookup(ip, &matched);
 
-    if(((it=mBanRanges.find(addr_16)) != mBanRanges.end()) && acceptedBanRanges_locked(it->second))
+    if(sources)
     {
-        ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << " found in blacklisted range " << sockaddr_storage_iptostring(it->first) << "/16. returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
-	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
-      return false ;
-  }
-
-  if(((it=mBanRanges.find(addr_24)) != mBanRanges.end()) && acceptedBanRanges_locked(it->second))
-  {
-      ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << " found in blacklisted range " << sockaddr_storage_iptostring(it->first) << "/24.  returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
-	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
-      return false ;
-  }
+        RS_STACK_MUTEX(mBanMtx);
+        countConnectAttempt_locked(matched, sources);
 
-  if(((it=mBanRanges.find(addr_32)) != mBanRanges.end()) && acceptedBanRanges_locked(it->second))
-  {
-      ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << " found in blacklisted range " << sockaddr_storage_iptostring(it->first) << "/32.  returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
 	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
         return false ;
     }
 
-    if((it=mBanSet.find(addr_32)) != mBanSet.end() && acceptedBanSet_locked(it->second))
-    {
-        ++it->second.connect_attempts;
-#ifdef DEBUG_BANLIST
-      std::cerr << "found as blacklisted address " << sockaddr_storage_iptostring(it->first) << ".  returning false. attempts=" << it->second.connect_attempts << std::endl;
-#endif
-	    check_result = RSBANLIST_CHECK_RESULT_BLACKLISTED;
-      return false ;
-  }
-
 #ifdef DEBUG_BANLIST
   std::cerr << " not blacklisted. Accepting." << std::endl;
 #endif
@@ -562,6 +544,12 @@ int p3BanList::tick()
     processIncoming();
     sendPackets();
 
+    {
+        RS_STACK_MUTEX(mBanMtx) ;
+        mWhiteListFilter.reclaim();
+        mBlackListFilter.reclaim();
+    }
+
     rstime_t now = time(NULL) ;
 
     if(mLastDhtInfoRequest + RSBANLIST_DELAY_BETWEEN_TALK_TO_DHT < now)
@@ -906,6 +894,7 @@ bool p3BanList::loadList(std::list<RsItem*>& load)
     }
 
     load.clear() ;
+    updateFilters_locked();
     return true ;
 }
 
@@ -1139,9 +1128,111 @@ int p3BanList::condenseBanSources_locked()
 	printBanSet_locked(std::cerr);
 #endif
 
+	updateFilters_locked();
 	return true ;
 }
 
+/* Values stored in mBlackListFilter, telling which map holds the entry */
+static const uint32_t BANLIST_FILTER_RANGE = 0x01;
+static const uint32_t BANLIST_FILTER_SET   = 0x02;
+
+static bool banListPrefix(const sockaddr_storage& key, int masked_bytes, RsIpPrefix& prefix)
+{
+    if(masked_bytes < 0 || masked_bytes > 2)
+        return false;
+
+    // masked bytes are set to 0xff in the keys, they are cleared here.
+    return RsIpPrefix::fromSockaddr(key, 32 - 8*masked_bytes, prefix);
+}
+
+/* Apply to trie the difference between the entries it was last synced with
+ * and the wanted ones, so only changed prefixes get copied. */
+static void syncFilter( RsIpPrefixTrie& trie,
+                        std::vector<std::pair<RsIpPrefix, uint32_t> >& current,
+                        std::vector<std::pair<RsIpPrefix, uint32_t> >& wanted )
+{
+    std::sort(wanted.begin(), wanted.end());
+
+    // merge duplicates (ex: same /32 in ban ranges and ban set)
+    size_t n = 0;
+    for(size_t i = 0; i < wanted.size(); ++i)
+        if(n > 0 && wanted[n-1].first == wanted[i].first)
+            wanted[n-1].second |= wanted[i].second;
+        else
+            wanted[n++] = wanted[i];
+    wanted.resize(n);
+
+    std::vector<std::pair<RsIpPrefix, uint32_t> >::const_iterator cit = current.begin();
+    std::vector<std::pair<RsIpPrefix, uint32_t> >::const_iterator wit = wanted.begin();
+
+    while(cit != current.end() || wit != wanted.end())
+    {
+        if(wit == wanted.end() || (cit != current.end() && cit->first < wit->first))
+            trie.set((cit++)->first, 0);
+        else if(cit == current.end() || wit->first < cit->first)
+        {
+            trie.set(wit->first, wit->second);
+            ++wit;
+        }
+        else
+        {
+            if(cit->second != wit->second)
+                trie.set(wit->first, wit->second);
+            ++cit;
+            ++wit;
+        }
+    }
+
+    trie.commit();
+    current.swap(wanted);
+}
+
+void p3BanList::updateFilters_locked()
+{
+    FilterEntries white, black;
+    RsIpPrefix prefix;
+
+    for(std::map<sockaddr_storage,BanListPeer>::const_iterator it(mWhiteListedRanges.begin());it!=mWhiteListedRanges.end();++it)
+        if(banListPrefix(it->first, it->second.masked_bytes, prefix))
+            white.push_back(std::make_pair(prefix, 1u)) ;
+
+    for(std::map<sockaddr_storage,BanListPeer>::const_iterator it(mBanRanges.begin());it!=mBanRanges.end();++it)
+        if(acceptedBanRanges_locked(it->second) && banListPrefix(it->first, it->second.masked_bytes, prefix))
+            black.push_back(std::make_pair(prefix, BANLIST_FILTER_RANGE)) ;
+
+    for(std::map<sockaddr_storage,BanListPeer>::const_iterator it(mBanSet.begin());it!=mBanSet.end();++it)
+        if(acceptedBanSet_locked(it->second) && banListPrefix(it->first, 0, prefix))
+            black.push_back(std::make_pair(prefix, BANLIST_FILTER_SET)) ;
+
+    syncFilter(mWhiteListFilter, mWhiteListFilterEntries, white);
+    syncFilter(mBlackListFilter, mBlackListFilterEntries, black);
+}
+
+void p3BanList::countConnectAttempt_locked(const RsIpPrefix& matched, uint32_t sources)
+{
+    // back from the IPv4-mapped prefix to the map keys
+    sockaddr_storage addr ;
+    sockaddr_storage_clear(addr) ;
+    sockaddr_in *ad = (sockaddr_in*)(&addr) ;
+    ad->sin_family = AF_INET ;
+    memcpy(&ad->sin_addr.s_addr, &matched.mBytes[12], 4) ;
+
+    int masked_bytes = (128 - matched.mLength) / 8 ;
+
+    std::map<sockaddr_storage,BanListPeer>::iterator it ;
+
+    if( (sources & BANLIST_FILTER_RANGE) && (it = mBanRanges.find(makeBitsRange(addr,masked_bytes))) != mBanRanges.end())
+        ++it->second.connect_attempts ;
+    else if( (sources & BANLIST_FILTER_SET) && (it = mBanSet.find(makeBitsRange(addr,0))) != mBanSet.end())
+        ++it->second.connect_attempts ;
+    else
+        return ;
+
+#ifdef DEBUG_BANLIST
+    std::cerr << " found in blacklist " << sockaddr_storage_iptostring(it->first) << "/" << 32 - 8*masked_bytes << ". returning false. attempts=" << it->second.connect_attempts << std::endl;
+#endif
+}
+
 
 
 int	p3BanList::sendPackets()
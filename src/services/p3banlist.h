@@ -22,13 +22,16 @@
 #ifndef SERVICE_RSBANLIST_HEADER
 #define SERVICE_RSBANLIST_HEADER
 
+#include <atomic>
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 #include "rsitems/rsbanlistitems.h"
 #include "services/p3service.h"
 #include "retroshare/rsbanlist.h"
+#include "util/rsiptrie.h"
 
 class p3ServiceControl;
 class p3NetMgr;
@@ -143,6 +146,8 @@ private:
     int printBanSources_locked(std::ostream &out);
     int printBanSet_locked(std::ostream &out);
     bool isWhiteListed_locked(const sockaddr_storage &addr);
+    void updateFilters_locked();
+    void countConnectAttempt_locked(const RsIpPrefix &matched, uint32_t sources);
 
     p3ServiceControl *mServiceCtrl;
     //p3NetMgr *mNetMgr;
@@ -152,12 +157,22 @@ private:
     std::map<struct sockaddr_storage, BanListPeer> mBanRanges;
     std::map<struct sockaddr_storage, BanListPeer> mWhiteListedRanges;
 
+    /* Lock free copies of the whitelist and of the accepted ban ranges/set,
+     * checked by isAddressAccepted(). Kept in sync with the maps above by
+     * updateFilters_locked(), which only applies what changed since the last
+     * sync (entries as last synced are kept sorted below). */
+    typedef std::vector<std::pair<RsIpPrefix, uint32_t> > FilterEntries;
+    RsIpPrefixTrie mWhiteListFilter;
+    RsIpPrefixTrie mBlackListFilter;
+    FilterEntries mWhiteListFilterEntries;
+    FilterEntries mBlackListFilterEntries;
+
     rstime_t mLastDhtInfoRequest ;
 
     uint32_t mAutoRangeLimit ;
     bool mAutoRangeIps ;
 
-    bool mIPFilteringEnabled ;
+    std::atomic<bool> mIPFilteringEnabled ;	// read by isAddressAccepted() without the lock
     bool mIPFriendGatheringEnabled ;
     bool mIPDHTGatheringEnabled ;
 };
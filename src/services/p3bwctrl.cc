@@ -281,6 +281,11 @@ int     p3BandwidthControl::ExtractTrafficInfo(std::list<RSTrafficClue>& out_sta
     return mPg->ExtractTrafficInfo(out_stats,in_stats) ;
 }
 
+int     p3BandwidthControl::ExtractQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats)
+{
+    return mPg->ExtractQueueStatistics(qos_stats) ;
+}
+
 
 
 
@@ -90,6 +90,7 @@ class p3BandwidthControl: public p3Service, public pqiServiceMonitor
 
 
         virtual int ExtractTrafficInfo(std::list<RSTrafficClue> &out_stats, std::list<RSTrafficClue> &in_stats);
+        virtual int ExtractQueueStatistics(std::map<RsPeerId, std::vector<RsQoSClassStats> >& qos_stats);
 
 		/*!
 		 * Interface stuff.
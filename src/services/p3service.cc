@@ -25,6 +25,7 @@
 #include "util/rsstring.h"
 #include "services/p3service.h"
 #include <iomanip>
+#include <cstring>
 
 #ifdef WINDOWS_SYS
 #include "util/rstime.h"
@@ -153,11 +154,12 @@ int p3FastService::sendItem(RsItem *si)
 	std::cerr << std::endl;
 #endif
 
-	/* try to convert */
-	uint32_t size = rsSerialiser->size(si);
-	if (!size)
+	/* try to convert, serialising in a single pass */
+	uint32_t size = 0;
+	const uint8_t *data = rsSerialiser->serialiseScratch(si, size);
+	if (!data || !size)
 	{
-		std::cerr << "p3Service::send() ERROR size == 0";
+		std::cerr << "p3Service::send() ERROR serialise failed";
 		std::cerr << std::endl;
 
 		/* can't convert! */
@@ -166,20 +168,10 @@ int p3FastService::sendItem(RsItem *si)
 	}
 
 	RsRawItem *raw = new RsRawItem(si->PacketId(), size);
-	if (!rsSerialiser->serialise(si, raw->getRawData(), &size))
-	{
-		std::cerr << "p3Service::send() ERROR serialise failed";
-		std::cerr << std::endl;
-
-		delete raw;
-		raw = NULL;
-	}
-
-	if ((raw) && (size != raw->getRawLength()))
+	if (raw->getRawData())
+		memcpy(raw->getRawData(), data, size);
+	else
 	{
-		std::cerr << "p3Service::send() ERROR serialise size mismatch";
-		std::cerr << std::endl;
-
 		delete raw;
 		raw = NULL;
 	}
@@ -0,0 +1,250 @@
+/*******************************************************************************
+ * libretroshare/src/tcponudp: tcpcongestion.cc                                *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include "tcpcongestion.h"
+
+#include <math.h>
+
+/* Initial window (RFC 3390): min(4 * MSS, max(2 * MSS, 4380 bytes)) */
+static uint32 initialWindow(uint32 mss)
+{
+	uint32 iw = 2 * mss;
+	if (iw < 4380)
+	{
+		iw = 4380;
+	}
+	if (iw > 4 * mss)
+	{
+		iw = 4 * mss;
+	}
+	return iw;
+}
+
+TcpCongestionControl::TcpCongestionControl(uint32 seg, uint32 win)
+	:mss(seg), maxWin(win), cwnd(initialWindow(seg)), ssthresh(win)
+{
+	return;
+}
+
+TcpCongestionControl *TcpCongestionControl::create(TcpCongestionType type,
+			uint32 mss, uint32 maxWin)
+{
+	switch(type)
+	{
+		case TCP_CONGESTION_RENO:
+			return new TcpRenoControl(mss, maxWin);
+		case TCP_CONGESTION_CUBIC:
+		default:
+			return new TcpCubicControl(mss, maxWin);
+	}
+}
+
+void	TcpCongestionControl::reset()
+{
+	cwnd = initialWindow(mss);
+	clampWindow();
+	ssthresh = maxWin;
+}
+
+void	TcpCongestionControl::onTimeout(double /* now */)
+{
+	ssthresh = cwnd / 2;
+	if (ssthresh < 2 * mss)
+	{
+		ssthresh = 2 * mss;
+	}
+	cwnd = mss;
+}
+
+void	TcpCongestionControl::clampWindow()
+{
+	if (cwnd > maxWin)
+	{
+		cwnd = maxWin;
+	}
+	if (cwnd < mss)
+	{
+		cwnd = mss;
+	}
+}
+
+
+/********************************* Reno ************************************/
+
+TcpRenoControl::TcpRenoControl(uint32 mss, uint32 maxWin)
+	:TcpCongestionControl(mss, maxWin), ackedBytes(0)
+{
+	reset();
+}
+
+void	TcpRenoControl::reset()
+{
+	TcpCongestionControl::reset();
+	ackedBytes = 0;
+}
+
+void	TcpRenoControl::onAck(uint32 acked, double /* srtt */, double /* now */)
+{
+	if (cwnd < ssthresh)
+	{
+		/* slow start: acks are gathered over a tick, so no per ack limit */
+		cwnd += acked;
+	}
+	else
+	{
+		/* congestion avoidance: one segment per window acknowledged */
+		ackedBytes += acked;
+		while(ackedBytes >= cwnd)
+		{
+			ackedBytes -= cwnd;
+			cwnd += mss;
+		}
+	}
+	clampWindow();
+}
+
+void	TcpRenoControl::onLoss(double /* now */)
+{
+	ssthresh = cwnd / 2;
+	if (ssthresh < 2 * mss)
+	{
+		ssthresh = 2 * mss;
+	}
+	cwnd = ssthresh;
+	ackedBytes = 0;
+}
+
+
+/********************************* CUBIC ***********************************/
+
+static const double CUBIC_C    = 0.4;
+static const double CUBIC_BETA = 0.7;
+
+TcpCubicControl::TcpCubicControl(uint32 mss, uint32 maxWin)
+	:TcpCongestionControl(mss, maxWin)
+{
+	reset();
+}
+
+void	TcpCubicControl::reset()
+{
+	TcpCongestionControl::reset();
+	wMax = 0;
+	wLastMax = 0;
+	wOrigin = 0;
+	wEst = 0;
+	epochStart = 0;
+	K = 0;
+	minRtt = 0;
+	cwndFrac = 0;
+}
+
+void	TcpCubicControl::onAck(uint32 acked, double srtt, double now)
+{
+	if ((srtt > 0) && ((minRtt == 0) || (srtt < minRtt)))
+	{
+		minRtt = srtt;
+	}
+
+	if (cwnd < ssthresh)
+	{
+		cwnd += acked;
+		clampWindow();
+		return;
+	}
+
+	double seg = (double) cwnd / mss;
+	double ackedSeg = (double) acked / mss;
+
+	if (epochStart == 0)
+	{
+		epochStart = now;
+		cwndFrac = 0;
+		wEst = seg;
+		if (seg < wMax)
+		{
+			K = cbrt((wMax - seg) / CUBIC_C);
+			wOrigin = wMax;
+		}
+		else
+		{
+			K = 0;
+			wOrigin = seg;
+		}
+	}
+
+	/* where the cubic function will be one RTT from now */
+	double t = now - epochStart + minRtt;
+	double target = wOrigin + CUBIC_C * (t - K) * (t - K) * (t - K);
+
+	/* never grow slower than Reno would (TCP friendly region) */
+	wEst += 3.0 * (1.0 - CUBIC_BETA) / (1.0 + CUBIC_BETA) * ackedSeg / seg;
+	if (wEst > target)
+	{
+		target = wEst;
+	}
+
+	/* at most 1.5 times the window per round trip */
+	if (target > 1.5 * seg)
+	{
+		target = 1.5 * seg;
+	}
+
+	if (target > seg)
+	{
+		cwndFrac += (target - seg) / seg * ackedSeg * mss;
+		uint32 inc = (uint32) cwndFrac;
+		cwnd += inc;
+		cwndFrac -= inc;
+	}
+	clampWindow();
+}
+
+void	TcpCubicControl::onLoss(double /* now */)
+{
+	double seg = (double) cwnd / mss;
+
+	/* fast convergence: release bandwidth if the window keeps shrinking */
+	if (seg < wLastMax)
+	{
+		wLastMax = seg;
+		wMax = seg * (1.0 + CUBIC_BETA) / 2.0;
+	}
+	else
+	{
+		wLastMax = seg;
+		wMax = seg;
+	}
+
+	epochStart = 0;
+	ssthresh = (uint32) (cwnd * CUBIC_BETA);
+	if (ssthresh < 2 * mss)
+	{
+		ssthresh = 2 * mss;
+	}
+	cwnd = ssthresh;
+}
+
+void	TcpCubicControl::onTimeout(double now)
+{
+	onLoss(now);
+	cwnd = mss;
+}
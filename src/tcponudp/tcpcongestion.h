@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * libretroshare/src/tcponudp: tcpcongestion.h                                 *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#ifndef TOU_TCP_CONGESTION_H
+#define TOU_TCP_CONGESTION_H
+
+#include "tcppacket.h"
+
+/* Congestion control for TcpStream.
+ *
+ * TcpStream tells the algorithm about acknowledged data and losses, and
+ * the algorithm decides how many bytes may be in flight (window()).
+ * All sizes are in bytes, all times in (fractional) seconds.
+ * Calls are made under the TcpStream mutex.
+ */
+
+enum TcpCongestionType
+{
+	TCP_CONGESTION_RENO  = 0,
+	TCP_CONGESTION_CUBIC = 1
+};
+
+class TcpCongestionControl
+{
+	public:
+
+	TcpCongestionControl(uint32 mss, uint32 maxWin);
+virtual ~TcpCongestionControl() { return; }
+
+static TcpCongestionControl *create(TcpCongestionType type, uint32 mss, uint32 maxWin);
+
+virtual const char *name() const = 0;
+
+	/* back to initial state, for a new connection */
+virtual void	reset();
+
+	/* new data acknowledged, outside of loss recovery.
+	 * srtt is the smoothed round trip time estimate.
+	 */
+virtual void	onAck(uint32 acked, double srtt, double now) = 0;
+
+	/* loss detected by duplicate acks or SACK (once per window) */
+virtual void	onLoss(double now) = 0;
+
+	/* retransmission timer expired */
+virtual void	onTimeout(double now);
+
+uint32	window() const { return cwnd; }
+uint32	threshold() const { return ssthresh; }
+
+	protected:
+
+void	clampWindow();
+
+	const uint32 mss;
+	const uint32 maxWin;
+
+	uint32 cwnd;
+	uint32 ssthresh;
+};
+
+
+/* NewReno (RFC 5681): slow start, then one segment per round trip,
+ * halve the window on loss.
+ */
+class TcpRenoControl: public TcpCongestionControl
+{
+	public:
+
+	TcpRenoControl(uint32 mss, uint32 maxWin);
+
+virtual const char *name() const { return "reno"; }
+virtual void	reset();
+virtual void	onAck(uint32 acked, double srtt, double now);
+virtual void	onLoss(double now);
+
+	private:
+
+	uint32 ackedBytes; /* congestion avoidance byte counter */
+};
+
+
+/* CUBIC (RFC 8312): after a loss the window grows as a cubic function of
+ * the time since the loss, centered on the window where it happened.
+ * Recovers the previous window in a few round trips whatever the RTT,
+ * which suits high latency links better than Reno's linear increase.
+ */
+class TcpCubicControl: public TcpCongestionControl
+{
+	public:
+
+	TcpCubicControl(uint32 mss, uint32 maxWin);
+
+virtual const char *name() const { return "cubic"; }
+virtual void	reset();
+virtual void	onAck(uint32 acked, double srtt, double now);
+virtual void	onLoss(double now);
+virtual void	onTimeout(double now);
+
+	private:
+
+	double wMax;       /* window before last reduction (segments) */
+	double wLastMax;   /* previous wMax, for fast convergence */
+	double wOrigin;    /* plateau of the cubic function (segments) */
+	double wEst;       /* Reno friendly window estimate (segments) */
+	double epochStart; /* start of current growth period, 0 if none */
+	double K;          /* time to get back to wOrigin from epochStart */
+	double minRtt;
+	double cwndFrac;   /* growth not yet added to cwnd (bytes) */
+};
+
+#endif
+
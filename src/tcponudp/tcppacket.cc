@@ -67,23 +67,21 @@
 
 
 TcpPacket::TcpPacket(uint8 *ptr, int size)
-	:data(0), datasize(0), seqno(0), ackno(0), hlen_flags(0), 
-	 winsize(0), ts(0), retrans(0)
+	:data(0), datasize(0), datacap(0), seqno(0), ackno(0), hlen_flags(0), 
+	 winsize(0), sackStart(0), sackLength(0), ts(0), retrans(0),
+	 sacked(false), lost(false)
 	{
 		if (size > 0)
 		{
-			datasize = size;
-			data = (uint8 *) rs_malloc(datasize);
-            
-            		if(data != NULL)
-				memcpy(data, (void *) ptr, size);
+			setData(ptr, size);
 		}
 		return;
 	}
 
 TcpPacket::TcpPacket() /* likely control packet */
-	:data(0), datasize(0), seqno(0), ackno(0), hlen_flags(0), 
-	 winsize(0), ts(0), retrans(0)
+	:data(0), datasize(0), datacap(0), seqno(0), ackno(0), hlen_flags(0), 
+	 winsize(0), sackStart(0), sackLength(0), ts(0), retrans(0),
+	 sacked(false), lost(false)
 	{
 		return;
 	}
@@ -95,6 +93,53 @@ TcpPacket::~TcpPacket()
 			free(data);
 	}
 
+void	TcpPacket::clear()
+{
+	datasize = 0;
+	seqno = 0;
+	ackno = 0;
+	hlen_flags = 0;
+	winsize = 0;
+	sackStart = 0;
+	sackLength = 0;
+	ts = 0;
+	retrans = 0;
+	sacked = false;
+	lost = false;
+}
+
+void	*TcpPacket::setData(void *ptr, int size)
+{
+	datasize = 0;
+	if (size <= 0)
+	{
+		return data;
+	}
+
+	if (size > datacap)
+	{
+		if (data)
+		{
+			free(data);
+			data = NULL;
+		}
+		/* round up, so the buffer can be reused for a full segment */
+		int cap = (size + 511) & ~511;
+
+		datacap = 0;
+		data = (uint8 *) rs_malloc(cap);
+		if (data == NULL)
+		{
+			return NULL;
+		}
+		datacap = cap;
+	}
+
+	memcpy(data, ptr, size);
+	datasize = size;
+	return data;
+}
+
 
 int	TcpPacket::writePacket(void *buf, int &size)
 {
@@ -122,11 +167,11 @@ int	TcpPacket::writePacket(void *buf, int &size)
 	/* byte: 14 => uint16 winsize */
 	*((uint16 *) &(((uint8 *) buf)[14])) = htons(winsize); 
 
-	/* byte: 16 => uint16 chksum */
-	*((uint16 *) &(((uint8 *) buf)[16])) = htons(0); 
+	/* byte: 16 => uint16 chksum -> sackStart */
+	*((uint16 *) &(((uint8 *) buf)[16])) = htons(sackStart); 
 
-	/* byte: 18 => uint16 urgptr */
-	*((uint16 *) &(((uint8 *) buf)[18])) = htons(0); 
+	/* byte: 18 => uint16 urgptr -> sackLength */
+	*((uint16 *) &(((uint8 *) buf)[18])) = htons(sackLength); 
 
 	/* total 20 bytes */
 
@@ -166,43 +211,29 @@ int	TcpPacket::readPacket(void *buf, int size)
 	/* byte: 14 => uint16 winsize */
 	winsize = ntohs(  *((uint16 *) &(((uint8 *) buf)[14])) );
 
-	/* byte: 16 => uint16 chksum *************************
-	*((uint16 *) &(((uint8 *) buf)[16])) = htons(0); 
-	***********/
+	/* byte: 16 => uint16 chksum -> sackStart */
+	sackStart = ntohs(  *((uint16 *) &(((uint8 *) buf)[16])) );
 
-	/* byte: 18 => uint16 urgptr *************************
-	*((uint16 *) &(((uint8 *) buf)[18])) = htons(0); 
-	***********/
+	/* byte: 18 => uint16 urgptr -> sackLength */
+	sackLength = ntohs(  *((uint16 *) &(((uint8 *) buf)[18])) );
 
 	/* total 20 bytes */
 
-	if (data)
-	{
-		free(data);
-		data = NULL ;
-	}
-	datasize = size - TCP_PSEUDO_HDR_SIZE;
-
 	// this happens for control packets (e.g. syn/ack/fin)
-	if(datasize == 0)
+	if(size == TCP_PSEUDO_HDR_SIZE)
 	{
-		// data is already NULL
-		// just return packet size
+		datasize = 0;
 		return size;
 	}
 
-	data = (uint8 *) rs_malloc(datasize);
-
-	if(data == NULL)
+	/* now the data, into the existing buffer if big enough */
+	if(setData(&(((uint8 *) buf)[20]), size - TCP_PSEUDO_HDR_SIZE) == NULL)
 	{
 		// malloc failed!
 		// return 0 to drop packet (will be retransmitted eventually)
 		return 0 ;
 	}
 
-	/* now the data */
-	memcpy(data, (void *) &(((uint8 *) buf)[20]), datasize);
-
 	return size;
 }
 
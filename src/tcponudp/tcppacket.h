@@ -37,6 +37,7 @@ class TcpPacket
 
 	uint8 *data;
 	int   datasize;
+	int   datacap; /* allocated size of data, reused by setData/readPacket */
 
 
 	/* ports aren't needed -> in udp 
@@ -48,6 +49,11 @@ class TcpPacket
 	/* don't need these -> in udp + not supported
 	uint16 chksum, urgptr; 
 	 **************************/
+	/* instead these fields carry one selective ack block:
+	 * [ackno + sackStart, ackno + sackStart + sackLength)
+	 * peers not supporting it send zeros (sackLength = 0 -> no block).
+	 **************************/
+	uint16 sackStart, sackLength;
 	/* no options.
 	 **************************/
 	
@@ -55,18 +61,23 @@ class TcpPacket
 	/* other variables */
 	double  ts; /* transmit time */ 
 	uint16  retrans; /* retransmit counter */
+	bool    sacked; /* peer has it (selective ack), waiting for cumulative ack */
+	bool    lost; /* already fast retransmitted in current recovery */
 
 	TcpPacket(uint8 *ptr, int size);
 	TcpPacket(); /* likely control packet */
 	~TcpPacket();
 
+	/* back to a blank control packet, keeping the data buffer */
+void	clear();
+
 int	writePacket(void *buf, int &size);
 int	readPacket(void *buf, int size);
 
 void    *getData();
 void    *releaseData();
 
-void    *setData(void *data, int size);
+void    *setData(void *data, int size); /* copies data */
 int 	getDataSize();
 
 	/* flags */
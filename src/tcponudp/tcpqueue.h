@@ -0,0 +1,140 @@
+/*******************************************************************************
+ * libretroshare/src/tcponudp: tcpqueue.h                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#ifndef TOU_TCP_QUEUE_H
+#define TOU_TCP_QUEUE_H
+
+#include <vector>
+#include <stddef.h>
+
+/* Containers for TcpStream, which handles every segment of a connection
+ * through a few objects that are created and destroyed at packet rate.
+ * Neither is thread safe: TcpStream uses them under its mutex.
+ */
+
+/* Pool handing out objects allocated by slabs of SLAB.
+ * Released objects are kept as is for reuse (so a TcpPacket keeps its data
+ * buffer), and only freed with the pool, which must outlive their use.
+ */
+template<class T, size_t SLAB = 64>
+class TcpSlabPool
+{
+	public:
+
+	TcpSlabPool() { return; }
+	~TcpSlabPool()
+	{
+		for(size_t i = 0; i < mSlabs.size(); i++)
+		{
+			delete [] mSlabs[i];
+		}
+	}
+
+	/* object in the state it was released in (or default constructed) */
+	T *get()
+	{
+		if (mFree.empty())
+		{
+			T *slab = new T[SLAB];
+			mSlabs.push_back(slab);
+			for(size_t i = SLAB; i > 0; i--)
+			{
+				mFree.push_back(&(slab[i - 1]));
+			}
+		}
+
+		T *obj = mFree.back();
+		mFree.pop_back();
+		return obj;
+	}
+
+	void put(T *obj) { mFree.push_back(obj); }
+
+	size_t allocated() const { return mSlabs.size() * SLAB; }
+	size_t available() const { return mFree.size(); }
+
+	private:
+
+	TcpSlabPool(const TcpSlabPool &);
+	TcpSlabPool &operator=(const TcpSlabPool &);
+
+	std::vector<T *> mSlabs;
+	std::vector<T *> mFree;
+};
+
+
+/* Fixed capacity FIFO with random access, capacity rounded up to a power
+ * of 2. Callers must check full() before push_back().
+ */
+template<class T>
+class TcpRing
+{
+	public:
+
+	explicit TcpRing(size_t capacity)
+	:mHead(0), mSize(0)
+	{
+		size_t cap = 1;
+		while(cap < capacity)
+		{
+			cap <<= 1;
+		}
+		mBuf.resize(cap);
+		mMask = cap - 1;
+	}
+
+	bool	empty() const { return mSize == 0; }
+	bool	full() const { return mSize == mBuf.size(); }
+	size_t	size() const { return mSize; }
+	size_t	capacity() const { return mBuf.size(); }
+
+	/* i = 0 is the oldest element */
+	T &operator[](size_t i) { return mBuf[(mHead + i) & mMask]; }
+	T &front() { return mBuf[mHead]; }
+	T &back() { return mBuf[(mHead + mSize - 1) & mMask]; }
+
+	void	push_back(const T &val)
+	{
+		mBuf[(mHead + mSize) & mMask] = val;
+		mSize++;
+	}
+
+	void	pop_front()
+	{
+		mHead = (mHead + 1) & mMask;
+		mSize--;
+	}
+
+	void	clear()
+	{
+		mHead = 0;
+		mSize = 0;
+	}
+
+	private:
+
+	std::vector<T> mBuf;
+	size_t mMask;
+	size_t mHead;
+	size_t mSize;
+};
+
+#endif
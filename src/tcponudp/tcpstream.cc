@@ -78,6 +78,7 @@ static double getCurrentTS();
 
 TcpStream::TcpStream(UdpSubReceiver *lyr)
 	: tcpMtx("TcpStream"), inSize(0), outSizeRead(0), outSizeNet(0), 
+	outPkt(TCP_MAX_OUT_PKTS), outSackedBytes(0),
 	state(TCP_CLOSED), 
         inStreamActive(false),
         outStreamActive(false),
@@ -88,6 +89,9 @@ TcpStream::TcpStream(UdpSubReceiver *lyr)
 	retransTimerOn(false),
 	retransTimeout(TCP_RETRANS_TIMEOUT),
 	retransTimerTs(0),
+	timeoutRetransCount(0),
+	fastRetransCount(0),
+	sackedPktCount(0),
 	keepAliveTimer(0),
 	lastIncomingPkt(0),
 	lastSentAck(0),
@@ -100,9 +104,15 @@ TcpStream::TcpStream(UdpSubReceiver *lyr)
 	/* retranmission variables - init to large */
 	rtt_est(TCP_RETRANS_TIMEOUT), 
 	rtt_dev(0),
-	congestThreshold(TCP_MAX_WIN),
-	congestWinSize(MAX_SEG),
-	congestUpdate(0),
+	congestCtrl(TcpCongestionControl::create(TCP_CONGESTION_CUBIC, MAX_SEG, maxWinSize)),
+	inRecovery(false),
+	recoveryByTimeout(false),
+	recoveryPoint(0),
+	dupAcks(0),
+	peerSack(false),
+	sackValid(false),
+	sackBlockStart(0),
+	sackBlockEnd(0),
 	ttl(0),
         mTTL_period(0), 
         mTTL_start(0),
@@ -150,13 +160,15 @@ int	TcpStream::connect(const struct sockaddr_in &raddr, uint32_t conn_period)
 	outAcked = outSeqno; /* min - 1 expected */
 	inWinSize = maxWinSize;
 
-	congestThreshold = TCP_MAX_WIN;
-	congestWinSize   = MAX_SEG;
-	congestUpdate    = outAcked + congestWinSize;
+	congestCtrl->reset();
+	inRecovery = false;
+	dupAcks    = 0;
+	peerSack   = false;
+	sackValid  = false;
 
 	/* Init Connection */
 	/* send syn packet */
-	TcpPacket *pkt = new TcpPacket();
+	TcpPacket *pkt = newPacket();
 	pkt -> setSyn();
 
 #ifdef DEBUG_TCP_STREAM
@@ -314,6 +326,16 @@ bool	TcpStream::isConnected()
 	return isConn;
 }
 
+void	TcpStream::setCongestionControl(TcpCongestionType type)
+{
+	tcpMtx.lock();   /********** LOCK MUTEX *********/
+
+	delete congestCtrl;
+	congestCtrl = TcpCongestionControl::create(type, MAX_SEG, maxWinSize);
+
+	tcpMtx.unlock(); /******** UNLOCK MUTEX *********/
+}
+
 int TcpStream::status(std::ostream &out)
 {
 	tcpMtx.lock();   /********** LOCK MUTEX *********/
@@ -345,6 +367,11 @@ int	TcpStream::status_locked(std::ostream &out)
 	out << std::endl;
 	out << "outPkts: " << outPkt.size() << " packets waiting for acks";
 	out << std::endl;
+	out << "pools: " << pktPool.allocated() - pktPool.available() << "/";
+	out << pktPool.allocated() << " packets, ";
+	out << bufPool.allocated() - bufPool.available() << "/";
+	out << bufPool.allocated() << " buffers in use";
+	out << std::endl;
 	out << "us -> peer: nextSeqno: " << outSeqno << " lastAcked: " << outAcked;
 	out << " winsize: " << outWinSize;
 	out << std::endl;
@@ -507,7 +534,7 @@ static uint32 TMPtotalwrite = 0;
 #endif
 
 	/* first create 1. */
-	dataBuffer *db = new dataBuffer;
+	dataBuffer *db = newBuffer();
 	memcpy((void *) db->data, (void *) inData, inSize);
 
 
@@ -527,7 +554,7 @@ static uint32 TMPtotalwrite = 0;
 		std::cerr << "TcpStream::write() filling whole dataBuffer" << std::endl;
 		std::cerr << "TcpStream::write() from dta[" << size-remSize << "]" << std::endl;
 #endif
-		db = new dataBuffer;
+		db = newBuffer();
 		memcpy((void *) db->data, (void *) &(dta[size-remSize]), MAX_SEG);
 
 		inQueue.push_back(db);
@@ -700,7 +727,7 @@ static  uint32 TMPtotalread = 0;
 			memcpy((void *) outDataRead, (void *) &(db->data[remSize]), MAX_SEG - remSize);
 			outSizeRead = MAX_SEG - remSize;
 
-			delete db;
+			freeBuffer(db);
 
 
 #ifdef DEBUG_TCP_STREAM_EXTRA
@@ -727,7 +754,7 @@ static  uint32 TMPtotalread = 0;
 		/* else copy whole segment */
 		memcpy((void *) &(dta[(size)-remSize]), (void *) db->data, MAX_SEG);
 		remSize -= MAX_SEG;
-		delete db;
+		freeBuffer(db);
 	}
 
 	/* assumes that outSizeNet >= remSize due to initial 
@@ -833,7 +860,7 @@ void 	TcpStream::recvPkt(void *data, int size)
 	//std::cerr << printPkt(input, size);
 	//std::cerr << std::endl;
 #endif
-	TcpPacket *pkt = new TcpPacket();
+	TcpPacket *pkt = newPacket();
 	if (0 < pkt -> readPacket(input, size))
 	{
 		lastIncomingPkt = getCurrentTS();
@@ -845,7 +872,7 @@ void 	TcpStream::recvPkt(void *data, int size)
 		std::cerr << "TcpStream::recv() Bad Packet Deleting!";
 		std::cerr << std::endl;
 #endif
-		delete pkt;
+		freePacket(pkt);
 	}
 	tcpMtx.unlock(); /******** UNLOCK MUTEX *********/
 	return;
@@ -981,6 +1008,30 @@ uint32	TcpStream::rbytes()
 	return rb;
 }
 
+uint32	TcpStream::timeoutRetransmits()
+{
+	tcpMtx.lock();   /********** LOCK MUTEX *********/
+	uint32 count = timeoutRetransCount;
+	tcpMtx.unlock(); /******** UNLOCK MUTEX *********/
+	return count;
+}
+
+uint32	TcpStream::fastRetransmits()
+{
+	tcpMtx.lock();   /********** LOCK MUTEX *********/
+	uint32 count = fastRetransCount;
+	tcpMtx.unlock(); /******** UNLOCK MUTEX *********/
+	return count;
+}
+
+uint32	TcpStream::sackedPkts()
+{
+	tcpMtx.lock();   /********** LOCK MUTEX *********/
+	uint32 count = sackedPktCount;
+	tcpMtx.unlock(); /******** UNLOCK MUTEX *********/
+	return count;
+}
+
 /********************* ALL BELOW HERE IS INTERNAL ******************
  ******************* AND ALWAYS PROTECTED BY A MUTEX ***************/
 
@@ -1057,15 +1108,16 @@ int	TcpStream::cleanup()
 	{
 		dataBuffer *db = inQueue.front();
 		inQueue.pop_front();
-		delete db;
+		freeBuffer(db);
 	}
 
 	while(outPkt.size() > 0)
 	{
 		TcpPacket *pkt = outPkt.front();
 		outPkt.pop_front();
-		delete pkt;
+		freePacket(pkt);
 	}
+	outSackedBytes = 0;
 
 
 	// clear arrays.
@@ -1075,15 +1127,15 @@ int	TcpStream::cleanup()
 	{
 		dataBuffer *db = outQueue.front();
 		outQueue.pop_front();
-		delete db;
+		freeBuffer(db);
 	}
 
-	while(inPkt.size() > 0)
+	std::unordered_map<uint32, TcpPacket *>::iterator it;
+	for(it = inPkt.begin(); it != inPkt.end(); ++it)
 	{
-		TcpPacket *pkt = inPkt.front();
-		inPkt.pop_front();
-		delete pkt;
+		freePacket(it->second);
 	}
+	inPkt.clear();
 	return 1;
 }
 
@@ -1209,7 +1261,7 @@ int 	TcpStream::handleIncoming(TcpPacket *pkt)
 			}
 			break;
 	}
-	delete pkt;
+	freePacket(pkt);
 	return 1;
 }
 
@@ -1243,7 +1295,7 @@ int TcpStream::incoming_Closed(TcpPacket *pkt)
 		 */
 
 		/* start packet */
-		TcpPacket *rsp = new TcpPacket();
+		TcpPacket *rsp = newPacket();
 
 		if (state == TCP_CLOSED)
 		{
@@ -1252,9 +1304,11 @@ int TcpStream::incoming_Closed(TcpPacket *pkt)
 			outAcked = outSeqno; /* min - 1 expected */
 
 			/* setup Congestion Charging */
-			congestThreshold = TCP_MAX_WIN;
-			congestWinSize   = MAX_SEG;
-			congestUpdate    = outAcked + congestWinSize;
+			congestCtrl->reset();
+			inRecovery = false;
+			dupAcks    = 0;
+			peerSack   = false;
+			sackValid  = false;
 
 			rsp -> setSyn();
 		}
@@ -1282,7 +1336,7 @@ int TcpStream::incoming_Closed(TcpPacket *pkt)
 		rslog(RSL_WARNING, rstcpstreamzone, "TcpStream::state => TCP_SYN_RECVD (recvd SYN & !ACK)");
 	}
 
-	delete pkt;
+	freePacket(pkt);
 	return 1;
 }
 
@@ -1313,7 +1367,7 @@ int TcpStream::incoming_SynSent(TcpPacket *pkt)
 			std::cerr << "TcpStream::incoming_SynSent() Bad Ack - Deleting " << std::endl;
 #endif
 			/* bad ignore */
-			delete pkt;
+			freePacket(pkt);
 			return -1;
 		}
 
@@ -1347,7 +1401,7 @@ int TcpStream::incoming_SynSent(TcpPacket *pkt)
 
 		rslog(RSL_WARNING, rstcpstreamzone, "TcpStream::state => TCP_ESTABLISHED (recvd SUN & ACK)");
 
-		delete pkt;
+		freePacket(pkt);
 	} 
 	else /* same as if closed! (simultaneous open) */
 	{
@@ -1372,7 +1426,7 @@ int TcpStream::incoming_SynRcvd(TcpPacket *pkt)
 
 		rslog(RSL_WARNING, rstcpstreamzone, "TcpStream::state => TCP_CLOSED (recvd RST)");
 
-		delete pkt;
+		freePacket(pkt);
 		return 1;
 	}
 
@@ -1395,7 +1449,7 @@ int TcpStream::incoming_SynRcvd(TcpPacket *pkt)
 #ifdef DEBUG_TCP_STREAM
 			std::cerr << "incoming_SynRcvd -> Ignoring Pkt with bad ACK" << std::endl;
 #endif
-			delete pkt;
+			freePacket(pkt);
 			return -1;
 		}
 
@@ -1455,7 +1509,7 @@ int TcpStream::incoming_SynRcvd(TcpPacket *pkt)
 		std::cerr << "incoming_SynRcvd -> Ignoring Pkt!" << std::endl;
 #endif
 		/* else nothing */
-		delete pkt;
+		freePacket(pkt);
 	}
 	return 1;
 }
@@ -1495,6 +1549,8 @@ int TcpStream::incoming_Established(TcpPacket *pkt)
 				std::cerr << std::endl;
 			}
 #endif
+			/* duplicate acks and selective acks, before outAcked moves */
+			processAck(pkt);
 			outAcked = pkt->ackno;
 		}
 
@@ -1504,6 +1560,11 @@ int TcpStream::incoming_Established(TcpPacket *pkt)
 		std::cerr << "\tUpdating OutWinSize to: " << outWinSize;
 		std::cerr << std::endl;
 #endif
+
+		if (pkt->hasAck())
+		{
+			fastRetransmit(lastIncomingPkt);
+		}
 	}
 	else
 	{
@@ -1535,74 +1596,145 @@ int TcpStream::incoming_Established(TcpPacket *pkt)
 	}
 
 
-	/* add to queue */
-	inPkt.push_back(pkt);
+	/* data past a hole: ack straight away with the selective ack, so the
+	 * peer can resend the hole without waiting for a timeout.
+	 */
+	bool outOfOrder = (pkt->datasize > 0) && isOldSequence(inAckno, pkt->seqno);
+	if (outOfOrder)
+	{
+		updateSackBlock(pkt);
+	}
+
+	/* add to queue, unless it is the next one */
+	TcpPacket *next = NULL;
+	if (isOldSequence(pkt->seqno, inAckno))
+	{
+#ifdef DEBUG_TCP_STREAM
+		std::cerr << "Discarding Old Packet expAck: " << std::hex << inAckno;
+		std::cerr << " seqno: " << std::hex << pkt->seqno;
+		std::cerr << " pkt->size: " << std::hex << pkt->datasize;
+		std::cerr << std::dec << std::endl;
+#endif
+		freePacket(pkt);
+	}
+	else if ((pkt->seqno == inAckno) && (inPkt.find(inAckno) == inPkt.end()))
+	{
+		next = pkt;
+	}
+	else
+	{
+		std::pair<std::unordered_map<uint32, TcpPacket *>::iterator, bool> ins =
+			inPkt.insert(std::make_pair(pkt->seqno, pkt));
+
+		if (!ins.second)
+		{
+			/* same seqno: a resent segment, or a pure ack sent while
+			 * that segment was in flight. Keep the one carrying data
+			 * (or FIN), but with the latest ack.
+			 */
+			TcpPacket *old = ins.first->second;
+			TcpPacket *keep = pkt;
+			TcpPacket *drop = old;
+			if (((old->datasize > 0) || old->hasFin()) &&
+				(pkt->datasize == 0) && (!pkt->hasFin()))
+			{
+				keep = old;
+				drop = pkt;
+			}
+
+			if ((drop->hasAck()) && ((!keep->hasAck()) ||
+				isOldSequence(keep->ackno, drop->ackno)))
+			{
+				keep->setAck(drop->ackno);
+				keep->winsize = drop->winsize;
+			}
+
+			ins.first->second = keep;
+			freePacket(drop);
+		}
+	}
+
+	/* use as many packets as possible */
+	int ret = check_InPkts(next);
 
 	if (inPkt.size() > kMaxQueueSize)
 	{
-		TcpPacket *pkt = inPkt.front();
-		inPkt.pop_front();
-		delete pkt;
+		/* drop the stale and the furthest ahead packets first */
+		std::unordered_map<uint32, TcpPacket *>::iterator it, last;
+		for(it = inPkt.begin(); it != inPkt.end();)
+		{
+			if (isOldSequence(it->first, inAckno))
+			{
+				freePacket(it->second);
+				it = inPkt.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		while(inPkt.size() > kMaxQueueSize)
+		{
+			last = inPkt.begin();
+			for(it = inPkt.begin(); it != inPkt.end(); ++it)
+			{
+				if (isOldSequence(last->first, it->first))
+				{
+					last = it;
+				}
+			}
+			freePacket(last->second);
+			inPkt.erase(last);
+		}
 
 #ifdef DEBUG_TCP_STREAM
-		std::cerr << "TcpStream::incoming_Established() inPkt reached max size...Discarding Oldest Pkt";
+		std::cerr << "TcpStream::incoming_Established() inPkt reached max size...Discarding Pkts";
 		std::cerr << std::endl;
 #endif
+	}
 
+	/* block now part of the in order data */
+	if ((sackValid) && (!isOldSequence(inAckno, sackBlockStart)))
+	{
+		sackValid = false;
 	}
 
-	/* use as many packets as possible */
-	return check_InPkts();
+	if ((outOfOrder) && (state != TCP_CLOSED))
+	{
+		sendAck();
+	}
+	return ret;
 }
 
-int TcpStream::check_InPkts()
+int TcpStream::check_InPkts(TcpPacket *next)
 {
 	bool found = true;
-	TcpPacket *pkt;
-	std::list<TcpPacket *>::iterator it;
+	TcpPacket *pkt = NULL;
+	std::unordered_map<uint32, TcpPacket *>::iterator it;
 	while(found)
 	{
-		found = false;
-		for(it = inPkt.begin(); (!found) && (it != inPkt.end());)
+		/* next in order packet (old ones are discarded when they arrive) */
+		if (next)
 		{
-#ifdef DEBUG_TCP_STREAM
-			std::cerr << "Checking expInAck: " << std::hex << inAckno;
-			std::cerr << " vs: " << std::hex << (*it)->seqno << std::dec << std::endl;
-#endif
-
-			pkt = *it;
-			if ((*it)->seqno == inAckno)
-			{
-				//std::cerr << "\tFOUND MATCH!";
-				//std::cerr << std::endl;
-
-				found = true;
-				it = inPkt.erase(it);
-
-			}
+			pkt = next;
+			next = NULL;
+		}
+		else if ((it = inPkt.find(inAckno)) != inPkt.end())
+		{
+			pkt = it->second;
+			inPkt.erase(it);
+		}
+		else
+		{
+			found = false;
+		}
 
-			/* see if we can discard it */
-			/* if smaller seqno, and not wrapping around */
-			else if (isOldSequence((*it)->seqno, inAckno))
-			{
 #ifdef DEBUG_TCP_STREAM
-				std::cerr << "Discarding Old Packet expAck: " << std::hex << inAckno;
-				std::cerr << " seqno: " << std::hex << (*it)->seqno;
-				std::cerr << " pkt->size: " << std::hex << (*it)->datasize;
-				std::cerr << " pkt->seqno+size: " << std::hex << (*it)->seqno + (*it)->datasize;
-				std::cerr << std::dec << std::endl;
+		std::cerr << "Checking expInAck: " << std::hex << inAckno;
+		std::cerr << " found: " << found << std::dec << std::endl;
 #endif
 
-				/* discard */
-				it = inPkt.erase(it);
-				delete pkt;
-				
-			}
-			else
-			{
-				++it;
-			}
-		}
 		if (found)
 		{
 
@@ -1688,7 +1820,7 @@ int TcpStream::check_InPkts()
 			else
 			{
 				/* if it'll overflow the buffer. */
-				dataBuffer *db = new dataBuffer();
+				dataBuffer *db = newBuffer();
 
 				/* move outDatNet -> buffer */
 				memcpy((void *) db->data, (void *) outDataNet, outSizeNet);
@@ -1704,7 +1836,7 @@ int TcpStream::check_InPkts()
 				int remData = pkt->datasize - remSpace;
 				while(remData >= MAX_SEG)
 				{
-					db = new dataBuffer();
+					db = newBuffer();
 					memcpy((void *) db->data,  (void *) &(pkt->data[remSpace]), MAX_SEG);
 
 					remData -= MAX_SEG;
@@ -1809,7 +1941,7 @@ int TcpStream::check_InPkts()
 				}
 			}
 
-			delete pkt;
+			freePacket(pkt);
 
 		} /* end of found */
 	} /* while(found) */
@@ -1853,7 +1985,7 @@ int TcpStream::sendAck()
 	std::cerr << std::endl;
 #endif
 
-	return toSend(new TcpPacket(), false);
+	return toSend(newPacket(), false);
 }
 
 void TcpStream::setRemoteAddress(const struct sockaddr_in &raddr)
@@ -1875,7 +2007,7 @@ int TcpStream::toSend(TcpPacket *pkt, bool retrans)
 		std::cerr << "TcpStream::toSend() peerUnknown ERROR!!!";
 		std::cerr << std::endl;
 #endif
-		delete pkt;
+		freePacket(pkt);
 		return 0;
 	}
 
@@ -1909,6 +2041,7 @@ int TcpStream::toSend(TcpPacket *pkt, bool retrans)
 	{
 		/* cannot auto Ack SynPackets */
 		pkt -> setAck(inAckno);
+		fillSack(pkt);
 	}
 
 	pkt -> winsize = inWinSize;
@@ -1945,11 +2078,12 @@ int TcpStream::toSend(TcpPacket *pkt, bool retrans)
 		std::cerr << std::endl;
 #endif
 
+		/* send() leaves room for SYNs and data packets */
 		outPkt.push_back(pkt);
 	}
 	else
 	{
-		delete pkt;
+		freePacket(pkt);
 	}
 	return 1;
 }
@@ -2061,7 +2195,7 @@ int TcpStream::retrans()
 		return 0;
 	}
 
-	if (outPkt.begin() == outPkt.end())
+	if (outPkt.empty())
 	{
 		resetRetransmitTimer();
 		return 0;
@@ -2075,19 +2209,32 @@ int TcpStream::retrans()
 		return 0;
 	}
 	
-	/* retransmission -> adjust the congestWinSize and congestThreshold 
-	*/
+	/* retransmission -> adjust the congestion window,
+	 * (not for startup SYNs, nothing is known about the path yet)
+	 * and stay in recovery until everything sent so far is acked:
+	 * holes reported by selective acks will be resent as they come.
+	 */
 
-	congestThreshold = congestWinSize / 2;
-	congestWinSize = MAX_SEG;
-	congestUpdate  = outAcked + congestWinSize; // point when we can up the winSize.
+	if (!(pkt->hasSyn()))
+	{
+		congestCtrl->onTimeout(cts);
+
+		inRecovery = true;
+		recoveryByTimeout = true;
+		recoveryPoint = outSeqno;
+		dupAcks = 0;
+
+		for(size_t i = 0; i < outPkt.size(); i++)
+		{
+			outPkt[i]->lost = false;
+		}
+	}
 	
 #ifdef DEBUG_TCP_STREAM
 	std::cerr << "TcpStream::retrans() Adjusting Congestion Parameters: ";
 	std::cerr << std::endl;
-	std::cerr << "\tcongestWinSize: " << congestWinSize;
-	std::cerr << "  congestThreshold: " << congestThreshold;
-	std::cerr << "  congestUpdate: " << congestUpdate;
+	std::cerr << "\tcongestWinSize: " << congestCtrl->window();
+	std::cerr << "  congestThreshold: " << congestCtrl->threshold();
 	std::cerr << std::endl;
 #endif
 	
@@ -2095,6 +2242,7 @@ int TcpStream::retrans()
 	if (!(pkt->hasSyn()))
 	{
 		pkt->setAck(inAckno);
+		fillSack(pkt);
 		lastSentAck = pkt -> ackno;
 	}
 	
@@ -2191,6 +2339,7 @@ int TcpStream::retrans()
 	/* restart timers */
 	pkt->ts = cts;
 	pkt->retrans++;	
+	timeoutRetransCount++;
 	
 	/* 
 	 * finally - double the retransTimeout ... (Karn's Algorithm)
@@ -2216,51 +2365,20 @@ void TcpStream::acknowledge()
 {
 	/* cleans up acknowledge packets */
 	/* packets are pushed back in order */
-	std::list<TcpPacket *>::iterator it;
 	double cts = getCurrentTS();
 	bool updateRTT = true;
 	bool clearedPkts = false;
+	uint32 acked = 0;
 
-	for(it = outPkt.begin(); (it != outPkt.end()) && 
-			(isOldSequence((*it)->seqno, outAcked)); 
-			it = outPkt.erase(it))
+	while((!outPkt.empty()) && (isOldSequence(outPkt.front()->seqno, outAcked)))
 	{
-		TcpPacket *pkt = (*it);
+		TcpPacket *pkt = outPkt.front();
+		outPkt.pop_front();
 		clearedPkts = true;
-
-		/* adjust the congestWinSize and congestThreshold 
-		 * congestUpdate <= outAcked
-		 *
-		 ***/
-
-		if (!isOldSequence(outAcked, congestUpdate))
+		acked += pkt->datasize;
+		if (pkt->sacked)
 		{
-			if (congestWinSize < congestThreshold)
-			{
-				/* double it baby! */
-				congestWinSize *= 2;
-			}
-			else
-			{
-				/* linear increase */
-				congestWinSize += MAX_SEG;
-			}
-
-			if (congestWinSize > maxWinSize)
-			{
-				congestWinSize = maxWinSize;
-			}
-
-			congestUpdate  = outAcked + congestWinSize; // point when we can up the winSize.
-
-#ifdef DEBUG_TCP_STREAM
-			std::cerr << "TcpStream::acknowledge() Adjusting Congestion Parameters: ";
-			std::cerr << std::endl;
-			std::cerr << "\tcongestWinSize: " << congestWinSize;
-			std::cerr << "  congestThreshold: " << congestThreshold;
-			std::cerr << "  congestUpdate: " << congestUpdate;
-			std::cerr << std::endl;
-#endif
+			outSackedBytes -= pkt->datasize;
 		}
 
 
@@ -2325,7 +2443,29 @@ void TcpStream::acknowledge()
 		std::cerr << pkt->seqno << " size: " << pkt->datasize;
 		std::cerr << std::endl;
 #endif
-		delete pkt;
+		freePacket(pkt);
+	}
+
+	/* adjust the congestion window, it is frozen while recovering from
+	 * a loss, except after a timeout where it starts again from scratch.
+	 */
+	if ((inRecovery) && (!isOldSequence(outAcked, recoveryPoint)))
+	{
+		inRecovery = false;
+		recoveryByTimeout = false;
+	}
+
+	if ((acked) && ((!inRecovery) || (recoveryByTimeout)))
+	{
+		congestCtrl->onAck(acked, rtt_est, cts);
+
+#ifdef DEBUG_TCP_STREAM
+		std::cerr << "TcpStream::acknowledge() Adjusting Congestion Parameters: ";
+		std::cerr << std::endl;
+		std::cerr << "\tcongestWinSize: " << congestCtrl->window();
+		std::cerr << "  congestThreshold: " << congestCtrl->threshold();
+		std::cerr << std::endl;
+#endif
 	}
 
 	/* This is triggered if we have recieved acks for retransmitted packets....
@@ -2342,7 +2482,7 @@ void TcpStream::acknowledge()
 	 * if have acked all data - resetRetransTimer()
 	 */
 
-	if (it == outPkt.end())
+	if (outPkt.empty())
 	{
 
 #ifdef DEBUG_TCP_STREAM
@@ -2366,6 +2506,267 @@ void TcpStream::acknowledge()
 }
 
 
+/* Selective acks.
+ *
+ * The pseudo header has no room for TCP options, so a single SACK block is
+ * carried in the unused chksum/urgptr fields, as 16bit offset and length
+ * from the ackno (always within the 64K window). Old peers write zeros
+ * there, which means no block, and ignore what we send.
+ *
+ * As receiver, we report the block holding the latest out of order packet
+ * (like the first block of RFC 2018), and ack out of order packets at once.
+ * As sender, we mark the packets reported in blocks, and a packet is deemed
+ * lost when enough data past it has been selectively acked (RFC 6675), or
+ * after 3 duplicate acks when the peer does not send selective acks.
+ */
+
+static const uint32 kDupAckThreshold = 3;
+
+void TcpStream::updateSackBlock(TcpPacket *pkt)
+{
+	uint32 start = pkt->seqno;
+	uint32 end = pkt->seqno + pkt->datasize;
+
+	/* too far ahead to be reported */
+	if (end - inAckno > 0xffff)
+	{
+		return;
+	}
+
+	/* extend current block if contiguous, else start a new one */
+	if ((sackValid) && (!isOldSequence(end, sackBlockStart)) &&
+		(!isOldSequence(sackBlockEnd, start)))
+	{
+		if (isOldSequence(start, sackBlockStart))
+		{
+			sackBlockStart = start;
+		}
+		if (isOldSequence(sackBlockEnd, end))
+		{
+			sackBlockEnd = end;
+		}
+	}
+	else
+	{
+		sackBlockStart = start;
+		sackBlockEnd = end;
+		sackValid = true;
+	}
+}
+
+void TcpStream::fillSack(TcpPacket *pkt)
+{
+	pkt->sackStart = 0;
+	pkt->sackLength = 0;
+
+	if ((!sackValid) || (!isOldSequence(inAckno, sackBlockStart)))
+	{
+		return;
+	}
+
+	uint32 start = sackBlockStart - inAckno;
+	uint32 length = sackBlockEnd - sackBlockStart;
+	if (start > 0xffff)
+	{
+		return;
+	}
+	if (start + length > 0xffff)
+	{
+		length = 0xffff - start;
+	}
+
+	pkt->sackStart = start;
+	pkt->sackLength = length;
+}
+
+void TcpStream::processAck(TcpPacket *pkt)
+{
+	/* stale ack, reordered by the network */
+	if (isOldSequence(pkt->ackno, outAcked))
+	{
+		return;
+	}
+
+	if (pkt->ackno == outAcked)
+	{
+		/* duplicate: no data, no window change, and data outstanding */
+		if ((pkt->datasize == 0) && (!pkt->hasFin()) &&
+			(pkt->winsize == outWinSize) && (!outPkt.empty()))
+		{
+			dupAcks++;
+		}
+	}
+	else
+	{
+		dupAcks = 0;
+	}
+
+	if (pkt->sackLength == 0)
+	{
+		return;
+	}
+
+	peerSack = true;
+
+	uint32 start = pkt->ackno + pkt->sackStart;
+	uint32 end = start + pkt->sackLength;
+
+	for(size_t i = outPktIndex(start); i < outPkt.size(); i++)
+	{
+		TcpPacket *opkt = outPkt[i];
+		if (isOldSequence(end, opkt->seqno + opkt->datasize))
+		{
+			break;
+		}
+		if ((opkt->datasize > 0) && (!opkt->sacked))
+		{
+			opkt->sacked = true;
+			outSackedBytes += opkt->datasize;
+			sackedPktCount++;
+		}
+	}
+}
+
+/* index in outPkt of the first packet with seqno >= the given one.
+ * Segments are mostly MAX_SEG long, so the first guess usually hits.
+ */
+size_t TcpStream::outPktIndex(uint32 seqno)
+{
+	if ((outPkt.empty()) || (!isOldSequence(outPkt.front()->seqno, seqno)))
+	{
+		return 0;
+	}
+
+	size_t guess = (seqno - outPkt.front()->seqno) / MAX_SEG;
+	if ((guess < outPkt.size()) && (outPkt[guess]->seqno == seqno))
+	{
+		return guess;
+	}
+
+	size_t low = 0;
+	size_t high = outPkt.size();
+	while(low < high)
+	{
+		size_t mid = (low + high) / 2;
+		if (isOldSequence(outPkt[mid]->seqno, seqno))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+int TcpStream::fastRetransmit(double cts)
+{
+	/* newest first */
+	std::vector<TcpPacket *> lostPkts;
+
+	/* walk back from the newest packet, counting selectively acked ones */
+	uint32 sackedAbove = 0;
+	for(size_t i = outPkt.size(); (outSackedBytes > 0) && (i > 0); i--)
+	{
+		TcpPacket *pkt = outPkt[i - 1];
+		if (isOldSequence(pkt->seqno, outAcked) || pkt->hasSyn())
+		{
+			break; /* acked, and so are the older ones */
+		}
+
+		if (pkt->sacked)
+		{
+			sackedAbove++;
+		}
+		else if ((!pkt->lost) && (sackedAbove >= kDupAckThreshold))
+		{
+			lostPkts.push_back(pkt);
+		}
+	}
+
+	/* without selective acks: duplicate acks, or a partial ack while
+	 * recovering (NewReno) point at the first unacked packet.
+	 */
+	if ((lostPkts.empty()) && (!peerSack) &&
+		((dupAcks >= kDupAckThreshold) || ((inRecovery) && (dupAcks == 0) &&
+		isOldSequence(outAcked, recoveryPoint))))
+	{
+		size_t i = outPktIndex(outAcked);
+		if (i < outPkt.size())
+		{
+			TcpPacket *pkt = outPkt[i];
+			if ((pkt->seqno == outAcked) && (!pkt->lost) &&
+				(!pkt->hasSyn()) && (pkt->datasize > 0))
+			{
+				lostPkts.push_back(pkt);
+			}
+		}
+	}
+
+	if (lostPkts.empty())
+	{
+		return 0;
+	}
+
+	/* react to congestion once per window */
+	if (!inRecovery)
+	{
+		congestCtrl->onLoss(cts);
+		inRecovery = true;
+		recoveryByTimeout = false;
+		recoveryPoint = outSeqno;
+
+#ifdef DEBUG_TCP_STREAM_RETRANS
+		std::cerr << "TcpStream::fastRetransmit() peer: " << peeraddr;
+		std::cerr << " entering recovery, congestWinSize: " << congestCtrl->window();
+		std::cerr << std::endl;
+#endif
+	}
+
+	int count = 0;
+	for(size_t i = lostPkts.size(); i > 0; i--)
+	{
+		lostPkts[i - 1]->lost = true;
+		resend(lostPkts[i - 1], cts);
+		count++;
+	}
+	fastRetransCount += count;
+
+#ifdef DEBUG_TCP_STREAM_RETRANS
+	std::cerr << "TcpStream::fastRetransmit() peer: " << peeraddr;
+	std::cerr << " resent " << count << " packets";
+	std::cerr << std::endl;
+#endif
+
+	return count;
+}
+
+int TcpStream::resend(TcpPacket *pkt, double cts)
+{
+	int  outPktSize = MAX_SEG + TCP_PSEUDO_HDR_SIZE;
+	char tmpOutPkt[outPktSize];
+
+	/* update ackno and winsize */
+	pkt->setAck(inAckno);
+	fillSack(pkt);
+	lastSentAck = pkt -> ackno;
+
+	pkt->winsize = inWinSize;
+	lastSentWinSize = pkt -> winsize;
+
+	keepAliveTimer = cts;
+
+	pkt->writePacket(tmpOutPkt, outPktSize);
+	udp -> sendPkt(tmpOutPkt, outPktSize, peeraddr, ttl);
+
+	/* not usable for RTT estimates any more (Karn's Algorithm) */
+	pkt->ts = cts;
+	pkt->retrans++;
+
+	return 1;
+}
+
 int TcpStream::send()
 {
 	/* handle network interface always */
@@ -2384,13 +2785,10 @@ int TcpStream::send()
 
 
 	/* determine exactly how much we can send */
-	uint32 maxsend = congestWinSize;
+	uint32 congestWinSize = congestCtrl->window();
+	uint32 maxsend = 0;
 	uint32 inTransit;
-
-	if (outWinSize < congestWinSize)
-	{
-		maxsend = outWinSize;
-	}
+	uint32 inPipe;
 
 	if (outSeqno < outAcked)
 	{
@@ -2401,9 +2799,26 @@ int TcpStream::send()
 		inTransit = outSeqno - outAcked;
 	}
 
-	if (maxsend > inTransit)
+	/* selectively acked data has left the network,
+	 * but still uses the peer's window.
+	 */
+	inPipe = 0;
+	if (inTransit > outSackedBytes)
+	{
+		inPipe = inTransit - outSackedBytes;
+	}
+
+	if (congestWinSize > inPipe)
 	{
-		maxsend -= inTransit;
+		maxsend = congestWinSize - inPipe;
+	}
+
+	if (outWinSize > inTransit)
+	{
+		if (outWinSize - inTransit < maxsend)
+		{
+			maxsend = outWinSize - inTransit;
+		}
 	}
 	else
 	{
@@ -2416,21 +2831,22 @@ int TcpStream::send()
 		std::cerr << "oWS: " << outWinSize;
 		std::cerr << " cWS: " << congestWinSize;
 		std::cerr << " | inT: " << inTransit;
+		std::cerr << " inP: " << inPipe;
 		std::cerr << " mSnd: " << maxsend;
 		std::cerr << " aSnd: " << availSend;
 		std::cerr << " | oSeq: " << outSeqno;
 		std::cerr << "  oAck: " << outAcked;
-		std::cerr << "  cUpd: " << congestUpdate;
+		std::cerr << "  rec: " << inRecovery;
 		std::cerr << std::endl;
 #endif
 
 	int sent = 0;
-	while((inQueue.size() > 0) && (maxsend >= MAX_SEG))
+	while((inQueue.size() > 0) && (maxsend >= MAX_SEG) && (!outPkt.full()))
 	{
 		dataBuffer *db = inQueue.front();
 		inQueue.pop_front();
 
-		TcpPacket *pkt = new TcpPacket(db->data, MAX_SEG);
+		TcpPacket *pkt = newPacket(db->data, MAX_SEG);
 #ifdef DEBUG_TCP_STREAM
 		std::cerr << "TcpStream::send() Segment ===> Seqno: ";
 		std::cerr << pkt->seqno << " size: " << pkt->datasize;
@@ -2439,13 +2855,14 @@ int TcpStream::send()
 		sent++;
 		maxsend -= MAX_SEG;
 		toSend(pkt);
-		delete db;
+		freeBuffer(db);
 	}
 
 	/* if inqueue empty, and enough window space, send partial stuff */
-	if ((!sent) && (inQueue.empty()) && (maxsend >= inSize) && (inSize))
+	if ((!sent) && (inQueue.empty()) && (maxsend >= inSize) && (inSize) &&
+		(!outPkt.full()))
 	{
-		TcpPacket *pkt = new TcpPacket(inData, inSize);
+		TcpPacket *pkt = newPacket(inData, inSize);
 #ifdef DEBUG_TCP_STREAM
 		std::cerr << "TcpStream::send() Remaining ===>";
 		std::cerr << std::endl;
@@ -2505,7 +2922,7 @@ int TcpStream::send()
 			((state == TCP_ESTABLISHED) || (state == TCP_CLOSE_WAIT)))
 		{
 			/* finish the stream */
-			TcpPacket *pkt = new TcpPacket();
+			TcpPacket *pkt = newPacket();
 			pkt -> setFin();
 
 			needsAck = false;
@@ -2562,6 +2979,33 @@ int TcpStream::send()
 }
 
 
+TcpPacket *TcpStream::newPacket(uint8 *ptr, int size)
+{
+	TcpPacket *pkt = pktPool.get();
+	pkt->clear();
+	if (size > 0)
+	{
+		pkt->setData(ptr, size);
+	}
+	return pkt;
+}
+
+void TcpStream::freePacket(TcpPacket *pkt)
+{
+	pktPool.put(pkt);
+}
+
+dataBuffer *TcpStream::newBuffer()
+{
+	return bufPool.get();
+}
+
+void TcpStream::freeBuffer(dataBuffer *db)
+{
+	bufPool.put(db);
+}
+
+
 uint32 TcpStream::genSequenceNo()
 {
 	return RSRandom::random_u32();
@@ -2601,9 +3045,20 @@ bool 	TcpStream::isOldSequence(uint32 tst, uint32 curr)
 #include <sys/timeb.h>
 #endif
 
+static double (*tcpClock)() = NULL;
+
+void	TcpStream::setClock(double (*clock)())
+{
+	tcpClock = clock;
+}
+
 // Little fn to get current timestamp in an independent manner.
 static double getCurrentTS()
 {
+	if (tcpClock)
+	{
+		return tcpClock();
+	}
 
 #ifndef WINDOWS_SYS
         struct timeval cts_tmp;
@@ -2728,9 +3183,18 @@ int TcpStream::dumpstate_locked(std::ostream &out)
 	out << " rtt_dev: " << rtt_dev;
 	out << std::endl;
 
-	out << "(congestion) congestThreshold: " << congestThreshold;
-	out << " congestWinSize: " << congestWinSize;
-	out << " congestUpdate: " << congestUpdate;
+	out << "(congestion) " << congestCtrl->name();
+	out << " congestThreshold: " << congestCtrl->threshold();
+	out << " congestWinSize: " << congestCtrl->window();
+	out << " inRecovery: " << inRecovery;
+	out << " recoveryPoint: " << recoveryPoint;
+	out << " dupAcks: " << dupAcks;
+	out << std::endl;
+
+	out << "(sack) peerSack: " << peerSack;
+	out << " sackValid: " << sackValid;
+	out << " sackBlockStart: " << sackBlockStart;
+	out << " sackBlockEnd: " << sackBlockEnd;
 	out << std::endl;
 
 	out << "(TTL) mTTL_period: " << mTTL_period;
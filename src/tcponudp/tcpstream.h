@@ -30,6 +30,8 @@
  */
 
 #include "tcppacket.h"
+#include "tcpcongestion.h"
+#include "tcpqueue.h"
 #include "udppeer.h"
 
 // WINDOWS doesn't like UDP packets bigger than 1492 (truncates them). 
@@ -45,6 +47,7 @@
 #define TCP_RETRANS_TIMEOUT	1	/* 1 sec (Initial value) */
 #define TCP_RETRANS_MAX_TIMEOUT	15	/* 15 secs */
 #define kNoPktTimeout		60	/* 1 min */
+#define TCP_MAX_OUT_PKTS	256	/* packets waiting for acks (> TCP_MAX_WIN / MAX_SEG) */
 
 
 #define	TCP_CLOSED 	0
@@ -67,6 +70,7 @@ class dataBuffer
 
 #include <list>
 #include <deque>
+#include <unordered_map>
 
 
 class TcpStream: public UdpPeer
@@ -75,7 +79,7 @@ class TcpStream: public UdpPeer
 	/* Top-Level exposed */
 
 	TcpStream(UdpSubReceiver *udp);
-virtual ~TcpStream() { return; }
+virtual ~TcpStream() { delete congestCtrl; }
 
 	/* user interface */
 int     status(std::ostream &out);
@@ -83,6 +87,9 @@ int     connect(const struct sockaddr_in &raddr, uint32_t conn_period);
 int 	listenfor(const struct sockaddr_in &raddr);
 bool    isConnected();
 
+	/* congestion control algorithm (CUBIC by default) */
+void	setCongestionControl(TcpCongestionType type);
+
 	/* get tcp information */
 bool 	getRemoteAddress(struct sockaddr_in &raddr);
 uint8	TcpState();
@@ -112,6 +119,14 @@ bool 	ridle(); /* read idle */
 uint32 	wbytes();
 uint32 	rbytes();
 
+	/* retransmission counts, since the stream was created */
+uint32	timeoutRetransmits(); /* resent on retransmit timeout */
+uint32	fastRetransmits(); /* resent on selective or duplicate acks */
+uint32	sackedPkts(); /* marked received by selective acks of the peer */
+
+	/* clock of all streams, for tests to simulate time (NULL: system clock) */
+static void setClock(double (*clock)());
+
 	/* Exposed for debugging */
 int     dumpstate(std::ostream &out);
 
@@ -145,7 +160,7 @@ int 	incoming_TimedWait(TcpPacket *pkt);
 int 	incoming_Closing(TcpPacket *pkt);
 int 	incoming_CloseWait(TcpPacket *pkt);
 int 	incoming_LastAck(TcpPacket *pkt);
-int 	check_InPkts();
+int 	check_InPkts(TcpPacket *next = NULL); /* next: in order, not queued */
 int 	UpdateInWinSize();
 int	int_read_pending();
 
@@ -154,6 +169,18 @@ int	send();
 int 	toSend(TcpPacket *pkt, bool retrans = true);
 void 	acknowledge();
 int	retrans();
+int	resend(TcpPacket *pkt, double cts);
+void	processAck(TcpPacket *pkt);
+int	fastRetransmit(double cts);
+void	updateSackBlock(TcpPacket *pkt);
+void	fillSack(TcpPacket *pkt);
+size_t	outPktIndex(uint32 seqno);
+
+/* packet and buffer recycling */
+TcpPacket *newPacket(uint8 *ptr = NULL, int size = 0);
+void	freePacket(TcpPacket *pkt);
+dataBuffer *newBuffer();
+void	freeBuffer(dataBuffer *db);
 int	sendAck();
 void 	setRemoteAddress(const struct sockaddr_in &raddr);
 
@@ -190,8 +217,16 @@ uint32 	int_rbytes();
 	/* get packed into here as size increases */
 	std::deque<dataBuffer *>   inQueue, outQueue;
 
-	/* packets waiting for acks */
-	std::list<TcpPacket *> inPkt, outPkt;
+	/* out of order packets, by seqno, waiting for the holes before them */
+	std::unordered_map<uint32, TcpPacket *> inPkt;
+
+	/* packets waiting for acks, in seqno order */
+	TcpRing<TcpPacket *> outPkt;
+	uint32 outSackedBytes; /* data of the selectively acked ones */
+
+	/* all packets and dataBuffers of the stream come from there */
+	TcpSlabPool<TcpPacket> pktPool;
+	TcpSlabPool<dataBuffer> bufPool;
 
 
 	uint8  state; /* stream state */
@@ -213,6 +248,9 @@ uint32 	int_rbytes();
 	bool   retransTimerOn;
 	double retransTimeout;
 	double retransTimerTs;
+	uint32 timeoutRetransCount;
+	uint32 fastRetransCount;
+	uint32 sackedPktCount;
 
 	/* some timers */
 	double keepAliveTimer;
@@ -233,10 +271,18 @@ uint32 	int_rbytes();
 	double rtt_est;
 	double rtt_dev;
 
-	/* congestion limits */
-	uint32 congestThreshold;
-	uint32 congestWinSize;
-	uint32 congestUpdate;
+	/* congestion control */
+	TcpCongestionControl *congestCtrl;
+	bool   inRecovery;    /* resending losses, until recoveryPoint is acked */
+	bool   recoveryByTimeout; /* recovery entered by timeout: keep growing */
+	uint32 recoveryPoint; /* outSeqno when recovery started */
+	uint32 dupAcks;
+	bool   peerSack;      /* peer sends selective acks */
+
+	/* selective ack: latest block of out of order data we hold */
+	bool   sackValid;
+	uint32 sackBlockStart;
+	uint32 sackBlockEnd;
 
 	/* existing TTL for this stream (tweaked at startup) */
 	int ttl;
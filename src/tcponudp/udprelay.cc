@@ -22,7 +22,6 @@
 #include "udprelay.h"
 #include <iostream>
 #include "util/rstime.h"
-#include <util/rsmemory.h>
 
 /*
  * #define DEBUG_UDP_RELAY 		1
@@ -48,7 +47,8 @@ int displayUdpRelayPacketHeader(const void *data, const int size);
 
 
 UdpRelayReceiver::UdpRelayReceiver(UdpPublisher *pub)
-	:UdpSubReceiver(pub), udppeerMtx("UdpSubReceiver"), relayMtx("UdpSubReceiver")
+	:UdpSubReceiver(pub), udppeerMtx("UdpSubReceiver"), streamMtx("UdpSubReceiver"),
+	relayMtx("UdpSubReceiver")
 {
 	mClassLimit.resize(UDP_RELAY_NUM_CLASS);
 	mClassCount.resize(UDP_RELAY_NUM_CLASS);
@@ -66,10 +66,6 @@ UdpRelayReceiver::UdpRelayReceiver(UdpPublisher *pub)
 	setRelayClassMax(UDP_RELAY_CLASS_FOF,     UDP_RELAY_DEFAULT_FOF, UDP_RELAY_DEFAULT_BANDWIDTH);
 	setRelayClassMax(UDP_RELAY_CLASS_GENERAL, UDP_RELAY_DEFAULT_GENERAL, UDP_RELAY_DEFAULT_BANDWIDTH);
 
-	/* only allocate this space once */
-	mTmpSendPkt = rs_malloc(MAX_RELAY_UDP_PACKET_SIZE);
-	mTmpSendSize = MAX_RELAY_UDP_PACKET_SIZE;
-
 	clearDataTransferred();
 
 	return;
@@ -77,7 +73,7 @@ UdpRelayReceiver::UdpRelayReceiver(UdpPublisher *pub)
 
 UdpRelayReceiver::~UdpRelayReceiver()
 {
-	free(mTmpSendPkt);
+	return;
 }
 
 
@@ -85,10 +81,10 @@ int     UdpRelayReceiver::addUdpPeer(UdpPeer *peer, UdpRelayAddrSet *endPoints,
 {
 	struct sockaddr_in realPeerAddr = endPoints->mDestAddr;
 	{
-		RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
+		RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
 		
 		/* check for duplicate */
-		std::map<struct sockaddr_in, UdpRelayEnd>::iterator it;
+		std::unordered_map<struct sockaddr_in, UdpRelayEnd, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator it;
 		it = mStreams.find(realPeerAddr);
 		bool ok = (it == mStreams.end());
 		if (!ok)
@@ -135,7 +131,7 @@ int     UdpRelayReceiver::removeUdpPeer(UdpPeer *peer)
 	{
 		RsStackMutex stack(udppeerMtx);   /********** LOCK MUTEX *********/
 		
-		std::map<struct sockaddr_in, UdpPeer *>::iterator it;
+		std::unordered_map<struct sockaddr_in, UdpPeer *, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator it;
 		for(it = mPeers.begin(); it != mPeers.end(); ++it)
 		{
 			if (it->second == peer)
@@ -162,9 +158,9 @@ int     UdpRelayReceiver::removeUdpPeer(UdpPeer *peer)
 
 	/* now we cleanup the associated data */
 	{
-		RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
+		RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
 		
-		std::map<struct sockaddr_in, UdpRelayEnd>::iterator it;
+		std::unordered_map<struct sockaddr_in, UdpRelayEnd, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator it;
 		it = mStreams.find(realPeerAddr);
 		if (it != mStreams.end())
 		{
@@ -183,9 +179,9 @@ int     UdpRelayReceiver::removeUdpPeer(UdpPeer *peer)
 
 int UdpRelayReceiver::getRelayEnds(std::list<UdpRelayEnd> &relayEnds)
 {
-        RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
+        RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
 
-	std::map<struct sockaddr_in, UdpRelayEnd>::iterator rit;
+	std::unordered_map<struct sockaddr_in, UdpRelayEnd, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator rit;
 	
 	for(rit = mStreams.begin(); rit != mStreams.end(); ++rit)
 	{
@@ -198,13 +194,15 @@ int UdpRelayReceiver::getRelayEnds(std::list<UdpRelayEnd> &relayEnds)
 
 int UdpRelayReceiver::getRelayProxies(std::list<UdpRelayProxy> &relayProxies)
 {
-        RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
-
-	std::map<UdpRelayAddrSet, UdpRelayProxy>::iterator rit;
-	
-	for(rit = mRelays.begin(); rit != mRelays.end(); ++rit)
+	for(int i = 0; i < UDP_RELAY_NB_SHARDS; i++)
 	{
-		relayProxies.push_back(rit->second);
+		RsStackMutex stack(mShards[i].mShardMtx);   /********** LOCK MUTEX *********/
+
+		std::unordered_map<UdpRelayAddrSet, UdpRelayProxy, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator rit;
+		for(rit = mShards[i].mRelays.begin(); rit != mShards[i].mRelays.end(); ++rit)
+		{
+			relayProxies.push_back(rit->second);
+		}
 	}
 	return 1;
 }
@@ -212,6 +210,17 @@ int UdpRelayReceiver::getRelayProxies(std::list<UdpRelayProxy> &relayProxies)
 #define RELAY_MAX_BANDWIDTH 1000
 #define RELAY_TIMEOUT		30
 
+/* token bucket size: a few packets at least, so the limit can be reached */
+static double relayBurst(double bandwidthLimit)
+{
+	double burst = bandwidthLimit * UDP_RELAY_BURST_SECS;
+	if (burst < 2 * MAX_RELAY_UDP_PACKET_SIZE)
+	{
+		burst = 2 * MAX_RELAY_UDP_PACKET_SIZE;
+	}
+	return burst;
+}
+
 
 int UdpRelayReceiver::checkRelays()
 {
@@ -231,94 +240,111 @@ int UdpRelayReceiver::checkRelays()
 #endif
 
 	std::list<UdpRelayAddrSet> eraseList;
-	std::map<UdpRelayAddrSet, UdpRelayProxy>::iterator rit;
 	rstime_t now = time(NULL);
 
 #define BANDWIDTH_FILTER_K	(0.8)
 	
-	for(rit = mRelays.begin(); rit != mRelays.end(); ++rit)
+	for(int i = 0; i < UDP_RELAY_NB_SHARDS; i++)
 	{
-		/* calc bandwidth */
-		//rit->second.mBandwidth = rit->second.mDataSize / (float) (now - rit->second.mLastBandwidthTS);
-		// Switch to a Low-Pass Filter to average it out.
-		float instantBandwidth = rit->second.mDataSize / (float) (now - rit->second.mLastBandwidthTS);
+		RsStackMutex shardStack(mShards[i].mShardMtx);   /********** LOCK MUTEX *********/
+
+		std::unordered_map<UdpRelayAddrSet, UdpRelayProxy, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator rit;
+		for(rit = mShards[i].mRelays.begin(); rit != mShards[i].mRelays.end(); ++rit)
+		{
+			/* calc bandwidth (not twice in a second, would divide by 0) */
+			bool overLimit = false;
+			float instantBandwidth = 0;
+			if (now > rit->second.mLastBandwidthTS)
+			{
+				//rit->second.mBandwidth = rit->second.mDataSize / (float) (now - rit->second.mLastBandwidthTS);
+				// Switch to a Low-Pass Filter to average it out.
+				float period = now - rit->second.mLastBandwidthTS;
+				instantBandwidth = rit->second.mDataSize / period;
 	
-		rit->second.mBandwidth *= (BANDWIDTH_FILTER_K);
-		rit->second.mBandwidth += (1.0 - BANDWIDTH_FILTER_K) * instantBandwidth;
+				rit->second.mBandwidth *= (BANDWIDTH_FILTER_K);
+				rit->second.mBandwidth += (1.0 - BANDWIDTH_FILTER_K) * instantBandwidth;
 
-		rit->second.mDataSize = 0;
-		rit->second.mLastBandwidthTS = now;
+				/* relayed data is shaped by the token bucket, which lets
+				 * a burst through on top of the limit over the period.
+				 */
+				overLimit = (rit->second.mBandwidth > rit->second.mBandwidthLimit
+						+ relayBurst(rit->second.mBandwidthLimit) / period);
+
+				rit->second.mDataSize = 0;
+				rit->second.mLastBandwidthTS = now;
+			}
 
 #ifdef DEBUG_UDP_RELAY
-		std::cerr << "UdpRelayReceiver::checkRelays()";
-		std::cerr << "Relay: " << rit->first;
-		std::cerr << " using bandwidth: " << rit->second.mBandwidth;
-		std::cerr << std::endl;
+			std::cerr << "UdpRelayReceiver::checkRelays()";
+			std::cerr << "Relay: " << rit->first;
+			std::cerr << " using bandwidth: " << rit->second.mBandwidth;
+			std::cerr << std::endl;
 #endif
 
-		// ONLY A WARNING.
+			// ONLY A WARNING.
 #ifdef DEBUG_UDP_RELAY
-		if (instantBandwidth > rit->second.mBandwidthLimit)
-		{
-			std::cerr << "UdpRelayReceiver::checkRelays() ";
-			std::cerr << "Warning instantBandwidth: " << instantBandwidth;
-			std::cerr << " Exceeding Limit: " << rit->second.mBandwidthLimit;
-			std::cerr << " for Relay: " << rit->first;
-			std::cerr << std::endl;
-		}
+			if (instantBandwidth > rit->second.mBandwidthLimit)
+			{
+				std::cerr << "UdpRelayReceiver::checkRelays() ";
+				std::cerr << "Warning instantBandwidth: " << instantBandwidth;
+				std::cerr << " Exceeding Limit: " << rit->second.mBandwidthLimit;
+				std::cerr << " for Relay: " << rit->first;
+				std::cerr << std::endl;
+			}
 #endif
 
-		if (rit->second.mBandwidth > rit->second.mBandwidthLimit)
-		{
+			if (overLimit)
+			{
 #ifdef DEBUG_UDP_RELAY_ERRORS
-			std::cerr << "UdpRelayReceiver::checkRelays() ";
-			std::cerr << "Dropping Relay due to excessive Bandwidth: " << rit->second.mBandwidth;
-			std::cerr << " Exceeding Limit: " << rit->second.mBandwidthLimit;
-			std::cerr << " Relay: " << rit->first;
-			std::cerr << std::endl;
+				std::cerr << "UdpRelayReceiver::checkRelays() ";
+				std::cerr << "Dropping Relay due to excessive Bandwidth: " << rit->second.mBandwidth;
+				std::cerr << " Exceeding Limit: " << rit->second.mBandwidthLimit;
+				std::cerr << " Relay: " << rit->first;
+				std::cerr << std::endl;
 #endif
 
-			/* if exceeding bandwidth -> drop */
-			eraseList.push_back(rit->first);
-		}
-		else if (now - rit->second.mLastTS > RELAY_TIMEOUT)
-		{
+				/* if exceeding bandwidth -> drop */
+				eraseList.push_back(rit->first);
+			}
+			else if (now - rit->second.mLastTS > RELAY_TIMEOUT)
+			{
 #ifdef DEBUG_UDP_RELAY_ERRORS
-			/* if haven't transmitted for ages -> drop */
-			std::cerr << "UdpRelayReceiver::checkRelays() ";
-			std::cerr << "Dropping Relay due to Timeout: " << rit->first;
-			std::cerr << std::endl;
+				/* if haven't transmitted for ages -> drop */
+				std::cerr << "UdpRelayReceiver::checkRelays() ";
+				std::cerr << "Dropping Relay due to Timeout: " << rit->first;
+				std::cerr << std::endl;
 #endif
-			eraseList.push_back(rit->first);
-		}
-		else
-		{
-			/* check the length of the relay - we will drop them after a certain amount of time */
-			int lifetime = 0;
-			switch(rit->second.mRelayClass)
-			{
-				default:
-			    case UDP_RELAY_CLASS_GENERAL:
-					lifetime = UDP_RELAY_LIFETIME_GENERAL;
-					break;
-			    case UDP_RELAY_CLASS_FOF:
-					lifetime = UDP_RELAY_LIFETIME_FOF;
-					break;
-			    case UDP_RELAY_CLASS_FRIENDS:
-					lifetime = UDP_RELAY_LIFETIME_FRIENDS;
-					break;
+				eraseList.push_back(rit->first);
 			}
-			if (now - rit->second.mStartTS > lifetime)
+			else
 			{
+				/* check the length of the relay - we will drop them after a certain amount of time */
+				int lifetime = 0;
+				switch(rit->second.mRelayClass)
+				{
+					default:
+				    case UDP_RELAY_CLASS_GENERAL:
+						lifetime = UDP_RELAY_LIFETIME_GENERAL;
+						break;
+				    case UDP_RELAY_CLASS_FOF:
+						lifetime = UDP_RELAY_LIFETIME_FOF;
+						break;
+				    case UDP_RELAY_CLASS_FRIENDS:
+						lifetime = UDP_RELAY_LIFETIME_FRIENDS;
+						break;
+				}
+				if (now - rit->second.mStartTS > lifetime)
+				{
 #ifdef DEBUG_UDP_RELAY
-				std::cerr << "UdpRelayReceiver::checkRelays() ";
-				std::cerr << "Dropping Relay due to Passing Lifetime Limit: " << lifetime;
-				std::cerr << " for class: " << rit->second.mRelayClass;
-				std::cerr << " Relay: " << rit->first;
-				std::cerr << std::endl;
+					std::cerr << "UdpRelayReceiver::checkRelays() ";
+					std::cerr << "Dropping Relay due to Passing Lifetime Limit: " << lifetime;
+					std::cerr << " for class: " << rit->second.mRelayClass;
+					std::cerr << " Relay: " << rit->first;
+					std::cerr << std::endl;
 #endif
 
-				eraseList.push_back(rit->first);
+					eraseList.push_back(rit->first);
+				}
 			}
 		}
 	}
@@ -350,8 +376,13 @@ int UdpRelayReceiver::addUdpRelay(UdpRelayAddrSet *addrSet, int &relayClass, uin
 	RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
 
 	/* check for duplicate */
-	std::map<UdpRelayAddrSet, UdpRelayProxy>::iterator rit = mRelays.find(*addrSet);
-	int ok = (rit == mRelays.end());
+	int ok = 0;
+	{
+		RelayShard &shard = shardOf(*addrSet);
+		RsStackMutex shardStack(shard.mShardMtx);   /********** LOCK MUTEX *********/
+
+		ok = (shard.mRelays.find(*addrSet) == shard.mRelays.end());
+	}
 	if (!ok)
 	{
 #ifdef DEBUG_UDP_RELAY_ERRORS
@@ -372,8 +403,16 @@ int UdpRelayReceiver::addUdpRelay(UdpRelayAddrSet *addrSet, int &relayClass, uin
 		UdpRelayProxy altUdpRelay(&alt, relayClass, bandwidth);
 
 		/* must install two (A, B) & (B, A) */
-		mRelays[*addrSet] = udpRelay;
-		mRelays[alt] = altUdpRelay;
+		{
+			RelayShard &shard = shardOf(*addrSet);
+			RsStackMutex shardStack(shard.mShardMtx);   /********** LOCK MUTEX *********/
+			shard.mRelays[*addrSet] = udpRelay;
+		}
+		{
+			RelayShard &shard = shardOf(alt);
+			RsStackMutex shardStack(shard.mShardMtx);   /********** LOCK MUTEX *********/
+			shard.mRelays[alt] = altUdpRelay;
+		}
 
 		/* grab bandwidth from one set */
 		bandwidth = altUdpRelay.mBandwidthLimit;
@@ -396,8 +435,8 @@ int UdpRelayReceiver::removeUdpRelay_relayLocked(UdpRelayAddrSet *addrSet)
 #endif
 
 	/* find in Relay list */
-        std::map<UdpRelayAddrSet, UdpRelayProxy>::iterator rit = mRelays.find(*addrSet);
-	if (rit == mRelays.end())
+	int relayClass = 0;
+	if (!eraseUdpRelay_relayLocked(*addrSet, relayClass))
 	{
 		/* ERROR */
 		std::cerr << "UdpRelayReceiver::removeUdpRelay()";
@@ -407,26 +446,37 @@ int UdpRelayReceiver::removeUdpRelay_relayLocked(UdpRelayAddrSet *addrSet)
 	else
 	{
 		/* lets drop the count here too */
-		removeRelayClass_relayLocked(rit->second.mRelayClass);
-		mRelays.erase(rit);
+		removeRelayClass_relayLocked(relayClass);
 	}
 
 	/* rotate around and delete matching set */
 	UdpRelayAddrSet alt = addrSet->flippedSet();
 
-	rit = mRelays.find(alt);
-	if (rit == mRelays.end())
+	if (!eraseUdpRelay_relayLocked(alt, relayClass))
 	{
 		std::cerr << "UdpRelayReceiver::removeUdpRelay()";
 		std::cerr << "ERROR Finding Alt Relay: " << alt;
 		std::cerr << std::endl;
 		/* ERROR */
 	}
-	else
+	return 1;
+}
+
+bool UdpRelayReceiver::eraseUdpRelay_relayLocked(const UdpRelayAddrSet &addrSet, int &relayClass)
+{
+	RelayShard &shard = shardOf(addrSet);
+	RsStackMutex shardStack(shard.mShardMtx);   /********** LOCK MUTEX *********/
+
+	std::unordered_map<UdpRelayAddrSet, UdpRelayProxy, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator rit;
+	rit = shard.mRelays.find(addrSet);
+	if (rit == shard.mRelays.end())
 	{
-		mRelays.erase(rit);
+		return false;
 	}
-	return 1;
+
+	relayClass = rit->second.mRelayClass;
+	shard.mRelays.erase(rit);
+	return true;
 }
 
         /* Need some stats, to work out how many relays we are supporting 	
@@ -607,17 +657,23 @@ int UdpRelayReceiver::RelayStatus(std::ostream &out)
 	out << "UdpRelayReceiver::RelayStatus()";
 	out << std::endl;
 
-	std::map<UdpRelayAddrSet, UdpRelayProxy>::iterator rit;
-	for(rit = mRelays.begin(); rit != mRelays.end(); ++rit)
+	for(int i = 0; i < UDP_RELAY_NB_SHARDS; i++)
 	{
-		out << "Relay for: " << rit->first;
-		out << std::endl;
+		RsStackMutex shardStack(mShards[i].mShardMtx);   /********** LOCK MUTEX *********/
 
-		out << "\tClass: " << rit->second.mRelayClass;
-		out << "\tBandwidth: " << rit->second.mBandwidth;
-		out << "\tDataSize: " << rit->second.mDataSize;
-		out << "\tLastBandwidthTS: " << rit->second.mLastBandwidthTS;
-		out << std::endl;
+		std::unordered_map<UdpRelayAddrSet, UdpRelayProxy, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator rit;
+		for(rit = mShards[i].mRelays.begin(); rit != mShards[i].mRelays.end(); ++rit)
+		{
+			out << "Relay for: " << rit->first;
+			out << std::endl;
+
+			out << "\tClass: " << rit->second.mRelayClass;
+			out << "\tBandwidth: " << rit->second.mBandwidth;
+			out << "\tDataSize: " << rit->second.mDataSize;
+			out << "\tDropped: " << rit->second.mDroppedSize;
+			out << "\tLastBandwidthTS: " << rit->second.mLastBandwidthTS;
+			out << std::endl;
+		}
 	}
 
 	out << "ClassLimits:" << std::endl;
@@ -641,11 +697,11 @@ int     UdpRelayReceiver::status(std::ostream &out)
 	RelayStatus(out);
 
 	{
-		RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
+		RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
 
 		out << "UdpRelayReceiver::Connections:" << std::endl;
 
-		std::map<struct sockaddr_in, UdpRelayEnd>::iterator pit;
+		std::unordered_map<struct sockaddr_in, UdpRelayEnd, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator pit;
 		for(pit = mStreams.begin(); pit != mStreams.end(); ++pit)
 		{
 			out << "\t" << pit->first << " : " << pit->second;
@@ -666,7 +722,7 @@ int UdpRelayReceiver::UdpPeersStatus(std::ostream &out)
 	out << "UdpRelayReceiver::UdpPeersStatus()";
 	out << std::endl;
 
-        std::map<struct sockaddr_in, UdpPeer *>::iterator pit;
+        std::unordered_map<struct sockaddr_in, UdpPeer *, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator pit;
 	for(pit = mPeers.begin(); pit != mPeers.end(); ++pit)
 	{
 		out << "UdpPeer for: " << pit->first;
@@ -680,10 +736,16 @@ int UdpRelayReceiver::UdpPeersStatus(std::ostream &out)
 void UdpRelayReceiver::clearDataTransferred()
 {
 	{
-	        RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
+	        RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
 
 		mWriteBytes = 0;
-		mRelayBytes = 0;
+	}
+
+	for(int i = 0; i < UDP_RELAY_NB_SHARDS; i++)
+	{
+	        RsStackMutex stack(mShards[i].mShardMtx);   /********** LOCK MUTEX *********/
+
+		mShards[i].mRelayBytes = 0;
 	}
 
 	{
@@ -697,10 +759,17 @@ void UdpRelayReceiver::clearDataTransferred()
 void UdpRelayReceiver::getDataTransferred(uint32_t &read, uint32_t &write, uint32_t &relay)
 {
 	{
-	        RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
+	        RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
 
 		write = mWriteBytes;
-		relay = mRelayBytes;
+	}
+
+	relay = 0;
+	for(int i = 0; i < UDP_RELAY_NB_SHARDS; i++)
+	{
+	        RsStackMutex stack(mShards[i].mShardMtx);   /********** LOCK MUTEX *********/
+
+		relay += mShards[i].mRelayBytes;
 	}
 
 	{
@@ -751,25 +820,51 @@ int UdpRelayReceiver::recvPkt(void *data, int size, struct sockaddr_in &from)
 	}
 
 	{
-	        RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
-	
-		/* lookup relay first (double entries) */
-		std::map<UdpRelayAddrSet, UdpRelayProxy>::iterator rit = mRelays.find(addrSet);
-		if (rit != mRelays.end())
+		/* lookup relay first (double entries), only locking its shard */
+		bool isRelay = false;
+		bool forward = false;
+		struct sockaddr_in destAddr;
 		{
-			/* we are the relay */
+			RelayShard &shard = shardOf(addrSet);
+			RsStackMutex stack(shard.mShardMtx);   /********** LOCK MUTEX *********/
+
+			std::unordered_map<UdpRelayAddrSet, UdpRelayProxy, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator rit;
+			rit = shard.mRelays.find(addrSet);
+			if (rit != shard.mRelays.end())
+			{
+				/* we are the relay */
 #ifdef DEBUG_UDP_RELAY_PKTS
-			std::cerr << "UdpRelayReceiver::recvPkt() We are the Relay. Passing onto: ";
-			std::cerr << rit->first.mDestAddr;
-			std::cerr << std::endl;
+				std::cerr << "UdpRelayReceiver::recvPkt() We are the Relay. Passing onto: ";
+				std::cerr << rit->first.mDestAddr;
+				std::cerr << std::endl;
 #endif
-			/* do accounting */
-			rit->second.mLastTS = time(NULL);
-			rit->second.mDataSize += size;
+				/* do accounting */
+				isRelay = true;
+				rit->second.mLastTS = time(NULL);
+
+				if (rit->second.consumeTokens(size, rstime::getCurrentTS()))
+				{
+					rit->second.mDataSize += size;
+					shard.mRelayBytes += size;
+
+					destAddr = rit->first.mDestAddr;
+					forward = true;
+				}
+				else
+				{
+					/* over the bandwidth limit, drop */
+					rit->second.mDroppedSize += size;
+				}
+			}
+		}
 
-			mRelayBytes += size;
-	
-			mPublisher->sendPkt(data, size, rit->first.mDestAddr, STD_RELAY_TTL);
+		if (isRelay)
+		{
+			/* pass on the packet as is, unlocked */
+			if (forward)
+			{
+				mPublisher->sendPkt(data, size, destAddr, STD_RELAY_TTL);
+			}
 			return 1;
 		}
 	}
@@ -781,7 +876,8 @@ int UdpRelayReceiver::recvPkt(void *data, int size, struct sockaddr_in &from)
 	{
 	        RsStackMutex stack(udppeerMtx);   /********** LOCK MUTEX *********/
 
-		std::map<struct sockaddr_in, UdpPeer *>::iterator pit = mPeers.find(addrSet.mSrcAddr);
+		std::unordered_map<struct sockaddr_in, UdpPeer *, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator pit;
+		pit = mPeers.find(addrSet.mSrcAddr);
 		if (pit != mPeers.end())
 		{
 			/* we are the end-point */
@@ -826,32 +922,43 @@ int UdpRelayReceiver::recvPkt(void *data, int size, struct sockaddr_in &from)
  */
 int UdpRelayReceiver::sendPkt(const void *data, int size, const struct sockaddr_in &to, int /*ttl*/)
 {
-	RsStackMutex stack(relayMtx);   /********** LOCK MUTEX *********/
-	
-	/* work out who the proxy is */
-	std::map<struct sockaddr_in, UdpRelayEnd>::iterator it;
-	it = mStreams.find(to);
-	if (it == mStreams.end())
+	UdpRelayEnd relayEnd;
 	{
+		RsStackMutex stack(streamMtx);   /********** LOCK MUTEX *********/
+	
+		/* work out who the proxy is */
+		std::unordered_map<struct sockaddr_in, UdpRelayEnd, UdpRelayAddrHash, UdpRelayAddrEqual>::iterator it;
+		it = mStreams.find(to);
+		if (it == mStreams.end())
+		{
 //#ifdef DEBUG_UDP_RELAY
-		std::cerr << "UdpRelayReceiver::sendPkt() Peer Unknown!";
-		std::cerr << std::endl;
+			std::cerr << "UdpRelayReceiver::sendPkt() Peer Unknown!";
+			std::cerr << std::endl;
 //#endif
-		return 0;
-	}
+			return 0;
+		}
 	
 #ifdef DEBUG_UDP_RELAY_PKTS
-	std::cerr << "UdpRelayReceiver::sendPkt() to Relay: " << it->second;
-	std::cerr << std::endl;
+		std::cerr << "UdpRelayReceiver::sendPkt() to Relay: " << it->second;
+		std::cerr << std::endl;
 #endif
 
-	mWriteBytes += size;
+		mWriteBytes += size;
+		relayEnd = it->second;
+	}
 
-	/* add a header to packet */
-	int finalPktSize = createRelayUdpPacket(data, size, mTmpSendPkt, MAX_RELAY_UDP_PACKET_SIZE, &(it->second));
+	/* add a header to packet, the only copy made.
+	 * The buffer is our own, so several threads can send at once.
+	 */
+	uint8_t relayPkt[MAX_RELAY_UDP_PACKET_SIZE];
+	int finalPktSize = createRelayUdpPacket(data, size, relayPkt, MAX_RELAY_UDP_PACKET_SIZE, &relayEnd);
+	if (finalPktSize == 0)
+	{
+		return 0;
+	}
 
 	/* send the packet on */
-	return mPublisher->sendPkt(mTmpSendPkt, finalPktSize, it->second.mProxyAddr, STD_RELAY_TTL);
+	return mPublisher->sendPkt(relayPkt, finalPktSize, relayEnd.mProxyAddr, STD_RELAY_TTL);
 }
 
 /***** RELAY PACKET FORMAT ****************************
@@ -1020,22 +1127,56 @@ int operator<(const UdpRelayAddrSet &a, const UdpRelayAddrSet &b)
 }
 
 
+size_t UdpRelayAddrHash::operator()(const struct sockaddr_in &addr) const
+{
+	/* mix ip and port (splitmix64 finaliser), both are in network order */
+	uint64_t key = ((uint64_t) addr.sin_addr.s_addr << 16) | addr.sin_port;
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return (size_t) key;
+}
+
+size_t UdpRelayAddrHash::operator()(const UdpRelayAddrSet &addrSet) const
+{
+	/* not symmetric: (A, B) and (B, A) are different relays */
+	return (*this)(addrSet.mSrcAddr) * 31 + (*this)(addrSet.mDestAddr);
+}
+
+bool UdpRelayAddrEqual::operator()(const struct sockaddr_in &a, const struct sockaddr_in &b) const
+{
+	return (a.sin_addr.s_addr == b.sin_addr.s_addr) && (a.sin_port == b.sin_port);
+}
+
+bool UdpRelayAddrEqual::operator()(const UdpRelayAddrSet &a, const UdpRelayAddrSet &b) const
+{
+	return (*this)(a.mSrcAddr, b.mSrcAddr) && (*this)(a.mDestAddr, b.mDestAddr);
+}
+
+
 UdpRelayProxy::UdpRelayProxy()
 {
 	mBandwidth = 0;
 	mDataSize = 0;
+	mDroppedSize = 0;
 	mLastBandwidthTS = 0;
 	mLastTS = time(NULL); // Must be set here, otherwise Proxy Timesout before anything can happen!
 	mRelayClass = 0;
 
         mStartTS = time(NULL);
         mBandwidthLimit = 0;
+
+	mTokens = relayBurst(mBandwidthLimit);
+	mTokensTS = rstime::getCurrentTS();
 }
 
 UdpRelayProxy::UdpRelayProxy(UdpRelayAddrSet *addrSet, int relayClass, uint32_t bandwidth)
 	: mAddrs(*addrSet),
 	  mBandwidth(0),
 	  mDataSize(0),
+	  mDroppedSize(0),
 	  mLastBandwidthTS(0),
 	  mLastTS(time(NULL)),
 	  mStartTS(time(NULL)),
@@ -1059,6 +1200,38 @@ UdpRelayProxy::UdpRelayProxy(UdpRelayAddrSet *addrSet, int relayClass, uint32_t
 				break;
 		}
 	}
+
+	/* start with a full bucket */
+	mTokens = relayBurst(mBandwidthLimit);
+	mTokensTS = rstime::getCurrentTS();
+}
+
+bool UdpRelayProxy::consumeTokens(int size, double now)
+{
+	/* refill for the time elapsed */
+	if (now > mTokensTS)
+	{
+		mTokens += (now - mTokensTS) * mBandwidthLimit;
+		mTokensTS = now;
+
+		double burst = relayBurst(mBandwidthLimit);
+		if (mTokens > burst)
+		{
+			mTokens = burst;
+		}
+	}
+	else
+	{
+		/* clock went back */
+		mTokensTS = now;
+	}
+
+	if (mTokens < size)
+	{
+		return false;
+	}
+	mTokens -= size;
+	return true;
 }
 
 UdpRelayEnd::UdpRelayEnd() 
@@ -1097,6 +1270,8 @@ std::ostream &operator<<(std::ostream &out, const UdpRelayProxy &urp)
 	out << std::endl;
 	out << "\tDataSize: " << urp.mDataSize;
 	out << std::endl;
+	out << "\tDroppedSize: " << urp.mDroppedSize;
+	out << std::endl;
 	out << "\tLastBandwidthTS: " << now - urp.mLastBandwidthTS << " secs ago";
 	out << std::endl;
 	out << "\tLastTS: " << now - urp.mLastTS << " secs ago";
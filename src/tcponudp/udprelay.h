@@ -24,6 +24,7 @@
 
 #include "tcponudp/udppeer.h"
 #include <retroshare/rsdht.h>
+#include <unordered_map>
 #include <vector>
 
 class UdpRelayAddrSet;
@@ -41,6 +42,21 @@ class UdpRelayAddrSet
 };
 
 int operator<(const UdpRelayAddrSet &a, const UdpRelayAddrSet &b);
+
+/* hashing for the relay tables: address and port only */
+class UdpRelayAddrHash
+{
+	public:
+	size_t operator()(const struct sockaddr_in &addr) const;
+	size_t operator()(const UdpRelayAddrSet &addrSet) const;
+};
+
+class UdpRelayAddrEqual
+{
+	public:
+	bool operator()(const struct sockaddr_in &a, const struct sockaddr_in &b) const;
+	bool operator()(const UdpRelayAddrSet &a, const UdpRelayAddrSet &b) const;
+};
 	
 class UdpRelayProxy
 {
@@ -48,15 +64,22 @@ class UdpRelayProxy
 	UdpRelayProxy();
 	UdpRelayProxy(UdpRelayAddrSet *addrSet, int relayClass, uint32_t bandwidth);
 
+	/* token bucket: take size bytes if available at time now */
+	bool consumeTokens(int size, double now);
+
 	UdpRelayAddrSet mAddrs;
 	double mBandwidth;
 	uint32_t mDataSize;
+	uint32_t mDroppedSize; /* over the bandwidth limit */
 	rstime_t mLastBandwidthTS;
 	rstime_t mLastTS;
 
 	rstime_t mStartTS;
 	double mBandwidthLimit;
 
+	double mTokens;
+	double mTokensTS;
+
 	int mRelayClass;
 };
 
@@ -121,6 +144,12 @@ std::ostream &operator<<(std::ostream &out, const UdpRelayEnd &ure);
 
 #define STD_RELAY_TTL	64
 
+/* Relayed packets are forwarded at most at the relay bandwidth limit,
+ * with bursts of up to UDP_RELAY_BURST_SECS worth of it.
+ */
+#define UDP_RELAY_BURST_SECS	2
+#define UDP_RELAY_NB_SHARDS	16
+
 class UdpRelayReceiver: public UdpSubReceiver
 {
 	public:
@@ -171,35 +200,55 @@ void 	getDataTransferred(uint32_t &read, uint32_t &write, uint32_t &relay);
 	void clearDataTransferred();
 
 	int removeUdpRelay_relayLocked(UdpRelayAddrSet *addrs);
+	bool eraseUdpRelay_relayLocked(const UdpRelayAddrSet &addrs, int &relayClass);
 	int installRelayClass_relayLocked(int &classIdx, uint32_t &bandwidth);
 	int removeRelayClass_relayLocked(int classIdx);
 
 	/* Unfortunately, Due the reentrant nature of this classes activities...
 	 * the SendPkt() must be callable from inside RecvPkt().
-	 * This means we need two seperate mutexes.
-	 *  - one for UdpPeer's, and one for Relay Data.
+	 * This means we need seperate mutexes.
+	 *  - one for UdpPeer's, one for our Relay Ends, and the Relay Data.
 	 *
 	 * care must be taken to lock these mutex's in a consistent manner to avoid deadlock.
-	 *  - You are not allowed to hold both at the same time!
+	 *  - streamMtx may be locked under udppeerMtx (a UdpPeer answering
+	 *    from its recvPkt()), not the reverse.
+	 *  - relayMtx may be held when locking a relay shard, not the reverse.
+	 * No mutex is held while sending.
 	 */
 
 	RsMutex udppeerMtx; /* for all class data (below) */
 	
-	std::map<struct sockaddr_in, UdpPeer *> mPeers; /* indexed by <dest> */
+	std::unordered_map<struct sockaddr_in, UdpPeer *, UdpRelayAddrHash, UdpRelayAddrEqual> mPeers; /* indexed by <dest> */
 	uint32_t mReadBytes;
 
-	RsMutex relayMtx; /* for all class data (below) */
+	RsMutex streamMtx; /* for all class data (below) */
 
-	std::vector<int> mClassLimit, mClassCount, mClassBandwidth;
-	std::map<struct sockaddr_in, UdpRelayEnd> mStreams; /* indexed by <dest> */
-	std::map<UdpRelayAddrSet, UdpRelayProxy> mRelays; /* indexed by <src,dest> */
+	std::unordered_map<struct sockaddr_in, UdpRelayEnd, UdpRelayAddrHash, UdpRelayAddrEqual> mStreams; /* indexed by <dest> */
+	uint32_t mWriteBytes;
 
-	void *mTmpSendPkt;
-	uint32_t mTmpSendSize;
+	RsMutex relayMtx; /* for class accounting (below) */
 
-	uint32_t mWriteBytes;
-	uint32_t mRelayBytes;
+	std::vector<int> mClassLimit, mClassCount, mClassBandwidth;
 
+	/* The relays we carry (indexed by <src,dest>) are split in shards by
+	 * hash, so relayed packets only lock the shard of their relay.
+	 */
+	class RelayShard
+	{
+		public:
+		RelayShard() : mShardMtx("UdpRelayReceiver::RelayShard"), mRelayBytes(0) {}
+
+		RsMutex mShardMtx; /* MUTEX */
+		std::unordered_map<UdpRelayAddrSet, UdpRelayProxy, UdpRelayAddrHash, UdpRelayAddrEqual> mRelays;
+		uint32_t mRelayBytes;
+	};
+
+	RelayShard &shardOf(const UdpRelayAddrSet &addrs)
+	{
+		return mShards[UdpRelayAddrHash()(addrs) % UDP_RELAY_NB_SHARDS];
+	}
+
+	RelayShard mShards[UDP_RELAY_NB_SHARDS];
 };
 
 /* utility functions for creating / extracting UdpRelayPackets */
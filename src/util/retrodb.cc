@@ -38,9 +38,15 @@
 const int RetroDb::OPEN_READONLY = SQLITE_OPEN_READONLY;
 const int RetroDb::OPEN_READWRITE = SQLITE_OPEN_READWRITE;
 const int RetroDb::OPEN_READWRITE_CREATE = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+const size_t RetroDb::MAX_CACHED_STATEMENTS = 64;
+
+const int RetroDb::SYNCHRONOUS_OFF = 0;
+const int RetroDb::SYNCHRONOUS_NORMAL = 1;
+const int RetroDb::SYNCHRONOUS_FULL = 2;
+const int RetroDb::SYNCHRONOUS_EXTRA = 3;
 
 RetroDb::RetroDb(const std::string& dbPath, int flags, const std::string& key):
-    mDb(nullptr), mKey(key),mDbNeedsCleaning(false),mPath(dbPath)
+    mDb(nullptr), mKey(key),mDbNeedsCleaning(false),mPath(dbPath),mTransactionDepth(0)
 {
 	bool alreadyExists = RsDirUtil::fileExists(dbPath);
 
@@ -157,6 +163,9 @@ void RetroDb::closeDb()
     if(!mDb)
         return;
 
+    // sqlite3_close() fails as long as statements are not finalised
+    finalizeCachedStatements();
+
     if(mDbNeedsCleaning)
     {
         RsDbg() << "Cleaning the Db \"" << mPath << "\" using the VACUUM command." ;
@@ -167,6 +176,7 @@ void RetroDb::closeDb()
 	// no-op if mDb is nullptr (https://www.sqlite.org/c3ref/close.html)
 	int rc = sqlite3_close(mDb);
 	mDb = nullptr;
+	mTransactionDepth = 0;
 
 	Dbg2() << __PRETTY_FUNCTION__ << " sqlite3_close return: " << rc
 	       << std::endl;
@@ -282,6 +292,129 @@ RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std
     return (new RetroCursor(stmt));
 }
 
+RetroCursor* RetroDb::sqlQuery_bind(const std::string& tableName, const std::list<std::string>& columns,
+                                    const std::string& selection, std::list<RetroBind*>& paramBindings,
+                                    const std::string& orderBy){
+
+    std::list<RetroBind*>::iterator lit;
+
+    if(tableName.empty() || columns.empty() || !isOpen()){
+        std::cerr << "RetroDb::sqlQuery_bind(): No table or columns given" << std::endl;
+
+        for(lit = paramBindings.begin(); lit != paramBindings.end(); ++lit)
+            delete *lit;
+        paramBindings.clear();
+        return NULL;
+    }
+
+    std::string sqlQuery = "SELECT ";
+    for(std::list<std::string>::const_iterator it = columns.begin(); it != columns.end(); ++it){
+        if (it != columns.begin())
+            sqlQuery += ",";
+        sqlQuery += *it;
+    }
+    sqlQuery += " FROM " + tableName;
+
+    if(!selection.empty())
+        sqlQuery += " WHERE " + selection;
+
+    if(!orderBy.empty())
+        sqlQuery += " ORDER BY " + orderBy;
+
+    sqlQuery += ";";
+
+#ifdef RETRODB_DEBUG
+    std::cerr << "RetroDb::sqlQuery_bind(): " << sqlQuery << std::endl;
+#endif
+
+    sqlite3_stmt* stmt = prepareCached(sqlQuery);
+    bool ok = (stmt != NULL);
+
+    for(lit = paramBindings.begin(); lit != paramBindings.end(); ++lit){
+        RetroBind* rb = *lit;
+
+        if(ok && !rb->bind(stmt)){
+            std::cerr << "RetroDb::sqlQuery_bind(): Bind failed for index: " << rb->getIndex()
+                      << std::endl;
+            ok = false;
+        }
+
+        delete rb;
+    }
+    paramBindings.clear();
+
+    if(!ok){
+        if(stmt)
+            releaseStatement(stmt);
+        return NULL;
+    }
+
+    return new RetroCursor(stmt, this);
+}
+
+sqlite3_stmt* RetroDb::prepareCached(const std::string& query){
+
+    std::map<std::string, CachedStatement>::iterator it = mStatements.find(query);
+
+    if(it != mStatements.end() && !it->second.mInUse){
+        it->second.mInUse = true;
+        return it->second.mStmt;
+    }
+
+    sqlite3_stmt* stmt = NULL;
+    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stmt, NULL);
+
+    if(rc != SQLITE_OK){
+        std::cerr << "RetroDb::prepareCached(): Error preparing statement\n";
+        std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
+                  << std::endl;
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    // an open cursor already uses the cached one, this one is only lent
+    if(it == mStatements.end() && mStatements.size() < MAX_CACHED_STATEMENTS){
+        CachedStatement& cs = mStatements[query];
+        cs.mStmt = stmt;
+        cs.mInUse = true;
+    }
+
+    return stmt;
+}
+
+void RetroDb::releaseStatement(sqlite3_stmt* stm){
+
+    if(!stm)
+        return;
+
+    const char* query = sqlite3_sql(stm);
+    std::map<std::string, CachedStatement>::iterator it;
+
+    if(query && (it = mStatements.find(query)) != mStatements.end() && it->second.mStmt == stm){
+        sqlite3_reset(stm);
+        sqlite3_clear_bindings(stm);
+        it->second.mInUse = false;
+        return;
+    }
+
+    sqlite3_finalize(stm);
+}
+
+void RetroDb::finalizeCachedStatements(){
+
+    std::map<std::string, CachedStatement>::iterator it;
+    for(it = mStatements.begin(); it != mStatements.end(); ++it){
+
+        if(it->second.mInUse)
+            RsErr() << __PRETTY_FUNCTION__ << " statement still used by a cursor: "
+                    << it->first << std::endl;
+
+        sqlite3_finalize(it->second.mStmt);
+    }
+
+    mStatements.clear();
+}
+
 bool RetroDb::isOpen() const {
     return (mDb==NULL ? false : true);
 }
@@ -318,7 +451,8 @@ bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColu
     // complete insertion query
     std::string sqlQuery = "INSERT INTO " + qColumns + " " + qValues;
 
-    bool ok = execSQL_bind(sqlQuery, paramBindings);
+    // the text only depends on the columns, rows of a table share the statement
+    bool ok = execSQL_bind(sqlQuery, paramBindings, true);
 
 #ifdef RETRODB_DEBUG
     std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
@@ -332,13 +466,27 @@ std::string RetroDb::getKey() const
 	return mKey;
 }
 
+std::string RetroDb::savepointName(int depth)
+{
+    return "retrodb_sp" + std::to_string(depth);
+}
+
 bool RetroDb::beginTransaction()
 {
     if (!isOpen()) {
         return false;
     }
 
-    return execSQL("BEGIN;");
+    bool ok;
+    if (mTransactionDepth == 0)
+        ok = execSQL("BEGIN;");
+    else
+        ok = execSQL("SAVEPOINT " + savepointName(mTransactionDepth) + ";");
+
+    if (ok)
+        ++mTransactionDepth;
+
+    return ok;
 }
 
 bool RetroDb::commitTransaction()
@@ -347,7 +495,18 @@ bool RetroDb::commitTransaction()
         return false;
     }
 
-    return execSQL("COMMIT;");
+    if (mTransactionDepth > 1) {
+        --mTransactionDepth;
+        return execSQL("RELEASE " + savepointName(mTransactionDepth) + ";");
+    }
+
+    bool ok = execSQL("COMMIT;");
+
+    // a failed commit may leave the transaction open
+    if (sqlite3_get_autocommit(mDb))
+        mTransactionDepth = 0;
+
+    return ok;
 }
 bool RetroDb::rollbackTransaction()
 {
@@ -355,25 +514,88 @@ bool RetroDb::rollbackTransaction()
         return false;
     }
 
-    return execSQL("ROLLBACK;");
+    if (mTransactionDepth > 1) {
+        --mTransactionDepth;
+        const std::string sp = savepointName(mTransactionDepth);
+        return execSQL("ROLLBACK TO " + sp + ";") && execSQL("RELEASE " + sp + ";");
+    }
+
+    bool ok = execSQL("ROLLBACK;");
+
+    if (sqlite3_get_autocommit(mDb))
+        mTransactionDepth = 0;
+
+    return ok;
+}
+
+bool RetroDb::inTransaction() const
+{
+    return mTransactionDepth > 0;
+}
+
+bool RetroDb::setWalMode()
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // the pragma returns the journal mode in use, which is not changed on error
+    sqlite3_stmt* stm = NULL;
+    std::string mode;
+
+    if(sqlite3_prepare_v2(mDb, "PRAGMA journal_mode=WAL;", -1, &stm, NULL) == SQLITE_OK &&
+       sqlite3_step(stm) == SQLITE_ROW)
+    {
+        const unsigned char* text = sqlite3_column_text(stm, 0);
+        if(text)
+            mode = reinterpret_cast<const char*>(text);
+    }
+
+    sqlite3_finalize(stm);
+
+    if(mode != "wal")
+    {
+        std::cerr << "RetroDb::setWalMode(): " << mPath << " stays in journal mode \""
+                  << mode << "\": " << sqlite3_errmsg(mDb) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool RetroDb::setSynchronous(int level)
+{
+    if (!isOpen() || level < SYNCHRONOUS_OFF || level > SYNCHRONOUS_EXTRA) {
+        return false;
+    }
+
+    return execSQL("PRAGMA synchronous=" + std::to_string(level) + ";");
 }
 
-bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings){
+bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings, bool cached){
 
     // prepare statement
     sqlite3_stmt* stm = NULL;
+    int rc;
 
 #ifdef RETRODB_DEBUG
     std::cerr << "Query: " << query << std::endl;
 #endif
 
-    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+    if(cached)
+        rc = (stm = prepareCached(query)) ? SQLITE_OK : SQLITE_ERROR;
+    else
+        rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
 
     // check if there are any errors
     if(rc != SQLITE_OK){
         std::cerr << "RetroDb::execSQL_bind(): Error preparing statement\n";
         std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
                   << std::endl;
+
+        for(std::list<RetroBind*>::iterator lit = paramBindings.begin(); lit != paramBindings.end(); ++lit)
+            delete *lit;
+        paramBindings.clear();
         return false;
     }
 
@@ -391,6 +613,7 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
         delete rb;
         rb = NULL;
     }
+    paramBindings.clear();
 
     uint32_t delta = 3;
     rstime_t stamp = time(NULL), now = 0;
@@ -435,7 +658,10 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
     }
 
     // finalise statement or else db cannot be closed
-    sqlite3_finalize(stm);
+    if(cached)
+        releaseStatement(stm);
+    else
+        sqlite3_finalize(stm);
     return ok;
 }
 
@@ -673,8 +899,8 @@ bool RetroDb::tableExists(const std::string &tableName)
 
 /********************** RetroCursor ************************/
 
-RetroCursor::RetroCursor(sqlite3_stmt *stmt)
-    : mStmt(NULL) {
+RetroCursor::RetroCursor(sqlite3_stmt *stmt, RetroDb *owner)
+    : mStmt(NULL), mOwner(owner) {
 
      open(stmt);
 }
@@ -683,10 +909,20 @@ RetroCursor::~RetroCursor(){
 
     // finalise statement
     if(mStmt){
-        sqlite3_finalize(mStmt);
+        releaseStatement();
     }
 }
 
+void RetroCursor::releaseStatement(){
+
+    if(mOwner)
+        mOwner->releaseStatement(mStmt);
+    else
+        sqlite3_finalize(mStmt);
+
+    mStmt = NULL;
+}
+
 bool RetroCursor::moveToFirst(){
 
 #ifdef RETRODB_DEBUG
@@ -769,6 +1005,10 @@ bool RetroCursor::close(){
     if(!isOpen())
         return false;
 
+    if(mOwner){
+        releaseStatement();
+        return true;
+    }
 
     int rc = sqlite3_finalize(mStmt);
     mStmt = NULL;
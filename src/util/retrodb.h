@@ -87,23 +87,48 @@ public:
 public:
 
     /*!
-     * Start transaction
+     * Start transaction \n
+     * Transactions can be nested: inside an open transaction this starts a \n
+     * savepoint, so only the outermost commit writes to disk.
      * @return true/false
      */
     bool beginTransaction();
 
     /*!
-     * Commit transaction
+     * Commit transaction, or release the savepoint of a nested one
      * @return true/false
      */
     bool commitTransaction();
 
     /*!
-     * Rollback transaction
+     * Rollback transaction, or only the changes of a nested one
      * @return true/false
      */
     bool rollbackTransaction();
 
+    /*!
+     * @return true between beginTransaction and the outermost commit or rollback
+     */
+    bool inTransaction() const;
+
+    /*!
+     * Switch the database to write-ahead logging: commits append to the log \n
+     * instead of rewriting pages through the rollback journal, and readers \n
+     * don't block the writer. The mode is persistent. \n
+     * For SQLCipher databases, the log is encrypted like the database itself.
+     * @return false if the journal mode could not be changed
+     */
+    bool setWalMode();
+
+    /*!
+     * Set how often sqlite waits for the data to reach the disk
+     * @param level one of SYNCHRONOUS_*. With WAL, SYNCHRONOUS_NORMAL only \n
+     *        syncs at checkpoints: the last commits can be lost on power \n
+     *        failure, but the database stays consistent.
+     * @return true/false
+     */
+    bool setSynchronous(int level);
+
     /*!
      * To a make query which do not return a result \n
      * below are the type of queries this method should be used for \n
@@ -151,6 +176,19 @@ public:
     RetroCursor* sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
                           const std::string& selection, const std::string& orderBy);
 
+    /*!
+     * Same as sqlQuery, but the selection uses '?' place holders whose values are
+     * bound from paramBindings, so the same query text serves all the values. \n
+     * The statement is prepared once and kept by RetroDb for the next calls, until
+     * the database is closed. Only one cursor can use it at a time: while it is
+     * open, the same query gets a statement of its own.
+     * @param paramBindings values of the place holders, deleted by the call
+     * @return cursor over result set, to be deleted before the database is closed
+     */
+    RetroCursor* sqlQuery_bind(const std::string& tableName, const std::list<std::string>& columns,
+                               const std::string& selection, std::list<RetroBind*>& paramBindings,
+                               const std::string& orderBy);
+
     /*!
      * delete row in an sql table
      * @param tableName the table on which to apply the DELETE
@@ -178,9 +216,38 @@ public:
     static const int OPEN_READWRITE;
     static const int OPEN_READWRITE_CREATE;
 
+    static const int SYNCHRONOUS_OFF;
+    static const int SYNCHRONOUS_NORMAL;
+    static const int SYNCHRONOUS_FULL;
+    static const int SYNCHRONOUS_EXTRA;
+
+    /// Maximum number of prepared statements kept by sqlQuery_bind
+    static const size_t MAX_CACHED_STATEMENTS;
+
 private:
 
-    bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs);
+    friend class RetroCursor;
+
+    /*!
+     * @return the cached statement of query, or a new one if it is in use
+     */
+    sqlite3_stmt* prepareCached(const std::string& query);
+
+    /*!
+     * Called by the cursors of sqlQuery_bind once done with stm: cached statements
+     * are reset for the next use, others are finalised.
+     */
+    void releaseStatement(sqlite3_stmt* stm);
+
+    void finalizeCachedStatements();
+
+    /*!
+     * @param cached keep the prepared statement for the next identical query, \n
+     *        for queries whose text doesn't depend on the values
+     */
+    bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs, bool cached = false);
+
+    static std::string savepointName(int depth);
 
     /*!
      * Build the "VALUE" part of an insertiong sql query
@@ -205,6 +272,18 @@ private:
     bool mDbNeedsCleaning;
     std::string mPath;
 
+    /// number of open transactions, the nested ones being savepoints
+    int mTransactionDepth;
+
+    struct CachedStatement
+    {
+        sqlite3_stmt* mStmt;
+        bool mInUse;
+    };
+
+    /// prepared statements, by query text
+    std::map<std::string, CachedStatement> mStatements;
+
 	RS_SET_CONTEXT_DEBUG_LEVEL(3)
 };
 
@@ -218,8 +297,9 @@ public:
     /*!
      * Initialises a null cursor
      * @warning cursor takes ownership of statement passed to it
+     * @param owner if set, the statement is handed back to it instead of being finalised
      */
-    RetroCursor(sqlite3_stmt*);
+    RetroCursor(sqlite3_stmt*, RetroDb* owner = nullptr);
 
     ~RetroCursor();
 
@@ -320,5 +400,8 @@ public:
     	str = T(temp);
     }
 private:
+    void releaseStatement();
+
     sqlite3_stmt* mStmt;
+    RetroDb* mOwner;
 };
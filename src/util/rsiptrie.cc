@@ -0,0 +1,274 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsiptrie.cc                                         *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <cstring>
+
+#include "util/rsiptrie.h"
+
+bool RsIpPrefix::fromSockaddr( const sockaddr_storage& addr, uint32_t length,
+                               RsIpPrefix& prefix )
+{
+	prefix = RsIpPrefix();
+
+	switch(addr.ss_family)
+	{
+	case AF_INET:
+	{
+		if(length > 32) return false;
+		const sockaddr_in& in = reinterpret_cast<const sockaddr_in&>(addr);
+		prefix.mBytes[10] = 0xff;
+		prefix.mBytes[11] = 0xff;
+		memcpy(&prefix.mBytes[12], &in.sin_addr.s_addr, 4);
+		prefix.truncate(96 + length);
+		return true;
+	}
+	case AF_INET6:
+	{
+		if(length > 128) return false;
+		const sockaddr_in6& in6 = reinterpret_cast<const sockaddr_in6&>(addr);
+		memcpy(prefix.mBytes, &in6.sin6_addr, 16);
+		prefix.truncate(length);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool RsIpPrefix::contains(const RsIpPrefix& ip) const
+{
+	if(ip.mLength < mLength) return false;
+
+	uint32_t fullBytes = mLength >> 3;
+	if(memcmp(mBytes, ip.mBytes, fullBytes)) return false;
+
+	uint32_t rest = mLength & 7;
+	if(!rest) return true;
+
+	uint8_t mask = uint8_t(0xff << (8 - rest));
+	return (mBytes[fullBytes] & mask) == (ip.mBytes[fullBytes] & mask);
+}
+
+uint32_t RsIpPrefix::commonLength(const RsIpPrefix& other) const
+{
+	uint32_t maxLength = std::min(mLength, other.mLength);
+	uint32_t length = 0;
+
+	for(uint32_t i = 0; i < 16 && length < maxLength; ++i)
+	{
+		uint8_t diff = mBytes[i] ^ other.mBytes[i];
+		if(!diff) { length += 8; continue; }
+
+		while(!(diff & 0x80)) { diff <<= 1; ++length; }
+		break;
+	}
+
+	return std::min(length, maxLength);
+}
+
+void RsIpPrefix::truncate(uint32_t length)
+{
+	mLength = uint8_t(length);
+
+	uint32_t fullBytes = length >> 3;
+	uint32_t rest = length & 7;
+
+	if(rest) mBytes[fullBytes++] &= uint8_t(0xff << (8 - rest));
+	if(fullBytes < 16) memset(&mBytes[fullBytes], 0, 16 - fullBytes);
+}
+
+bool RsIpPrefix::operator==(const RsIpPrefix& o) const
+{ return mLength == o.mLength && !memcmp(mBytes, o.mBytes, 16); }
+
+bool RsIpPrefix::operator<(const RsIpPrefix& o) const
+{
+	int c = memcmp(mBytes, o.mBytes, 16);
+	if(c) return c < 0;
+	return mLength < o.mLength;
+}
+
+struct RsIpPrefixTrie::Node
+{
+	RsIpPrefix mPrefix;
+	uint32_t mValue;        /// 0 for pure branching nodes
+	uint64_t mGeneration;
+	NodePtr mChildren[2];   /// indexed by the bit following mPrefix
+};
+
+RsIpPrefixTrie::RsIpPrefixTrie() : mGeneration(1) {}
+
+RsIpPrefixTrie::~RsIpPrefixTrie() {}
+
+uint32_t RsIpPrefixTrie::lookup(const RsIpPrefix& ip, RsIpPrefix* matched) const
+{
+	uint32_t value = 0;
+
+	RsRcuReadLock rcu;
+
+	const Node* n = mRoot.get();
+	while(n && n->mPrefix.contains(ip))
+	{
+		if(n->mValue)
+		{
+			value = n->mValue;
+			if(matched) *matched = n->mPrefix;
+			break;
+		}
+
+		if(n->mPrefix.mLength >= ip.mLength) break;
+		n = n->mChildren[ip.bit(n->mPrefix.mLength)].get();
+	}
+
+	return value;
+}
+
+RsIpPrefixTrie::NodePtr RsIpPrefixTrie::newNode(
+        const RsIpPrefix& prefix, uint32_t value )
+{
+	NodePtr n = std::make_shared<Node>();
+	n->mPrefix = prefix;
+	n->mValue = value;
+	n->mGeneration = mGeneration;
+	return n;
+}
+
+RsIpPrefixTrie::NodePtr RsIpPrefixTrie::writable(const NodePtr& n)
+{
+	if(n->mGeneration == mGeneration) return n;
+
+	NodePtr copy = std::make_shared<Node>(*n);
+	copy->mGeneration = mGeneration;
+	return copy;
+}
+
+RsIpPrefixTrie::NodePtr RsIpPrefixTrie::compact(const NodePtr& n)
+{
+	if(n->mValue) return n;
+
+	if(!n->mChildren[0]) return n->mChildren[1];
+	if(!n->mChildren[1]) return n->mChildren[0];
+	return n;
+}
+
+RsIpPrefixTrie::NodePtr RsIpPrefixTrie::insert(
+        const NodePtr& n, const RsIpPrefix& prefix, uint32_t value )
+{
+	if(!n) return newNode(prefix, value);
+
+	const uint32_t common = n->mPrefix.commonLength(prefix);
+	const uint32_t nodeLength = n->mPrefix.mLength;
+
+	if(common == nodeLength && common == prefix.mLength)
+	{
+		if(n->mValue == value) return n;
+
+		NodePtr w = writable(n);
+		w->mValue = value;
+		return w;
+	}
+
+	if(common == nodeLength)
+	{
+		// prefix is below n
+		const uint8_t b = prefix.bit(nodeLength);
+		NodePtr child = insert(n->mChildren[b], prefix, value);
+		if(child == n->mChildren[b]) return n;
+
+		NodePtr w = writable(n);
+		w->mChildren[b] = child;
+		return w;
+	}
+
+	if(common == prefix.mLength)
+	{
+		// n is below prefix
+		NodePtr m = newNode(prefix, value);
+		m->mChildren[n->mPrefix.bit(common)] = n;
+		return m;
+	}
+
+	// n and prefix diverge, branch at the first different bit
+	RsIpPrefix branch(prefix);
+	branch.truncate(common);
+
+	NodePtr m = newNode(branch, 0);
+	m->mChildren[prefix.bit(common)] = newNode(prefix, value);
+	m->mChildren[n->mPrefix.bit(common)] = n;
+	return m;
+}
+
+RsIpPrefixTrie::NodePtr RsIpPrefixTrie::remove(
+        const NodePtr& n, const RsIpPrefix& prefix )
+{
+	if(!n) return n;
+
+	const uint32_t nodeLength = n->mPrefix.mLength;
+	if(!n->mPrefix.contains(prefix)) return n;
+
+	if(nodeLength == prefix.mLength)
+	{
+		if(!n->mValue) return n;
+
+		NodePtr w = writable(n);
+		w->mValue = 0;
+		return compact(w);
+	}
+
+	const uint8_t b = prefix.bit(nodeLength);
+	NodePtr child = remove(n->mChildren[b], prefix);
+	if(child == n->mChildren[b]) return n;
+
+	NodePtr w = writable(n);
+	w->mChildren[b] = child;
+	return compact(w);
+}
+
+void RsIpPrefixTrie::set(const RsIpPrefix& prefix, uint32_t value)
+{
+	if(value) mPending = insert(mPending, prefix, value);
+	else mPending = remove(mPending, prefix);
+}
+
+uint32_t RsIpPrefixTrie::find(const RsIpPrefix& prefix) const
+{
+	const Node* n = mPending.get();
+	while(n && n->mPrefix.contains(prefix))
+	{
+		if(n->mPrefix.mLength == prefix.mLength) return n->mValue;
+		n = n->mChildren[prefix.bit(n->mPrefix.mLength)].get();
+	}
+	return 0;
+}
+
+void RsIpPrefixTrie::clear() { mPending.reset(); }
+
+void RsIpPrefixTrie::commit()
+{
+	if(mPending == mRoot.published()) return;
+
+	mRoot.publish(mPending);
+
+	// From now on nodes of the published version must not be modified
+	++mGeneration;
+}
+
+void RsIpPrefixTrie::reclaim() { mRoot.reclaim(); }
@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsiptrie.h                                          *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "util/rsnet.h"
+#include "util/rsrcu.h"
+
+/**
+ * @brief IP address prefix of arbitrary length.
+ * IPv4 addresses are stored as IPv4-mapped IPv6 addresses (::ffff:a.b.c.d), so
+ * a /24 IPv4 prefix is a /120 prefix. Bits past the prefix length are zero.
+ */
+struct RsIpPrefix
+{
+	RsIpPrefix() : mBytes{0}, mLength(0) {}
+
+	/**
+	 * Build prefix from the IP of given address.
+	 * @param[in] addr IPv4 or IPv6 address, port is ignored
+	 * @param[in] length prefix length in bits relative to the address family,
+	 *	0..32 for IPv4 and 0..128 for IPv6
+	 * @return false if the family is unsupported or length out of range
+	 */
+	static bool fromSockaddr( const sockaddr_storage& addr, uint32_t length,
+	                          RsIpPrefix& prefix );
+
+	/// @return value of bit at given position, 0 being the most significant
+	uint8_t bit(uint32_t pos) const
+	{ return (mBytes[pos >> 3] >> (7 - (pos & 7))) & 1; }
+
+	/// @return true if the first mLength bits of ip match this prefix
+	bool contains(const RsIpPrefix& ip) const;
+
+	/// @return number of leading bits shared by both prefixes, at most the
+	///	shortest length
+	uint32_t commonLength(const RsIpPrefix& other) const;
+
+	/// Zero bits past length and set mLength to it
+	void truncate(uint32_t length);
+
+	bool operator==(const RsIpPrefix& o) const;
+	bool operator!=(const RsIpPrefix& o) const { return !(*this == o); }
+	bool operator<(const RsIpPrefix& o) const;
+
+	uint8_t mBytes[16];
+	uint8_t mLength;
+};
+
+/**
+ * @brief Path compressed binary trie mapping IP prefixes to non zero values.
+ * Meant for address filters consulted on every connection attempt and changed
+ * rarely, but sometimes in large batches (ex: when loading a blocklist).
+ *
+ * Lookups are lock free and can run concurrently with one writer. Changes are
+ * made copy-on-write on a pending version of the trie, which is published
+ * atomically by commit(). Only the nodes on the path of modified prefixes are
+ * copied, and nodes already copied since last commit() are modified in place,
+ * so applying a batch of changes costs about as much as building those
+ * entries. Nodes replaced by a commit are freed once the lookups which may
+ * still see them are done (see RsRcuPtr).
+ *
+ * Writer methods (set(), clear(), find(), commit(), reclaim()) must be
+ * serialised by the caller.
+ */
+class RsIpPrefixTrie
+{
+public:
+	RsIpPrefixTrie();
+	~RsIpPrefixTrie();
+
+	/**
+	 * Lock free lookup in the last committed version.
+	 * @param[in] ip address to check, usually a full length prefix
+	 * @param[out] matched if not null, receives the matching prefix
+	 * @return value of the shortest prefix containing ip, 0 if none
+	 */
+	uint32_t lookup(const RsIpPrefix& ip, RsIpPrefix* matched = nullptr) const;
+
+	/**
+	 * Set value of given prefix in the pending version.
+	 * @param[in] value 0 removes the prefix
+	 */
+	void set(const RsIpPrefix& prefix, uint32_t value);
+
+	/// @return value of exactly given prefix in the pending version, 0 if none
+	uint32_t find(const RsIpPrefix& prefix) const;
+
+	/// Remove all prefixes from the pending version
+	void clear();
+
+	/// Publish the pending version to lookup()
+	void commit();
+
+	/// Free the versions replaced by commit() which no lookup can see anymore
+	void reclaim();
+
+private:
+	struct Node;
+	typedef std::shared_ptr<Node> NodePtr;
+
+	NodePtr writable(const NodePtr& n);
+	NodePtr newNode(const RsIpPrefix& prefix, uint32_t value);
+	NodePtr insert(const NodePtr& n, const RsIpPrefix& prefix, uint32_t value);
+	NodePtr remove(const NodePtr& n, const RsIpPrefix& prefix);
+	NodePtr compact(const NodePtr& n);
+
+	RsIpPrefixTrie(const RsIpPrefixTrie&) = delete;
+	RsIpPrefixTrie& operator=(const RsIpPrefixTrie&) = delete;
+
+	/// Published version, read by lookup()
+	RsRcuPtr<Node> mRoot;
+
+	/// Version changed by the writer
+	NodePtr mPending;
+
+	/** Nodes created since last commit() carry the current generation and
+	 * are not visible to readers, so they can be modified in place */
+	uint64_t mGeneration;
+};
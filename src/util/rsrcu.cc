@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsrcu.cc                                            *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "util/rsrcu.h"
+
+/* Slots of the threads which ever read, in a list which only grows. Slots of
+ * exited threads are reused. Epoch 0 marks a thread outside of any section.
+ * The padding keeps each epoch on a cache line of its own. */
+struct RsRcuReadLock::Slot
+{
+	Slot() : mEpoch(0), mInUse(true), mDepth(0), mNext(nullptr) {}
+
+	char mPadBefore[64];
+	std::atomic<uint64_t> mEpoch;
+	char mPadAfter[64];
+
+	std::atomic<bool> mInUse;
+	uint32_t mDepth; // only used by the owner thread
+	Slot* mNext;
+};
+
+static std::atomic<uint64_t> sEpoch(1);
+static std::atomic<RsRcuReadLock::Slot*> sSlots(nullptr);
+
+static RsRcuReadLock::Slot* acquireSlot()
+{
+	for(RsRcuReadLock::Slot* s = sSlots.load(); s; s = s->mNext)
+	{
+		bool inUse = false;
+		if(!s->mInUse.load() && s->mInUse.compare_exchange_strong(inUse, true))
+			return s;
+	}
+
+	RsRcuReadLock::Slot* s = new RsRcuReadLock::Slot;
+	s->mNext = sSlots.load();
+	while(!sSlots.compare_exchange_weak(s->mNext, s));
+	return s;
+}
+
+namespace
+{
+struct ThreadSlot
+{
+	ThreadSlot() : mSlot(acquireSlot()) {}
+	~ThreadSlot() { mSlot->mInUse.store(false); }
+
+	RsRcuReadLock::Slot* const mSlot;
+};
+}
+
+RsRcuReadLock::RsRcuReadLock()
+{
+	static thread_local ThreadSlot slot;
+	mSlot = slot.mSlot;
+
+	/* Sequentially consistent, so a writer which doesn't see this epoch after
+	 * swapping a pointer makes this reader load the new one */
+	if(mSlot->mDepth++ == 0) mSlot->mEpoch.store(sEpoch.load());
+}
+
+RsRcuReadLock::~RsRcuReadLock()
+{
+	if(--mSlot->mDepth == 0) mSlot->mEpoch.store(0, std::memory_order_release);
+}
+
+uint64_t RsRcuReadLock::advanceEpoch() { return sEpoch.fetch_add(1) + 1; }
+
+uint64_t RsRcuReadLock::oldestReaderEpoch()
+{
+	uint64_t oldest = UINT64_MAX;
+	for(Slot* s = sSlots.load(); s; s = s->mNext)
+	{
+		const uint64_t epoch = s->mEpoch.load();
+		if(epoch && epoch < oldest) oldest = epoch;
+	}
+	return oldest;
+}
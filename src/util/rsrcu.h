@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsrcu.h                                             *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief Read side section of the epoch based reclamation behind RsRcuPtr.
+ * On entering, a thread writes the current epoch in a slot of its own, and
+ * clears it on leaving, so readers never write to a shared cache line. An
+ * object retired at some epoch is freed once no reader which entered before
+ * is left, readers entering later don't hold it back.
+ * Sections can be nested, objects read must not be used after the outermost
+ * one is left.
+ */
+class RsRcuReadLock
+{
+public:
+	RsRcuReadLock();
+	~RsRcuReadLock();
+
+	/// Start a new epoch. @return the epoch of objects unlinked before the call
+	static uint64_t advanceEpoch();
+
+	/// @return the epoch the oldest reader entered at, UINT64_MAX if none
+	static uint64_t oldestReaderEpoch();
+
+	struct Slot;
+
+private:
+	RsRcuReadLock(const RsRcuReadLock&) = delete;
+	RsRcuReadLock& operator=(const RsRcuReadLock&) = delete;
+
+	Slot* mSlot;
+};
+
+/**
+ * @brief Pointer to an immutable object, read lock free and replaced by a
+ * single writer (read-copy-update).
+ * Readers call get() inside a RsRcuReadLock, the writer publish() a new
+ * version, the replaced one is freed when no reader can see it anymore, on
+ * next publish() or reclaim().
+ * publish(), published() and reclaim() must be serialised by the caller.
+ */
+template<class T> class RsRcuPtr
+{
+public:
+	RsRcuPtr() : mPtr(nullptr) {}
+
+	/// @return the last published version, valid until the read lock is left
+	const T* get() const { return mPtr.load(); }
+
+	/// @return the last published version, for the writer to copy
+	const std::shared_ptr<const T>& published() const { return mPublished; }
+
+	void publish(std::shared_ptr<const T> ptr)
+	{
+		if(ptr == mPublished) return;
+
+		std::shared_ptr<const T> old = std::move(mPublished);
+		mPublished = std::move(ptr);
+		mPtr.store(mPublished.get());
+
+		if(old) mRetired.push_back(
+		            std::make_pair(RsRcuReadLock::advanceEpoch(), std::move(old)) );
+		reclaim();
+	}
+
+	/// Free the replaced versions no reader can see anymore
+	void reclaim()
+	{
+		if(mRetired.empty()) return;
+
+		const uint64_t oldest = RsRcuReadLock::oldestReaderEpoch();
+		while(!mRetired.empty() && mRetired.front().first <= oldest)
+			mRetired.pop_front();
+	}
+
+private:
+	RsRcuPtr(const RsRcuPtr&) = delete;
+	RsRcuPtr& operator=(const RsRcuPtr&) = delete;
+
+	std::atomic<const T*> mPtr;
+	std::shared_ptr<const T> mPublished;
+	std::deque<std::pair<uint64_t, std::shared_ptr<const T> > > mRetired;
+};
@@ -44,6 +44,13 @@ int rs_usleep(uint32_t micro_seconds)
 	return 0 ;
 }
 
+double getCurrentTS()
+{
+	timeval tv ;
+	gettimeofday(&tv,NULL) ;
+	return tv.tv_sec + tv.tv_usec/1000000.0 ;
+}
+
 RsScopeTimer::RsScopeTimer(const std::string& name)
 {
 	_name = name ;
@@ -58,6 +58,12 @@ namespace rstime {
 RS_DEPRECATED_FOR("std::this_thread::sleep_for")
 int rs_usleep(uint32_t micro_seconds);
 
+/**
+ * @brief Current time in seconds since the epoch, with microseconds, for
+ * rates and short delays. Unlike RsScopeTimer::currentTime() it doesn't wrap.
+ */
+double getCurrentTS();
+
 	/* Use this class to measure and display time duration of a given environment:
 
 	 {
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * benchmarks/benchmarks.cc                                                    *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "benchmarks.h"
+
+struct RsBenchmarkEntry
+{
+	std::string usage;
+	RsBenchmarkFn fn;
+};
+
+static std::map<std::string, RsBenchmarkEntry>& registry()
+{
+	static std::map<std::string, RsBenchmarkEntry> benchmarks;
+	return benchmarks;
+}
+
+RsBenchmarkRegistrar::RsBenchmarkRegistrar(
+        const char* name, const char* usage, RsBenchmarkFn fn )
+{ registry()[name] = RsBenchmarkEntry{usage, fn}; }
+
+RsBenchmarkOptions::RsBenchmarkOptions(int argc, char** argv)
+{
+	for(int i = 0; i + 1 < argc; i += 2)
+	{
+		std::string key(argv[i]);
+		if(key.compare(0, 2, "--") == 0) key = key.substr(2);
+		mValues[key] = argv[i+1];
+	}
+}
+
+std::string RsBenchmarkOptions::get(
+        const std::string& key, const std::string& def ) const
+{
+	auto it = mValues.find(key);
+	return it == mValues.end() ? def : it->second;
+}
+
+uint64_t RsBenchmarkOptions::get(const std::string& key, uint64_t def) const
+{
+	auto it = mValues.find(key);
+	return it == mValues.end() ? def : strtoull(it->second.c_str(), nullptr, 10);
+}
+
+double RsBenchmarkOptions::get(const std::string& key, double def) const
+{
+	auto it = mValues.find(key);
+	return it == mValues.end() ? def : strtod(it->second.c_str(), nullptr);
+}
+
+double rsBenchmarkNow()
+{
+	return std::chrono::duration<double>(
+	            std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+double RsBenchmarkSamples::percentile(double p)
+{
+	if(mSamples.empty()) return 0;
+	if(!mSorted)
+	{
+		std::sort(mSamples.begin(), mSamples.end());
+		mSorted = true;
+	}
+	size_t i = static_cast<size_t>(p * (mSamples.size() - 1) + 0.5);
+	return mSamples[std::min(i, mSamples.size() - 1)];
+}
+
+/* Count heap allocations by interposing glibc malloc family. operator new
+ * goes through malloc too, so everything allocated by libretroshare is seen */
+#ifdef __GLIBC__
+static std::atomic<uint64_t> sAllocCount(0);
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+	sAllocCount.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+	sAllocCount.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	sAllocCount.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+}
+
+uint64_t rsBenchmarkAllocCount() { return sAllocCount.load(); }
+#else
+uint64_t rsBenchmarkAllocCount() { return 0; }
+#endif
+
+int main(int argc, char** argv)
+{
+	if(argc < 2 || !registry().count(argv[1]))
+	{
+		std::cerr << "Usage: " << argv[0] << " <benchmark> [--option value]..."
+		          << std::endl << "Available benchmarks:" << std::endl;
+		for(auto& b : registry())
+			std::cerr << "  " << b.first << " " << b.second.usage << std::endl;
+		return 1;
+	}
+
+	RsBenchmarkOptions options(argc - 2, argv + 2);
+	return registry()[argv[1]].fn(options);
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * benchmarks/benchmarks.h                                                     *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Small framework for offline performance benchmarks of libretroshare.
+ * Each benchmark registers itself with RS_BENCHMARK() and is run by name:
+ *	rsbenchmarks <name> [--option value]...
+ */
+struct RsBenchmarkOptions
+{
+	RsBenchmarkOptions(int argc, char** argv);
+
+	std::string get(const std::string& key, const std::string& def) const;
+	uint64_t get(const std::string& key, uint64_t def) const;
+	double get(const std::string& key, double def) const;
+
+	std::map<std::string, std::string> mValues;
+};
+
+typedef int (*RsBenchmarkFn)(const RsBenchmarkOptions& options);
+
+struct RsBenchmarkRegistrar
+{
+	RsBenchmarkRegistrar( const char* name, const char* usage,
+	                      RsBenchmarkFn fn );
+};
+
+#define RS_BENCHMARK(name, usage) \
+	static int name##_benchmark(const RsBenchmarkOptions& options); \
+	static RsBenchmarkRegistrar name##_registrar( \
+	    #name, usage, &name##_benchmark ); \
+	static int name##_benchmark(const RsBenchmarkOptions& options)
+
+/// Number of heap allocations done by the process so far (0 if not tracked)
+uint64_t rsBenchmarkAllocCount();
+
+/// Monotonic time in seconds
+double rsBenchmarkNow();
+
+/// Collects samples (latencies...) and reports percentiles
+class RsBenchmarkSamples
+{
+public:
+	void add(double v) { mSamples.push_back(v); }
+	size_t count() const { return mSamples.size(); }
+
+	/// @param p in [0,1]. Sorts the samples on first call.
+	double percentile(double p);
+
+private:
+	std::vector<double> mSamples;
+	bool mSorted = false;
+};
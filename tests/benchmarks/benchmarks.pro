@@ -0,0 +1,100 @@
+################################################################################
+# benchmarks.pro                                                               #
+# Copyright (C) 2026, Retroshare team <retroshare.team@gmailcom>               #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Lesser General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Lesser General Public License     #
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.       #
+################################################################################
+
+!include("../../retroshare.pri"): error("Could not include file ../../retroshare.pri")
+
+# Offline performance benchmarks, run as:
+#	./rsbenchmarks <benchmark> [--option value]...
+# Build in release mode, figures of debug builds are meaningless.
+
+CONFIG += bitdht gxs release
+CONFIG -= debug
+
+gxs {
+	DEFINES += RS_ENABLE_GXS
+}
+
+TEMPLATE = app
+TARGET = rsbenchmarks
+
+OPENPGPSDK_DIR = ../../openpgpsdk/src
+INCLUDEPATH *= $${OPENPGPSDK_DIR} ../openpgpsdk
+
+################################# Linux ##########################################
+linux-* {
+	QMAKE_CXXFLAGS *= -D_FILE_OFFSET_BITS=64
+
+	PRE_TARGETDEPS *= ../../libretroshare/src/lib/libretroshare.a
+	PRE_TARGETDEPS *= ../../openpgpsdk/src/lib/libops.a
+
+	LIBS += ../../libretroshare/src/lib/libretroshare.a
+	LIBS += ../../openpgpsdk/src/lib/libops.a -lbz2
+	LIBS += -lssl -lupnp -lixml
+	LIBS *= -lcrypto -ldl -lz -lpthread
+
+	no_sqlcipher {
+		DEFINES *= NO_SQLCIPHER
+		PKGCONFIG *= sqlite3
+	} else {
+		LIBS += -lsqlcipher
+	}
+
+	LIBS *= -rdynamic
+	OBJECTS_DIR = temp/linux/obj
+}
+
+##################################### MacOS ######################################
+macx {
+	LIBS += ../../libretroshare/src/lib/libretroshare.a
+	LIBS += ../../openpgpsdk/src/lib/libops.a -lbz2
+	LIBS += -lssl -lcrypto -lz
+	LIBS += /usr/local/lib/libsqlcipher.a
+	LIBS += -framework CoreFoundation
+	LIBS += -framework Security
+
+	for(lib, LIB_DIR):LIBS += -L"$$lib"
+	for(bin, BIN_DIR):LIBS += -L"$$bin"
+}
+
+############################## Common stuff ######################################
+
+bitdht {
+	LIBS += ../../libbitdht/src/lib/libbitdht.a
+	PRE_TARGETDEPS *= ../../libbitdht/src/lib/libbitdht.a
+}
+
+INCLUDEPATH += ../../libretroshare/src/
+
+HEADERS += benchmarks.h
+SOURCES += benchmarks.cc
+
+################################ pqi ###################################
+
+SOURCES += libretroshare/pqi/wirepath_benchmark.cc \
+	libretroshare/pqi/pqihandler_benchmark.cc
+
+################################ tcponudp ###################################
+
+SOURCES += libretroshare/tcponudp/tcpstream_benchmark.cc \
+	libretroshare/tcponudp/udprelay_benchmark.cc
+
+################################ gxs ###################################
+
+gxs {
+	SOURCES += libretroshare/gxs/rsdataservice_benchmark.cc
+}
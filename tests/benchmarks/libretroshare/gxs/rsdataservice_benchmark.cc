@@ -0,0 +1,286 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/gxs/rsdataservice_benchmark.cc                     *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+/* Queries of RsDataService on a synthetic message database: the meta data of
+ * whole groups (what opening a forum and RsGxsCleanUp do), the same read page
+ * by page, newest first, the message ids of groups, and single messages by id.
+ * The database is built once and kept, so several runs can compare the index
+ * layouts:
+ *	rsbenchmarks gxsdb --legacy-index 1   # only the group id index (release 1)
+ *	rsbenchmarks gxsdb --reuse 1          # migrates back to the current one
+ * The figures include the OS page cache, drop it between runs for cold ones. */
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "benchmarks.h"
+
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgxsutil.h"
+#include "retroshare/rsgxsifacetypes.h"
+#include "rsitems/rsnxsitems.h"
+#include "rsitems/rsserviceids.h"
+#include "util/retrodb.h"
+#include "util/rsdir.h"
+#include "util/rsrandom.h"
+
+static const char* DB_NAME = "gxsdb_benchmark";
+
+struct BenchmarkMsg
+{
+	size_t grp;
+	RsGxsMessageId msgId;
+};
+
+static void fillDatabase( const std::string& dir, uint64_t nbMsgs,
+                          const std::vector<RsGxsGroupId>& grps, uint32_t size,
+                          std::vector<BenchmarkMsg>& msgs )
+{
+	RsDataService ds(dir, DB_NAME, RS_SERVICE_GXS_TYPE_FORUMS);
+	std::vector<char> data(size, 'x');
+	std::vector<std::vector<RsGxsMessageId>> threads(grps.size());
+	const rstime_t now = time(NULL);
+	const double start = rsBenchmarkNow();
+
+	msgs.reserve(nbMsgs);
+	while(msgs.size() < nbMsgs)
+	{
+		std::list<RsNxsMsg*> batch;
+
+		for(int i = 0; i < 1000 && msgs.size() < nbMsgs; ++i)
+		{
+			size_t grp = RsRandom::random_u32() % grps.size();
+
+			RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_GXS_TYPE_FORUMS);
+			msg->grpId = grps[grp];
+			msg->msgId = RsGxsMessageId::random();
+			msg->msg.setBinData(data.data(), size);
+
+			RsGxsMsgMetaData* meta = new RsGxsMsgMetaData;
+			meta->mGroupId = msg->grpId;
+			meta->mMsgId = msg->msgId;
+			meta->mAuthorId = RsGxsId::random();
+			meta->mMsgName = "benchmark message";
+			meta->mPublishTs = now - RsRandom::random_u32() % (365 * 86400);
+			meta->recvTS = now;
+
+			/* one message out of four starts a thread, the others answer
+			 * somewhere in a thread of the group */
+			std::vector<RsGxsMessageId>& grpThreads = threads[grp];
+			if(grpThreads.empty() || RsRandom::random_u32() % 4 == 0)
+				grpThreads.push_back(msg->msgId);
+			else
+			{
+				meta->mThreadId = grpThreads[RsRandom::random_u32() % grpThreads.size()];
+				meta->mParentId = meta->mThreadId;
+			}
+
+			msg->metaData = meta;
+			batch.push_back(msg);
+			msgs.push_back(BenchmarkMsg{grp, msg->msgId});
+		}
+
+		ds.storeMessage(batch);
+	}
+
+	const double elapsed = rsBenchmarkNow() - start;
+	std::cout << std::fixed << std::setprecision(1)
+	          << "stored: " << nbMsgs << " messages in " << elapsed << " s, "
+	          << nbMsgs / elapsed << " msgs/s" << std::endl;
+}
+
+/// Put back the layout of release 1, the next open migrates it again
+static bool setLegacyIndex(const std::string& path)
+{
+	RetroDb db(path, RetroDb::OPEN_READWRITE);
+
+	bool ok = db.isOpen();
+	ok = ok && db.execSQL("DROP INDEX IF EXISTS INDEX_MESSAGES_META;");
+	ok = ok && db.execSQL("DROP INDEX IF EXISTS INDEX_MESSAGES_TS;");
+	ok = ok && db.execSQL("CREATE INDEX IF NOT EXISTS INDEX_MESSAGES_GRPID ON MESSAGES(grpId);");
+	ok = ok && db.execSQL("ALTER TABLE MESSAGES DROP COLUMN nxsBlob;");
+	ok = ok && db.execSQL("ALTER TABLE GROUPS DROP COLUMN nxsBlob;");
+	ok = ok && db.execSQL("UPDATE DATABASE_RELEASE SET release=1;");
+
+	db.closeDb();
+	return ok;
+}
+
+RS_BENCHMARK( gxsdb,
+              "[--dir gxsdb_benchmark] [--msgs 1000000] [--groups 100] "
+              "[--size 512] [--lookups 10000] [--page 100] [--legacy-index 0] "
+              "[--reuse 0]" )
+{
+	const std::string dir = options.get("dir", std::string("gxsdb_benchmark"));
+	const uint64_t nbMsgs = options.get("msgs", uint64_t(1000000));
+	const uint64_t nbGroups = options.get("groups", uint64_t(100));
+	const uint32_t size = options.get("size", uint64_t(512));
+	const uint64_t nbLookups = options.get("lookups", uint64_t(10000));
+	const uint32_t pageSize = options.get("page", uint64_t(100));
+	const bool legacyIndex = options.get("legacy-index", uint64_t(0)) != 0;
+	const bool reuse = options.get("reuse", uint64_t(0)) != 0;
+
+	const std::string path = dir + "/" + DB_NAME;
+
+	if(!nbGroups || !pageSize || !RsDirUtil::checkCreateDirectory(dir))
+	{
+		std::cerr << "--groups and --page must be > 0 and --dir writable" << std::endl;
+		return 1;
+	}
+
+	std::vector<RsGxsGroupId> grps;
+	std::vector<BenchmarkMsg> msgs;
+
+	if(reuse && RsDirUtil::fileExists(path))
+	{
+		/* take the groups and messages from the database */
+		RetroDb db(path, RetroDb::OPEN_READONLY);
+		std::list<std::string> columns = { "grpId", "msgId" };
+		RetroCursor* c = db.sqlQuery("MESSAGES", columns, "", "grpId");
+		std::string grpId, msgId;
+
+		for(bool valid = c && c->moveToFirst(); valid; valid = c->moveToNext())
+		{
+			c->getString(0, grpId);
+			c->getString(1, msgId);
+
+			if(grps.empty() || grps.back() != RsGxsGroupId(grpId))
+				grps.push_back(RsGxsGroupId(grpId));
+			msgs.push_back(BenchmarkMsg{grps.size() - 1, RsGxsMessageId(msgId)});
+		}
+
+		delete c;
+		db.closeDb();
+	}
+	else
+	{
+		remove(path.c_str());
+		for(uint64_t i = 0; i < nbGroups; ++i)
+			grps.push_back(RsGxsGroupId::random());
+		fillDatabase(dir, nbMsgs, grps, size, msgs);
+	}
+
+	if(msgs.empty())
+	{
+		std::cerr << "No message in " << path << std::endl;
+		return 1;
+	}
+
+	if(legacyIndex && !setLegacyIndex(path))
+	{
+		std::cerr << "Could not set the legacy index of " << path << std::endl;
+		return 1;
+	}
+
+	/* opening migrates the index if needed */
+	double start = rsBenchmarkNow();
+	RsDataService ds(dir, DB_NAME, RS_SERVICE_GXS_TYPE_FORUMS);
+	std::cout << std::fixed << std::setprecision(1)
+	          << "messages: " << msgs.size() << " in " << grps.size() << " groups"
+	          << (legacyIndex ? ", legacy index" : "") << std::endl
+	          << "open: " << (rsBenchmarkNow() - start) * 1e3 << " ms" << std::endl;
+
+	/* single messages, before the meta data cache of their group is filled */
+	RsBenchmarkSamples metaById, dataById;
+	for(uint64_t i = 0; i < nbLookups; ++i)
+	{
+		const BenchmarkMsg& m = msgs[RsRandom::random_u32() % msgs.size()];
+		GxsMsgReq req;
+		req[grps[m.grp]].insert(m.msgId);
+
+		GxsMsgMetaResult metaResult;
+		start = rsBenchmarkNow();
+		ds.retrieveGxsMsgMetaData(req, metaResult);
+		metaById.add(rsBenchmarkNow() - start);
+
+		RsNxsMsgDataTemporaryMap dataResult;
+		start = rsBenchmarkNow();
+		ds.retrieveNxsMsgs(req, dataResult, false);
+		dataById.add(rsBenchmarkNow() - start);
+	}
+
+	RsBenchmarkSamples idsByGroup, metaByGroup;
+	uint64_t nbIds = 0, nbMetas = 0;
+	for(const RsGxsGroupId& grpId : grps)
+	{
+		RsGxsMessageId::std_set ids;
+		start = rsBenchmarkNow();
+		ds.retrieveMsgIds(grpId, ids);
+		idsByGroup.add(rsBenchmarkNow() - start);
+		nbIds += ids.size();
+
+		GxsMsgReq req;
+		req[grpId];
+		GxsMsgMetaResult result;
+		start = rsBenchmarkNow();
+		ds.retrieveGxsMsgMetaData(req, result);
+		metaByGroup.add(rsBenchmarkNow() - start);
+		nbMetas += result[grpId].size();
+	}
+
+	RsBenchmarkSamples pageOfGroup;
+	uint64_t nbPaged = 0;
+	for(const RsGxsGroupId& grpId : grps)
+	{
+		RsGxsMsgPageCursor after;
+		do
+		{
+			std::vector<std::shared_ptr<RsGxsMsgMetaData> > page;
+			start = rsBenchmarkNow();
+			ds.retrieveGxsMsgMetaPage( grpId, pageSize,
+			                           RsGxsMsgPageOrder::PUBLISH_TS_DESC,
+			                           after, page );
+			pageOfGroup.add(rsBenchmarkNow() - start);
+			nbPaged += page.size();
+
+			after = RsGxsMsgPageCursor();
+			if(page.size() == pageSize)
+			{
+				after.mMsgId = page.back()->mMsgId;
+				after.mPublishTs = page.back()->mPublishTs;
+			}
+		}
+		while(!after.isNull());
+	}
+
+	if(nbIds != msgs.size() || nbMetas != msgs.size() || nbPaged != msgs.size())
+	{
+		std::cerr << "Missing messages: " << nbIds << " ids, " << nbMetas
+		          << " metas, " << nbPaged << " paged out of " << msgs.size()
+		          << std::endl;
+		return 1;
+	}
+
+	std::cout << std::setprecision(3)
+	          << "meta by id (ms): p50 " << metaById.percentile(0.5) * 1e3
+	          << " p99 " << metaById.percentile(0.99) * 1e3 << std::endl
+	          << "data by id (ms): p50 " << dataById.percentile(0.5) * 1e3
+	          << " p99 " << dataById.percentile(0.99) * 1e3 << std::endl
+	          << "ids of group (ms): p50 " << idsByGroup.percentile(0.5) * 1e3
+	          << " max " << idsByGroup.percentile(1.0) * 1e3 << std::endl
+	          << "meta of group (ms): p50 " << metaByGroup.percentile(0.5) * 1e3
+	          << " max " << metaByGroup.percentile(1.0) * 1e3 << std::endl
+	          << "page of " << pageSize << " (ms): p50 "
+	          << pageOfGroup.percentile(0.5) * 1e3
+	          << " p99 " << pageOfGroup.percentile(0.99) * 1e3 << std::endl;
+
+	return 0;
+}
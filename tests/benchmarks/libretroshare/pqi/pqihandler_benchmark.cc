@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/pqi/pqihandler_benchmark.cc                        *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+/* Many service threads sending items to many peers through pqihandler, to
+ * measure contention on the dispatch path. Peers are stand-ins which just
+ * count the items (optionally spinning a while, like a streamer queuing the
+ * item), so the figures only depend on pqihandler locking. */
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchmarks.h"
+
+#include "pqi/pqihandler.h"
+#include "pqi/pqi_base.h"
+#include "rsitems/rsitem.h"
+#include "rsitems/rsserviceids.h"
+#include "serialiser/rsserial.h"
+
+/// Peer module counting received items under its own mutex
+class ContentionPeer: public PQInterface
+{
+public:
+	ContentionPeer(const RsPeerId& id, uint64_t spin) :
+	    PQInterface(id), mSpin(spin), mCount(0) {}
+
+	int SendItem(RsItem* item) override
+	{
+		uint32_t size;
+		return SendItem(item, size);
+	}
+
+	int SendItem(RsItem* item, uint32_t& size) override
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+
+		size = static_cast<RsRawItem*>(item)->getRawLength();
+		for(volatile uint64_t i = 0; i < mSpin; ++i);
+		++mCount;
+
+		delete item;
+		return 1;
+	}
+
+	RsItem* GetItem() override { return nullptr; }
+
+	uint64_t count()
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+		return mCount;
+	}
+
+private:
+	std::mutex mMtx;
+	const uint64_t mSpin;
+	uint64_t mCount;
+};
+
+RS_BENCHMARK( pqihandler,
+              "[--threads 8] [--peers 64] [--items 200000] [--size 256] "
+              "[--spin 200] [--global-lock 0]" )
+{
+	const uint64_t nbThreads = options.get("threads", uint64_t(8));
+	const uint64_t nbPeers = options.get("peers", uint64_t(64));
+	const uint64_t nbItems = options.get("items", uint64_t(200000));
+	const uint32_t size = options.get("size", uint64_t(256));
+	const uint64_t spin = options.get("spin", uint64_t(200));
+
+	/* serialise all senders on a single mutex, as the whole dispatch was done
+	 * under pqihandler::coreMtx, to compare with the sharded path */
+	const bool globalLock = options.get("global-lock", uint64_t(0)) != 0;
+
+	if(!nbThreads || !nbPeers)
+	{
+		std::cerr << "--threads and --peers must be > 0" << std::endl;
+		return 1;
+	}
+
+	pqihandler handler;
+	std::vector<std::unique_ptr<ContentionPeer>> peers;
+	std::vector<std::unique_ptr<SearchModule>> modules;
+
+	for(uint64_t i = 0; i < nbPeers; ++i)
+	{
+		RsPeerId id = RsPeerId::random();
+		peers.emplace_back(new ContentionPeer(id, spin));
+		modules.emplace_back(new SearchModule);
+		modules.back()->peerid = id;
+		modules.back()->pqi = peers.back().get();
+		handler.AddSearchModule(modules.back().get());
+	}
+
+	const uint32_t packetId = (uint32_t(RS_PKT_VERSION_SERVICE) << 24) |
+	        (uint32_t(RS_SERVICE_TYPE_CHAT) << 8) | 0x01;
+
+	std::mutex global;
+	std::atomic<bool> go(false);
+	std::vector<std::thread> threads;
+	RsBenchmarkSamples perThread;
+	std::vector<double> elapsed(nbThreads);
+
+	for(uint64_t t = 0; t < nbThreads; ++t)
+		threads.emplace_back([&, t]()
+		{
+			while(!go.load()) std::this_thread::yield();
+
+			const double start = rsBenchmarkNow();
+			for(uint64_t i = t; i < nbItems; i += nbThreads)
+			{
+				RsRawItem* item = new RsRawItem(packetId, size);
+				item->PeerId(peers[(i * 2654435761u) % nbPeers]->PeerId());
+
+				if(globalLock)
+				{
+					std::lock_guard<std::mutex> lock(global);
+					handler.SendRsRawItem(item);
+				}
+				else handler.SendRsRawItem(item);
+			}
+			elapsed[t] = rsBenchmarkNow() - start;
+		});
+
+	const double start = rsBenchmarkNow();
+	go = true;
+	for(std::thread& t : threads) t.join();
+	const double total = rsBenchmarkNow() - start;
+
+	uint64_t received = 0;
+	for(auto& p : peers) received += p->count();
+
+	for(uint64_t t = 0; t < nbThreads; ++t) perThread.add(elapsed[t]);
+
+	for(auto& m : modules) handler.RemoveSearchModule(m.get());
+
+	if(received != nbItems)
+	{
+		std::cerr << "Lost items: " << nbItems - received << std::endl;
+		return 1;
+	}
+
+	std::cout << std::fixed << std::setprecision(1)
+	          << "items: " << received << " in " << total * 1e3 << " ms, "
+	          << nbThreads << " threads, " << nbPeers << " peers"
+	          << (globalLock ? ", global lock" : "") << std::endl
+	          << "throughput: " << received / total << " items/s" << std::endl
+	          << "thread time (ms): p50 " << perThread.percentile(0.5) * 1e3
+	          << " max " << perThread.percentile(1.0) * 1e3 << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/pqi/wirepath_benchmark.cc                          *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+/* Moves items through the whole wire path of a peer connection, without
+ * network nor crypto:
+ *	RsSerialiser -> pqiQoSstreamer (pqiQoS, slicing) -> BinInterface
+ *	-> pqiQoSstreamer (reassembly) -> RsSerialiser
+ * The BinInterface is an in memory pipe standing in for pqissl, so the figures
+ * only depend on the streamer, QoS and serialisation code. */
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "benchmarks.h"
+
+#include "chat/rschatitems.h"
+#include "ft/ftturtlefiletransferitem.h"
+#include "pqi/pqiqosstreamer.h"
+#include "rsitems/rsfiletransferitems.h"
+#include "rsitems/rsnxsitems.h"
+#include "rsitems/rsserviceids.h"
+#include "serialiser/rsserial.h"
+
+/// One direction of the in memory connection
+struct WirePipe
+{
+	std::vector<uint8_t> mData;
+	size_t mStart = 0;
+
+	size_t available() const { return mData.size() - mStart; }
+};
+
+/// BinInterface writing to one pipe and reading from the other
+class WirePipeBin: public BinInterface
+{
+public:
+	WirePipeBin(WirePipe& in, WirePipe& out, size_t capacity) :
+	    mIn(in), mOut(out), mCapacity(capacity) {}
+
+	int tick() override { return 0; }
+
+	int senddata(void* data, int len) override
+	{
+		if(mOut.available() >= mCapacity) return -1; // like EWOULDBLOCK
+
+		const uint8_t* d = static_cast<const uint8_t*>(data);
+		mOut.mData.insert(mOut.mData.end(), d, d + len);
+		return len;
+	}
+
+	/* Same behaviour as pqissl, expected by pqistreamer: either the whole
+	 * requested size is read, or nothing */
+	int readdata(void* data, int len) override
+	{
+		if(mIn.available() < static_cast<size_t>(len)) return -1;
+
+		memcpy(data, mIn.mData.data() + mIn.mStart, len);
+		mIn.mStart += len;
+
+		if(mIn.mStart == mIn.mData.size()) { mIn.mData.clear(); mIn.mStart = 0; }
+		else if(mIn.mStart > mIn.mData.size() / 2)
+		{
+			mIn.mData.erase(mIn.mData.begin(), mIn.mData.begin() + mIn.mStart);
+			mIn.mStart = 0;
+		}
+		return len;
+	}
+
+	int netstatus() override { return 1; }
+	int isactive() override { return 1; }
+	bool moretoread(uint32_t) override { return mIn.available() > 0; }
+	bool cansend(uint32_t) override { return mOut.available() < mCapacity; }
+	int close() override { return 0; }
+	RsFileHash gethash() override { return RsFileHash(); }
+	bool bandwidthLimited() override { return false; }
+
+private:
+	WirePipe& mIn;
+	WirePipe& mOut;
+	size_t mCapacity;
+};
+
+/// Exposes the send/receive rounds normally run by the streamer thread
+class WireStreamer: public pqiQoSstreamer
+{
+public:
+	WireStreamer(RsSerialiser* rss, const RsPeerId& id, BinInterface* bio) :
+	    pqiQoSstreamer(nullptr, rss, id, bio, 0) {}
+
+	void sendRound() { tick_send(0); }
+	void recvRound() { tick_recv(0); }
+};
+
+/// Turtle file data items are normally deserialised by ftServer
+struct WireTurtleFtSerialiser: RsServiceSerializer
+{
+	WireTurtleFtSerialiser() : RsServiceSerializer(RS_SERVICE_TYPE_TURTLE) {}
+
+	RsItem* create_item(uint16_t service, uint8_t subtype) const override
+	{
+		if( service == RS_SERVICE_TYPE_TURTLE &&
+		        subtype == RS_TURTLE_SUBTYPE_FILE_DATA )
+			return new RsTurtleFileDataItem();
+		return nullptr;
+	}
+};
+
+static RsSerialiser* wireSerialiser()
+{
+	RsSerialiser* rss = new RsSerialiser();
+	rss->addSerialType(new RsChatSerialiser());
+	rss->addSerialType(new RsNxsSerialiser(RS_SERVICE_GXS_TYPE_CHANNELS));
+	rss->addSerialType(new WireTurtleFtSerialiser());
+	rss->addSerialType(new RsFileTransferSerialiser());
+	return rss;
+}
+
+enum WireItemType { WIRE_CHAT, WIRE_NXS, WIRE_TURTLE, WIRE_FT, WIRE_TYPES };
+static const char* wireItemNames[WIRE_TYPES] = { "chat", "nxs", "turtle", "ft" };
+
+/// Creates an item of given type, carrying seq in one of its fields
+static RsItem* makeItem( WireItemType type, uint32_t seq, uint32_t chatSize,
+                         const std::vector<uint8_t>& payload )
+{
+	switch(type)
+	{
+	case WIRE_CHAT:
+	{
+		RsChatMsgItem* item = new RsChatMsgItem();
+		item->chatFlags = 0;
+		item->sendTime = seq;
+		item->message.assign(chatSize, 'x');
+		return item;
+	}
+	case WIRE_NXS:
+	{
+		RsNxsMsg* item = new RsNxsMsg(RS_SERVICE_GXS_TYPE_CHANNELS);
+		item->transactionNumber = seq;
+		item->msg.setBinData(payload.data(), payload.size());
+		item->meta.setBinData(payload.data(), std::min<size_t>(payload.size(), 256));
+		return item;
+	}
+	case WIRE_TURTLE:
+	{
+		RsTurtleFileDataItem* item = new RsTurtleFileDataItem();
+		item->tunnel_id = seq;
+		item->chunk_offset = uint64_t(seq) * payload.size();
+		item->chunk_size = payload.size();
+		item->chunk_data = rs_malloc(payload.size());
+		memcpy(item->chunk_data, payload.data(), payload.size());
+		return item;
+	}
+	case WIRE_FT:
+	{
+		RsFileTransferDataItem* item = new RsFileTransferDataItem();
+		item->fd.file_offset = seq;
+		item->fd.binData.setBinData(payload.data(), payload.size());
+		return item;
+	}
+	default: return nullptr;
+	}
+}
+
+/// @return the seq stored by makeItem(), or false if item is unexpected
+static bool itemSeq(const RsItem* item, uint32_t& seq)
+{
+	if(auto i = dynamic_cast<const RsChatMsgItem*>(item)) seq = i->sendTime;
+	else if(auto i = dynamic_cast<const RsNxsMsg*>(item)) seq = i->transactionNumber;
+	else if(auto i = dynamic_cast<const RsTurtleFileDataItem*>(item)) seq = i->tunnel_id;
+	else if(auto i = dynamic_cast<const RsFileTransferDataItem*>(item)) seq = i->fd.file_offset;
+	else return false;
+	return true;
+}
+
+/// Parse a mix like "chat=40,nxs=20,turtle=20,ft=20" into cumulative weights
+static bool parseMix(const std::string& mix, std::vector<uint32_t>& weights)
+{
+	weights.assign(WIRE_TYPES, 0);
+	std::istringstream in(mix);
+	std::string entry;
+
+	while(std::getline(in, entry, ','))
+	{
+		size_t eq = entry.find('=');
+		if(eq == std::string::npos) return false;
+
+		std::string name = entry.substr(0, eq);
+		int type = 0;
+		while(type < WIRE_TYPES && name != wireItemNames[type]) ++type;
+		if(type == WIRE_TYPES) return false;
+
+		weights[type] = strtoul(entry.c_str() + eq + 1, nullptr, 10);
+	}
+
+	for(int i = 1; i < WIRE_TYPES; ++i) weights[i] += weights[i-1];
+	return weights.back() > 0;
+}
+
+RS_BENCHMARK( wirepath,
+              "[--items 100000] [--mix chat=40,nxs=20,turtle=20,ft=20] "
+              "[--burst 64] [--chat-size 200] [--data-size 8192] "
+              "[--pipe-buffer 262144]" )
+{
+	const uint64_t nbItems = options.get("items", uint64_t(100000));
+	const uint64_t burst = options.get("burst", uint64_t(64));
+	const uint32_t chatSize = options.get("chat-size", uint64_t(200));
+	const uint32_t dataSize = options.get("data-size", uint64_t(8192));
+	const size_t pipeBuffer = options.get("pipe-buffer", uint64_t(256*1024));
+
+	std::vector<uint32_t> weights;
+	if(!parseMix(options.get("mix", std::string("chat=40,nxs=20,turtle=20,ft=20")), weights))
+	{
+		std::cerr << "Invalid --mix, expected type=weight,... with types "
+		          << "chat, nxs, turtle, ft" << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> payload(dataSize);
+	for(uint32_t i = 0; i < dataSize; ++i) payload[i] = uint8_t(i * 7);
+
+	WirePipe aToB, bToA;
+	RsPeerId peerA = RsPeerId::random(), peerB = RsPeerId::random();
+	WireStreamer a(wireSerialiser(), peerB, new WirePipeBin(bToA, aToB, pipeBuffer));
+	WireStreamer b(wireSerialiser(), peerA, new WirePipeBin(aToB, bToA, pipeBuffer));
+
+	/* exchange packet slicing probes, so large items get sliced as with
+	 * current peers */
+	a.sendRound(); b.sendRound();
+	a.recvRound(); b.recvRound();
+
+	std::vector<double> sentTs(nbItems);
+	std::vector<WireItemType> sentType(nbItems);
+	RsBenchmarkSamples latency[WIRE_TYPES + 1];
+	uint64_t count[WIRE_TYPES] = {0};
+	uint64_t bytes = 0, sent = 0, received = 0, rounds = 0, idleRounds = 0;
+
+	const uint64_t allocStart = rsBenchmarkAllocCount();
+	const double start = rsBenchmarkNow();
+
+	while(received < nbItems)
+	{
+		for(uint64_t i = 0; i < burst && sent < nbItems; ++i, ++sent)
+		{
+			uint32_t w = (sent * 2654435761u) % weights.back();
+			int type = 0;
+			while(w >= weights[type]) ++type;
+
+			uint32_t size = 0;
+			sentType[sent] = WireItemType(type);
+			sentTs[sent] = rsBenchmarkNow();
+			a.SendItem(makeItem(WireItemType(type), sent, chatSize, payload), size);
+			bytes += size;
+		}
+
+		a.sendRound();
+		b.recvRound();
+		++rounds;
+
+		uint64_t before = received;
+		while(RsItem* item = b.GetItem())
+		{
+			double now = rsBenchmarkNow();
+			uint32_t seq;
+
+			if(!itemSeq(item, seq) || seq >= sent)
+			{
+				std::cerr << "Unexpected item received" << std::endl;
+				delete item;
+				return 1;
+			}
+
+			latency[sentType[seq]].add(now - sentTs[seq]);
+			latency[WIRE_TYPES].add(now - sentTs[seq]);
+			++count[sentType[seq]];
+			++received;
+			delete item;
+		}
+
+		idleRounds = received == before && sent == nbItems ? idleRounds + 1 : 0;
+		if(idleRounds > 1000000)
+		{
+			std::cerr << "Stalled after " << received << " items" << std::endl;
+			return 1;
+		}
+	}
+
+	const double elapsed = rsBenchmarkNow() - start;
+	const uint64_t allocs = rsBenchmarkAllocCount() - allocStart;
+
+	std::cout << std::fixed << std::setprecision(1)
+	          << "items: " << received << " in " << elapsed << " s, "
+	          << rounds << " rounds" << std::endl
+	          << "throughput: " << received / elapsed << " items/s, "
+	          << bytes / elapsed / (1024*1024) << " MiB/s" << std::endl
+	          << "allocations: " << allocs << " ("
+	          << double(allocs) / received << " per item)" << std::endl
+	          << "latency (us):" << std::endl
+	          << std::left << std::setw(8) << "type" << std::right
+	          << std::setw(8) << "count" << std::setw(10) << "p50"
+	          << std::setw(10) << "p90" << std::setw(10) << "p99"
+	          << std::setw(10) << "max" << std::endl;
+
+	for(int t = 0; t <= WIRE_TYPES; ++t)
+	{
+		if(!latency[t].count()) continue;
+		std::cout << std::left << std::setw(8)
+		          << (t == WIRE_TYPES ? "all" : wireItemNames[t])
+		          << std::right << std::setw(8)
+		          << (t == WIRE_TYPES ? received : count[t]);
+		for(double p : {0.5, 0.9, 0.99, 1.0})
+			std::cout << std::setw(10) << latency[t].percentile(p) * 1e6;
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/tcponudp/tcpstream_benchmark.cc                    *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+/* CPU cost of the TOU stream itself: two TcpStreams exchange data through an
+ * in-memory link without delay (optionally dropping packets), driven by a
+ * busy loop, so nearly all the time is spent in TcpStream. */
+
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "benchmarks.h"
+
+#include "tcponudp/tcpstream.h"
+
+/// Packets sent by a stream, handed to its peer on next deliver()
+class MemoryLink: public UdpSubReceiver
+{
+public:
+	MemoryLink(double loss) :
+	    UdpSubReceiver(nullptr), mPeer(nullptr), mLoss(loss), mRandom(1) {}
+
+	void setPeer(TcpStream* peer) { mPeer = peer; }
+
+	int sendPkt( const void* data, int size, const sockaddr_in& /*to*/,
+	             int /*ttl*/ ) override
+	{
+		std::uniform_real_distribution<double> uniform(0, 1);
+		if(mLoss > 0 && uniform(mRandom) < mLoss) return size;
+
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		mQueue.insert(mQueue.end(), bytes, bytes + size);
+		mSizes.push_back(size);
+		return size;
+	}
+
+	int recvPkt(void*, int, sockaddr_in&) override { return 0; }
+
+	/* buffers are swapped and reused, so the link itself does not allocate
+	 * once warmed up */
+	void deliver()
+	{
+		mDelivering.swap(mQueue);
+		mDeliveringSizes.swap(mSizes);
+
+		size_t offset = 0;
+		for(int size : mDeliveringSizes)
+		{
+			mPeer->recvPkt(&mDelivering[offset], size);
+			offset += size;
+		}
+
+		mDelivering.clear();
+		mDeliveringSizes.clear();
+	}
+
+private:
+	TcpStream* mPeer;
+	const double mLoss;
+	std::mt19937 mRandom;
+	std::vector<uint8_t> mQueue, mDelivering;
+	std::vector<int> mSizes, mDeliveringSizes;
+};
+
+static sockaddr_in localAddr(uint16_t port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	return addr;
+}
+
+RS_BENCHMARK(tcpstream, "[--mb 64] [--loss 0.0]")
+{
+	const uint64_t total = options.get("mb", uint64_t(64)) * 1024 * 1024;
+	const double loss = options.get("loss", 0.0);
+
+	MemoryLink forward(loss), backward(loss);
+	TcpStream sender(&forward);
+	TcpStream receiver(&backward);
+	forward.setPeer(&receiver);
+	backward.setPeer(&sender);
+
+	auto step = [&]()
+	{
+		forward.deliver();
+		backward.deliver();
+		sender.tick();
+		receiver.tick();
+	};
+
+	receiver.listenfor(localAddr(1001));
+	sender.connect(localAddr(1002), 10);
+	double deadline = rsBenchmarkNow() + 30;
+	while(!(sender.isConnected() && receiver.isConnected()))
+	{
+		if(rsBenchmarkNow() > deadline)
+		{
+			std::cerr << "Connection failed" << std::endl;
+			return 1;
+		}
+		step();
+	}
+
+	std::vector<char> chunk(64 * 1024, 'x');
+	std::vector<char> buf(64 * 1024);
+	uint64_t written = 0, received = 0;
+
+	const uint64_t allocs = rsBenchmarkAllocCount();
+	const std::clock_t cpuStart = std::clock();
+	const double start = rsBenchmarkNow();
+
+	while(received < total)
+	{
+		if(written < total && sender.write_allowed() > int(chunk.size()))
+		{
+			int w = sender.write(chunk.data(), chunk.size());
+			if(w > 0) written += w;
+		}
+
+		step();
+
+		int r;
+		while((r = receiver.read(buf.data(), buf.size())) > 0) received += r;
+
+		if(rsBenchmarkNow() - start > 600)
+		{
+			std::cerr << "Transfer timed out" << std::endl;
+			return 1;
+		}
+	}
+
+	const double elapsed = rsBenchmarkNow() - start;
+	const double cpu = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	const double mb = double(total) / (1024 * 1024);
+
+	std::cout << std::fixed << std::setprecision(2)
+	          << "transferred: " << mb << " MB in " << elapsed << " s"
+	          << (loss > 0 ? " (lossy link)" : "") << std::endl
+	          << "throughput: " << mb / elapsed << " MB/s" << std::endl
+	          << "cpu: " << cpu * 1e3 / mb << " ms/MB" << std::endl
+	          << "allocations: "
+	          << double(rsBenchmarkAllocCount() - allocs) / mb << " /MB"
+	          << std::endl;
+
+	return 0;
+}
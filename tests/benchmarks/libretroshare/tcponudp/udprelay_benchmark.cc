@@ -0,0 +1,170 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/tcponudp/udprelay_benchmark.cc                     *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+/* Relay node load test, offline: thousands of relay pairs are installed in
+ * a UdpRelayReceiver, and threads push relayed packets of random pairs
+ * through it (as UDP stacks would) while relays end points of our own send
+ * and the DHT thread runs checkRelays(). The UDP stack only counts. */
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "benchmarks.h"
+
+#include "tcponudp/udprelay.h"
+
+class NullPublisher: public UdpPublisher
+{
+public:
+	int sendPkt( const void*, int size, const sockaddr_in&, int ) override
+	{ return size; }
+};
+
+class NullPeer: public UdpPeer
+{
+public:
+	void recvPkt(void*, int) override {}
+};
+
+static sockaddr_in makeAddr(uint32_t ip, uint16_t port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(ip);
+	addr.sin_port = htons(port);
+	return addr;
+}
+
+RS_BENCHMARK( udprelay,
+              "[--pairs 4000] [--threads 4] [--packets 4000000] [--size 1036]" )
+{
+	const uint64_t pairs = options.get("pairs", uint64_t(4000));
+	const uint64_t threads = options.get("threads", uint64_t(4));
+	const uint64_t packets = options.get("packets", uint64_t(4000000));
+	const int size = static_cast<int>(options.get("size", uint64_t(1036)));
+
+	NullPublisher publisher;
+	UdpRelayReceiver relay(&publisher);
+	relay.setRelayTotal(pairs);
+	relay.setRelayClassMax(UDP_RELAY_CLASS_GENERAL, pairs, 1000000000);
+
+	/* relay packets of both directions of each pair */
+	const sockaddr_in proxy = makeAddr(0x0a000001, 9000);
+	std::vector<std::vector<uint8_t>> pkts;
+	std::vector<uint8_t> payload(size, 0x55);
+	for(uint64_t i = 0; i < pairs; ++i)
+	{
+		sockaddr_in a = makeAddr(0x0b000000 + i, 1000 + i % 50000);
+		sockaddr_in b = makeAddr(0x0c000000 + i, 2000 + i % 50000);
+		UdpRelayAddrSet addrs(&a, &b);
+		int relayClass = UDP_RELAY_CLASS_GENERAL;
+		uint32_t bandwidth = 0;
+		if(!relay.addUdpRelay(&addrs, relayClass, bandwidth))
+		{
+			std::cerr << "Cannot install relay " << i << std::endl;
+			return 1;
+		}
+
+		UdpRelayAddrSet flipped = addrs.flippedSet();
+		for(UdpRelayAddrSet* ends : { &addrs, &flipped })
+		{
+			UdpRelayEnd end(ends, &proxy);
+			std::vector<uint8_t> pkt(size + 16);
+			createRelayUdpPacket(payload.data(), size, pkt.data(), pkt.size(), &end);
+			pkts.push_back(pkt);
+		}
+	}
+
+	/* a few connections of our own going through other relays */
+	std::vector<NullPeer> peers(64);
+	std::vector<sockaddr_in> remotes;
+	for(size_t i = 0; i < peers.size(); ++i)
+	{
+		sockaddr_in own = makeAddr(0x0d000000 + i, 3000);
+		sockaddr_in remote = makeAddr(0x0e000000 + i, 4000);
+		UdpRelayAddrSet ends(&own, &remote);
+		relay.addUdpPeer(&peers[i], &ends, &proxy);
+		remotes.push_back(remote);
+	}
+
+	std::atomic<bool> done(false);
+	std::atomic<uint64_t> sent(0);
+	std::thread endPoints([&]()
+	{
+		uint64_t count = 0;
+		while(!done)
+		{
+			for(const sockaddr_in& remote : remotes)
+				count += relay.sendPkt(payload.data(), size, remote, 64) > 0;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		sent = count;
+	});
+	std::thread dht([&]()
+	{
+		/* more often than the DHT does, to see it in the load */
+		for(int i = 0; !done; ++i)
+		{
+			if(i % 100 == 0) relay.checkRelays();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	});
+
+	std::vector<std::thread> stacks;
+	std::atomic<uint64_t> relayed(0);
+	const double start = rsBenchmarkNow();
+	for(uint64_t t = 0; t < threads; ++t)
+		stacks.emplace_back([&, t]()
+		{
+			std::mt19937 random(t);
+			std::uniform_int_distribution<size_t> pick(0, pkts.size() - 1);
+			sockaddr_in from = makeAddr(0x0f000000, 5000);
+			uint64_t count = 0;
+			for(uint64_t i = 0; i < packets / threads; ++i)
+			{
+				std::vector<uint8_t>& pkt = pkts[pick(random)];
+				count += relay.recvPkt(pkt.data(), pkt.size(), from);
+			}
+			relayed += count;
+		});
+	for(std::thread& stack : stacks) stack.join();
+	const double elapsed = rsBenchmarkNow() - start;
+
+	done = true;
+	endPoints.join();
+	dht.join();
+
+	uint32_t read, write, relayedBytes;
+	relay.getDataTransferred(read, write, relayedBytes);
+
+	std::cout << std::fixed << std::setprecision(2)
+	          << pairs << " relay pairs, " << threads << " threads" << std::endl
+	          << "relayed: " << relayed << " packets in " << elapsed << " s, "
+	          << relayed / elapsed / 1e6 << " Mpkt/s" << std::endl
+	          << "sent by our end points meanwhile: " << sent << " packets"
+	          << std::endl;
+
+	return relayed == packets / threads * threads ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_service/rsdataservice_page_test.cc         *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <set>
+#include <vector>
+
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgxsdataaccess.h"
+#include "retroshare/rstokenservice.h"
+#include "rsitems/rsnxsitems.h"
+#include "rsitems/rsserviceids.h"
+#include "util/retrodb.h"
+
+#define PAGE_DB_NAME "rsdataservice_page_test_db"
+
+static const uint32_t NB_MSGS = 50;
+static const uint32_t PAGE_SIZE = 7;
+
+/* Group a gets NB_MSGS messages over 5 publish times, so most of them tie on
+ * the time stamp, group b some more to check pages stay in their group. */
+static void fillGroups( RsDataService& ds, const RsGxsGroupId& a,
+                        const RsGxsGroupId& b )
+{
+	std::list<RsNxsMsg*> msgs;
+
+	for(uint32_t i = 0; i < NB_MSGS + 20; ++i)
+	{
+		RsNxsMsg* msg = new RsNxsMsg(RS_SERVICE_GXS_TYPE_FORUMS);
+		msg->grpId = i < NB_MSGS ? a : b;
+		msg->msgId = RsGxsMessageId::random();
+		msg->msg.setBinData(msg->msgId.toByteArray(), msg->msgId.SIZE_IN_BYTES);
+
+		RsGxsMsgMetaData* meta = new RsGxsMsgMetaData;
+		meta->mGroupId = msg->grpId;
+		meta->mMsgId = msg->msgId;
+		meta->mPublishTs = 1000 + (i % 5) * 10;
+
+		msg->metaData = meta;
+		msgs.push_back(msg);
+	}
+
+	ASSERT_EQ(1, ds.storeMessage(msgs));
+}
+
+static bool inOrder( RsGxsMsgPageOrder order, const RsGxsMsgMetaData& x,
+                     const RsGxsMsgMetaData& y )
+{
+	switch(order)
+	{
+	case RsGxsMsgPageOrder::PUBLISH_TS:
+		return x.mPublishTs < y.mPublishTs ||
+		        (x.mPublishTs == y.mPublishTs && x.mMsgId < y.mMsgId);
+	case RsGxsMsgPageOrder::PUBLISH_TS_DESC:
+		return x.mPublishTs > y.mPublishTs ||
+		        (x.mPublishTs == y.mPublishTs && y.mMsgId < x.mMsgId);
+	default:
+		return x.mMsgId < y.mMsgId;
+	}
+}
+
+static RsGxsMsgPageCursor cursorAfter(const RsGxsMsgMetaData& last)
+{
+	RsGxsMsgPageCursor cursor;
+	cursor.mMsgId = last.mMsgId;
+	cursor.mPublishTs = last.mPublishTs;
+	return cursor;
+}
+
+TEST(libretroshare_gxs, RsDataService_MsgMetaPages)
+{
+	remove(PAGE_DB_NAME);
+	RsDataService ds(".", PAGE_DB_NAME, RS_SERVICE_GXS_TYPE_FORUMS);
+
+	RsGxsGroupId a = RsGxsGroupId::random(), b = RsGxsGroupId::random();
+	fillGroups(ds, a, b);
+
+	RsGxsMessageId::std_set all;
+	ds.retrieveMsgIds(a, all);
+	ASSERT_EQ(NB_MSGS, all.size());
+
+	for( RsGxsMsgPageOrder order : { RsGxsMsgPageOrder::MSG_ID,
+	                                 RsGxsMsgPageOrder::PUBLISH_TS,
+	                                 RsGxsMsgPageOrder::PUBLISH_TS_DESC } )
+	{
+		std::vector<std::shared_ptr<RsGxsMsgMetaData> > paged;
+		RsGxsMsgPageCursor after;
+		uint32_t nbPages = 0;
+
+		do
+		{
+			std::vector<std::shared_ptr<RsGxsMsgMetaData> > page;
+			ds.retrieveGxsMsgMetaPage(a, PAGE_SIZE, order, after, page);
+			ASSERT_LE(page.size(), PAGE_SIZE);
+			ASSERT_LE(++nbPages, NB_MSGS / PAGE_SIZE + 1);
+
+			paged.insert(paged.end(), page.begin(), page.end());
+			after = page.size() == PAGE_SIZE ? cursorAfter(*page.back())
+			                                 : RsGxsMsgPageCursor();
+		}
+		while(!after.isNull());
+
+		// the whole group, once, in order
+		RsGxsMessageId::std_set ids;
+		for(uint32_t i = 0; i < paged.size(); ++i)
+		{
+			EXPECT_EQ(a, paged[i]->mGroupId);
+			ids.insert(paged[i]->mMsgId);
+			if(i > 0)
+			{
+				EXPECT_TRUE(inOrder(order, *paged[i-1], *paged[i]));
+			}
+		}
+		EXPECT_EQ(NB_MSGS, paged.size());
+		EXPECT_EQ(all, ids);
+	}
+
+	remove(PAGE_DB_NAME);
+}
+
+TEST(libretroshare_gxs, RsGxsDataAccess_MsgDataPages)
+{
+	remove(PAGE_DB_NAME);
+	RsDataService ds(".", PAGE_DB_NAME, RS_SERVICE_GXS_TYPE_FORUMS);
+	RsGxsDataAccess da(&ds);
+
+	RsGxsGroupId a = RsGxsGroupId::random(), b = RsGxsGroupId::random();
+	fillGroups(ds, a, b);
+
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_MSG_DATA;
+	opts.mPageSize = PAGE_SIZE;
+	opts.mPageOrder = RsGxsMsgPageOrder::PUBLISH_TS_DESC;
+
+	std::list<RsGxsGroupId> req = { a };
+
+	// the messages of each page come in the order of the page meta data
+	for(uint32_t nbPages = 0; nbPages < 3; ++nbPages)
+	{
+		std::vector<std::shared_ptr<RsGxsMsgMetaData> > page;
+		ds.retrieveGxsMsgMetaPage(a, PAGE_SIZE, opts.mPageOrder, opts.mPageAfter, page);
+		ASSERT_EQ(PAGE_SIZE, page.size());
+
+		uint32_t token;
+		ASSERT_TRUE(da.requestMsgInfo(token, 0, opts, req));
+		da.processRequests();
+		ASSERT_EQ(RsTokenService::COMPLETE, da.requestStatus(token));
+
+		NxsMsgDataResult data;
+		ASSERT_TRUE(da.getMsgData(token, data));
+		ASSERT_EQ(1u, data.size());
+		ASSERT_EQ(PAGE_SIZE, data[a].size());
+
+		for(uint32_t i = 0; i < PAGE_SIZE; ++i)
+			EXPECT_EQ(page[i]->mMsgId, data[a][i]->msgId);
+
+		for(RsNxsMsg* msg : data[a]) delete msg;
+		opts.mPageAfter = cursorAfter(*page.back());
+	}
+
+	// a cursor is a position in one group
+	req.push_back(b);
+	uint32_t token;
+	ASSERT_TRUE(da.requestMsgInfo(token, 0, opts, req));
+	da.processRequests();
+	EXPECT_EQ(RsTokenService::FAILED, da.requestStatus(token));
+
+	remove(PAGE_DB_NAME);
+}
+
+TEST(libretroshare_gxs, RsGxsDataAccess_FailedPageRead)
+{
+	remove(PAGE_DB_NAME);
+	RsDataService ds(".", PAGE_DB_NAME, RS_SERVICE_GXS_TYPE_FORUMS);
+	RsGxsDataAccess da(&ds);
+
+	RsGxsGroupId a = RsGxsGroupId::random(), b = RsGxsGroupId::random();
+	fillGroups(ds, a, b);
+
+	// the page query can't be prepared anymore
+	sqlite3* db = nullptr;
+	ASSERT_EQ(SQLITE_OK, sqlite3_open(PAGE_DB_NAME, &db));
+	ASSERT_EQ(SQLITE_OK, sqlite3_exec(db, "DROP TABLE MESSAGES;", nullptr, nullptr, nullptr));
+	sqlite3_close(db);
+
+	// which the data service notices on its next query
+	RsGxsMessageId::std_set ids;
+	ds.retrieveMsgIds(a, ids);
+	EXPECT_TRUE(ids.empty());
+
+	std::vector<std::shared_ptr<RsGxsMsgMetaData> > page;
+	EXPECT_EQ(0, ds.retrieveGxsMsgMetaPage( a, PAGE_SIZE, RsGxsMsgPageOrder::MSG_ID,
+	                                        RsGxsMsgPageCursor(), page ));
+
+	RsTokReqOptions opts;
+	opts.mPageSize = PAGE_SIZE;
+	std::list<RsGxsGroupId> req = { a };
+
+	for( uint32_t type : { GXS_REQUEST_TYPE_MSG_META, GXS_REQUEST_TYPE_MSG_DATA,
+	                       GXS_REQUEST_TYPE_MSG_IDS } )
+	{
+		opts.mReqType = type;
+
+		uint32_t token;
+		ASSERT_TRUE(da.requestMsgInfo(token, 0, opts, req));
+		da.processRequests();
+		EXPECT_EQ(RsTokenService::FAILED, da.requestStatus(token)) << "request type " << type;
+	}
+
+	remove(PAGE_DB_NAME);
+}
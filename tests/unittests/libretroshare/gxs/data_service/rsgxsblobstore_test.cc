@@ -0,0 +1,265 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_service/rsgxsblobstore_test.cc             *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gxs/rsgxsblobstore.h"
+
+#define BLOB_FILE_NAME "rsgxsblobstore_test_blobs"
+
+static void removeBlobFiles()
+{
+	remove(BLOB_FILE_NAME);
+	remove(BLOB_FILE_NAME ".idx");
+	remove(BLOB_FILE_NAME ".tmp");
+}
+
+static std::vector<uint8_t> blob(uint8_t value, size_t size)
+{
+	return std::vector<uint8_t>(size, value);
+}
+
+static Sha256CheckSum put(RsGxsBlobStore& store, const std::vector<uint8_t>& data)
+{
+	Sha256CheckSum address;
+	EXPECT_TRUE(store.put(data.data(), data.size(), address));
+	return address;
+}
+
+TEST(libretroshare_gxs, RsGxsBlobStore_PutGet)
+{
+	for(const std::string key : { std::string(), std::string("database key") })
+	{
+		removeBlobFiles();
+		RsGxsBlobStore store(BLOB_FILE_NAME, key);
+		ASSERT_TRUE(store.open());
+
+		Sha256CheckSum a = put(store, blob('a', 100));
+		Sha256CheckSum b = put(store, blob('b', 70000));
+		EXPECT_TRUE(store.sync());
+
+		// same data, same address, written once
+		uint64_t size = store.fileSize();
+		EXPECT_EQ(a, put(store, blob('a', 100)));
+		EXPECT_EQ(size, store.fileSize());
+		EXPECT_EQ(2u, store.count());
+
+		std::vector<uint8_t> data;
+		EXPECT_TRUE(store.get(a, data));
+		EXPECT_EQ(blob('a', 100), data);
+		EXPECT_TRUE(store.get(b, data));
+		EXPECT_EQ(blob('b', 70000), data);
+		EXPECT_FALSE(store.get(Sha256CheckSum::random(), data));
+
+		// the data doesn't show in the file when it is encrypted
+		store.close();
+		FILE* f = fopen(BLOB_FILE_NAME, "rb");
+		ASSERT_TRUE(f != NULL);
+		std::vector<uint8_t> file(size);
+		EXPECT_EQ(size, fread(file.data(), 1, size, f));
+		fclose(f);
+		std::vector<uint8_t> clear = blob('b', 64);
+		bool found = std::search(file.begin(), file.end(), clear.begin(), clear.end()) != file.end();
+		EXPECT_EQ(key.empty(), found);
+	}
+
+	removeBlobFiles();
+}
+
+TEST(libretroshare_gxs, RsGxsBlobStore_Reopen)
+{
+	removeBlobFiles();
+	Sha256CheckSum a, b;
+
+	{
+		RsGxsBlobStore store(BLOB_FILE_NAME, "key");
+		ASSERT_TRUE(store.open());
+		a = put(store, blob('a', 1000));
+	}
+
+	// from the index, then the record appended after it was saved
+	{
+		RsGxsBlobStore store(BLOB_FILE_NAME, "key");
+		ASSERT_TRUE(store.open());
+		b = put(store, blob('b', 1000));
+		EXPECT_TRUE(store.sync());
+	}
+	remove(BLOB_FILE_NAME ".idx");
+
+	{
+		RsGxsBlobStore store(BLOB_FILE_NAME, "key");
+		ASSERT_TRUE(store.open());
+		EXPECT_EQ(2u, store.count());
+
+		std::vector<uint8_t> data;
+		EXPECT_TRUE(store.get(a, data));
+		EXPECT_TRUE(store.get(b, data));
+		EXPECT_EQ(blob('b', 1000), data);
+	}
+
+	// a wrong key is refused at once
+	{
+		RsGxsBlobStore store(BLOB_FILE_NAME, "another key");
+		EXPECT_FALSE(store.open());
+	}
+	{
+		RsGxsBlobStore store(BLOB_FILE_NAME, "");
+		EXPECT_FALSE(store.open());
+	}
+
+	removeBlobFiles();
+}
+
+TEST(libretroshare_gxs, RsGxsBlobStore_IncompleteRecord)
+{
+	removeBlobFiles();
+	Sha256CheckSum a;
+	uint64_t size;
+
+	{
+		RsGxsBlobStore store(BLOB_FILE_NAME, "");
+		ASSERT_TRUE(store.open());
+		a = put(store, blob('a', 1000));
+		size = store.fileSize();
+	}
+
+	// as if the process died while appending a record
+	FILE* f = fopen(BLOB_FILE_NAME, "ab");
+	ASSERT_TRUE(f != NULL);
+	std::vector<uint8_t> partial(RsGxsBlobStore::RECORD_HEADER_SIZE + 10, 0xff);
+	fwrite(partial.data(), 1, partial.size(), f);
+	fclose(f);
+
+	RsGxsBlobStore store(BLOB_FILE_NAME, "");
+	ASSERT_TRUE(store.open());
+	EXPECT_EQ(size, store.fileSize());
+	EXPECT_EQ(1u, store.count());
+
+	std::vector<uint8_t> data;
+	EXPECT_TRUE(store.get(a, data));
+	Sha256CheckSum b = put(store, blob('b', 10));
+	EXPECT_TRUE(store.get(b, data));
+	EXPECT_EQ(blob('b', 10), data);
+
+	store.close();
+	removeBlobFiles();
+}
+
+TEST(libretroshare_gxs, RsGxsBlobStore_Compact)
+{
+	removeBlobFiles();
+
+	RsGxsBlobStore store(BLOB_FILE_NAME, "key");
+	ASSERT_TRUE(store.open());
+
+	std::set<Sha256CheckSum> live;
+	std::vector<Sha256CheckSum> dropped;
+	for(int i = 0; i < 20; ++i)
+	{
+		Sha256CheckSum address = put(store, blob(i, 1000 + i));
+		if(i % 4 == 0) live.insert(address);
+		else dropped.push_back(address);
+	}
+
+	const uint64_t before = store.fileSize();
+	EXPECT_LT(store.usedSize(live), before);
+
+	uint64_t reclaimed = 0;
+	ASSERT_TRUE(store.compact(live, reclaimed));
+	EXPECT_EQ(before - reclaimed, store.fileSize());
+	EXPECT_EQ(store.usedSize(live), store.fileSize());
+	EXPECT_EQ(live.size(), store.count());
+
+	std::vector<uint8_t> data;
+	for(const Sha256CheckSum& address : dropped)
+		EXPECT_FALSE(store.get(address, data));
+
+	// still readable, and writable, after the file has been replaced
+	Sha256CheckSum address = put(store, blob('z', 10));
+	EXPECT_TRUE(store.get(address, data));
+	store.close();
+
+	RsGxsBlobStore reopened(BLOB_FILE_NAME, "key");
+	ASSERT_TRUE(reopened.open());
+	EXPECT_EQ(live.size() + 1, reopened.count());
+	for(const Sha256CheckSum& a : live)
+		EXPECT_TRUE(reopened.get(a, data));
+
+	reopened.close();
+	removeBlobFiles();
+}
+
+TEST(libretroshare_gxs, RsGxsBlobStore_PutWhileCompacting)
+{
+	removeBlobFiles();
+
+	RsGxsBlobStore store(BLOB_FILE_NAME, "key");
+	ASSERT_TRUE(store.open());
+
+	// enough records for some to be merged in the index by sync()
+	std::set<Sha256CheckSum> live;
+	std::vector<Sha256CheckSum> dropped;
+	for(int i = 0; i < 5000; ++i)
+	{
+		std::vector<uint8_t> data = blob(i & 0xff, 10 + i / 256);
+		Sha256CheckSum address = put(store, data);
+		if(i % 2 == 0) live.insert(address);
+		else dropped.push_back(address);
+	}
+	EXPECT_TRUE(store.sync());
+	EXPECT_EQ(5000u, store.count());
+
+	ASSERT_TRUE(store.beginCompaction(live));
+	EXPECT_FALSE(store.beginCompaction(live));
+
+	// new data, and dropped data put again, while the records are copied
+	Sha256CheckSum added = put(store, blob('z', 3000));
+	std::vector<uint8_t> revived = blob(1, 10);
+	EXPECT_EQ(dropped[0], put(store, revived));
+
+	uint64_t reclaimed = 0;
+	ASSERT_TRUE(store.finishCompaction(reclaimed));
+	EXPECT_GT(reclaimed, 0u);
+	EXPECT_EQ(live.size() + 2, store.count());
+
+	std::vector<uint8_t> data;
+	EXPECT_TRUE(store.get(added, data));
+	EXPECT_EQ(blob('z', 3000), data);
+	EXPECT_TRUE(store.get(dropped[0], data));
+	EXPECT_EQ(revived, data);
+	EXPECT_FALSE(store.get(dropped[1], data));
+	store.close();
+
+	RsGxsBlobStore reopened(BLOB_FILE_NAME, "key");
+	ASSERT_TRUE(reopened.open());
+	EXPECT_EQ(live.size() + 2, reopened.count());
+	for(const Sha256CheckSum& a : live)
+		EXPECT_TRUE(reopened.get(a, data));
+	EXPECT_TRUE(reopened.get(dropped[0], data));
+
+	reopened.close();
+	removeBlobFiles();
+}
@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/p3servicecontrol_test.cc                        *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "pqi/p3servicecontrol.h"
+#include "util/rsrandom.h"
+
+/// What checkFilter() did on mPeerFilterMap before the snapshot
+static bool mapAllows( const std::map<RsPeerId, ServicePeerFilter>& filters,
+                       const RsPeerId& peerId, uint32_t serviceId )
+{
+	std::map<RsPeerId, ServicePeerFilter>::const_iterator pit;
+	pit = filters.find(peerId);
+	if (pit == filters.end()) return false;
+	if (pit->second.mDenyAll) return false;
+	if (pit->second.mAllowAll) return true;
+	return pit->second.mAllowedServices.count(serviceId) != 0;
+}
+
+static bool snapshotAllows( const ServiceFilterSnapshot& snapshot,
+                            const RsPeerId& peerId, uint32_t serviceId )
+{
+	ServiceFilterSnapshot::const_iterator pit = snapshot.find(peerId);
+	return pit != snapshot.end() && pit->second->isAllowed(serviceId);
+}
+
+static uint32_t randomServiceId()
+{
+	return RsServiceInfo::RsServiceInfoUIn16ToFullServiceId(
+	            RsRandom::random_u32() & 0xffff );
+}
+
+TEST(libretroshare_pqi, p3ServiceControl_SnapshotMatchesPeerFilters)
+{
+	std::vector<uint32_t> services;
+	for(int i = 0; i < 40; ++i) services.push_back(randomServiceId());
+
+	std::map<RsPeerId, ServicePeerFilter> filters;
+	std::vector<RsPeerId> peers;
+
+	for(int i = 0; i < 20; ++i)
+	{
+		RsPeerId peerId = RsPeerId::random();
+		peers.push_back(peerId);
+
+		ServicePeerFilter& filter = filters[peerId];
+		switch(i % 4)
+		{
+		case 0: break; // deny all
+		case 1: // allow all, with a stale allowed list
+			filter.mDenyAll = false;
+			filter.mAllowAll = true;
+			filter.mAllowedServices.insert(services[i]);
+			break;
+		default:
+			filter.mDenyAll = false;
+			for(uint32_t serviceId : services)
+				if (RsRandom::random_u32() % 2)
+					filter.mAllowedServices.insert(serviceId);
+		}
+	}
+	peers.push_back(RsPeerId::random()); // without filter
+
+	ServiceFilterSnapshot snapshot;
+	for(const auto& it : filters)
+		snapshot[it.first] = std::make_shared<ServicePermissionBitmap>(it.second);
+
+	/* the services of the filters, random ones, and ids which are not full
+	 * service ids but share the service type of allowed ones */
+	std::vector<uint32_t> probes = services;
+	for(int i = 0; i < 1000; ++i) probes.push_back(randomServiceId());
+	for(uint32_t serviceId : services)
+	{
+		probes.push_back(serviceId | 0x01);
+		probes.push_back((serviceId & 0x00ffffff) | 0x01000000);
+		probes.push_back(serviceId & 0x00ffffff);
+	}
+	probes.push_back(0);
+	probes.push_back(0xffffffff);
+
+	int allowed = 0;
+	for(const RsPeerId& peerId : peers)
+		for(uint32_t serviceId : probes)
+		{
+			bool expected = mapAllows(filters, peerId, serviceId);
+			EXPECT_EQ(expected, snapshotAllows(snapshot, peerId, serviceId))
+			        << "peer " << peerId << " service " << std::hex << serviceId;
+			allowed += expected;
+		}
+
+	EXPECT_GT(allowed, 0);
+}
@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqibwalloc_test.cc                              *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "pqi/pqibwalloc.h"
+#include "rsitems/itempriorities.h"
+
+static const double RATE     = 100000; // B/s
+static const double DURATION = 20;     // s
+static const double TICK     = 0.01;   // streamer tick, s
+static const uint32_t CHUNK  = 2048;   // bytes sent per try, like a batch
+
+/* A peer class that sends as much as it is allowed, at most limit B/s */
+struct Sender
+{
+	Sender(const RsPeerId& id, uint32_t cls, double limit = 0)
+	    : mId(id), mClass(cls), mLimit(limit), mSent(0) {}
+
+	RsPeerId mId;
+	uint32_t mClass;
+	double mLimit;
+	double mSent;
+};
+
+/* Runs the senders one try each per tick, as the streamer threads would */
+static void simulate( pqiBandwidthAllocator& alloc, std::vector<Sender>& senders,
+                      double start, double duration )
+{
+	for(double now = start; now < start + duration; now += TICK)
+		for(Sender& s : senders)
+		{
+			if(s.mLimit > 0 && s.mSent >= s.mLimit * (now - start))
+				continue;
+
+			int allowed;
+			uint32_t blocked;
+			ASSERT_TRUE(alloc.outAllowedBytes(s.mId, now, allowed, blocked));
+			if(blocked & (1u << s.mClass) || allowed <= 0)
+				continue;
+
+			uint32_t bytes[PQI_BW_NB_CLASSES] = { 0, 0, 0 };
+			bytes[s.mClass] = std::min(uint32_t(allowed), CHUNK);
+			alloc.outSentBytes(s.mId, now, bytes);
+			s.mSent += bytes[s.mClass];
+		}
+}
+
+/* Runs one second for the initial bursts to be spent, then the measure */
+static void measure( pqiBandwidthAllocator& alloc, std::vector<Sender>& senders,
+                     double start )
+{
+	simulate(alloc, senders, start, 1);
+	for(Sender& s : senders) s.mSent = 0;
+	simulate(alloc, senders, start + 1, DURATION);
+}
+
+static double total(const std::vector<Sender>& senders)
+{
+	double sum = 0;
+	for(const Sender& s : senders) sum += s.mSent;
+	return sum;
+}
+
+TEST(libretroshare_pqi, pqiBandwidthAllocator_fills_global_rate)
+{
+	pqiBandwidthAllocator alloc;
+	std::map<RsPeerId, double> ceils;
+	std::vector<Sender> senders;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		RsPeerId id = RsPeerId::random();
+		ceils[id] = 0;
+		senders.push_back(Sender(id, PQI_BW_CLASS_DATA));
+	}
+	alloc.setRates(RATE, ceils, 1000);
+	measure(alloc, senders, 1000);
+
+	/* neither underused nor overshot */
+	EXPECT_NEAR(RATE * DURATION, total(senders), 0.01 * RATE * DURATION);
+
+	/* equal shares */
+	for(const Sender& s : senders)
+		EXPECT_NEAR(RATE * DURATION / 4, s.mSent, 0.05 * RATE * DURATION / 4);
+}
+
+TEST(libretroshare_pqi, pqiBandwidthAllocator_lends_unused_capacity)
+{
+	pqiBandwidthAllocator alloc;
+	std::map<RsPeerId, double> ceils;
+	std::vector<Sender> senders;
+
+	/* one peer only sends 10% of the rate, the other gets the rest */
+	RsPeerId light = RsPeerId::random(), heavy = RsPeerId::random();
+	ceils[light] = 0;
+	ceils[heavy] = 0;
+	senders.push_back(Sender(light, PQI_BW_CLASS_DATA, RATE / 10));
+	senders.push_back(Sender(heavy, PQI_BW_CLASS_DATA));
+
+	alloc.setRates(RATE, ceils, 1000);
+	measure(alloc, senders, 1000);
+
+	EXPECT_NEAR(RATE * DURATION / 10, senders[0].mSent, 0.05 * RATE * DURATION / 10);
+	EXPECT_NEAR(RATE * DURATION * 0.9, senders[1].mSent, 0.05 * RATE * DURATION);
+	EXPECT_NEAR(RATE * DURATION, total(senders), 0.01 * RATE * DURATION);
+}
+
+TEST(libretroshare_pqi, pqiBandwidthAllocator_respects_peer_ceiling)
+{
+	pqiBandwidthAllocator alloc;
+	std::map<RsPeerId, double> ceils;
+	std::vector<Sender> senders;
+
+	RsPeerId capped = RsPeerId::random(), uncapped = RsPeerId::random();
+	ceils[capped] = RATE / 5;
+	ceils[uncapped] = 0;
+	senders.push_back(Sender(capped, PQI_BW_CLASS_DATA));
+	senders.push_back(Sender(uncapped, PQI_BW_CLASS_DATA));
+
+	alloc.setRates(RATE, ceils, 1000);
+
+	double rate, ceil;
+	ASSERT_TRUE(alloc.getPeerRates(capped, rate, ceil));
+	EXPECT_DOUBLE_EQ(RATE / 5, rate);
+	EXPECT_DOUBLE_EQ(RATE / 5, ceil);
+	ASSERT_TRUE(alloc.getPeerRates(uncapped, rate, ceil));
+	EXPECT_DOUBLE_EQ(RATE * 4 / 5, rate);
+
+	measure(alloc, senders, 1000);
+
+	EXPECT_NEAR(RATE * DURATION / 5, senders[0].mSent, 0.05 * RATE * DURATION / 5);
+	EXPECT_NEAR(RATE * DURATION, total(senders), 0.01 * RATE * DURATION);
+}
+
+TEST(libretroshare_pqi, pqiBandwidthAllocator_isolates_service_classes)
+{
+	pqiBandwidthAllocator alloc;
+	std::map<RsPeerId, double> ceils;
+	std::vector<Sender> senders;
+
+	/* bulk data saturating the link doesn't starve interactive traffic */
+	RsPeerId id = RsPeerId::random();
+	ceils[id] = 0;
+	senders.push_back(Sender(id, PQI_BW_CLASS_DATA));
+	senders.push_back(Sender(id, PQI_BW_CLASS_BULK));
+	senders.push_back(Sender(id, PQI_BW_CLASS_INTERACTIVE, RATE / 5));
+
+	alloc.setRates(RATE, ceils, 1000);
+	measure(alloc, senders, 1000);
+
+	EXPECT_NEAR(RATE * DURATION / 5, senders[2].mSent, 0.05 * RATE * DURATION / 5);
+	EXPECT_GE(senders[1].mSent, 0.9 * 0.15 * RATE * DURATION);
+	EXPECT_NEAR(RATE * DURATION, total(senders), 0.01 * RATE * DURATION);
+
+	/* forgotten peers are not handled anymore */
+	alloc.setRates(RATE, std::map<RsPeerId, double>(), 1001 + DURATION);
+	int allowed;
+	uint32_t blocked;
+	EXPECT_FALSE(alloc.outAllowedBytes(id, 1001 + DURATION, allowed, blocked));
+}
+
+TEST(libretroshare_pqi, pqiBandwidthAllocator_maps_priorities_to_classes)
+{
+	EXPECT_EQ(PQI_BW_CLASS_INTERACTIVE, pqiBandwidthAllocator::classOf(QOS_PRIORITY_RS_CHAT_ITEM));
+	EXPECT_EQ(PQI_BW_CLASS_INTERACTIVE, pqiBandwidthAllocator::classOf(QOS_PRIORITY_RS_RTT_PING));
+	EXPECT_EQ(PQI_BW_CLASS_DATA, pqiBandwidthAllocator::classOf(QOS_PRIORITY_RS_FILE_DATA));
+	EXPECT_EQ(PQI_BW_CLASS_DATA, pqiBandwidthAllocator::classOf(QOS_PRIORITY_RS_GXS_NET));
+	EXPECT_EQ(PQI_BW_CLASS_BULK, pqiBandwidthAllocator::classOf(QOS_PRIORITY_RS_MAIL_ITEM));
+
+	uint32_t mask = pqiBandwidthAllocator::priorityMask(1u << PQI_BW_CLASS_DATA);
+	EXPECT_EQ((1u << 5) | (1u << 6), mask);
+	EXPECT_EQ(0x3ffu, pqiBandwidthAllocator::priorityMask(0x7));
+}
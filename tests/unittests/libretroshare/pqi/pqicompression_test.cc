@@ -0,0 +1,117 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqicompression_test.cc                          *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "pqi/pqicompression.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/rsrandom.h"
+
+/* Build a packet with a valid RS header, filled with given payload */
+static std::vector<uint8_t> makePacket(uint16_t service, uint32_t size, bool random)
+{
+	std::vector<uint8_t> pkt(size);
+	for(uint32_t i=8; i<size; ++i)
+		pkt[i] = random ? RsRandom::random_u32() & 0xff : "retroshare "[i % 11];
+
+	pkt[0] = 0x02;
+	pkt[1] = service >> 8;
+	pkt[2] = service & 0xff;
+	pkt[3] = 0x01;
+	uint32_t offset = 4;
+	setRawUInt32(pkt.data(), size, &offset, size);
+	return pkt;
+}
+
+TEST(libretroshare_pqi, pqiPacketCompressor_round_trip)
+{
+	pqiPacketCompressor compressor;
+	std::vector<uint8_t> pkt = makePacket(0x0217, 20000, false);
+
+	void *out = NULL;
+	uint32_t out_size = 0;
+
+	ASSERT_TRUE(compressor.compress(pkt.data(), pkt.size(), 0x0217, out, out_size));
+	EXPECT_LT(out_size, pkt.size() / 4);
+	EXPECT_TRUE(pqiPacketCompressor::isCompressed(out, out_size));
+	EXPECT_FALSE(pqiPacketCompressor::isCompressed(pkt.data(), pkt.size()));
+
+	uint32_t size = 0;
+	void *back = pqiPacketCompressor::uncompress(out, out_size, size);
+
+	ASSERT_TRUE(back != NULL);
+	ASSERT_EQ(pkt.size(), size);
+	EXPECT_EQ(0, memcmp(back, pkt.data(), size));
+
+	free(out);
+	free(back);
+}
+
+TEST(libretroshare_pqi, pqiPacketCompressor_skips_incompressible)
+{
+	pqiPacketCompressor compressor;
+	std::vector<uint8_t> noise = makePacket(0x0013, 4000, true);
+	std::vector<uint8_t> text  = makePacket(0x0217, 4000, false);
+	std::vector<uint8_t> small = makePacket(0x0217, 100, false);
+
+	void *out = NULL;
+	uint32_t out_size = 0;
+
+	EXPECT_FALSE(compressor.compress(small.data(), small.size(), 0x0217, out, out_size));
+	EXPECT_TRUE(out == NULL);
+
+	/* failures on a service back off exponentially */
+	for(uint32_t i=0; i<100; ++i)
+	{
+		EXPECT_FALSE(compressor.compress(noise.data(), noise.size(), 0x0013, out, out_size));
+		EXPECT_TRUE(out == NULL);
+	}
+
+	/* other services are not affected */
+	ASSERT_TRUE(compressor.compress(text.data(), text.size(), 0x0217, out, out_size));
+	free(out);
+}
+
+TEST(libretroshare_pqi, pqiPacketCompressor_rejects_bad_wrapper)
+{
+	pqiPacketCompressor compressor;
+	std::vector<uint8_t> pkt = makePacket(0x0217, 5000, false);
+
+	void *out = NULL;
+	uint32_t out_size = 0;
+	ASSERT_TRUE(compressor.compress(pkt.data(), pkt.size(), 0x0217, out, out_size));
+
+	uint32_t size = 0;
+
+	/* truncated stream */
+	EXPECT_TRUE(pqiPacketCompressor::uncompress(out, out_size - 4, size) == NULL);
+
+	/* announced size larger than any packet */
+	uint32_t offset = 8;
+	setRawUInt32(out, out_size, &offset, 0xffffffff);
+	EXPECT_TRUE(pqiPacketCompressor::uncompress(out, out_size, size) == NULL);
+	EXPECT_EQ(0u, size);
+
+	free(out);
+}
@@ -0,0 +1,357 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqiperson_test.cc                               *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "pqi/p3linkmgr.h"
+#include "pqi/p3netmgr.h"
+#include "pqi/p3peermgr.h"
+#include "pqi/pqimonitor.h"
+#include "pqi/pqiperson.h"
+#include "pqi/pqipersongrp.h"
+#include "serialiser/rsserial.h"
+#include "util/rsnet.h"
+
+/* Connections to simulated addresses, on a clock ticked by the test where a
+ * tick stands for a second, the unit of the pqissl delays and timeouts.
+ * The port of an address gives its outcome: the ticks a connection takes, or
+ * DEAD_ADDRESS if it times out. */
+static const int DEAD_ADDRESS = -1;
+
+class FakeNetBin: public NetBinInterface
+{
+public:
+	FakeNetBin( PQInterface* parent, const RsPeerId& id, const uint32_t& clock,
+	            const std::map<uint16_t, int>& outcomes ) :
+	    NetBinInterface(parent, id), mClock(clock), mOutcomes(outcomes),
+	    mConnecting(false), mActive(false), mStart(0), mDelay(0), mTimeout(0),
+	    mResets(0)
+	{ sockaddr_storage_clear(mAddr); }
+
+	/* NetInterface */
+	int connect(const sockaddr_storage& raddr) override
+	{
+		mAddr = raddr;
+		mStart = mClock + mDelay;
+		mConnecting = true;
+		return 1;
+	}
+	int listen() override { return 1; }
+	int stoplistening() override { return 1; }
+	int disconnect() override { return reset(); }
+	int reset() override
+	{
+		mConnecting = false;
+		mActive = false;
+		++mResets;
+		return 1;
+	}
+	int getConnectAddress(sockaddr_storage& raddr) override
+	{ raddr = mAddr; return 1; }
+	bool connect_parameter(uint32_t type, uint32_t value) override
+	{
+		if(type == NET_PARAM_CONNECT_DELAY) mDelay = value;
+		if(type == NET_PARAM_CONNECT_TIMEOUT) mTimeout = value;
+		return true;
+	}
+
+	/* BinInterface */
+	int tick() override
+	{
+		if(!mConnecting || mClock < mStart) return 0;
+
+		int ticks = mOutcomes.at(sockaddr_storage_port(mAddr));
+		if(ticks != DEAD_ADDRESS && mClock >= mStart + ticks)
+		{
+			mConnecting = false;
+			mActive = true;
+			parent()->notifyEvent(this, CONNECT_SUCCESS, mAddr);
+		}
+		else if(ticks == DEAD_ADDRESS && mClock >= mStart + mTimeout)
+		{
+			/* without the address, as pqissl does */
+			sockaddr_storage none;
+			sockaddr_storage_clear(none);
+			mConnecting = false;
+			parent()->notifyEvent(this, CONNECT_FAILED, none);
+		}
+		return 0;
+	}
+	int senddata(void*, int) override { return 0; }
+	int readdata(void*, int) override { return -1; }
+	int netstatus() override { return 1; }
+	int isactive() override { return mActive; }
+	bool moretoread(uint32_t) override { return false; }
+	bool cansend(uint32_t) override { return false; }
+	int close() override { return reset(); }
+	RsFileHash gethash() override { return RsFileHash(); }
+
+	bool connecting() const { return mConnecting; }
+	int resets() const { return mResets; }
+	uint32_t delay() const { return mDelay; }
+
+private:
+	const uint32_t& mClock;
+	const std::map<uint16_t, int>& mOutcomes;
+
+	sockaddr_storage mAddr;
+	bool mConnecting;
+	std::atomic<bool> mActive; // also read by the streamer thread
+	uint32_t mStart;
+	uint32_t mDelay;
+	uint32_t mTimeout;
+	int mResets;
+};
+
+struct FakePeer
+{
+	FakePeer(uint32_t nbConnections, const std::map<uint16_t, int>& outcomes) :
+	    mClock(0), mPerson(RsPeerId::random(), NULL)
+	{
+		for(uint32_t i = 0; i < nbConnections; ++i)
+		{
+			FakeNetBin* bin = new FakeNetBin( &mPerson, mPerson.PeerId(),
+			                                  mClock, outcomes );
+			mBins.push_back(bin);
+
+			RsSerialiser* rss = new RsSerialiser();
+			mPerson.addChildInterface( PQI_CONNECT_TCP,
+			                           new pqiconnect(&mPerson, rss, bin) );
+		}
+	}
+
+	~FakePeer() { mPerson.fullstopthreads(); }
+
+	void connect(uint16_t port, uint32_t delay)
+	{
+		sockaddr_storage addr, none;
+		sockaddr_storage_ipv4_aton(addr, "10.0.0.1");
+		sockaddr_storage_setport(addr, port);
+		sockaddr_storage_clear(none);
+
+		mPerson.connect( PQI_CONNECT_TCP, addr, none, none, delay, 0,
+		                 RS_TCP_STD_TIMEOUT_PERIOD, 0, 0, "", 0 );
+	}
+
+	int activeCount() const
+	{
+		int n = 0;
+		for(FakeNetBin* bin : mBins) n += bin->isactive();
+		return n;
+	}
+
+	uint32_t mClock;
+	pqiperson mPerson;
+	std::vector<FakeNetBin*> mBins; // owned by their pqiconnect
+};
+
+TEST(libretroshare_pqi, pqiperson_late_race_winner_is_dropped)
+{
+	std::map<uint16_t, int> outcomes = { {1, 0}, {2, 0} };
+	FakePeer peer(2, outcomes);
+
+	peer.connect(1, 0);
+	peer.connect(2, 0);
+
+	/* both succeed in this tick, the second success is handled once the
+	 * first one is installed */
+	peer.mPerson.tick();
+
+	EXPECT_EQ(1, peer.activeCount());
+	EXPECT_TRUE(peer.mBins[0]->isactive());
+	EXPECT_FALSE(peer.mBins[1]->isactive());
+	EXPECT_EQ(1, peer.mBins[0]->resets()); // only the one of connect()
+}
+
+/* p3LinkMgr of a node without SSL setup, its friend addresses come from the
+ * DHT: the peer manager has none to add. */
+class RaceLinkMgr: public p3LinkMgrIMPL
+{
+public:
+	RaceLinkMgr(p3PeerMgrIMPL* peerMgr, p3NetMgrIMPL* netMgr) :
+	    p3LinkMgrIMPL(peerMgr, netMgr) {}
+
+	const RsPeerId& getOwnId() override { return mOwnId; }
+
+	void addAddress(const RsPeerId& id, uint16_t port)
+	{
+		sockaddr_storage addr, none;
+		sockaddr_storage_ipv4_aton(addr, "10.0.0.1");
+		sockaddr_storage_setport(addr, port);
+		sockaddr_storage_clear(none);
+
+		peerConnectRequest( id, addr, none, none, RS_CB_DHT,
+		                    RS_CB_FLAG_MODE_TCP, 0, 0 );
+	}
+
+	RsPeerId mOwnId;
+};
+
+/* The peers of pqisslpersongrp, with FakeNetBin connections */
+class RaceGroup: public pqipersongrp
+{
+public:
+	RaceGroup(uint32_t nbConnections, const std::map<uint16_t, int>& outcomes) :
+	    pqipersongrp(NULL, 0), mClock(0), mPerson(NULL),
+	    mNbConnections(nbConnections), mOutcomes(outcomes) {}
+
+	int activeCount() const
+	{
+		int n = 0;
+		for(FakeNetBin* bin : mBins) n += bin->isactive();
+		return n;
+	}
+
+	uint32_t mClock;
+	pqiperson* mPerson;
+	std::vector<FakeNetBin*> mBins; // owned by their pqiconnect
+
+protected:
+	pqilistener* locked_createListener(const sockaddr_storage&) override
+	{ return new pqilistener(); }
+
+	pqiperson* locked_createPerson(const RsPeerId& id, pqilistener*) override
+	{
+		mPerson = new pqiperson(id, this);
+		for(uint32_t i = 0; i < mNbConnections; ++i)
+		{
+			FakeNetBin* bin = new FakeNetBin(mPerson, id, mClock, mOutcomes);
+			mBins.push_back(bin);
+
+			RsSerialiser* rss = new RsSerialiser();
+			mPerson->addChildInterface( PQI_CONNECT_TCP,
+			                            new pqiconnect(mPerson, rss, bin) );
+		}
+		return mPerson;
+	}
+
+private:
+	uint32_t mNbConnections;
+	const std::map<uint16_t, int>& mOutcomes;
+};
+
+/* A friend with a dead local and a dead historical address in front of the
+ * live one, and one more address behind it. With as many connections as
+ * RS_TCP_RACE_WIDTH the addresses race, started RS_TCP_RACE_STAGGER apart,
+ * with a single one they are tried one after the other, each attempt waiting
+ * for the previous one to time out. */
+static uint32_t reconnectTicks(uint32_t nbConnections, std::vector<uint32_t>& delays)
+{
+	std::map<uint16_t, int> outcomes =
+	{ {1, DEAD_ADDRESS}, {2, DEAD_ADDRESS}, {3, 1}, {4, DEAD_ADDRESS} };
+
+	p3NetMgrIMPL netMgr;
+	RsPeerId ownId = RsPeerId::random();
+	p3PeerMgrIMPL peerMgr(ownId, RsPgpId(), "", "");
+	RaceLinkMgr linkMgr(&peerMgr, &netMgr);
+	linkMgr.mOwnId = ownId;
+	RaceGroup group(nbConnections, outcomes);
+	linkMgr.addMonitor(&group);
+
+	RsPeerId id = RsPeerId::random();
+	linkMgr.addFriend(id, false);
+	for(uint16_t port = 1; port <= 4; ++port)
+		linkMgr.addAddress(id, port);
+
+	linkMgr.tick(); // the new friend gets its pqiperson
+	if(!group.mPerson) return 0;
+
+	/* the race stops at its width, or when the peer has no free connection */
+	group.connectPeer(id);
+	EXPECT_EQ( nbConnections < RS_TCP_RACE_WIDTH,
+	           linkMgr.canRaceConnectAttempt(id) );
+	for(FakeNetBin* bin : group.mBins)
+		if(bin->connecting()) delays.push_back(bin->delay());
+
+	uint32_t ticks = 0;
+	for(; group.mClock < 100 && !ticks; ++group.mClock)
+	{
+		group.mPerson->tick();
+		linkMgr.tick(); // the attempts over are followed by the next ones
+		if(group.activeCount()) ticks = group.mClock;
+	}
+
+	group.removePeer(id);
+	return ticks;
+}
+
+TEST(libretroshare_pqi, pqiperson_race_reconnect_time)
+{
+	std::vector<uint32_t> raceDelays, sequentialDelays;
+	uint32_t raced = reconnectTicks(RS_TCP_RACE_WIDTH, raceDelays);
+	uint32_t sequential = reconnectTicks(1, sequentialDelays);
+
+	RecordProperty("race_seconds", raced);
+	RecordProperty("sequential_seconds", sequential);
+
+	/* the link manager staggers the attempts it starts together */
+	ASSERT_EQ(RS_TCP_RACE_WIDTH, raceDelays.size());
+	const uint32_t delay = raceDelays[0];
+	for(uint32_t i = 1; i < RS_TCP_RACE_WIDTH; ++i)
+		EXPECT_EQ(delay + i * RS_TCP_RACE_STAGGER, raceDelays[i]);
+	ASSERT_EQ(1u, sequentialDelays.size());
+	EXPECT_EQ(delay, sequentialDelays[0]);
+
+	EXPECT_EQ(delay + 2 * RS_TCP_RACE_STAGGER + 1, raced);
+	EXPECT_LT(raced + 2 * RS_TCP_STD_TIMEOUT_PERIOD, sequential);
+}
+
+TEST(libretroshare_pqi, pqiperson_race_failure_of_another_address)
+{
+	std::map<uint16_t, int> outcomes =
+	{ {1, DEAD_ADDRESS}, {2, DEAD_ADDRESS}, {3, DEAD_ADDRESS}, {4, DEAD_ADDRESS} };
+
+	p3NetMgrIMPL netMgr;
+	RsPeerId ownId = RsPeerId::random();
+	p3PeerMgrIMPL peerMgr(ownId, RsPgpId(), "", "");
+	RaceLinkMgr linkMgr(&peerMgr, &netMgr);
+	linkMgr.mOwnId = ownId;
+	RaceGroup group(RS_TCP_RACE_WIDTH, outcomes);
+	linkMgr.addMonitor(&group);
+
+	RsPeerId id = RsPeerId::random();
+	linkMgr.addFriend(id, false);
+	for(uint16_t port = 1; port <= 4; ++port)
+		linkMgr.addAddress(id, port);
+	linkMgr.tick();
+	ASSERT_TRUE(group.mPerson);
+
+	group.connectPeer(id);
+	EXPECT_FALSE(linkMgr.canRaceConnectAttempt(id));
+
+	/* none of the attempts in progress is over */
+	sockaddr_storage addr;
+	sockaddr_storage_ipv4_aton(addr, "10.0.0.2");
+	sockaddr_storage_setport(addr, 1);
+	linkMgr.connectResult(id, false, false, RS_NET_CONN_TCP_ALL, addr);
+	EXPECT_FALSE(linkMgr.canRaceConnectAttempt(id));
+
+	/* the last one started is, its place goes to the fourth address */
+	sockaddr_storage_ipv4_aton(addr, "10.0.0.1");
+	sockaddr_storage_setport(addr, 3);
+	linkMgr.connectResult(id, false, false, RS_NET_CONN_TCP_ALL, addr);
+	EXPECT_TRUE(linkMgr.canRaceConnectAttempt(id));
+
+	group.removePeer(id);
+}
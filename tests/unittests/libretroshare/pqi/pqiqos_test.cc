@@ -0,0 +1,171 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqiqos_test.cc                                  *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "pqi/pqiqos.h"
+
+static const uint32_t NB_LEVELS  = 10;
+static const uint32_t SLICE_SIZE = 512;
+
+/* Queue an item whose first 4 bytes hold an identifier */
+static void queueItem(pqiQoS& qos, uint32_t id, uint32_t size, int priority)
+{
+	void *mem = malloc(size);
+	memset(mem, 0, size);
+	memcpy(mem, &id, sizeof(id));
+	qos.in_rsItem(mem, size, priority);
+}
+
+TEST(libretroshare_pqi, pqiQoS_keeps_order_within_level)
+{
+	pqiQoS qos(NB_LEVELS, 2.0f);
+
+	for(uint32_t i=0; i<1000; ++i)
+		queueItem(qos, i, 100 + (i%7)*300, i % NB_LEVELS);
+
+	std::vector<uint32_t> last(NB_LEVELS, 0);
+	uint32_t nb_out = 0;
+
+	pqiOutSlice slice;
+	bool starts, ends;
+	uint32_t packet_id;
+
+	while(qos.out_rsItem(SLICE_SIZE, slice, starts, ends, packet_id))
+	{
+		if(!starts) continue;
+
+		uint32_t id;
+		memcpy(&id, slice.data(), sizeof(id));
+
+		EXPECT_TRUE(id == 0 || id > last[id % NB_LEVELS]);
+		last[id % NB_LEVELS] = id;
+		++nb_out;
+	}
+
+	EXPECT_EQ(1000u, nb_out);
+	EXPECT_EQ(0u, qos.qos_queue_size());
+}
+
+TEST(libretroshare_pqi, pqiQoS_bounds_delay_of_high_priority)
+{
+	pqiQoS qos(NB_LEVELS, 2.0f);
+
+	/* saturate with bulk traffic, then queue one interactive item */
+	for(uint32_t i=0; i<200; ++i) queueItem(qos, i, 8000, 5);
+	queueItem(qos, 0xffffffff, 300, 7);
+
+	pqiOutSlice slice;
+	bool starts, ends;
+	uint32_t packet_id;
+	uint32_t bulk_bytes_before = 0;
+
+	while(qos.out_rsItem(SLICE_SIZE, slice, starts, ends, packet_id))
+	{
+		uint32_t id = 0;
+		if(starts) memcpy(&id, slice.data(), sizeof(id));
+		if(starts && id == 0xffffffff) break;
+
+		bulk_bytes_before += slice.size();
+	}
+
+	/* at most one quantum of the bulk level goes out before */
+	EXPECT_LE(bulk_bytes_before, qos.quantum(5));
+
+	std::vector<RsQoSClassStats> stats;
+	qos.gatherQueueStatistics(stats);
+
+	ASSERT_EQ(NB_LEVELS, stats.size());
+	EXPECT_EQ(0u, stats[7].backlogItems);
+	EXPECT_EQ(1u, stats[7].sentItems);
+	EXPECT_GT(stats[5].backlogBytes, 0u);
+}
+
+TEST(libretroshare_pqi, pqiQoS_shares_bandwidth_by_quantum)
+{
+	pqiQoS qos(NB_LEVELS, 2.0f);
+	qos.setQuantum(2, 1000);
+	qos.setQuantum(3, 3000);
+
+	/* items fit in one slice, the level is stored in the identifier */
+	for(uint32_t i=0; i<2000; ++i)
+	{
+		queueItem(qos, 2, 500, 2);
+		queueItem(qos, 3, 500, 3);
+	}
+
+	std::vector<uint32_t> bytes(NB_LEVELS, 0);
+	pqiOutSlice slice;
+	bool starts, ends;
+	uint32_t packet_id;
+
+	/* only look at the part where both levels are backlogged */
+	for(uint32_t n=0; n<1000 && qos.out_rsItem(SLICE_SIZE, slice, starts, ends, packet_id); ++n)
+	{
+		uint32_t level;
+		memcpy(&level, slice.data(), sizeof(level));
+		bytes[level] += slice.size();
+	}
+
+	ASSERT_GT(bytes[2], 0u);
+	float ratio = float(bytes[3]) / bytes[2];
+	EXPECT_NEAR(3.0f, ratio, 0.1f);
+}
+
+TEST(libretroshare_pqi, pqiQoS_leaves_blocked_levels_aside)
+{
+	pqiQoS qos(NB_LEVELS, 2.0f);
+
+	for(uint32_t i=0; i<10; ++i)
+	{
+		queueItem(qos, 5, 300, 5);
+		queueItem(qos, 8, 300, 8);
+	}
+
+	pqiOutSlice slice;
+	bool starts, ends;
+	uint32_t packet_id, level;
+
+	/* only level 8 goes out while level 5 is blocked */
+	qos.setBlockedLevels(1u << 5);
+	for(uint32_t n=0; n<10; ++n)
+	{
+		ASSERT_TRUE(qos.out_rsItem(SLICE_SIZE, slice, starts, ends, packet_id));
+		memcpy(&level, slice.data(), sizeof(level));
+		EXPECT_EQ(8u, level);
+		EXPECT_EQ(8u, qos.lastOutLevel());
+	}
+
+	/* nothing left but blocked items */
+	EXPECT_FALSE(qos.out_rsItem(SLICE_SIZE, slice, starts, ends, packet_id));
+	EXPECT_EQ(10u, qos.qos_queue_size());
+
+	qos.setBlockedLevels(0);
+	for(uint32_t n=0; n<10; ++n)
+	{
+		ASSERT_TRUE(qos.out_rsItem(SLICE_SIZE, slice, starts, ends, packet_id));
+		EXPECT_EQ(5u, qos.lastOutLevel());
+	}
+	EXPECT_EQ(0u, qos.qos_queue_size());
+}
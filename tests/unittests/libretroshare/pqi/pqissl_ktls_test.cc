@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqissl_ktls_test.cc                             *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#ifdef RS_KTLS
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "pqi/authssl.h"
+
+#ifndef TCP_ULP
+#define TCP_ULP 31 /* older libc headers */
+#endif
+
+/* A TLS connection over loopback TCP between two end points whose contexts
+ * get their options and cipher list from AuthSSL::setupContextOptions() as
+ * the peer connection context does, data exchanged with SSL_read() and
+ * SSL_write() as pqissl does. */
+
+static bool tcpPair(int& client, int& server)
+{
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	client = socket(AF_INET, SOCK_STREAM, 0);
+	bool ok = listener >= 0 && client >= 0 &&
+	        !bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) &&
+	        !listen(listener, 1) &&
+	        !getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) &&
+	        !connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+	server = ok ? accept(listener, nullptr, nullptr) : -1;
+
+	if(listener >= 0) close(listener);
+	return server >= 0;
+}
+
+/// @return false if the kernel has no TLS upper layer protocol to offload to
+static bool kernelHasTls()
+{
+	int client, server;
+	if(!tcpPair(client, server)) return false;
+
+	bool ok = !setsockopt(client, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+	close(client);
+	close(server);
+	return ok;
+}
+
+static int acceptAll(int, X509_STORE_CTX*) { return 1; }
+
+static SSL_CTX* makeCtx(int maxVersion)
+{
+	EVP_PKEY* key = EVP_RSA_gen(2048);
+
+	X509* cert = X509_new();
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME* name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	                           (const unsigned char*)"node", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+
+	SSL_CTX* ctx = SSL_CTX_new(SSLv23_method());
+	AuthSSL::setupContextOptions(ctx);
+	SSL_CTX_set_max_proto_version(ctx, maxVersion);
+	SSL_CTX_set_dh_auto(ctx, 1);
+	SSL_CTX_use_certificate(ctx, cert);
+	SSL_CTX_use_PrivateKey(ctx, key);
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+	                   acceptAll);
+
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return ctx;
+}
+
+static bool writeAll(SSL* ssl, const std::vector<char>& data)
+{
+	for(size_t sent = 0; sent < data.size(); )
+	{
+		int n = SSL_write(ssl, data.data() + sent, data.size() - sent);
+		if(n <= 0) return false;
+		sent += n;
+	}
+	return true;
+}
+
+static bool readAll(SSL* ssl, std::vector<char>& data)
+{
+	for(size_t received = 0; received < data.size(); )
+	{
+		int n = SSL_read(ssl, data.data() + received, data.size() - received);
+		if(n <= 0) return false;
+		received += n;
+	}
+	return true;
+}
+
+static void offloadsAndRoundTrips(int version)
+{
+	if(!kernelHasTls())
+		GTEST_SKIP() << "No kernel TLS (modprobe tls) to test against";
+
+	SSL_CTX* clientCtx = makeCtx(version);
+	SSL_CTX* serverCtx = makeCtx(version);
+
+	int clientFd, serverFd;
+	ASSERT_TRUE(tcpPair(clientFd, serverFd));
+
+	SSL* client = SSL_new(clientCtx);
+	SSL* server = SSL_new(serverCtx);
+	SSL_set_fd(client, clientFd);
+	SSL_set_fd(server, serverFd);
+
+	int accepted = 0;
+	std::thread serverThread([&]() { accepted = SSL_accept(server); });
+	int connected = SSL_connect(client);
+	serverThread.join();
+	ASSERT_EQ(1, connected);
+	ASSERT_EQ(1, accepted);
+
+	/* what pqissl logs and exports in RsPeerCryptoParams */
+	EXPECT_TRUE(BIO_get_ktls_send(SSL_get_wbio(client)));
+	EXPECT_TRUE(BIO_get_ktls_send(SSL_get_wbio(server)));
+
+	/* OpenSSL before 3.2 only offloads transmission with TLS 1.3 */
+#if OPENSSL_VERSION_NUMBER < 0x30200000L
+	if(version != TLS1_3_VERSION)
+#endif
+	{
+		EXPECT_TRUE(BIO_get_ktls_recv(SSL_get_rbio(client)));
+		EXPECT_TRUE(BIO_get_ktls_recv(SSL_get_rbio(server)));
+	}
+
+	/* several records each way, the last one partial */
+	std::vector<char> request(300 * 1024 + 17), reply(request.size());
+	for(size_t i = 0; i < request.size(); ++i)
+	{
+		request[i] = static_cast<char>(i * 7);
+		reply[i] = static_cast<char>(i * 13);
+	}
+
+	std::vector<char> gotRequest(request.size()), gotReply(reply.size());
+	bool served = false;
+	serverThread = std::thread([&]()
+	{
+		served = readAll(server, gotRequest) && writeAll(server, reply);
+	});
+	EXPECT_TRUE(writeAll(client, request));
+	EXPECT_TRUE(readAll(client, gotReply));
+	serverThread.join();
+
+	EXPECT_TRUE(served);
+	EXPECT_EQ(request, gotRequest);
+	EXPECT_EQ(reply, gotReply);
+
+	SSL_free(client);
+	SSL_free(server);
+	close(clientFd);
+	close(serverFd);
+	SSL_CTX_free(clientCtx);
+	SSL_CTX_free(serverCtx);
+}
+
+TEST(libretroshare_pqi, pqissl_KernelTls12)
+{ offloadsAndRoundTrips(TLS1_2_VERSION); }
+
+TEST(libretroshare_pqi, pqissl_KernelTls13)
+{ offloadsAndRoundTrips(TLS1_3_VERSION); }
+
+#endif // RS_KTLS
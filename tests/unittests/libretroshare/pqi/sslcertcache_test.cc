@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/sslcertcache_test.cc                            *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+
+#include "pqi/sslcertcache.h"
+
+/* Result codes as in authssl.cc, the cache doesn't interpret them */
+static const uint32_t DIAGNOSTIC_OK              = 0x01;
+static const uint32_t DIAGNOSTIC_WRONG_SIGNATURE = 0x05;
+
+static X509* makeCert(long serial)
+{
+	EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+	EVP_PKEY_keygen_init(pctx);
+	EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1);
+	EVP_PKEY* key = nullptr;
+	EVP_PKEY_keygen(pctx, &key);
+	EVP_PKEY_CTX_free(pctx);
+
+	X509* cert = X509_new();
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_sign(cert, key, EVP_sha256());
+	EVP_PKEY_free(key);
+	return cert;
+}
+
+TEST(libretroshare_pqi, SslVerifiedCertCache_remembers_results)
+{
+	SslVerifiedCertCache cache;
+	X509* good = makeCert(1);
+	X509* bad = makeCert(2);
+	RsPgpId issuer = RsPgpId::random();
+	RsPgpFingerprint fpr = RsPgpFingerprint::random();
+
+	uint32_t diagnostic = 0;
+	EXPECT_FALSE(cache.get(good, fpr, diagnostic, 100));
+
+	cache.store(good, issuer, fpr, DIAGNOSTIC_OK, 100);
+	cache.store(bad, issuer, fpr, DIAGNOSTIC_WRONG_SIGNATURE, 100);
+	EXPECT_EQ(2u, cache.size());
+
+	ASSERT_TRUE(cache.get(good, fpr, diagnostic, 101));
+	EXPECT_EQ(DIAGNOSTIC_OK, diagnostic);
+	ASSERT_TRUE(cache.get(bad, fpr, diagnostic, 101));
+	EXPECT_EQ(DIAGNOSTIC_WRONG_SIGNATURE, diagnostic);
+
+	/* same certificate, parsed again */
+	unsigned char* der = nullptr;
+	int len = i2d_X509(good, &der);
+	const unsigned char* p = der;
+	X509* copy = d2i_X509(nullptr, &p, len);
+	OPENSSL_free(der);
+	ASSERT_TRUE(cache.get(copy, fpr, diagnostic, 102));
+	EXPECT_EQ(DIAGNOSTIC_OK, diagnostic);
+
+	X509_free(copy);
+	X509_free(good);
+	X509_free(bad);
+}
+
+TEST(libretroshare_pqi, SslVerifiedCertCache_follows_issuer_key)
+{
+	SslVerifiedCertCache cache;
+	X509* cert = makeCert(1);
+	X509* other = makeCert(2);
+	RsPgpId issuer = RsPgpId::random();
+	RsPgpFingerprint fpr = RsPgpFingerprint::random();
+
+	cache.store(cert, issuer, fpr, DIAGNOSTIC_OK, 100);
+
+	/* the issuer has another key now: the result is dropped */
+	uint32_t diagnostic;
+	EXPECT_FALSE(cache.get(cert, RsPgpFingerprint::random(), diagnostic, 101));
+	EXPECT_FALSE(cache.get(cert, fpr, diagnostic, 101));
+	EXPECT_EQ(0u, cache.size());
+
+	/* the key is removed */
+	cache.store(cert, issuer, fpr, DIAGNOSTIC_OK, 102);
+	cache.store(other, RsPgpId::random(), fpr, DIAGNOSTIC_OK, 102);
+	cache.forgetIssuer(issuer);
+	EXPECT_FALSE(cache.get(cert, fpr, diagnostic, 103));
+	EXPECT_TRUE(cache.get(other, fpr, diagnostic, 103));
+
+	X509_free(cert);
+	X509_free(other);
+}
+
+TEST(libretroshare_pqi, SslVerifiedCertCache_drops_least_recently_used)
+{
+	SslVerifiedCertCache cache(2);
+	X509* certs[3] = { makeCert(1), makeCert(2), makeCert(3) };
+	RsPgpFingerprint fpr = RsPgpFingerprint::random();
+	uint32_t diagnostic;
+
+	cache.store(certs[0], RsPgpId::random(), fpr, DIAGNOSTIC_OK, 100);
+	cache.store(certs[1], RsPgpId::random(), fpr, DIAGNOSTIC_OK, 101);
+	EXPECT_TRUE(cache.get(certs[0], fpr, diagnostic, 102));
+
+	cache.store(certs[2], RsPgpId::random(), fpr, DIAGNOSTIC_OK, 103);
+	EXPECT_EQ(2u, cache.size());
+	EXPECT_TRUE(cache.get(certs[0], fpr, diagnostic, 104));
+	EXPECT_FALSE(cache.get(certs[1], fpr, diagnostic, 104));
+	EXPECT_TRUE(cache.get(certs[2], fpr, diagnostic, 104));
+
+	for(X509* cert : certs) X509_free(cert);
+}
@@ -0,0 +1,265 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/sslsessioncache_test.cc                         *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <ctime>
+#include <map>
+#include <vector>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include "pqi/sslsessioncache.h"
+
+/* Handshakes between two in memory end points, set up as AuthSSL does: peer
+ * certificates verified by a callback, client side session cache. */
+
+static SslSessionCache* sCache = nullptr;
+static RsPeerId sPeer;
+static int sVerifyCalls = 0;
+
+static int countingVerify(int, X509_STORE_CTX*) { ++sVerifyCalls; return 1; }
+
+static int storeSession(SSL* ssl, SSL_SESSION* session)
+{
+	if(!SSL_is_server(ssl) && sCache)
+		sCache->store(sPeer, session);
+	return 0;
+}
+
+static void makeIdentity(EVP_PKEY*& key, X509*& cert)
+{
+	EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+	EVP_PKEY_keygen_init(pctx);
+	EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1);
+	key = nullptr;
+	EVP_PKEY_keygen(pctx, &key);
+	EVP_PKEY_CTX_free(pctx);
+
+	cert = X509_new();
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME* name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	                           (const unsigned char*)"node", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+}
+
+static SSL_CTX* makeCtx(int maxVersion)
+{
+	EVP_PKEY* key;
+	X509* cert;
+	makeIdentity(key, cert);
+
+	SSL_CTX* ctx = SSL_CTX_new(TLS_method());
+	SSL_CTX_set_max_proto_version(ctx, maxVersion);
+	SSL_CTX_use_certificate(ctx, cert);
+	SSL_CTX_use_PrivateKey(ctx, key);
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+	                   countingVerify);
+	SSL_CTX_set_session_id_context(ctx, (const unsigned char*)"RetroShare", 10);
+	SSL_CTX_set_timeout(ctx, RS_SSL_SESSION_LIFETIME);
+	SSL_CTX_set_session_cache_mode(
+	            ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+	SSL_CTX_sess_set_new_cb(ctx, storeSession);
+
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return ctx;
+}
+
+/// @return true if connected, resumed tells if the session was resumed
+static bool connect(SSL_CTX* client_ctx, SSL_CTX* server_ctx,
+                    SSL_SESSION* session, bool& resumed)
+{
+	SSL* client = SSL_new(client_ctx);
+	SSL* server = SSL_new(server_ctx);
+	BIO *cbio, *sbio;
+	BIO_new_bio_pair(&cbio, 0, &sbio, 0);
+	SSL_set_bio(client, cbio, cbio);
+	SSL_set_bio(server, sbio, sbio);
+	SSL_set_connect_state(client);
+	SSL_set_accept_state(server);
+
+	if(session)
+		SSL_set_session(client, session);
+
+	bool client_done = false, server_done = false;
+	for(int i = 0; i < 20 && !(client_done && server_done); ++i)
+	{
+		if(!client_done) client_done = SSL_do_handshake(client) == 1;
+		if(!server_done) server_done = SSL_do_handshake(server) == 1;
+	}
+
+	/* TLS 1.3 tickets come after the handshake */
+	char buf[16];
+	SSL_read(client, buf, sizeof(buf));
+
+	resumed = SSL_session_reused(client) && SSL_session_reused(server);
+
+	SSL_free(client);
+	SSL_free(server);
+	return client_done && server_done;
+}
+
+/* One client and one server of the given TLS version max */
+class Nodes
+{
+public:
+	explicit Nodes(int version) : mVersion(version)
+	{
+		sCache = &mCache;
+		sPeer = RsPeerId::random();
+		sVerifyCalls = 0;
+		mClient = makeCtx(version);
+		mServer = makeCtx(version);
+	}
+
+	~Nodes()
+	{
+		SSL_CTX_free(mClient);
+		SSL_CTX_free(mServer);
+		sCache = nullptr;
+	}
+
+	int mVersion;
+	SslSessionCache mCache;
+	SSL_CTX* mClient;
+	SSL_CTX* mServer;
+};
+
+static void resumesWithoutVerifying(int version)
+{
+	Nodes n(version);
+
+	bool resumed;
+	ASSERT_TRUE(connect(n.mClient, n.mServer, nullptr, resumed));
+	EXPECT_FALSE(resumed);
+	EXPECT_LT(0, sVerifyCalls);
+	ASSERT_EQ(1u, n.mCache.size());
+
+	SSL_SESSION* session = n.mCache.get(sPeer, time(nullptr));
+	ASSERT_TRUE(session);
+
+	sVerifyCalls = 0;
+	ASSERT_TRUE(connect(n.mClient, n.mServer, session, resumed));
+	SSL_SESSION_free(session);
+
+	/* certificates are not checked again, AuthSSL has to */
+	EXPECT_TRUE(resumed);
+	EXPECT_EQ(0, sVerifyCalls);
+
+	EXPECT_FALSE(n.mCache.get(RsPeerId::random(), time(nullptr)));
+	n.mCache.remove(sPeer);
+	EXPECT_FALSE(n.mCache.get(sPeer, time(nullptr)));
+}
+
+static void dropsExpiredSessions(int version)
+{
+	Nodes n(version);
+
+	bool resumed;
+	ASSERT_TRUE(connect(n.mClient, n.mServer, nullptr, resumed));
+
+	rstime_t later = time(nullptr) + RS_SSL_SESSION_LIFETIME + 1;
+	std::map<RsPeerId, std::vector<uint8_t> > saved;
+	n.mCache.exportSessions(saved, later);
+	EXPECT_TRUE(saved.empty());
+
+	EXPECT_FALSE(n.mCache.get(sPeer, later));
+	EXPECT_EQ(0u, n.mCache.size());
+}
+
+static void survivesRestart(int version)
+{
+	Nodes n(version);
+
+	bool resumed;
+	ASSERT_TRUE(connect(n.mClient, n.mServer, nullptr, resumed));
+
+	std::map<RsPeerId, std::vector<uint8_t> > saved;
+	n.mCache.exportSessions(saved, time(nullptr));
+	ASSERT_EQ(1u, saved.size());
+
+	/* both ends restart, the server with its ticket keys */
+	unsigned char keys[80];
+	ASSERT_EQ(1, SSL_CTX_get_tlsext_ticket_keys(n.mServer, keys, sizeof(keys)));
+	SSL_CTX_free(n.mServer);
+	n.mServer = makeCtx(version);
+	ASSERT_EQ(1, SSL_CTX_set_tlsext_ticket_keys(n.mServer, keys, sizeof(keys)));
+
+	SslSessionCache restarted;
+	restarted.importSessions(saved, time(nullptr));
+	SSL_SESSION* session = restarted.get(sPeer, time(nullptr));
+	ASSERT_TRUE(session);
+
+	sCache = nullptr;
+	ASSERT_TRUE(connect(n.mClient, n.mServer, session, resumed));
+	SSL_SESSION_free(session);
+	EXPECT_TRUE(resumed);
+}
+
+TEST(libretroshare_pqi, SslSessionCache_resumes_without_verifying)
+{
+	resumesWithoutVerifying(TLS1_2_VERSION);
+	resumesWithoutVerifying(TLS1_3_VERSION);
+}
+
+TEST(libretroshare_pqi, SslSessionCache_drops_expired_sessions)
+{
+	dropsExpiredSessions(TLS1_2_VERSION);
+	dropsExpiredSessions(TLS1_3_VERSION);
+}
+
+TEST(libretroshare_pqi, SslSessionCache_survives_restart)
+{
+	survivesRestart(TLS1_2_VERSION);
+	survivesRestart(TLS1_3_VERSION);
+}
+
+TEST(libretroshare_pqi, SslSessionCache_evicts_oldest)
+{
+	SslSessionCache cache(2);
+	RsPeerId peers[3];
+	long now = time(nullptr);
+
+	for(int i = 0; i < 3; ++i)
+	{
+		SSL_SESSION* session = SSL_SESSION_new();
+		SSL_SESSION_set_time(session, now - 10 + i);
+		SSL_SESSION_set_timeout(session, RS_SSL_SESSION_LIFETIME);
+		peers[i] = RsPeerId::random();
+		cache.store(peers[i], session);
+		SSL_SESSION_free(session);
+	}
+
+	EXPECT_EQ(2u, cache.size());
+	EXPECT_FALSE(cache.get(peers[0], now));
+
+	SSL_SESSION* kept = cache.get(peers[2], now);
+	ASSERT_TRUE(kept);
+	EXPECT_EQ(now - 8, SSL_SESSION_get_time(kept));
+	SSL_SESSION_free(kept);
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * unittests/libretroshare/serialiser/rsrawitem_test.cc                        *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <cstdlib>
+
+#include "serialiser/rsserial.h"
+#include "serialiser/rsserializer.h"
+#include "rsitems/rsitem.h"
+
+static void *makeRawPacket(uint32_t size, uint32_t capacity)
+{
+	uint8_t *mem = static_cast<uint8_t*>(malloc(capacity));
+	for(uint32_t i=8;i<size;++i) mem[i] = uint8_t(i);
+
+	uint32_t type = (RS_PKT_VERSION_SERVICE << 24) + (0x1234 << 8) + 0x01;
+	setRsItemHeader(mem, size, type, size);
+	return mem;
+}
+
+TEST(libretroshare_serialiser, RsRawSerialiser_deserialiseOwned)
+{
+	RsSerialiser srl;
+	srl.addSerialType(new RsRawSerialiser());
+
+	/* reassembly buffers may be larger than the packet they hold */
+	const uint32_t pktsize = 1000;
+	void *mem = makeRawPacket(pktsize, 2*pktsize);
+
+	uint32_t size = 2*pktsize;
+	RsItem *item = srl.deserialiseOwned(mem, &size);
+	RsRawItem *raw = dynamic_cast<RsRawItem*>(item);
+
+	ASSERT_TRUE(raw != NULL);
+	EXPECT_EQ(pktsize, size);
+	EXPECT_EQ(pktsize, raw->getRawLength());
+
+	/* the buffer is handed over to the item, not copied */
+	EXPECT_EQ(mem, raw->getRawData());
+
+	uint32_t outsize = 0;
+	const uint8_t *out = srl.serialiseScratch(raw, outsize);
+	ASSERT_TRUE(out != NULL);
+	EXPECT_EQ(pktsize, outsize);
+	EXPECT_EQ(0, memcmp(out, mem, pktsize));
+
+	delete item;
+}
+
+TEST(libretroshare_serialiser, RsRawSerialiser_deserialiseOwned_truncated)
+{
+	RsSerialiser srl;
+	srl.addSerialType(new RsRawSerialiser());
+
+	/* announced size bigger than the data: rejected, buffer released */
+	void *mem = makeRawPacket(1000, 1000);
+	uint32_t size = 500;
+
+	EXPECT_TRUE(srl.deserialiseOwned(mem, &size) == NULL);
+}
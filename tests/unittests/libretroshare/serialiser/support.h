@@ -25,6 +25,7 @@
 #include <gtest/gtest.h>
 
 #include <string>
+#include <cstring>
 #include <stdint.h>
 #include <iostream>
 
@@ -136,6 +137,17 @@ template<class ItemClass,class ItemSerialiser> int test_RsItem()
 
 	EXPECT_TRUE(done == true);
 
+	/* single pass serialisation must produce exactly the same packet */
+	uint32_t scratchsize = 0;
+	const uint8_t *scratch = srl.serialiseScratch(&rsfi, scratchsize);
+
+	EXPECT_TRUE(scratch != NULL);
+	EXPECT_TRUE(scratchsize == sersize);
+	if(scratch)
+	{
+		EXPECT_TRUE(0 == memcmp(scratch, buffer, sersize));
+	}
+
 	uint32_t sersize2 = sersize;
 	RsItem *output = srl.deserialise((void *) buffer, &sersize2);
 
@@ -219,6 +231,17 @@ template<class ItemClass,class ItemSerialiser> int test_RsItem(uint16_t servtype
 
         EXPECT_TRUE(done == true);
 
+        /* single pass serialisation must produce exactly the same packet */
+        uint32_t scratchsize = 0;
+        const uint8_t *scratch = srl.serialiseScratch(&rsfi, scratchsize);
+
+        EXPECT_TRUE(scratch != NULL);
+        EXPECT_TRUE(scratchsize == sersize);
+        if(scratch)
+        {
+                EXPECT_TRUE(0 == memcmp(scratch, buffer, sersize));
+        }
+
         uint32_t sersize2 = sersize;
         RsItem *output = srl.deserialise((void *) buffer, &sersize2);
 
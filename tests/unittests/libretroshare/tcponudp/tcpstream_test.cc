@@ -0,0 +1,227 @@
+/*******************************************************************************
+ * unittests/libretroshare/tcponudp/tcpstream_test.cc                          *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "tcponudp/tcpstream.h"
+
+/* Simulated time, advanced by the test instead of waiting for it */
+static double simTime = 0;
+static double now() { return simTime; }
+
+static const double SIM_STEP = 0.001;
+
+class SimulatedClock
+{
+public:
+	SimulatedClock() { simTime = 1000; TcpStream::setClock(now); }
+	~SimulatedClock() { TcpStream::setClock(NULL); }
+};
+
+/* One direction of a simulated UDP path: delays, reorders (through jitter)
+ * and drops the packets sent by a stream before handing them to its peer. */
+class LossyLink: public UdpSubReceiver
+{
+public:
+	LossyLink(double delay, double jitter, uint32_t seed) :
+	    UdpSubReceiver(nullptr), mPeer(nullptr), mDelay(delay),
+	    mJitter(jitter), mLoss(0), mRandom(seed), mSent(0), mDropped(0) {}
+
+	void setPeer(TcpStream* peer) { mPeer = peer; }
+	void setLoss(double loss) { mLoss = loss; }
+
+	int sendPkt( const void* data, int size, const sockaddr_in& /*to*/,
+	             int /*ttl*/ ) override
+	{
+		std::uniform_real_distribution<double> uniform(0, 1);
+
+		++mSent;
+		if(uniform(mRandom) < mLoss)
+		{
+			++mDropped;
+			return size;
+		}
+
+		double at = now() + mDelay + mJitter * uniform(mRandom);
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		mInFlight.insert(std::make_pair(
+		                     at, std::vector<uint8_t>(bytes, bytes + size) ));
+		return size;
+	}
+
+	int recvPkt(void*, int, sockaddr_in&) override { return 0; }
+
+	/// Hand packets which reached the other end to the peer stream
+	void deliver()
+	{
+		double cts = now();
+		while(!mInFlight.empty() && mInFlight.begin()->first <= cts)
+		{
+			std::vector<uint8_t> pkt = mInFlight.begin()->second;
+			mInFlight.erase(mInFlight.begin());
+			mPeer->recvPkt(pkt.data(), static_cast<int>(pkt.size()));
+		}
+	}
+
+	uint32_t sent() const { return mSent; }
+	uint32_t dropped() const { return mDropped; }
+
+private:
+	TcpStream* mPeer;
+	const double mDelay;
+	const double mJitter;
+	double mLoss;
+	std::mt19937 mRandom;
+	std::multimap<double, std::vector<uint8_t>> mInFlight;
+	uint32_t mSent;
+	uint32_t mDropped;
+};
+
+static sockaddr_in localAddr(uint16_t port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	return addr;
+}
+
+/** Send size bytes from sender to receiver over a lossy path, in simulated
+ * time.
+ * @return transfer time in seconds, < 0 on timeout */
+static double transfer( TcpCongestionType cc, double loss, uint32_t size,
+                        TcpStream& sender, TcpStream& receiver,
+                        LossyLink& forward, LossyLink& backward )
+{
+	forward.setPeer(&receiver);
+	backward.setPeer(&sender);
+	sender.setCongestionControl(cc);
+	receiver.setCongestionControl(cc);
+
+	auto step = [&]()
+	{
+		forward.deliver();
+		backward.deliver();
+		sender.tick();
+		receiver.tick();
+		simTime += SIM_STEP;
+	};
+
+	/* connect on a clean path, losing SYNs only costs seconds */
+	receiver.listenfor(localAddr(1001));
+	sender.connect(localAddr(1002), 10);
+	double deadline = now() + 10;
+	while(!(sender.isConnected() && receiver.isConnected()))
+	{
+		if(now() > deadline) return -1;
+		step();
+	}
+
+	forward.setLoss(loss);
+	backward.setLoss(loss);
+
+	std::vector<uint8_t> data(size);
+	std::mt19937 random(3);
+	for(uint8_t& b : data) b = static_cast<uint8_t>(random());
+
+	std::vector<uint8_t> received;
+	uint32_t written = 0;
+	std::vector<char> buf(16 * 1024);
+
+	const double start = now();
+	deadline = start + 60;
+	while(received.size() < size)
+	{
+		if(now() > deadline) return -1;
+
+		if(written < size && sender.write_allowed() > 0)
+		{
+			int chunk = std::min<int>(buf.size(), size - written);
+			int w = sender.write(
+			            reinterpret_cast<char*>(&data[written]), chunk );
+			if(w > 0) written += w;
+		}
+
+		step();
+
+		int r;
+		while((r = receiver.read(buf.data(), buf.size())) > 0)
+			received.insert(received.end(), buf.begin(), buf.begin() + r);
+	}
+	const double elapsed = now() - start;
+
+	EXPECT_TRUE(received == data);
+	return elapsed;
+}
+
+/* Losses are recovered from selective acks, not from timeouts */
+static void checkLossRecovery(TcpCongestionType cc)
+{
+	SimulatedClock clock;
+	LossyLink forward(0.010, 0.004, 1);
+	LossyLink backward(0.010, 0.002, 2);
+	TcpStream sender(&forward);
+	TcpStream receiver(&backward);
+
+	double elapsed = transfer(cc, 0.03, 1024*1024, sender, receiver, forward, backward);
+	ASSERT_GT(elapsed, 0) << "transfer timed out";
+	EXPECT_LT(elapsed, 10);
+
+	EXPECT_GT(forward.dropped(), 0u);
+	EXPECT_GT(sender.sackedPkts(), 0u);
+	EXPECT_GT(sender.fastRetransmits(), 0u);
+	EXPECT_GT(sender.fastRetransmits(), sender.timeoutRetransmits());
+
+	/* every data packet dropped is sent again */
+	EXPECT_GE(sender.fastRetransmits() + sender.timeoutRetransmits(),
+	          forward.dropped());
+}
+
+TEST(libretroshare_tcponudp, TcpStream_CubicLossyLink)
+{
+	checkLossRecovery(TCP_CONGESTION_CUBIC);
+}
+
+TEST(libretroshare_tcponudp, TcpStream_RenoLossyLink)
+{
+	checkLossRecovery(TCP_CONGESTION_RENO);
+}
+
+TEST(libretroshare_tcponudp, TcpStream_CleanLink)
+{
+	SimulatedClock clock;
+	LossyLink forward(0.010, 0, 1);
+	LossyLink backward(0.010, 0.002, 2);
+	TcpStream sender(&forward);
+	TcpStream receiver(&backward);
+
+	double elapsed = transfer( TCP_CONGESTION_CUBIC, 0, 256*1024, sender,
+	                           receiver, forward, backward );
+	ASSERT_GT(elapsed, 0) << "transfer timed out";
+	EXPECT_EQ(0u, forward.dropped());
+	EXPECT_EQ(0u, sender.sackedPkts());
+	EXPECT_EQ(0u, sender.fastRetransmits());
+	EXPECT_EQ(0u, sender.timeoutRetransmits());
+}
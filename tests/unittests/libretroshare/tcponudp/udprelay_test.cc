@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * unittests/libretroshare/tcponudp/udprelay_test.cc                           *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "tcponudp/udprelay.h"
+
+/// Records what the relay hands to the UDP stack
+class CapturePublisher: public UdpPublisher
+{
+public:
+	int sendPkt( const void* data, int size, const sockaddr_in& to,
+	             int /*ttl*/ ) override
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		mPkts.push_back(std::vector<uint8_t>(bytes, bytes + size));
+		mTo.push_back(to);
+		return size;
+	}
+
+	std::vector<std::vector<uint8_t>> mPkts;
+	std::vector<sockaddr_in> mTo;
+};
+
+class CapturePeer: public UdpPeer
+{
+public:
+	void recvPkt(void* data, int size) override
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		mPkts.push_back(std::vector<uint8_t>(bytes, bytes + size));
+	}
+
+	std::vector<std::vector<uint8_t>> mPkts;
+};
+
+static sockaddr_in makeAddr(uint32_t ip, uint16_t port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(ip);
+	addr.sin_port = htons(port);
+	return addr;
+}
+
+static bool sameAddr(const sockaddr_in& a, const sockaddr_in& b)
+{
+	return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+/// Relay packet as sent by the end point from to the end point to
+static std::vector<uint8_t> relayPacket( const sockaddr_in& from,
+                                         const sockaddr_in& to, int size )
+{
+	std::vector<uint8_t> data(size);
+	for(int i = 0; i < size; ++i) data[i] = static_cast<uint8_t>(i * 7);
+
+	sockaddr_in proxy = makeAddr(0x0a000001, 9000);
+	UdpRelayAddrSet ends(&from, &to);
+	UdpRelayEnd end(&ends, &proxy);
+
+	std::vector<uint8_t> pkt(size + 16);
+	int pktSize = createRelayUdpPacket(
+	            data.data(), size, pkt.data(), pkt.size(), &end );
+	pkt.resize(pktSize);
+	return pkt;
+}
+
+class UdpRelayTest: public ::testing::Test
+{
+protected:
+	UdpRelayTest() : mRelay(&mPublisher),
+	    mA(makeAddr(0x0a000002, 1000)), mB(makeAddr(0x0a000003, 2000)) {}
+
+	void SetUp() override
+	{
+		mRelay.setRelayTotal(100);
+		mRelay.setRelayClassMax(UDP_RELAY_CLASS_GENERAL, 100, 1000000);
+	}
+
+	bool addRelay(const sockaddr_in& a, const sockaddr_in& b)
+	{
+		UdpRelayAddrSet addrs(&a, &b);
+		int relayClass = UDP_RELAY_CLASS_GENERAL;
+		uint32_t bandwidth = 0;
+		return mRelay.addUdpRelay(&addrs, relayClass, bandwidth);
+	}
+
+	int receive(std::vector<uint8_t> pkt)
+	{
+		sockaddr_in from = makeAddr(0x0a0000ff, 1);
+		return mRelay.recvPkt(pkt.data(), pkt.size(), from);
+	}
+
+	CapturePublisher mPublisher;
+	UdpRelayReceiver mRelay;
+	sockaddr_in mA, mB;
+};
+
+TEST_F(UdpRelayTest, ForwardsBothWaysUnchanged)
+{
+	ASSERT_TRUE(addRelay(mA, mB));
+	EXPECT_EQ(1, mRelay.getRelayCount(UDP_RELAY_CLASS_GENERAL));
+
+	std::vector<uint8_t> ab = relayPacket(mA, mB, 1000);
+	std::vector<uint8_t> ba = relayPacket(mB, mA, 300);
+	EXPECT_EQ(1, receive(ab));
+	EXPECT_EQ(1, receive(ba));
+
+	ASSERT_EQ(2u, mPublisher.mPkts.size());
+	EXPECT_EQ(ab, mPublisher.mPkts[0]);
+	EXPECT_TRUE(sameAddr(mB, mPublisher.mTo[0]));
+	EXPECT_EQ(ba, mPublisher.mPkts[1]);
+	EXPECT_TRUE(sameAddr(mA, mPublisher.mTo[1]));
+
+	uint32_t read, write, relay;
+	mRelay.getDataTransferred(read, write, relay);
+	EXPECT_EQ(ab.size() + ba.size(), relay);
+}
+
+TEST_F(UdpRelayTest, IgnoresUnknownAndRemovedRelays)
+{
+	EXPECT_EQ(0, receive(relayPacket(mA, mB, 100)));
+
+	ASSERT_TRUE(addRelay(mA, mB));
+	EXPECT_FALSE(addRelay(mA, mB));
+
+	UdpRelayAddrSet addrs(&mB, &mA);
+	mRelay.removeUdpRelay(&addrs);
+	EXPECT_EQ(0, mRelay.getRelayCount(UDP_RELAY_CLASS_ALL));
+
+	EXPECT_EQ(0, receive(relayPacket(mA, mB, 100)));
+	EXPECT_EQ(0, receive(relayPacket(mB, mA, 100)));
+	EXPECT_TRUE(mPublisher.mPkts.empty());
+}
+
+TEST_F(UdpRelayTest, KeepsRelaysApart)
+{
+	/* many relays spread over the shards, each packet to its own end */
+	std::vector<sockaddr_in> ends;
+	for(uint32_t i = 0; i < 40; ++i)
+		ends.push_back(makeAddr(0x0a010000 + i, 3000 + i));
+	for(size_t i = 0; i < ends.size(); i += 2)
+		ASSERT_TRUE(addRelay(ends[i], ends[i + 1]));
+
+	for(size_t i = 0; i < ends.size(); ++i)
+		EXPECT_EQ(1, receive(relayPacket(ends[i], ends[i ^ 1], 50)));
+
+	ASSERT_EQ(ends.size(), mPublisher.mTo.size());
+	for(size_t i = 0; i < ends.size(); ++i)
+		EXPECT_TRUE(sameAddr(ends[i ^ 1], mPublisher.mTo[i]));
+
+	std::list<UdpRelayProxy> proxies;
+	mRelay.getRelayProxies(proxies);
+	EXPECT_EQ(ends.size(), proxies.size());
+}
+
+TEST_F(UdpRelayTest, DropsOverBandwidthLimit)
+{
+	const uint32_t limit = 10000;
+	mRelay.setRelayClassMax(UDP_RELAY_CLASS_GENERAL, 100, limit);
+	ASSERT_TRUE(addRelay(mA, mB));
+
+	const int size = 1000;
+	const int count = 100;
+	for(int i = 0; i < count; ++i)
+		EXPECT_EQ(1, receive(relayPacket(mA, mB, size)));
+
+	/* a burst of UDP_RELAY_BURST_SECS at the limit goes through */
+	const size_t burst = limit * UDP_RELAY_BURST_SECS / (size + 16);
+	EXPECT_GE(mPublisher.mPkts.size(), burst);
+	EXPECT_LE(mPublisher.mPkts.size(), burst + 1);
+
+	std::list<UdpRelayProxy> proxies;
+	mRelay.getRelayProxies(proxies);
+	uint32_t dropped = 0;
+	for(const UdpRelayProxy& proxy : proxies) dropped += proxy.mDroppedSize;
+	EXPECT_EQ((count - mPublisher.mPkts.size()) * (size + 16), dropped);
+}
+
+TEST_F(UdpRelayTest, WrapsAndUnwrapsEndPointPackets)
+{
+	sockaddr_in proxy = makeAddr(0x0a000001, 9000);
+	UdpRelayAddrSet ends(&mA, &mB);
+	CapturePeer peer;
+	ASSERT_EQ(1, mRelay.addUdpPeer(&peer, &ends, &proxy));
+
+	/* outgoing: header added, sent to the proxy */
+	std::vector<uint8_t> data(500, 0x42);
+	EXPECT_EQ(516, mRelay.sendPkt(data.data(), data.size(), mB, 64));
+	ASSERT_EQ(1u, mPublisher.mPkts.size());
+	EXPECT_TRUE(sameAddr(proxy, mPublisher.mTo[0]));
+	EXPECT_TRUE(isUdpRelayPacket(mPublisher.mPkts[0].data(), 516));
+
+	/* incoming from the other end: header removed, handed to the peer */
+	std::vector<uint8_t> pkt = relayPacket(mB, mA, 200);
+	EXPECT_EQ(1, receive(pkt));
+	ASSERT_EQ(1u, peer.mPkts.size());
+	EXPECT_EQ(std::vector<uint8_t>(pkt.begin() + 16, pkt.end()), peer.mPkts[0]);
+
+	mRelay.removeUdpPeer(&peer);
+	EXPECT_EQ(0, mRelay.sendPkt(data.data(), data.size(), mB, 64));
+	EXPECT_EQ(0, receive(pkt));
+}
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/retrodb_test.cc                                *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <list>
+#include <string>
+
+#include "util/retrodb.h"
+
+#define DATA_BASE_NAME "retrodb_test.db"
+
+static void fill(RetroDb& db)
+{
+	ASSERT_TRUE(db.execSQL("CREATE TABLE msgs (grpId TEXT, msgId TEXT, ts INT);"));
+
+	const char* grps[] = { "a", "a", "b", "it's" };
+	for(int i = 0; i < 4; ++i)
+	{
+		ContentValue cv;
+		cv.put("grpId", std::string(grps[i]));
+		cv.put("msgId", std::string("m") + std::to_string(i));
+		cv.put("ts", (int32_t) i);
+		ASSERT_TRUE(db.sqlInsert("msgs", "", cv));
+	}
+}
+
+static std::list<std::string> msgsOf(RetroDb& db, const std::string& grpId)
+{
+	std::list<std::string> columns;
+	columns.push_back("msgId");
+
+	std::list<RetroBind*> binds;
+	binds.push_back(new RsStringBind(grpId, 1));
+
+	std::list<std::string> result;
+	RetroCursor* c = db.sqlQuery_bind("msgs", columns, "grpId=?", binds, "ts");
+	EXPECT_TRUE(binds.empty());
+	if(!c) return result;
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		std::string msgId;
+		c->getString(0, msgId);
+		result.push_back(msgId);
+	}
+
+	delete c;
+	return result;
+}
+
+TEST(libretroshare_util, RetroDb_BoundQueries)
+{
+	remove(DATA_BASE_NAME);
+	RetroDb db(DATA_BASE_NAME, RetroDb::OPEN_READWRITE_CREATE);
+	fill(db);
+
+	/* same statement, other values */
+	EXPECT_EQ(std::list<std::string>({ "m0", "m1" }), msgsOf(db, "a"));
+	EXPECT_EQ(std::list<std::string>({ "m2" }), msgsOf(db, "b"));
+	EXPECT_EQ(std::list<std::string>({ "m0", "m1" }), msgsOf(db, "a"));
+
+	/* values are not part of the SQL text */
+	EXPECT_EQ(std::list<std::string>({ "m3" }), msgsOf(db, "it's"));
+	EXPECT_TRUE(msgsOf(db, "' OR '1'='1").empty());
+
+	db.closeDb();
+	remove(DATA_BASE_NAME);
+}
+
+TEST(libretroshare_util, RetroDb_ConcurrentCursors)
+{
+	remove(DATA_BASE_NAME);
+	RetroDb db(DATA_BASE_NAME, RetroDb::OPEN_READWRITE_CREATE);
+	fill(db);
+
+	std::list<std::string> columns;
+	columns.push_back("msgId");
+
+	std::list<RetroBind*> binds;
+	binds.push_back(new RsStringBind("a", 1));
+	RetroCursor* first = db.sqlQuery_bind("msgs", columns, "grpId=?", binds, "ts");
+	ASSERT_TRUE(first);
+	ASSERT_TRUE(first->moveToFirst());
+
+	/* the cached statement is busy, this one gets its own */
+	binds.push_back(new RsStringBind("b", 1));
+	RetroCursor* second = db.sqlQuery_bind("msgs", columns, "grpId=?", binds, "ts");
+	ASSERT_TRUE(second);
+	ASSERT_TRUE(second->moveToFirst());
+
+	std::string msgId;
+	first->getString(0, msgId);
+	EXPECT_EQ("m0", msgId);
+	second->getString(0, msgId);
+	EXPECT_EQ("m2", msgId);
+
+	ASSERT_TRUE(first->moveToNext());
+	first->getString(0, msgId);
+	EXPECT_EQ("m1", msgId);
+	EXPECT_FALSE(first->moveToNext());
+	EXPECT_FALSE(second->moveToNext());
+
+	delete second;
+	delete first;
+
+	/* both released, the cached one is still good */
+	EXPECT_EQ(std::list<std::string>({ "m2" }), msgsOf(db, "b"));
+
+	/* bad SQL gives no cursor and doesn't leak the bindings */
+	binds.push_back(new RsStringBind("a", 1));
+	EXPECT_FALSE(db.sqlQuery_bind("msgs", columns, "nocolumn=?", binds, ""));
+	EXPECT_TRUE(binds.empty());
+
+	db.closeDb();
+	remove(DATA_BASE_NAME);
+}
+
+TEST(libretroshare_util, RetroDb_NestedTransactions)
+{
+	remove(DATA_BASE_NAME);
+	RetroDb db(DATA_BASE_NAME, RetroDb::OPEN_READWRITE_CREATE);
+	EXPECT_TRUE(db.setWalMode());
+	EXPECT_TRUE(db.setSynchronous(RetroDb::SYNCHRONOUS_NORMAL));
+	EXPECT_FALSE(db.setSynchronous(RetroDb::SYNCHRONOUS_EXTRA + 1));
+	fill(db);
+
+	ContentValue cv;
+	cv.put("grpId", std::string("c"));
+	cv.put("ts", (int32_t) 10);
+
+	ASSERT_TRUE(db.beginTransaction());
+	cv.put("msgId", std::string("kept"));
+	EXPECT_TRUE(db.sqlInsert("msgs", "", cv));
+
+	/* only the inner changes are dropped */
+	ASSERT_TRUE(db.beginTransaction());
+	cv.put("msgId", std::string("dropped"));
+	EXPECT_TRUE(db.sqlInsert("msgs", "", cv));
+	EXPECT_TRUE(db.rollbackTransaction());
+
+	ASSERT_TRUE(db.beginTransaction());
+	cv.put("msgId", std::string("released"));
+	EXPECT_TRUE(db.sqlInsert("msgs", "", cv));
+	EXPECT_TRUE(db.commitTransaction());
+
+	EXPECT_TRUE(db.commitTransaction());
+	EXPECT_FALSE(db.commitTransaction());
+
+	db.closeDb();
+
+	/* committed for real */
+	RetroDb reopened(DATA_BASE_NAME, RetroDb::OPEN_READWRITE);
+	EXPECT_EQ(std::list<std::string>({ "kept", "released" }), msgsOf(reopened, "c"));
+
+	reopened.closeDb();
+	remove(DATA_BASE_NAME);
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsiptrie_test.cc                               *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include "util/rsiptrie.h"
+#include "util/rsrandom.h"
+
+static RsIpPrefix ipv4(const char* ip, uint32_t length)
+{
+	sockaddr_storage addr;
+	sockaddr_storage_clear(addr);
+	EXPECT_TRUE(sockaddr_storage_ipv4_aton(addr, ip));
+
+	RsIpPrefix prefix;
+	EXPECT_TRUE(RsIpPrefix::fromSockaddr(addr, length, prefix));
+	return prefix;
+}
+
+TEST(libretroshare_util, RsIpPrefixTrie_LookupAndRemove)
+{
+	RsIpPrefixTrie trie;
+
+	trie.set(ipv4("10.1.0.0", 16), 1);
+	trie.set(ipv4("10.1.2.0", 24), 2);
+	trie.set(ipv4("192.168.1.7", 32), 3);
+	trie.set(ipv4("172.16.0.0", 12), 4);
+	trie.commit();
+
+	RsIpPrefix matched;
+	EXPECT_EQ(1u, trie.lookup(ipv4("10.1.2.3", 32), &matched));
+	EXPECT_EQ(ipv4("10.1.0.0", 16), matched);
+	EXPECT_EQ(3u, trie.lookup(ipv4("192.168.1.7", 32)));
+	EXPECT_EQ(0u, trie.lookup(ipv4("192.168.1.8", 32)));
+	EXPECT_EQ(4u, trie.lookup(ipv4("172.31.255.1", 32)));
+	EXPECT_EQ(0u, trie.lookup(ipv4("172.32.0.1", 32)));
+
+	// shortest prefix gone, longer one now matches
+	trie.set(ipv4("10.1.0.0", 16), 0);
+	trie.commit();
+	EXPECT_EQ(2u, trie.lookup(ipv4("10.1.2.3", 32)));
+	EXPECT_EQ(0u, trie.lookup(ipv4("10.1.3.3", 32)));
+	EXPECT_EQ(0u, trie.find(ipv4("10.1.0.0", 16)));
+	EXPECT_EQ(2u, trie.find(ipv4("10.1.2.0", 24)));
+}
+
+TEST(libretroshare_util, RsIpPrefixTrie_ChangesVisibleOnCommit)
+{
+	RsIpPrefixTrie trie;
+
+	trie.set(ipv4("1.2.3.4", 32), 1);
+	EXPECT_EQ(0u, trie.lookup(ipv4("1.2.3.4", 32)));
+	trie.commit();
+	EXPECT_EQ(1u, trie.lookup(ipv4("1.2.3.4", 32)));
+
+	trie.set(ipv4("1.2.3.4", 32), 0);
+	trie.set(ipv4("5.6.7.8", 32), 2);
+	EXPECT_EQ(1u, trie.lookup(ipv4("1.2.3.4", 32)));
+	EXPECT_EQ(0u, trie.lookup(ipv4("5.6.7.8", 32)));
+	trie.commit();
+	EXPECT_EQ(0u, trie.lookup(ipv4("1.2.3.4", 32)));
+	EXPECT_EQ(2u, trie.lookup(ipv4("5.6.7.8", 32)));
+
+	trie.clear();
+	trie.commit();
+	EXPECT_EQ(0u, trie.lookup(ipv4("5.6.7.8", 32)));
+}
+
+TEST(libretroshare_util, RsIpPrefixTrie_MatchesBruteForce)
+{
+	RsIpPrefixTrie trie;
+	std::map<RsIpPrefix, uint32_t> entries;
+
+	/* Random prefixes in a small address space, so they overlap a lot */
+	auto randomPrefix = []()
+	{
+		sockaddr_storage addr;
+		sockaddr_storage_clear(addr);
+		sockaddr_in& in = reinterpret_cast<sockaddr_in&>(addr);
+		in.sin_family = AF_INET;
+		in.sin_addr.s_addr = htonl(0x0a000000 | (RsRandom::random_u32() & 0x3ff));
+
+		RsIpPrefix prefix;
+		RsIpPrefix::fromSockaddr(addr, 20 + RsRandom::random_u32() % 13, prefix);
+		return prefix;
+	};
+
+	for(int round = 0; round < 50; ++round)
+	{
+		for(int i = 0; i < 40; ++i)
+		{
+			RsIpPrefix prefix = randomPrefix();
+			uint32_t value = RsRandom::random_u32() % 4;
+			trie.set(prefix, value);
+			if(value) entries[prefix] = value;
+			else entries.erase(prefix);
+		}
+		trie.commit();
+
+		for(int i = 0; i < 200; ++i)
+		{
+			RsIpPrefix ip = randomPrefix();
+			ip.truncate(128);
+
+			uint32_t expected = 0;
+			uint32_t expectedLength = 129;
+			for(auto& it : entries)
+				if(it.first.contains(ip) && it.first.mLength < expectedLength)
+				{
+					expected = it.second;
+					expectedLength = it.first.mLength;
+				}
+
+			ASSERT_EQ(expected, trie.lookup(ip));
+		}
+	}
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsrcu_test.cc                                  *
+ *                                                                             *
+ * Copyright 2026 by retroshare team <contact@retroshare.cc>                   *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "util/rsrcu.h"
+
+/// Counts the live versions, and poisons freed ones for readers to notice
+struct RcuVersion
+{
+	explicit RcuVersion(std::atomic<int>& live, int value) :
+	    mLive(live), mValue(value) { ++mLive; }
+	~RcuVersion() { mValue = -1; --mLive; }
+
+	std::atomic<int>& mLive;
+	std::atomic<int> mValue;
+};
+
+TEST(libretroshare_util, RsRcuPtr_FreesOnlyVersionsNoReaderSees)
+{
+	std::atomic<int> live(0);
+	{
+		RsRcuPtr<RcuVersion> ptr;
+		ptr.publish(std::make_shared<RcuVersion>(live, 1));
+
+		std::thread reader;
+		std::atomic<int> step(0);
+		std::atomic<int> seen(0);
+
+		/* a reader holding the first version */
+		reader = std::thread([&]()
+		{
+			RsRcuReadLock rcu;
+			const RcuVersion* v = ptr.get();
+			step = 1;
+			while(step != 2) std::this_thread::yield();
+			seen = v->mValue.load();
+		});
+		while(step != 1) std::this_thread::yield();
+
+		ptr.publish(std::make_shared<RcuVersion>(live, 2));
+		EXPECT_EQ(2, live.load());
+
+		/* a reader entering later doesn't hold back the third version */
+		ptr.publish(std::make_shared<RcuVersion>(live, 3));
+		{
+			RsRcuReadLock rcu;
+			RsRcuReadLock nested;
+			EXPECT_EQ(3, ptr.get()->mValue.load());
+		}
+		EXPECT_EQ(3, live.load());
+
+		step = 2;
+		reader.join();
+		EXPECT_EQ(1, seen.load());
+
+		ptr.reclaim();
+		EXPECT_EQ(1, live.load());
+	}
+	EXPECT_EQ(0, live.load());
+}
+
+TEST(libretroshare_util, RsRcuPtr_ConcurrentReaders)
+{
+	std::atomic<int> live(0);
+	RsRcuPtr<RcuVersion> ptr;
+	ptr.publish(std::make_shared<RcuVersion>(live, 0));
+
+	std::atomic<bool> stop(false);
+	std::atomic<int> bad(0);
+	std::vector<std::thread> readers;
+
+	for(int i = 0; i < 4; ++i)
+		readers.push_back(std::thread([&]()
+		{
+			int last = 0;
+			while(!stop)
+			{
+				RsRcuReadLock rcu;
+				int value = ptr.get()->mValue.load();
+				if(value < last) ++bad; // freed, or went back in time
+				last = value;
+			}
+		}));
+
+	for(int i = 1; i <= 20000; ++i)
+		ptr.publish(std::make_shared<RcuVersion>(live, i));
+
+	stop = true;
+	for(std::thread& t : readers) t.join();
+
+	ptr.reclaim();
+	EXPECT_EQ(0, bad.load());
+	EXPECT_EQ(1, live.load());
+}
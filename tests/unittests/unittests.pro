@@ -27,6 +27,10 @@ gxs {
 	DEFINES += RS_ENABLE_GXS
 }
 
+rs_ktls {
+	DEFINES *= RS_KTLS
+}
+
 TEMPLATE = app
 TARGET = unittests
 
@@ -294,6 +298,28 @@ SOURCES +=  unittests.cc \
 
 SOURCES += libretroshare/crypto/chacha20_test.cc
 
+################################ pqi ###################################
+
+SOURCES +=  libretroshare/pqi/pqicompression_test.cc \
+		libretroshare/pqi/pqiqos_test.cc \
+		libretroshare/pqi/pqibwalloc_test.cc \
+		libretroshare/pqi/sslsessioncache_test.cc \
+		libretroshare/pqi/sslcertcache_test.cc \
+		libretroshare/pqi/pqiperson_test.cc \
+		libretroshare/pqi/p3servicecontrol_test.cc \
+		libretroshare/pqi/pqissl_ktls_test.cc
+
+################################ util ##################################
+
+SOURCES +=  libretroshare/util/rsiptrie_test.cc \
+            libretroshare/util/rsrcu_test.cc \
+            libretroshare/util/retrodb_test.cc
+
+############################### tcponudp ###############################
+
+SOURCES +=  libretroshare/tcponudp/tcpstream_test.cc \
+            libretroshare/tcponudp/udprelay_test.cc
+
 ################################ Serialiser ################################
 HEADERS +=  libretroshare/serialiser/support.h \
 	libretroshare/serialiser/rstlvutil.h \
@@ -303,6 +329,7 @@ SOURCES +=  libretroshare/serialiser/rsturtleitem_test.cc \
 		libretroshare/serialiser/rsgxsupdateitem_test.cc \
 		libretroshare/serialiser/rsmsgitem_test.cc \
 		libretroshare/serialiser/rsstatusitem_test.cc \
+		libretroshare/serialiser/rsrawitem_test.cc \
 		libretroshare/serialiser/rsnxsitems_test.cc \
 		libretroshare/serialiser/rsgxsiditem_test.cc \
 #		libretroshare/serialiser/rsphotoitem_test.cc \
@@ -371,6 +398,8 @@ HEADERS += libretroshare/gxs/data_service/rsdataservice_test.h \
 
 SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 	libretroshare/gxs/data_service/rsgxsdata_test.cc \
+	libretroshare/gxs/data_service/rsgxsblobstore_test.cc \
+	libretroshare/gxs/data_service/rsdataservice_page_test.cc \
 
 
 ################################ dbase #####################################